@@ -1,11 +1,11 @@
-import React, { createContext, useCallback, useState, useEffect, ReactNode } from 'react';
+import React, { createContext, useCallback, useMemo, useState, useEffect, ReactNode } from 'react';
 import { 
   AlgorithmType, 
   AlgorithmOperation, 
   ExecutionStep,
   AlgorithmOperationRequest
 } from '@shared/schema';
-import { performAlgorithmOperation } from '@/lib/algorithm-wasm';
+import { performAlgorithmOperation, AlgorithmTrace } from '@/lib/algorithm-wasm';
 import { apiRequest } from '@/lib/queryClient';
 
 interface AlgorithmContextProps {
@@ -21,7 +21,6 @@ interface AlgorithmContextProps {
   } | null;
   selectAlgorithm: (type: AlgorithmType) => void;
   currentStep: ExecutionStep | null;
-  executionSteps: ExecutionStep[];
   isPlaying: boolean;
   togglePlay: () => void;
   stepForward: () => void;
@@ -39,7 +38,6 @@ export const AlgorithmContext = createContext<AlgorithmContextProps>({
   currentAlgorithm: null,
   selectAlgorithm: () => {},
   currentStep: null,
-  executionSteps: [],
   isPlaying: false,
   togglePlay: () => {},
   stepForward: () => {},
@@ -132,20 +130,21 @@ const algorithmComplexityMap: Record<AlgorithmType, { time: string, space: strin
 export const AlgorithmProvider: React.FC<AlgorithmProviderProps> = ({ children }) => {
   // State for current algorithm and execution
   const [currentAlgorithm, setCurrentAlgorithm] = useState<AlgorithmContextProps['currentAlgorithm']>(null);
-  const [executionSteps, setExecutionSteps] = useState<ExecutionStep[]>([]);
+  const [trace, setTrace] = useState<AlgorithmTrace | null>(null);
   const [currentStepIndex, setCurrentStepIndex] = useState<number>(0);
   const [isPlaying, setIsPlaying] = useState<boolean>(false);
   const [speed, setSpeed] = useState<number>(3);
   const [operationValue, setOperationValue] = useState<number>(42);
   const [playInterval, setPlayInterval] = useState<number | undefined>(undefined);
 
-  // Compute current step from index
-  const currentStep = executionSteps.length > 0 && currentStepIndex < executionSteps.length
-    ? executionSteps[currentStepIndex]
-    : null;
+  // Current step, read from the trace's window around the index
+  const currentStep = useMemo(
+    () => (trace ? trace.step(currentStepIndex) : null),
+    [trace, currentStepIndex]
+  );
 
-  // Total steps
-  const totalSteps = executionSteps.length;
+  // Total steps (known after the current step has been read)
+  const totalSteps = trace ? trace.totalSteps : 0;
 
   // Select an algorithm
   const selectAlgorithm = useCallback((type: AlgorithmType) => {
@@ -156,19 +155,19 @@ export const AlgorithmProvider: React.FC<AlgorithmProviderProps> = ({ children }
       description: algorithmDescriptionMap[type] || '',
       complexity: algorithmComplexityMap[type] || { time: 'Unknown', space: 'Unknown' }
     });
-    setExecutionSteps([]);
+    setTrace(null);
     setCurrentStepIndex(0);
     setIsPlaying(false);
   }, []);
 
   // Step forward in the execution
   const stepForward = useCallback(() => {
-    if (currentStepIndex < executionSteps.length - 1) {
+    if (currentStepIndex < totalSteps - 1) {
       setCurrentStepIndex(prev => prev + 1);
     } else if (isPlaying) {
       setIsPlaying(false);
     }
-  }, [currentStepIndex, executionSteps.length, isPlaying]);
+  }, [currentStepIndex, totalSteps, isPlaying]);
 
   // Step backward in the execution
   const stepBackward = useCallback(() => {
@@ -202,13 +201,13 @@ export const AlgorithmProvider: React.FC<AlgorithmProviderProps> = ({ children }
 
       // In a real implementation, this would call the backend API
       // For now, we'll use the WASM module directly
-      const steps = await performAlgorithmOperation(
+      const operationTrace = await performAlgorithmOperation(
         currentAlgorithm.type,
         operation,
         operationValue
       );
       
-      setExecutionSteps(steps);
+      setTrace(operationTrace);
       setCurrentStepIndex(0);
       setIsPlaying(true);
     } catch (error) {
@@ -253,7 +252,6 @@ export const AlgorithmProvider: React.FC<AlgorithmProviderProps> = ({ children }
     currentAlgorithm,
     selectAlgorithm,
     currentStep,
-    executionSteps,
     isPlaying,
     togglePlay,
     stepForward,
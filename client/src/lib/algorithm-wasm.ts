@@ -1,7 +1,8 @@
-import { AlgorithmType, AlgorithmOperation, ExecutionStep } from '@shared/schema';
+import { AlgorithmType, AlgorithmOperation, AlgorithmState, ExecutionStep } from '@shared/schema';
+import { StepBuffer, STEP_HIGHLIGHTED, STEP_SWAPPING } from './step-buffer';
 
 // Type to represent a WASM module interface
-interface AlgorithmModule {
+export interface AlgorithmModule {
   _performOperation: (
     algorithmType: number, 
     operation: number, 
@@ -11,6 +12,7 @@ interface AlgorithmModule {
   _getCurrentStep: () => number;
   _getStepData: (step: number) => number;
   _freeStepData: (ptr: number) => void;
+  _getStepBuffer: (firstStep: number, count: number) => number;
   HEAPU8: Uint8Array;
 }
 
@@ -73,6 +75,122 @@ export async function initAlgorithmWasm(): Promise<void> {
   }
 }
 
+// Steps decoded per step buffer request; only this window of the trace is
+// held on the JavaScript side
+const STEP_WINDOW = 64;
+
+// Color of elements the engine marks as being swapped
+const SWAPPING_COLOR = '#ff4081';
+
+/**
+ * The steps of one operation, read from the module's step buffer a window
+ * at a time around the step being shown, so memory stays bounded by the
+ * window instead of growing with the trace
+ */
+export class AlgorithmTrace {
+  private total: number;
+  private complete = false; // The last window read reached the end of the trace
+  private windowFirst = 0;
+  private window: ExecutionStep[] = [];
+
+  constructor(
+    private readonly module: AlgorithmModule,
+    private readonly type: AlgorithmType,
+    private readonly operation: AlgorithmOperation,
+    private readonly value: number
+  ) {
+    this.total = module._getStepCount();
+  }
+
+  /** Steps recorded so far (lazy traces grow as later steps are read) */
+  get totalSteps(): number {
+    return this.total;
+  }
+
+  /** The step at a 0-based index, or null past the end of the trace */
+  step(index: number): ExecutionStep | null {
+    if (index < 0 || index >= this.total) {
+      return null;
+    }
+    const windowEnd = this.windowFirst + this.window.length;
+    // At the last step recorded so far a lazy trace may have more to generate
+    const atRecordedEnd = index === windowEnd - 1 && windowEnd === this.total && !this.complete;
+    if (index < this.windowFirst || index >= windowEnd || atRecordedEnd) {
+      // Keep a few steps behind the requested one so stepping back stays in the window
+      this.readWindow(Math.max(0, index - STEP_WINDOW / 4));
+    }
+    return this.window[index - this.windowFirst] ?? null;
+  }
+
+  private readWindow(first: number): void {
+    const bufferPtr = this.module._getStepBuffer(first, STEP_WINDOW);
+    this.windowFirst = first;
+    this.window = [];
+    if (!bufferPtr) {
+      // Mock module: no step buffer, so make up the window's steps
+      const end = Math.min(first + STEP_WINDOW, this.total);
+      for (let i = first; i < end; i++) {
+        this.window.push(createMockExecutionStep(this.type, this.operation, i, this.total, this.value));
+      }
+      this.complete = true;
+      return;
+    }
+    // The buffer's views are only valid until the next request, so decode now
+    const buffer = new StepBuffer(this.module.HEAPU8, bufferPtr);
+    this.total = buffer.totalSteps;
+    this.complete = buffer.firstStep + buffer.stepCount < first + STEP_WINDOW;
+    this.windowFirst = buffer.firstStep;
+    for (let i = 0; i < buffer.stepCount; i++) {
+      this.window.push(decodeStep(buffer, i, this.type, this.total));
+    }
+  }
+}
+
+// Visual state of the i-th step of a step buffer
+function decodeStep(buffer: StepBuffer, i: number, type: AlgorithmType, totalSteps: number): ExecutionStep {
+  const nodes: AlgorithmState['nodes'] = [];
+  const [firstElement, endElement] = buffer.elementRange(i);
+  for (let e = firstElement; e < endElement; e++) {
+    const flags = buffer.elementFlags(e);
+    nodes.push({
+      id: String(buffer.elementId(e)),
+      value: buffer.elementLabel(e) ?? buffer.elementValue(e),
+      x: buffer.elementX(e),
+      y: buffer.elementY(e),
+      highlighted: (flags & STEP_HIGHLIGHTED) !== 0,
+      color: flags & STEP_SWAPPING ? SWAPPING_COLOR : undefined
+    });
+  }
+
+  const edges: AlgorithmState['edges'] = [];
+  const [firstEdge, endEdge] = buffer.edgeRange(i);
+  for (let e = firstEdge; e < endEdge; e++) {
+    edges.push({
+      source: String(buffer.edgeSource(e)),
+      target: String(buffer.edgeTarget(e)),
+      value: buffer.edgeWeight(e),
+      highlighted: (buffer.edgeFlags(e) & STEP_HIGHLIGHTED) !== 0
+    });
+  }
+
+  const message = buffer.message(i);
+  return {
+    state: {
+      nodes,
+      edges,
+      step: buffer.stepNumber(i),
+      totalSteps,
+      message
+    },
+    code: {
+      content: getAlgorithmCode(type),
+      highlightLines: [],
+      language: 'cpp'
+    },
+    description: message
+  };
+}
+
 /**
  * Perform an algorithm operation using the WASM module
  */
@@ -80,7 +198,7 @@ export async function performAlgorithmOperation(
   algorithmType: AlgorithmType,
   operation: AlgorithmOperation,
   value: number
-): Promise<ExecutionStep[]> {
+): Promise<AlgorithmTrace> {
   if (!algorithmModule) {
     await initAlgorithmWasm();
     if (!algorithmModule) {
@@ -96,26 +214,8 @@ export async function performAlgorithmOperation(
     // Call WASM module to perform the operation
     algorithmModule._performOperation(typeNum, opNum, value);
     
-    // Get the number of steps that were created
-    const stepCount = algorithmModule._getStepCount();
-    
-    // Retrieve all the steps
-    const steps: ExecutionStep[] = [];
-    for (let i = 0; i < stepCount; i++) {
-      // Get data for the step from WASM
-      const stepDataPtr = algorithmModule._getStepData(i);
-      
-      // In a real implementation, this would parse binary data from WASM memory
-      // For now, we'll use mock data based on the algorithm type and operation
-      const step = createMockExecutionStep(algorithmType, operation, i, stepCount, value);
-      
-      // In a real implementation, we would need to free the memory
-      algorithmModule._freeStepData(stepDataPtr);
-      
-      steps.push(step);
-    }
-    
-    return steps;
+    // Steps are read from the module as they are shown
+    return new AlgorithmTrace(algorithmModule, algorithmType, operation, value);
   } catch (error) {
     console.error('Error executing algorithm operation:', error);
     throw error;
@@ -130,6 +230,7 @@ function createMockModule(): AlgorithmModule {
     _getCurrentStep: () => 0,
     _getStepData: () => 0,
     _freeStepData: () => {},
+    _getStepBuffer: () => 0,
     HEAPU8: new Uint8Array(0)
   };
 }
@@ -405,6 +506,28 @@ function getOperationDescription(operation: AlgorithmOperation, value: number):
   }
 }
 
+// Code shown next to a step decoded from the step buffer
+function getAlgorithmCode(type: AlgorithmType): string {
+  switch (type) {
+    case 'bst':
+      return getBSTCode();
+    case 'dfs':
+      return getDFSCode();
+    case 'bfs':
+      return getBFSCode();
+    case 'fibonacci':
+      return getFibonacciCode();
+    case 'quicksort':
+      return getQuicksortCode();
+    case 'mergesort':
+      return getMergesortCode();
+    case 'heapsort':
+      return getHeapsortCode();
+    default:
+      return '// Algorithm code would be shown here';
+  }
+}
+
 // Example code snippets for different algorithms
 function getBSTCode(): string {
   return `template <typename T>
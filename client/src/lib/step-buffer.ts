@@ -0,0 +1,125 @@
+// Reader for the binary step buffer written by the WASM algorithm modules
+// (layout documented in server/algorithms/step_buffer.h)
+
+const STEP_BUFFER_MAGIC = 0x50455453; // "STEP"
+const STEP_BUFFER_VERSION = 1;
+const HEADER_WORDS = 12;
+const STEP_WORDS = 6;
+const ELEMENT_WORDS = 6;
+const EDGE_WORDS = 4;
+
+export const NO_STRING = 0xffffffff;
+export const STEP_HIGHLIGHTED = 1;
+export const STEP_SWAPPING = 2;
+
+const textDecoder = new TextDecoder();
+
+/**
+ * Typed-array views over one step buffer in WASM memory. Nothing is copied
+ * or parsed up front; strings are decoded only when asked for. The views
+ * must not be used after the module's next buffer request or after WASM
+ * memory grows.
+ */
+export class StepBuffer {
+  readonly totalSteps: number;
+  readonly firstStep: number;
+  readonly stepCount: number;
+
+  private readonly steps: Uint32Array;
+  private readonly elementInts: Int32Array;
+  private readonly elementFloats: Float32Array;
+  private readonly edges: Int32Array;
+  private readonly stringIndex: Uint32Array;
+  private readonly stringPool: Uint8Array;
+
+  constructor(heap: Uint8Array, ptr: number) {
+    const buffer = heap.buffer;
+    const base = heap.byteOffset + ptr;
+    const header = new Uint32Array(buffer, base, HEADER_WORDS);
+    if (header[0] !== STEP_BUFFER_MAGIC || header[1] !== STEP_BUFFER_VERSION) {
+      throw new Error('Not a step buffer (version ' + STEP_BUFFER_VERSION + ')');
+    }
+
+    this.totalSteps = header[2];
+    this.firstStep = header[3];
+    this.stepCount = header[4];
+    const elementCount = header[5];
+    const edgeCount = header[6];
+    const stringCount = header[7];
+
+    this.steps = new Uint32Array(buffer, base + header[8], this.stepCount * STEP_WORDS);
+    this.elementInts = new Int32Array(buffer, base + header[9], elementCount * ELEMENT_WORDS);
+    this.elementFloats = new Float32Array(buffer, base + header[9], elementCount * ELEMENT_WORDS);
+    this.edges = new Int32Array(buffer, base + header[10], edgeCount * EDGE_WORDS);
+    this.stringIndex = new Uint32Array(buffer, base + header[11], stringCount + 1);
+    const poolStart = base + header[11] + (stringCount + 1) * 4;
+    this.stringPool = new Uint8Array(buffer, poolStart, this.stringIndex[stringCount]);
+  }
+
+  /** 1-based step number of the i-th step in the buffer */
+  stepNumber(i: number): number {
+    return this.steps[i * STEP_WORDS + 5];
+  }
+
+  message(i: number): string {
+    return this.string(this.steps[i * STEP_WORDS + 4]);
+  }
+
+  /** Element records of step i as [first, end) record indices */
+  elementRange(i: number): [number, number] {
+    const first = this.steps[i * STEP_WORDS];
+    return [first, first + this.steps[i * STEP_WORDS + 1]];
+  }
+
+  /** Edge records of step i as [first, end) record indices */
+  edgeRange(i: number): [number, number] {
+    const first = this.steps[i * STEP_WORDS + 2];
+    return [first, first + this.steps[i * STEP_WORDS + 3]];
+  }
+
+  elementId(e: number): number {
+    return this.elementInts[e * ELEMENT_WORDS];
+  }
+
+  elementValue(e: number): number {
+    return this.elementInts[e * ELEMENT_WORDS + 1];
+  }
+
+  elementX(e: number): number {
+    return this.elementFloats[e * ELEMENT_WORDS + 2];
+  }
+
+  elementY(e: number): number {
+    return this.elementFloats[e * ELEMENT_WORDS + 3];
+  }
+
+  elementFlags(e: number): number {
+    return this.elementInts[e * ELEMENT_WORDS + 4] >>> 0;
+  }
+
+  /** Text label of an element (DP cells), or null for plain values */
+  elementLabel(e: number): string | null {
+    const label = this.elementInts[e * ELEMENT_WORDS + 5] >>> 0;
+    return label === NO_STRING ? null : this.string(label);
+  }
+
+  edgeSource(e: number): number {
+    return this.edges[e * EDGE_WORDS];
+  }
+
+  edgeTarget(e: number): number {
+    return this.edges[e * EDGE_WORDS + 1];
+  }
+
+  edgeWeight(e: number): number {
+    return this.edges[e * EDGE_WORDS + 2];
+  }
+
+  edgeFlags(e: number): number {
+    return this.edges[e * EDGE_WORDS + 3] >>> 0;
+  }
+
+  private string(index: number): string {
+    return textDecoder.decode(this.stringPool.subarray(this.stringIndex[index], this.stringIndex[index + 1]));
+  }
+}
@@ -0,0 +1,98 @@
+// C interface exported by the algorithm modules (sort, graph, dp, tree).
+// The same functions are exported from the WebAssembly builds; native
+// builds link the modules into one library for tools such as the benchmark.
+//
+// Steps can be read one at a time as JSON (get*StepData) or as a window
+// in the flat binary layout of step_buffer.h (get*StepBuffer).
+//
+// Each module has a trace mode (0 = full, 1 = coarse, 2 = off, see
+// trace_policy.h) that applies to its subsequent perform* calls. Sorting,
+// graph and DP traces can also be generated lazily (set*LazySteps): steps
+// are then produced as they are requested and the step count grows until
+// is*StepsComplete returns 1.
+
+#ifndef ALGORITHMS_H
+#define ALGORITHMS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sorting (sort.cpp)
+int performSortingOperation(int algorithm, int arraySize);
+int getSortingStepCount();
+char* getSortingStepData(int step);
+void freeSortingStepData(char* ptr);
+const unsigned char* getSortingStepBuffer(int firstStep, int count);
+int getSortingStepBufferSize();
+void setSortingTraceMode(int mode);
+int sortIntArray(int* data, int size, int algorithm);
+const char* getSortingKernelName();
+void setSortingParallel(int enabled);
+int getSortingThreadCount();
+void setSortingLazySteps(int window);
+int isSortingStepsComplete();
+
+// Graph (graph.cpp)
+int performGraphOperation(int algorithm, int startNode);
+int getGraphStepCount();
+char* getGraphStepData(int step);
+void freeGraphStepData(char* ptr);
+const unsigned char* getGraphStepBuffer(int firstStep, int count);
+int getGraphStepBufferSize();
+void setGraphTraceMode(int mode);
+void setGraphLazySteps(int window);
+int isGraphStepsComplete();
+void setGraphTraceCacheBudget(int megabytes);
+void resetGraph();
+int addGraphNode();
+void addGraphEdge(int source, int target, int weight);
+int removeGraphEdge(int source, int target);
+int setGraphEdgeWeight(int source, int target, int weight);
+int removeGraphNode(int node);
+void setGraphPathRepair(int enabled);
+void setGraphDijkstraQueue(int queue);
+int computeShortestPaths(int startNode, int queue, int* distances);
+void setGraphDeltaSteppingWidth(int delta);
+int computeDeltaSteppingPaths(int startNode, int delta, int* distances);
+int computeSpanningForest(int algorithm, int startNode, int* edges, long long* weight);
+void setGraphPathQuery(int target, int method);
+int computePointToPointPath(int source, int target, int method, int* distance);
+int saveContractionHierarchy(const char* path);
+int loadContractionHierarchy(const char* path);
+int computeParallelBfs(int startNode, int* depths);
+int computeMultiSourceBfs(const int* sources, int count, int* reached, long long* distanceSums,
+                          int* eccentricities, int* depths);
+int loadGraphFile(const char* path, int format);
+int generateGraph(int kind, int nodes, int degree, int seed);
+int reorderGraph(int order);
+int saveGraphFile(const char* path);
+int computeGraphLayout(int incremental, double* positions);
+
+// Dynamic programming (dp.cpp)
+int performDPOperation(int algorithm, int param1, int param2);
+int performLCSOperation(const char* str1, const char* str2);
+int getDPStepCount();
+char* getDPStepData(int step);
+void freeDPStepData(char* ptr);
+const unsigned char* getDPStepBuffer(int firstStep, int count);
+int getDPStepBufferSize();
+void setDPTraceMode(int mode);
+void setDPLazySteps(int window);
+int isDPStepsComplete();
+
+// Binary search tree (tree.cpp)
+int performOperation(int operation, int value);
+int getStepCount();
+char* getStepData(int step);
+void freeStepData(char* ptr);
+const unsigned char* getStepBuffer(int firstStep, int count);
+int getStepBufferSize();
+void setTreeTraceMode(int mode);
+void resetTree();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALGORITHMS_H
@@ -0,0 +1,834 @@
+// Native benchmark harness for the algorithm modules
+//
+// Times each engine through the same C interface the WebAssembly builds
+// export and prints one JSON record per (algorithm, input size):
+//
+//   algorithm_bench [--quick] [--filter <substring>] [--trace full|coarse|off]
+//
+// ns_per_op is wall time per operation (one full traced run, or one BST
+// insert/search), steps_per_sec counts recorded visualization steps,
+// cache_misses_per_op counts hardware cache misses of the calling thread
+// in the timed runs (null where perf events are unavailable), and
+// peak_rss_kb is the process high-water mark after the case has run.
+//
+// Cases with a reference check the result of their last timed run against
+// it outside the timing (sorted order, distances, forest weights); the
+// harness reports each mismatch and exits non-zero.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "algorithms.h"
+#include "step_buffer.h"
+#include "trace_policy.h"
+
+using namespace std;
+
+namespace {
+
+struct BenchCase {
+    string module;
+    string algorithm;
+    vector<int> sizes;
+    function<void(int)> setup;  // Untimed preparation for a given size
+    function<long(int)> run;    // Timed body, returns the number of steps recorded
+    function<int(int)> opsPerRun = nullptr; // Operations performed by one run (defaults to 1)
+    function<string(int)> check = nullptr; // Untimed check of the last run, returns the mismatch or ""
+};
+
+struct BenchResult {
+    long reps;
+    double nsPerOp;
+    long steps;
+    double stepsPerSec;
+    double cacheMissesPerOp; // -1 when not counted
+    long peakRssKb;
+};
+
+const double MIN_BENCH_SECONDS = 0.2;
+const long MIN_REPS = 3;
+const long MAX_REPS = 1000;
+
+// Trace mode selected with --trace, for cases that run untraced and restore it
+int benchTraceMode = TRACE_FULL;
+
+long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+// Hardware cache misses of the calling thread (worker threads started
+// before it are not counted) while running, through perf events
+class CacheMissCounter {
+public:
+    CacheMissCounter() : fd(-1) {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool available() const {
+        return fd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    // Misses counted while running so far
+    long long count() const {
+        long long misses = 0;
+#ifdef __linux__
+        if (fd >= 0 && read(fd, &misses, sizeof(misses)) != sizeof(misses)) misses = 0;
+#endif
+        return misses;
+    }
+
+private:
+    int fd;
+};
+
+// Build a connected random graph with about 4 edges per node
+void buildRandomGraph(int nodes, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_int_distribution<> weight(1, 20);
+    resetGraph();
+    for (int i = 0; i < nodes; i++) {
+        addGraphNode();
+    }
+    for (int i = 1; i < nodes; i++) {
+        addGraphEdge(gen() % i, i, weight(gen));
+    }
+    for (int i = 0; i < 3 * nodes; i++) {
+        addGraphEdge(gen() % nodes, gen() % nodes, weight(gen));
+    }
+}
+
+// Build a dense graph: each pair of nodes joined with probability 1/4,
+// weights 1 to 1000
+void buildDenseGraph(int nodes, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_int_distribution<> weight(1, 1000);
+    resetGraph();
+    for (int i = 0; i < nodes; i++) {
+        addGraphNode();
+    }
+    for (int i = 0; i < nodes; i++) {
+        for (int j = i + 1; j < nodes; j++) {
+            if (gen() % 4 == 0) {
+                addGraphEdge(i, j, weight(gen));
+            }
+        }
+    }
+}
+
+// Generator kinds of generateGraph (see graph_generators.h)
+const int GENERATOR_RMAT = 0;
+const int GENERATOR_GRID = 2;
+
+// Build a power-law R-MAT graph of 8 edges per node, once per size
+void preparePowerLawGraph(int nodes) {
+    static int builtNodes = -1;
+    if (builtNodes == nodes) {
+        return;
+    }
+    generateGraph(GENERATOR_RMAT, nodes, 16, 42);
+    builtNodes = nodes;
+}
+
+// Generate an R-MAT or road-like grid graph renumbered in a NodeOrder
+// (see graph_reorder.h) once per (kind, order, size), frozen outside the
+// timed runs
+void prepareOrderedGraph(bool road, int order, int nodes) {
+    static int builtNodes = -1;
+    static bool builtRoad = false;
+    static int builtOrder = -1;
+    if (builtNodes == nodes && builtRoad == road && builtOrder == order) {
+        return;
+    }
+    generateGraph(road ? GENERATOR_GRID : GENERATOR_RMAT, nodes, road ? 0 : 16, 42);
+    reorderGraph(order);
+    computeShortestPaths(-1, 0, nullptr);
+    builtNodes = nodes;
+    builtRoad = road;
+    builtOrder = order;
+}
+
+// Build a graph for the shortest path cases once per (kind, size) and
+// freeze it outside the timed runs (node -1 computes nothing)
+void prepareShortestPathGraph(bool road, int nodes) {
+    static int builtNodes = -1;
+    static bool builtRoad = false;
+    if (builtNodes == nodes && builtRoad == road) {
+        return;
+    }
+    if (road) {
+        generateGraph(GENERATOR_GRID, nodes, 0, 42);
+    } else {
+        buildRandomGraph(nodes, 42);
+    }
+    computeShortestPaths(-1, 0, nullptr);
+    builtNodes = nodes;
+    builtRoad = road;
+}
+
+// Build a graph for the spanning tree cases once per (kind, size) and
+// freeze it outside the timed runs
+void prepareSpanningTreeGraph(bool dense, int nodes) {
+    static int builtNodes = -1;
+    static bool builtDense = false;
+    if (builtNodes == nodes && builtDense == dense) {
+        return;
+    }
+    if (dense) {
+        buildDenseGraph(nodes, 42);
+    } else {
+        buildRandomGraph(nodes, 42);
+    }
+    computeShortestPaths(-1, 0, nullptr);
+    builtNodes = nodes;
+    builtDense = dense;
+}
+
+// Scratch files of the graph loading cases
+string graphFilePath(const char* extension) {
+    return (filesystem::temp_directory_path() / (string("algorithm_bench_graph") + extension)).string();
+}
+
+// Write a random graph of about 4 edges per node as an edge list, and its
+// binary CSR form, once per size
+void prepareGraphFiles(int nodes) {
+    static int writtenNodes = -1;
+    if (writtenNodes == nodes) {
+        return;
+    }
+    mt19937 gen(42);
+    FILE* out = fopen(graphFilePath(".txt").c_str(), "w");
+    for (int i = 0; i < 4 * nodes; i++) {
+        fprintf(out, "%d %d %d\n", (int)(gen() % nodes), (int)(gen() % nodes), (int)(1 + gen() % 20));
+    }
+    fclose(out);
+    loadGraphFile(graphFilePath(".txt").c_str(), 0);
+    saveGraphFile(graphFilePath(".csr").c_str());
+    writtenNodes = nodes;
+}
+
+string randomString(int length, unsigned seed) {
+    mt19937 gen(seed);
+    string s(length, 'A');
+    for (auto& c : s) {
+        c = 'A' + gen() % 4;
+    }
+    return s;
+}
+
+vector<int> randomValues(int count, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_int_distribution<> dis(1, 1000000);
+    vector<int> values(count);
+    for (auto& v : values) {
+        v = dis(gen);
+    }
+    return values;
+}
+
+// Element values of the first step in a step buffer
+vector<int> stepValues(const unsigned char* buffer) {
+    StepBufferHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    vector<int> values;
+    if (header.stepCount == 0) {
+        return values;
+    }
+    StepBufferStep record;
+    memcpy(&record, buffer + header.stepsOffset, sizeof(record));
+    for (uint32_t e = record.firstElement; e < record.firstElement + record.elementCount; e++) {
+        StepBufferElement element;
+        memcpy(&element, buffer + header.elementsOffset + e * sizeof(element), sizeof(element));
+        values.push_back(element.value);
+    }
+    return values;
+}
+
+// Element values of one step of the sorting trace
+vector<int> sortingStepValues(int step) {
+    return stepValues(getSortingStepBuffer(step, 1));
+}
+
+// A traced Fibonacci run ends with the table F(0)..F(n), computed here in
+// 64 bits
+string checkFibonacciTrace(int n) {
+    int steps = getDPStepCount();
+    if (steps == 0) {
+        return "";
+    }
+    vector<int64_t> expected(n + 1, 0);
+    for (int i = 1; i <= n; i++) {
+        expected[i] = i == 1 ? 1 : expected[i - 1] + expected[i - 2];
+    }
+    vector<int> values = stepValues(getDPStepBuffer(steps - 1, 1));
+    return equal(values.begin(), values.end(), expected.begin(), expected.end()) ? "" : "wrong Fibonacci table";
+}
+
+// A traced sort ends in the sorted form of the array it starts from
+string checkSortTrace(int) {
+    int steps = getSortingStepCount();
+    if (steps == 0) {
+        return "";
+    }
+    vector<int> expected = sortingStepValues(0);
+    sort(expected.begin(), expected.end());
+    return sortingStepValues(steps - 1) == expected ? "" : "last step is not the sorted array";
+}
+
+// Distances from source by another engine than the benchmarked one:
+// delta-stepping to check Dijkstra, otherwise Dijkstra on the d-ary heap
+// from scratch (path repair is switched back on afterwards)
+vector<int> referenceDistances(int source, int nodes, bool deltaStepping) {
+    vector<int> distances(nodes);
+    if (deltaStepping) {
+        computeDeltaSteppingPaths(source, 0, distances.data());
+    } else {
+        setGraphPathRepair(0);
+        computeShortestPaths(source, 0, distances.data());
+        setGraphPathRepair(1);
+    }
+    return distances;
+}
+
+// Index of the first node whose distance differs, as a mismatch message
+string compareDistances(const vector<int>& actual, const vector<int>& expected) {
+    for (size_t node = 0; node < expected.size(); node++) {
+        if (actual[node] != expected[node]) {
+            return "distance of node " + to_string(node) + " is " + to_string(actual[node]) + ", expected " +
+                   to_string(expected[node]);
+        }
+    }
+    return "";
+}
+
+BenchResult measure(const BenchCase& bench, int size) {
+    using Clock = chrono::steady_clock;
+
+    long reps = 0;
+    long steps = 0;
+    double seconds = 0;
+    CacheMissCounter misses;
+
+    while (reps < MAX_REPS && (reps < MIN_REPS || seconds < MIN_BENCH_SECONDS)) {
+        if (bench.setup) {
+            bench.setup(size);
+        }
+        misses.start();
+        auto start = Clock::now();
+        steps = bench.run(size);
+        seconds += chrono::duration<double>(Clock::now() - start).count();
+        misses.stop();
+        reps++;
+    }
+
+    int ops = bench.opsPerRun ? bench.opsPerRun(size) : 1;
+    BenchResult result;
+    result.reps = reps;
+    result.nsPerOp = seconds * 1e9 / (reps * (double)ops);
+    result.steps = steps;
+    result.stepsPerSec = seconds > 0 ? steps * reps / seconds : 0;
+    result.cacheMissesPerOp = misses.available() ? misses.count() / (reps * (double)ops) : -1;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+vector<BenchCase> createBenchCases(bool quick) {
+    auto sizes = [quick](vector<int> all) {
+        return quick ? vector<int>{all.front()} : all;
+    };
+
+    vector<BenchCase> cases;
+
+    // Sorting: one traced sort of a random array per run
+    const char* sortNames[] = {"quickSort", "mergeSort", "heapSort", "radixSort"};
+    for (int algorithm = 0; algorithm < 4; algorithm++) {
+        cases.push_back({"sort", sortNames[algorithm], sizes({100, 1000, 10000}), nullptr,
+                         [algorithm](int n) { return (long)performSortingOperation(algorithm, n); }});
+        cases.back().check = checkSortTrace;
+    }
+
+    // Sorting without tracing on caller-owned arrays of full-range ints,
+    // with std::sort as the reference
+    static vector<int> sortInput;
+    auto fillSortInput = [](int n) { sortInput = randomValues(n, 11); };
+    auto checkSortedInput = [](int n) {
+        vector<int> expected = randomValues(n, 11);
+        sort(expected.begin(), expected.end());
+        return sortInput == expected ? string() : string("array is not the sorted input");
+    };
+    for (int algorithm = 0; algorithm < 4; algorithm++) {
+        cases.push_back({"sort", string(sortNames[algorithm]) + "Array", sizes({100000, 1000000, 10000000}),
+                         fillSortInput,
+                         [algorithm](int n) { sortIntArray(sortInput.data(), n, algorithm); return 0L; }});
+        cases.back().check = checkSortedInput;
+    }
+    for (int algorithm = 0; algorithm < 2; algorithm++) {
+        cases.push_back({"sort", string(sortNames[algorithm]) + "ArrayParallel", sizes({1000000, 10000000, 50000000}),
+                         fillSortInput,
+                         [algorithm](int n) {
+                             setSortingParallel(1);
+                             sortIntArray(sortInput.data(), n, algorithm);
+                             setSortingParallel(0);
+                             return 0L;
+                         }});
+        cases.back().check = checkSortedInput;
+    }
+    cases.push_back({"sort", "stdSortArray", sizes({100000, 1000000, 10000000}), fillSortInput,
+                     [](int) { sort(sortInput.begin(), sortInput.end()); return 0L; }});
+
+    // Graph: traversals from node 0 of a random graph, traced from scratch
+    // with the trace cache off and replayed from it after an untimed first run
+    const char* graphNames[] = {"dfs", "bfs", "dijkstra"};
+    const int TRACE_CACHE_MB = 64;
+    for (int algorithm = 0; algorithm < 3; algorithm++) {
+        cases.push_back({"graph", graphNames[algorithm], sizes({16, 64, 256}),
+                         [](int n) {
+                             setGraphTraceCacheBudget(0);
+                             buildRandomGraph(n, 42);
+                         },
+                         [algorithm](int) { return (long)performGraphOperation(algorithm, 0); }});
+        cases.push_back({"graph", string(graphNames[algorithm]) + "Cached", sizes({16, 64, 256}),
+                         [algorithm](int n) {
+                             setGraphTraceCacheBudget(TRACE_CACHE_MB);
+                             buildRandomGraph(n, 42);
+                             performGraphOperation(algorithm, 0);
+                         },
+                         [algorithm](int) { return (long)performGraphOperation(algorithm, 0); }});
+    }
+
+    // Graph: untraced Dijkstra on each priority queue (0 d-ary heap,
+    // 1 pairing heap, 2 bucket queue) and delta-stepping with its default
+    // bucket width on road-like and random graphs
+    static vector<int> benchDistances; // Distances of the last run of a checked case
+    auto checkDistances = [](bool deltaStepping) {
+        return [deltaStepping](int n) { return compareDistances(benchDistances, referenceDistances(0, n, deltaStepping)); };
+    };
+    const char* queueNames[] = {"DaryHeap", "PairingHeap", "BucketQueue"};
+    for (int road = 1; road >= 0; road--) {
+        for (int queue = 0; queue < 3; queue++) {
+            cases.push_back({"graph", string(road ? "dijkstraRoad" : "dijkstraRandom") + queueNames[queue],
+                             sizes({10000, 100000, 1000000}),
+                             [road](int n) {
+                                 prepareShortestPathGraph(road, n);
+                                 benchDistances.resize(n);
+                             },
+                             [queue](int) { computeShortestPaths(0, queue, benchDistances.data()); return 0L; }});
+            cases.back().check = checkDistances(true);
+        }
+        cases.push_back({"graph", string(road ? "deltaSteppingRoad" : "deltaSteppingRandom"),
+                         sizes({10000, 100000, 1000000}),
+                         [road](int n) {
+                             prepareShortestPathGraph(road, n);
+                             benchDistances.resize(n);
+                         },
+                         [](int) { computeDeltaSteppingPaths(0, 0, benchDistances.data()); return 0L; }});
+        cases.back().check = checkDistances(false);
+    }
+
+    // Graph: untraced point-to-point queries between random node pairs of a
+    // road-like graph by bidirectional Dijkstra, A*, ALT and contraction
+    // hierarchies; the layout, landmarks and hierarchy are built by an
+    // untimed first query. A* lays the graph out and the hierarchy takes
+    // its preprocessing first, so they stop short of the largest size.
+    const char* pathNames[] = {"pathBidirectional", "pathAStar", "pathAlt", "pathContraction"};
+    const int PATH_QUERIES = 16;
+    static vector<int> pathDistances(PATH_QUERIES);
+    for (int method = 0; method < 4; method++) {
+        bool preprocessed = method == 1 || method == 3;
+        cases.push_back({"graph", pathNames[method],
+                         preprocessed ? sizes({10000, 100000}) : sizes({10000, 100000, 1000000}),
+                         [method](int n) {
+                             prepareShortestPathGraph(true, n);
+                             computePointToPointPath(0, n - 1, method, nullptr);
+                         },
+                         [method](int n) {
+                             mt19937 gen(7);
+                             for (int i = 0; i < PATH_QUERIES; i++) {
+                                 int source = gen() % n;
+                                 computePointToPointPath(source, gen() % n, method, &pathDistances[i]);
+                             }
+                             return 0L;
+                         },
+                         [](int) { return PATH_QUERIES; }});
+        cases.back().check = [](int n) {
+            mt19937 gen(7);
+            for (int i = 0; i < PATH_QUERIES; i++) {
+                int source = gen() % n;
+                int target = gen() % n;
+                int expected = referenceDistances(source, n, false)[target];
+                if (pathDistances[i] != expected) {
+                    return "path from " + to_string(source) + " to " + to_string(target) + " is " +
+                           to_string(pathDistances[i]) + ", expected " + to_string(expected);
+                }
+            }
+            return string();
+        };
+    }
+
+    // Graph: untraced Kruskal and Prim minimum spanning trees on sparse
+    // random graphs and dense graphs
+    static long long forestWeight; // Weight of the last run's forest
+    for (int dense = 0; dense < 2; dense++) {
+        for (int algorithm = 0; algorithm < 2; algorithm++) {
+            cases.push_back({"graph", string(algorithm == 0 ? "kruskal" : "prim") + (dense ? "Dense" : "Sparse"),
+                             dense ? sizes({500, 1000, 2000}) : sizes({10000, 100000, 1000000}),
+                             [dense](int n) { prepareSpanningTreeGraph(dense, n); },
+                             [algorithm](int) { computeSpanningForest(algorithm, 0, nullptr, &forestWeight); return 0L; }});
+            // Kruskal's and Prim's forests weigh the same
+            cases.back().check = [algorithm](int) {
+                long long expected = 0;
+                computeSpanningForest(1 - algorithm, 0, nullptr, &expected);
+                return forestWeight == expected ? string()
+                                                : "forest weight " + to_string(forestWeight) + ", expected " +
+                                                      to_string(expected);
+            };
+        }
+    }
+
+    // Graph: untraced sequential and direction-optimizing parallel BFS on
+    // a power-law graph
+    cases.push_back({"graph", "bfsSequential", sizes({100000, 1000000}), preparePowerLawGraph,
+                     [](int) {
+                         setGraphTraceMode(TRACE_OFF);
+                         performGraphOperation(1, 0);
+                         setGraphTraceMode(benchTraceMode);
+                         return 0L;
+                     }});
+    cases.push_back({"graph", "bfsDirectionOptimizing", sizes({100000, 1000000}), preparePowerLawGraph,
+                     [](int) { computeParallelBfs(0, nullptr); return 0L; }});
+
+    // Graph: closeness-style aggregates (nodes reached, depth sums,
+    // eccentricities) from random start nodes of a power-law and a
+    // road-like graph, by one direction-optimizing BFS per start node and
+    // by bit-parallel multi-source BFS in one batch of 64 and of 512;
+    // times are per start node
+    static vector<int> bfsSources;
+    static vector<int> bfsReached, bfsEccentricities;
+    static vector<long long> bfsDistanceSums;
+    auto prepareBfsSources = [](int count, int n) {
+        mt19937 gen(7);
+        bfsSources.resize(count);
+        for (int& source : bfsSources) {
+            source = gen() % n;
+        }
+        bfsReached.resize(count);
+        bfsEccentricities.resize(count);
+        bfsDistanceSums.resize(count);
+    };
+    for (int road = 0; road < 2; road++) {
+        string graphName = road ? "Road" : "PowerLaw";
+        auto prepare = [road](int n) {
+            if (road) {
+                prepareShortestPathGraph(true, n);
+            } else {
+                preparePowerLawGraph(n);
+            }
+        };
+        const int REPEATED_SOURCES = 64;
+        cases.push_back({"graph", "bfsRepeated" + graphName, sizes({100000, 1000000}),
+                         [=](int n) {
+                             prepare(n);
+                             prepareBfsSources(REPEATED_SOURCES, n);
+                         },
+                         [](int n) {
+                             vector<int> depths(n);
+                             for (int i = 0; i < REPEATED_SOURCES; i++) {
+                                 computeParallelBfs(bfsSources[i], depths.data());
+                                 long long sum = 0;
+                                 int eccentricity = 0;
+                                 for (int depth : depths) {
+                                     sum += max(depth, 0);
+                                     eccentricity = max(eccentricity, depth);
+                                 }
+                                 bfsDistanceSums[i] = sum;
+                                 bfsEccentricities[i] = eccentricity;
+                             }
+                             return 0L;
+                         },
+                         [](int) { return REPEATED_SOURCES; }});
+        for (int count : {64, 512}) {
+            cases.push_back({"graph", "bfsMultiSource" + graphName + to_string(count), sizes({100000, 1000000}),
+                             [=](int n) {
+                                 prepare(n);
+                                 prepareBfsSources(count, n);
+                             },
+                             [count](int) {
+                                 computeMultiSourceBfs(bfsSources.data(), count, bfsReached.data(),
+                                                       bfsDistanceSums.data(), bfsEccentricities.data(), nullptr);
+                                 return 0L;
+                             },
+                             [count](int) { return count; }});
+            // The first few start nodes against one BFS each
+            cases.back().check = [](int n) {
+                vector<int> depths(n);
+                for (int i = 0; i < 4; i++) {
+                    computeParallelBfs(bfsSources[i], depths.data());
+                    int reached = 0, eccentricity = 0;
+                    long long sum = 0;
+                    for (int depth : depths) {
+                        if (depth < 0) continue;
+                        reached++;
+                        sum += depth;
+                        eccentricity = max(eccentricity, depth);
+                    }
+                    if (bfsReached[i] != reached || bfsDistanceSums[i] != sum || bfsEccentricities[i] != eccentricity) {
+                        return "aggregates of start node " + to_string(bfsSources[i]) + " differ from BFS";
+                    }
+                }
+                return string();
+            };
+        }
+    }
+
+    // Graph: synthetic graphs of 16 edges per node (road-like grids about
+    // 3.6) built straight into CSR storage
+    const char* generatorNames[] = {"generateRmat", "generateErdosRenyi", "generateGrid", "generateBarabasiAlbert"};
+    for (int kind = 0; kind < 4; kind++) {
+        cases.push_back({"graph", generatorNames[kind], sizes({100000, 1000000}), nullptr,
+                         [kind](int n) { generateGraph(kind, n, 16, 42); return 0L; }});
+    }
+
+    // Graph: untraced BFS and Dijkstra from node 0 of R-MAT and road-like
+    // grid graphs in each node order (as generated, reverse Cuthill-McKee,
+    // by degree, Gorder, and shuffled as the worst case), and the time each
+    // order takes to apply to the generated graph. Gorder stops short of
+    // the largest size, where it takes close to a minute.
+    const char* orderNames[] = {"Generated", "Rcm", "Degree", "Gorder", "Random"};
+    for (int road = 0; road < 2; road++) {
+        string graphName = road ? "Road" : "Rmat";
+        for (int order = 0; order < 5; order++) {
+            vector<int> orderSizes = order == 3 ? sizes({100000}) : sizes({100000, 1000000});
+            auto prepare = [road, order](int n) { prepareOrderedGraph(road, order, n); };
+            cases.push_back({"graph", "bfs" + graphName + orderNames[order], orderSizes, prepare,
+                             [](int) {
+                                 setGraphTraceMode(TRACE_OFF);
+                                 performGraphOperation(1, 0);
+                                 setGraphTraceMode(benchTraceMode);
+                                 return 0L;
+                             }});
+            cases.push_back({"graph", "dijkstra" + graphName + orderNames[order], orderSizes,
+                             [prepare](int n) {
+                                 prepare(n);
+                                 benchDistances.resize(n);
+                             },
+                             [](int) { computeShortestPaths(0, 0, benchDistances.data()); return 0L; }});
+            cases.back().check = checkDistances(true);
+            if (order == 0) continue;
+            cases.push_back({"graph", "reorder" + graphName + orderNames[order], orderSizes,
+                             [road](int n) {
+                                 prepareOrderedGraph(road, 0, n);
+                                 reorderGraph(0);
+                             },
+                             [order](int) { reorderGraph(order); return 0L; }});
+        }
+    }
+
+    // Graph: untraced Dijkstra from node 0 of a road-like grid after
+    // reweighting (or removing) four random street segments, repairing the
+    // last run's shortest path tree and recomputing it from scratch. The
+    // grid is generated again for each case, since the runs change it.
+    const int REPAIR_CHANGES = 4;
+    for (int removal = 0; removal < 2; removal++) {
+        for (int repair = 1; repair >= 0; repair--) {
+            string name = string(repair ? "dijkstraRepair" : "dijkstraRecompute") + (removal ? "Removal" : "Reweight");
+            cases.push_back({"graph", name, sizes({100000, 1000000}),
+                             [repair](int n) {
+                                 generateGraph(GENERATOR_GRID, n, 0, 42);
+                                 setGraphPathRepair(repair);
+                                 computeShortestPaths(0, 0, nullptr);
+                                 benchDistances.resize(n);
+                             },
+                             [removal](int n) {
+                                 static mt19937 gen(7);
+                                 for (int i = 0; i < REPAIR_CHANGES; i++) {
+                                     int node = gen() % (n - 1);
+                                     if (removal) {
+                                         removeGraphEdge(node, node + 1);
+                                     } else {
+                                         setGraphEdgeWeight(node, node + 1, 10 + gen() % 91);
+                                     }
+                                 }
+                                 computeShortestPaths(0, 0, benchDistances.data());
+                                 return 0L;
+                             }});
+            cases.back().check = checkDistances(false);
+        }
+    }
+
+    // Graph: force-directed layout of a random graph from scratch, and
+    // incrementally after adding ten nodes with two edges each
+    cases.push_back({"graph", "layoutCold", sizes({1000, 10000, 100000}),
+                     [](int n) { prepareShortestPathGraph(false, n); },
+                     [](int) { computeGraphLayout(0, nullptr); return 0L; }});
+    cases.push_back({"graph", "layoutIncremental", sizes({1000, 10000, 100000}),
+                     [](int n) {
+                         prepareShortestPathGraph(false, n);
+                         computeGraphLayout(0, nullptr);
+                     },
+                     [](int n) {
+                         for (int i = 0; i < 10; i++) {
+                             int node = addGraphNode();
+                             addGraphEdge(node, node * 7919 % n, 1);
+                             addGraphEdge(node, node * 104729 % n, 1);
+                         }
+                         computeGraphLayout(1, nullptr);
+                         return 0L;
+                     }});
+
+    // Graph: bulk loading from an edge list and from binary CSR
+    cases.push_back({"graph", "loadEdgeList", sizes({100000, 1000000}), prepareGraphFiles,
+                     [](int) { loadGraphFile(graphFilePath(".txt").c_str(), 0); return 0L; }});
+    cases.push_back({"graph", "loadBinaryCsr", sizes({100000, 1000000}), prepareGraphFiles,
+                     [](int) { loadGraphFile(graphFilePath(".csr").c_str(), 2); return 0L; }});
+
+    // Dynamic programming; F(46) is the largest Fibonacci number an int holds
+    cases.push_back({"dp", "fibonacci", sizes({10, 30, 46}), nullptr,
+                     [](int n) { return (long)performDPOperation(0, n, 0); }});
+    cases.back().check = checkFibonacciTrace;
+    cases.push_back({"dp", "knapsack", sizes({10, 50, 200}), nullptr,
+                     [](int capacity) { return (long)performDPOperation(1, capacity, 0); }});
+    cases.push_back({"dp", "lcs", sizes({8, 16, 32}), nullptr,
+                     [](int n) {
+                         string a = randomString(n, 1), b = randomString(n, 2);
+                         return (long)performLCSOperation(a.c_str(), b.c_str());
+                     }});
+
+    // BST: n inserts into an empty tree, then n searches in the filled tree
+    cases.push_back({"tree", "bstInsert", sizes({100, 1000}),
+                     [](int) { resetTree(); },
+                     [](int n) {
+                         long steps = 0;
+                         for (int v : randomValues(n, 7)) {
+                             steps += performOperation(0, v);
+                         }
+                         return steps;
+                     },
+                     [](int n) { return n; }});
+    cases.push_back({"tree", "bstSearch", sizes({100, 1000}),
+                     [](int n) {
+                         resetTree();
+                         for (int v : randomValues(n, 7)) {
+                             performOperation(0, v);
+                         }
+                     },
+                     [](int n) {
+                         long steps = 0;
+                         for (int v : randomValues(n, 8)) {
+                             steps += performOperation(1, v);
+                         }
+                         return steps;
+                     },
+                     [](int n) { return n; }});
+
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    string filter;
+    string traceName = "full";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceName = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--quick] [--filter <substring>] [--trace full|coarse|off]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int traceMode = traceName == "off" ? TRACE_OFF : traceName == "coarse" ? TRACE_COARSE : TRACE_FULL;
+    benchTraceMode = traceMode;
+    setSortingTraceMode(traceMode);
+    setGraphTraceMode(traceMode);
+    setDPTraceMode(traceMode);
+    setTreeTraceMode(traceMode);
+
+    fprintf(stderr, "sorting kernels: %s, threads: %d\n", getSortingKernelName(), getSortingThreadCount());
+
+    printf("[\n");
+    bool first = true;
+    int mismatches = 0;
+    for (const auto& bench : createBenchCases(quick)) {
+        string name = bench.module + "/" + bench.algorithm;
+        if (!filter.empty() && name.find(filter) == string::npos) {
+            continue;
+        }
+        for (int size : bench.sizes) {
+            BenchResult result = measure(bench, size);
+            string mismatch = bench.check ? bench.check(size) : "";
+            if (!mismatch.empty()) {
+                fprintf(stderr, "%s size %d: wrong result: %s\n", name.c_str(), size, mismatch.c_str());
+                mismatches++;
+            }
+            char misses[32] = "null";
+            if (result.cacheMissesPerOp >= 0) {
+                snprintf(misses, sizeof(misses), "%.1f", result.cacheMissesPerOp);
+            }
+            printf("%s  {\"module\":\"%s\",\"algorithm\":\"%s\",\"trace\":\"%s\",\"size\":%d,\"reps\":%ld,"
+                   "\"ns_per_op\":%.1f,\"steps\":%ld,\"steps_per_sec\":%.1f,\"cache_misses_per_op\":%s,"
+                   "\"peak_rss_kb\":%ld}",
+                   first ? "" : ",\n", bench.module.c_str(), bench.algorithm.c_str(), traceName.c_str(), size,
+                   result.reps, result.nsPerOp, result.steps, result.stepsPerSec, misses, result.peakRssKb);
+            fflush(stdout);
+            first = false;
+        }
+    }
+    printf("\n]\n");
+    remove(graphFilePath(".txt").c_str());
+    remove(graphFilePath(".csr").c_str());
+    if (mismatches > 0) {
+        fprintf(stderr, "%d cases returned wrong results\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -15,8 +15,10 @@ function checkEmscripten() {
   }
 }
 
-// Compile a C++ file to WebAssembly
-function compileToWasm(inputFile, outputFilename) {
+// Compile a C++ file to WebAssembly, with Emscripten pthreads when threads
+// is set (the module then needs SharedArrayBuffer, so only loads on a
+// cross-origin isolated page)
+function compileToWasm(inputFile, outputFilename, threads = false) {
   const inputPath = path.resolve(__dirname, inputFile);
   const outputDir = path.resolve(__dirname, '../../dist/algorithms');
   
@@ -27,9 +29,14 @@ function compileToWasm(inputFile, outputFilename) {
   
   const outputPath = path.join(outputDir, outputFilename);
   
+  const threadFlags = threads ? '-pthread -s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency' : '';
+  
   // Command to compile C++ to WebAssembly with Emscripten
   const command = `emcc ${inputPath} \
     -O2 \
+    -std=c++20 \
+    -msimd128 \
+    ${threadFlags} \
     -s WASM=1 \
     -s EXPORTED_RUNTIME_METHODS=["ccall","cwrap"] \
     -s EXPORTED_FUNCTIONS="['_malloc', '_free', '_main']" \
@@ -56,17 +63,22 @@ function compileAllAlgorithms() {
     return;
   }
   
+  // Every module gets a single-threaded build; the sorting and graph
+  // engines, whose task pools use threads, also get a pthreads build
+  // (*.threads.js) to load when the page is cross-origin isolated
   const algorithms = [
     { input: 'tree.cpp', output: 'tree.js' },
     { input: 'graph.cpp', output: 'graph.js' },
+    { input: 'graph.cpp', output: 'graph.threads.js', threads: true },
     { input: 'dp.cpp', output: 'dp.js' },
-    { input: 'sort.cpp', output: 'sort.js' }
+    { input: 'sort.cpp', output: 'sort.js' },
+    { input: 'sort.cpp', output: 'sort.threads.js', threads: true }
   ];
   
   let allSuccessful = true;
   
   for (const algorithm of algorithms) {
-    const success = compileToWasm(algorithm.input, algorithm.output);
+    const success = compileToWasm(algorithm.input, algorithm.output, algorithm.threads);
     if (!success) {
       allSuccessful = false;
     }
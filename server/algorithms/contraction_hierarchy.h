@@ -0,0 +1,691 @@
+// Contraction hierarchies for repeated point-to-point queries on a
+// static graph with non-negative weights
+//
+// Preprocessing removes ("contracts") the nodes one at a time, lowest
+// priority first, and adds a shortcut between two neighbors of the node
+// whenever the path through it is the only shortest one a bounded witness
+// search finds. The priority is twice the edge difference (shortcuts
+// added minus arcs removed) plus the number of neighbors already
+// contracted and the node's depth (one more than the deepest contracted
+// neighbor's), which spread contraction evenly over the graph and keep
+// the hierarchy shallow.
+//
+// Rounds contract an independent set in parallel: every remaining node
+// whose (priority, id) is below all its neighbors'. Witness searches of a
+// round avoid every node of the set, so they only use arcs that survive
+// it; the shortcuts are then applied in id order, which makes the
+// hierarchy the same for any thread count. The nodes next to a contracted
+// one get their priority recomputed, also in parallel.
+//
+// Shortcuts pile up on graphs without road-like structure, so
+// contraction stops once the remaining nodes average CORE_DEGREE arcs;
+// those nodes form an uncontracted core at the top.
+//
+// Each arc of the result, original or shortcut, leads from a node to one
+// contracted later, or joins two core nodes. A query searches upward
+// from the source over the arcs leaving each node and upward from the
+// target over the arcs entering it, with stall-on-demand: a node reached
+// more cheaply from above is settled without relaxing its arcs. Both
+// searches cross the core like Dijkstra. The shortest path meets at the
+// top, so on road-like graphs the searches settle a few hundred nodes
+// where Dijkstra would settle the graph. Shortcuts record the node they
+// bypass and are unpacked into original edges for the path.
+//
+// Hierarchies are saved as a binary index: a 32-byte header (magic
+// "CHIX", version, node count, upward and downward arc counts, then the
+// 64-bit fingerprint of the graph it was built from) followed by the
+// offsets, targets, weights and bypassed nodes of both arc sets as
+// little-endian int32s. An index only loads for a graph with the same
+// fingerprint.
+
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "csr_graph.h"
+#include "graph_file.h"
+#include "path_query.h"
+#include "priority_queues.h"
+#include "task_pool.h"
+
+namespace contraction {
+
+const char INDEX_MAGIC[4] = {'C', 'H', 'I', 'X'};
+const int32_t INDEX_VERSION = 1;
+
+// Nodes a witness search settles before it gives up and the shortcut is
+// added; extra shortcuts cost query time, never correctness
+const int WITNESS_SETTLE_LIMIT = 500;
+
+// Average arcs per remaining node at which contraction stops and the rest
+// becomes the core
+const int CORE_DEGREE = 16;
+
+// Nodes per block handed to a thread, and the fewest nodes worth a
+// parallel pass
+const int PARALLEL_BLOCK = 64;
+const int PARALLEL_CUTOFF = 1 << 10;
+
+const int UNREACHABLE = INT_MAX;
+
+struct IndexHeader {
+    char magic[4];
+    int32_t version;
+    int32_t nodeCount;
+    int32_t upCount;
+    int32_t downCount;
+    int32_t reserved;
+    uint64_t fingerprint;
+};
+
+// 64-bit FNV-1a over the CSR arrays, one int32 at a time
+inline uint64_t fingerprint(const CsrGraph& graph) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const std::vector<int32_t>* array : {&graph.edgeOffsets(), &graph.edgeTargets(), &graph.edgeWeights()}) {
+        for (int32_t word : *array) {
+            hash = (hash ^ (uint32_t)word) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+namespace detail {
+
+// Arc of the graph under contraction; via is the bypassed node of a
+// shortcut, -1 for an original edge
+struct Arc {
+    int32_t node;
+    int32_t weight;
+    int32_t via;
+};
+
+struct Shortcut {
+    int32_t from;
+    int32_t to;
+    int32_t weight;
+};
+
+// Lower the arc to node in arcs to weight, adding it when missing
+inline void lowerArc(std::vector<Arc>& arcs, int node, int weight, int via) {
+    for (Arc& arc : arcs) {
+        if (arc.node == node) {
+            if (weight < arc.weight) {
+                arc.weight = weight;
+                arc.via = via;
+            }
+            return;
+        }
+    }
+    arcs.push_back({node, weight, via});
+}
+
+inline void removeArc(std::vector<Arc>& arcs, int node) {
+    for (size_t i = 0; i < arcs.size(); i++) {
+        if (arcs[i].node == node) {
+            arcs[i] = arcs.back();
+            arcs.pop_back();
+            return;
+        }
+    }
+}
+
+// Bounded Dijkstra over the remaining arcs with its own distance array,
+// reset after each search by the nodes it touched
+class Witness {
+public:
+    explicit Witness(int nodeCount) : distances(nodeCount, UNREACHABLE), targets(nodeCount, 0), heap(distances, 0) {}
+
+    Witness(const Witness&) = delete;
+    Witness& operator=(const Witness&) = delete;
+
+    // Distances from source to the nodes of wanted avoiding skip and the
+    // nodes marked in excluded (when given), up to limit
+    void search(const std::vector<std::vector<Arc>>& out, int source, const std::vector<Arc>& wanted, int skip,
+                const std::vector<uint8_t>* excluded, long long limit) {
+        int remaining = 0;
+        for (const Arc& arc : wanted) {
+            if (arc.node != source) {
+                targets[arc.node] = 1;
+                remaining++;
+            }
+        }
+        distances[source] = 0;
+        touched.push_back(source);
+        heap.update(source);
+        int settled = 0;
+        while (!heap.empty() && settled < WITNESS_SETTLE_LIMIT && remaining > 0) {
+            int node = heap.pop();
+            if (distances[node] > limit) break;
+            settled++;
+            remaining -= targets[node];
+            for (const Arc& arc : out[node]) {
+                if (arc.node == skip || (excluded && (*excluded)[arc.node])) continue;
+                long long candidate = (long long)distances[node] + arc.weight;
+                if (candidate < distances[arc.node]) {
+                    if (distances[arc.node] == UNREACHABLE) {
+                        touched.push_back(arc.node);
+                    }
+                    distances[arc.node] = candidate;
+                    heap.update(arc.node);
+                }
+            }
+        }
+        for (const Arc& arc : wanted) {
+            targets[arc.node] = 0;
+        }
+    }
+
+    int distance(int node) const {
+        return distances[node];
+    }
+
+    void reset() {
+        heap.clear();
+        for (int32_t node : touched) {
+            distances[node] = UNREACHABLE;
+        }
+        touched.clear();
+    }
+
+private:
+    std::vector<int> distances;
+    std::vector<uint8_t> targets; // Nodes of the current search's wanted arcs
+    std::vector<int32_t> touched;
+    DaryHeap<4> heap;
+};
+
+// The remaining graph during preprocessing
+struct Contraction {
+    std::vector<std::vector<Arc>> out; // Arcs leaving each node
+    std::vector<std::vector<Arc>> in; // Arcs entering each node, node being their source
+    std::vector<int32_t> contractedNeighbors;
+    std::vector<int32_t> depth; // Levels of contracted nodes below
+    std::vector<int> priority;
+    std::vector<uint8_t> contracted;
+    std::vector<uint8_t> selected; // In the independent set of this round
+
+    // Shortcuts needed to contract node, counted, and stored in shortcuts
+    // when given; witnesses avoid excluded nodes
+    int shortcutsFor(int node, Witness& witness, const std::vector<uint8_t>* excluded,
+                     std::vector<Shortcut>* shortcuts) const {
+        int maxOut = 0;
+        for (const Arc& arc : out[node]) {
+            maxOut = std::max(maxOut, (int)arc.weight);
+        }
+        int count = 0;
+        for (const Arc& first : in[node]) {
+            witness.search(out, first.node, out[node], node, excluded, (long long)first.weight + maxOut);
+            for (const Arc& second : out[node]) {
+                if (second.node == first.node) continue;
+                long long through = (long long)first.weight + second.weight;
+                if (witness.distance(second.node) <= through) continue;
+                count++;
+                if (shortcuts) {
+                    shortcuts->push_back({first.node, second.node, (int32_t)std::min<long long>(through, INT_MAX - 1)});
+                }
+            }
+            witness.reset();
+        }
+        return count;
+    }
+
+    void updatePriority(int node, Witness& witness) {
+        int removed = in[node].size() + out[node].size();
+        int edgeDifference = shortcutsFor(node, witness, nullptr, nullptr) - removed;
+        priority[node] = 2 * edgeDifference + contractedNeighbors[node] + depth[node];
+    }
+
+    // True when node comes before every remaining neighbor
+    bool isLocalMinimum(int node) const {
+        for (const std::vector<Arc>* arcs : {&out[node], &in[node]}) {
+            for (const Arc& arc : *arcs) {
+                int other = arc.node;
+                if (priority[other] < priority[node] || (priority[other] == priority[node] && other < node)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Run body(i, witness) for i in [0, count), handing blocks of
+// PARALLEL_BLOCK items to the pool's threads, each with its own witness
+template <class Body>
+void forEachIndex(TaskPool& pool, std::vector<std::unique_ptr<Witness>>& witnesses, int count, const Body& body) {
+    if (count < PARALLEL_CUTOFF || witnesses.size() == 1) {
+        for (int i = 0; i < count; i++) {
+            body(i, *witnesses[0]);
+        }
+        return;
+    }
+    std::atomic<int> next(0);
+    parallelFor(pool, witnesses.size(), [&](int thread) {
+        for (;;) {
+            int first = next.fetch_add(PARALLEL_BLOCK, std::memory_order_relaxed);
+            if (first >= count) break;
+            for (int i = first; i < std::min(first + PARALLEL_BLOCK, count); i++) {
+                body(i, *witnesses[thread]);
+            }
+        }
+    });
+}
+
+} // namespace detail
+
+// A contraction hierarchy with a reusable query workspace; queries are
+// not safe to run concurrently on one hierarchy
+class Hierarchy {
+public:
+    int nodeCount() const {
+        return std::max(up.nodeCount(), 0);
+    }
+
+    // Arcs of the hierarchy, shortcuts included
+    int arcCount() const {
+        return up.edgeCount() + down.edgeCount();
+    }
+
+    // Contract graph on the pool's threads; false (and the hierarchy
+    // emptied) when some weight is negative
+    bool build(const CsrGraph& graph, TaskPool& pool) {
+        *this = Hierarchy();
+        for (int32_t weight : graph.edgeWeights()) {
+            if (weight < 0) return false;
+        }
+        int count = graph.nodeCount();
+
+        // Parallel edges keep their lightest weight; self-loops never lie
+        // on a shortest path
+        detail::Contraction state;
+        state.out.resize(count);
+        state.in.resize(count);
+        for (int node = 0; node < count; node++) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(node);
+            std::vector<detail::Arc>& arcs = state.out[node];
+            for (int k = 0; k < neighbors.size(); k++) {
+                if (neighbors.targets[k] != node) {
+                    arcs.push_back({neighbors.targets[k], neighbors.weights[k], -1});
+                }
+            }
+            std::sort(arcs.begin(), arcs.end(), [](const detail::Arc& a, const detail::Arc& b) {
+                return a.node < b.node || (a.node == b.node && a.weight < b.weight);
+            });
+            arcs.erase(std::unique(arcs.begin(), arcs.end(),
+                                   [](const detail::Arc& a, const detail::Arc& b) { return a.node == b.node; }),
+                       arcs.end());
+            for (const detail::Arc& arc : arcs) {
+                state.in[arc.node].push_back({node, arc.weight, -1});
+            }
+        }
+        state.contractedNeighbors.assign(count, 0);
+        state.depth.assign(count, 0);
+        state.priority.assign(count, 0);
+        state.contracted.assign(count, 0);
+        state.selected.assign(count, 0);
+
+        std::vector<std::unique_ptr<detail::Witness>> witnesses;
+        for (int i = 0; i < pool.concurrency(); i++) {
+            witnesses.push_back(std::make_unique<detail::Witness>(count));
+        }
+
+        std::vector<int32_t> remaining(count);
+        for (int node = 0; node < count; node++) {
+            remaining[node] = node;
+        }
+        detail::forEachIndex(pool, witnesses, count, [&](int node, detail::Witness& witness) {
+            state.updatePriority(node, witness);
+        });
+
+        // Arcs from each node to later ones, by the node they leave
+        // (upArcs) and the node they enter (downArcs)
+        std::vector<std::vector<detail::Arc>> upArcs(count), downArcs(count);
+        std::vector<int32_t> round;
+        std::vector<std::vector<detail::Shortcut>> shortcuts;
+        std::vector<int32_t> affected;
+        std::vector<uint8_t> isAffected(count, 0);
+        while (!remaining.empty()) {
+            round.clear();
+            for (int32_t node : remaining) {
+                if (state.isLocalMinimum(node)) {
+                    round.push_back(node);
+                    state.selected[node] = 1;
+                }
+            }
+
+            shortcuts.assign(round.size(), {});
+            detail::forEachIndex(pool, witnesses, round.size(), [&](int i, detail::Witness& witness) {
+                state.shortcutsFor(round[i], witness, &state.selected, &shortcuts[i]);
+            });
+
+            affected.clear();
+            for (size_t i = 0; i < round.size(); i++) {
+                int node = round[i];
+                upArcs[node] = std::move(state.out[node]);
+                downArcs[node] = std::move(state.in[node]);
+                for (const detail::Arc& arc : upArcs[node]) {
+                    detail::removeArc(state.in[arc.node], node);
+                }
+                for (const detail::Arc& arc : downArcs[node]) {
+                    detail::removeArc(state.out[arc.node], node);
+                }
+                for (const std::vector<detail::Arc>* arcs : {&upArcs[node], &downArcs[node]}) {
+                    for (const detail::Arc& arc : *arcs) {
+                        state.contractedNeighbors[arc.node]++;
+                        state.depth[arc.node] = std::max(state.depth[arc.node], state.depth[node] + 1);
+                        if (!isAffected[arc.node]) {
+                            isAffected[arc.node] = 1;
+                            affected.push_back(arc.node);
+                        }
+                    }
+                }
+                for (const detail::Shortcut& shortcut : shortcuts[i]) {
+                    detail::lowerArc(state.out[shortcut.from], shortcut.to, shortcut.weight, node);
+                    detail::lowerArc(state.in[shortcut.to], shortcut.from, shortcut.weight, node);
+                }
+                state.out[node] = {};
+                state.in[node] = {};
+                state.contracted[node] = 1;
+                state.selected[node] = 0;
+            }
+
+            for (int32_t node : affected) {
+                isAffected[node] = 0;
+            }
+            detail::forEachIndex(pool, witnesses, affected.size(), [&](int i, detail::Witness& witness) {
+                state.updatePriority(affected[i], witness);
+            });
+            remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                           [&](int32_t node) { return state.contracted[node]; }),
+                            remaining.end());
+
+            // Core arcs go both ways: upward searches continue across the core
+            long long arcs = 0;
+            for (int32_t node : remaining) {
+                arcs += state.out[node].size();
+            }
+            if (arcs > (long long)CORE_DEGREE * (long long)remaining.size()) {
+                for (int32_t node : remaining) {
+                    upArcs[node] = std::move(state.out[node]);
+                    downArcs[node] = std::move(state.in[node]);
+                }
+                break;
+            }
+        }
+
+        up = toCsr(upArcs, upVia);
+        down = toCsr(downArcs, downVia);
+        graphFingerprint = fingerprint(graph);
+        prepareQueries();
+        return true;
+    }
+
+    // Shortest path from source to target; settled nodes go to log when
+    // given, upward from the source as forward settles and upward from the
+    // target as backward ones
+    pathquery::PathResult query(int source, int target, std::vector<pathquery::SettledNode>* log = nullptr) {
+        pathquery::PathResult result;
+        if (!up.contains(source) || !up.contains(target)) {
+            return result;
+        }
+        const CsrGraph* arcs[2] = {&up, &down};
+        distances[0][source] = 0;
+        distances[1][target] = 0;
+        touched[0].push_back(source);
+        touched[1].push_back(target);
+        queues[0]->update(source);
+        queues[1]->update(target);
+
+        long long best = UNREACHABLE;
+        int meeting = -1;
+        for (;;) {
+            int heads[2];
+            for (int side = 0; side < 2; side++) {
+                heads[side] = queues[side]->empty() ? UNREACHABLE : distances[side][queues[side]->top()];
+            }
+            if (heads[0] >= best && heads[1] >= best) break;
+            int side = heads[0] <= heads[1] ? 0 : 1;
+            int node = queues[side]->pop();
+            result.settled++;
+            if (log) {
+                log->push_back({node, distances[side][node], side == 1});
+            }
+            if (distances[1 - side][node] != UNREACHABLE && (long long)distances[0][node] + distances[1][node] < best) {
+                best = (long long)distances[0][node] + distances[1][node];
+                meeting = node;
+            }
+            if (stalled(side, node, *arcs[1 - side])) continue;
+
+            CsrGraph::Neighbors neighbors = arcs[side]->neighbors(node);
+            for (int k = 0; k < neighbors.size(); k++) {
+                int next = neighbors.targets[k];
+                long long candidate = (long long)distances[side][node] + neighbors.weights[k];
+                if (candidate < distances[side][next]) {
+                    if (distances[side][next] == UNREACHABLE) {
+                        touched[side].push_back(next);
+                    }
+                    distances[side][next] = candidate;
+                    parents[side][next] = node;
+                    queues[side]->update(next);
+                }
+            }
+        }
+
+        if (meeting >= 0) {
+            result.distance = best;
+            unpackPath(source, target, meeting, result.path);
+        }
+        for (int side = 0; side < 2; side++) {
+            queues[side]->clear();
+            for (int32_t node : touched[side]) {
+                distances[side][node] = UNREACHABLE;
+            }
+            touched[side].clear();
+        }
+        return result;
+    }
+
+    // Write the hierarchy as a binary index
+    bool save(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+        IndexHeader header = {};
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        header.nodeCount = nodeCount();
+        header.upCount = up.edgeCount();
+        header.downCount = down.edgeCount();
+        header.fingerprint = graphFingerprint;
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+        const std::vector<int32_t>* arrays[] = {&up.edgeOffsets(), &up.edgeTargets(), &up.edgeWeights(), &upVia,
+                                                &down.edgeOffsets(), &down.edgeTargets(), &down.edgeWeights(), &downVia};
+        for (const std::vector<int32_t>* array : arrays) {
+            written = written && fwrite(array->data(), sizeof(int32_t), array->size(), file) == array->size();
+        }
+        return fclose(file) == 0 && written;
+    }
+
+    // Read an index saved for graph; false (with the hierarchy unchanged)
+    // when the file cannot be read, is malformed or belongs to another graph
+    bool load(const char* path, const CsrGraph& graph) {
+        graphfile::MappedFile file(path);
+        IndexHeader header;
+        if (!file.valid() || file.size() < sizeof(header)) return false;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+            header.nodeCount != graph.nodeCount() || header.upCount < 0 || header.downCount < 0 ||
+            header.fingerprint != fingerprint(graph) ||
+            file.size() != sizeof(header) + sizeof(int32_t) * (2 * ((size_t)header.nodeCount + 1) +
+                                                               3 * ((size_t)header.upCount + header.downCount))) {
+            return false;
+        }
+
+        const int32_t* words = (const int32_t*)(file.data() + sizeof(header));
+        std::vector<int32_t> loadedUpVia, loadedDownVia;
+        CsrGraph loadedUp = readArcs(words, header.nodeCount, header.upCount, loadedUpVia);
+        CsrGraph loadedDown = readArcs(words, header.nodeCount, header.downCount, loadedDownVia);
+        if (!validArcs(loadedUp, loadedUpVia) || !validArcs(loadedDown, loadedDownVia)) return false;
+
+        *this = Hierarchy();
+        up = std::move(loadedUp);
+        down = std::move(loadedDown);
+        upVia = std::move(loadedUpVia);
+        downVia = std::move(loadedDownVia);
+        graphFingerprint = header.fingerprint;
+        prepareQueries();
+        return true;
+    }
+
+    Hierarchy() = default;
+
+    Hierarchy(const Hierarchy&) = delete;
+    Hierarchy& operator=(const Hierarchy&) = delete;
+
+    // Queues refer to the distance arrays, so a moved hierarchy rebuilds them
+    Hierarchy& operator=(Hierarchy&& other) {
+        up = std::move(other.up);
+        down = std::move(other.down);
+        upVia = std::move(other.upVia);
+        downVia = std::move(other.downVia);
+        graphFingerprint = other.graphFingerprint;
+        prepareQueries();
+        return *this;
+    }
+
+private:
+    CsrGraph up; // Arcs leaving each node for later or core ones
+    CsrGraph down; // Arcs entering each node from later or core ones, by their source
+    std::vector<int32_t> upVia; // Bypassed node of each arc, -1 for original edges
+    std::vector<int32_t> downVia;
+    uint64_t graphFingerprint = 0;
+
+    // Query workspace, by side: 0 upward from the source, 1 from the target
+    std::vector<int> distances[2];
+    std::vector<int32_t> parents[2];
+    std::vector<int32_t> touched[2];
+    std::unique_ptr<DaryHeap<4>> queues[2];
+
+    static CsrGraph toCsr(std::vector<std::vector<detail::Arc>>& arcs, std::vector<int32_t>& via) {
+        std::vector<int32_t> offsets(1, 0), targets, weights;
+        via.clear();
+        for (std::vector<detail::Arc>& node : arcs) {
+            for (const detail::Arc& arc : node) {
+                targets.push_back(arc.node);
+                weights.push_back(arc.weight);
+                via.push_back(arc.via);
+            }
+            offsets.push_back(targets.size());
+            node = {};
+        }
+        return CsrGraph(std::move(offsets), std::move(targets), std::move(weights));
+    }
+
+    static CsrGraph readArcs(const int32_t*& words, int count, int arcCount, std::vector<int32_t>& via) {
+        std::vector<int32_t> offsets(words, words + count + 1);
+        words += count + 1;
+        std::vector<int32_t> targets(words, words + arcCount);
+        words += arcCount;
+        std::vector<int32_t> weights(words, words + arcCount);
+        words += arcCount;
+        via.assign(words, words + arcCount);
+        words += arcCount;
+        return CsrGraph(std::move(offsets), std::move(targets), std::move(weights));
+    }
+
+    static bool validArcs(const CsrGraph& arcs, const std::vector<int32_t>& via) {
+        const std::vector<int32_t>& offsets = arcs.edgeOffsets();
+        if (offsets[0] != 0 || offsets.back() != arcs.edgeCount()) return false;
+        for (int node = 0; node < arcs.nodeCount(); node++) {
+            if (offsets[node + 1] < offsets[node]) return false;
+        }
+        for (int i = 0; i < arcs.edgeCount(); i++) {
+            if (!arcs.contains(arcs.edgeTargets()[i]) || arcs.edgeWeights()[i] < 0 ||
+                (via[i] != -1 && !arcs.contains(via[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void prepareQueries() {
+        int count = nodeCount();
+        for (int side = 0; side < 2; side++) {
+            distances[side].assign(count, UNREACHABLE);
+            parents[side].assign(count, -1);
+            touched[side].clear();
+            queues[side] = std::make_unique<DaryHeap<4>>(distances[side], 0);
+        }
+    }
+
+    // A node reached more cheaply through a later neighbor is not on a
+    // shortest upward path (a core node will be settled again from it);
+    // other holds the arcs into it from later nodes
+    bool stalled(int side, int node, const CsrGraph& other) const {
+        CsrGraph::Neighbors neighbors = other.neighbors(node);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int from = distances[side][neighbors.targets[k]];
+            if (from != UNREACHABLE && (long long)from + neighbors.weights[k] < distances[side][node]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Bypassed node of the arc from a to b
+    int viaOf(int a, int b) const {
+        for (int side = 0; side < 2; side++) {
+            int owner = side == 0 ? a : b;
+            int other = side == 0 ? b : a;
+            CsrGraph::Neighbors neighbors = (side == 0 ? up : down).neighbors(owner);
+            for (int k = 0; k < neighbors.size(); k++) {
+                if (neighbors.targets[k] == other) {
+                    return (side == 0 ? upVia : downVia)[neighbors.first + k];
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Original nodes from source through meeting to target
+    void unpackPath(int source, int target, int meeting, std::vector<int32_t>& path) const {
+        // Hierarchy nodes along the path, then each arc expanded in turn
+        std::vector<int32_t> nodes;
+        for (int node = meeting; node != source; node = parents[0][node]) {
+            nodes.push_back(node);
+        }
+        nodes.push_back(source);
+        std::reverse(nodes.begin(), nodes.end());
+        for (int node = meeting; node != target;) {
+            node = parents[1][node];
+            nodes.push_back(node);
+        }
+
+        path.push_back(source);
+        std::vector<std::pair<int32_t, int32_t>> pending;
+        for (size_t i = nodes.size() - 1; i > 0; i--) {
+            pending.push_back({nodes[i - 1], nodes[i]});
+        }
+        while (!pending.empty()) {
+            auto [a, b] = pending.back();
+            pending.pop_back();
+            int via = viaOf(a, b);
+            if (via < 0) {
+                path.push_back(b);
+            } else {
+                pending.push_back({via, b});
+                pending.push_back({a, via});
+            }
+        }
+    }
+};
+
+} // namespace contraction
+
+#endif // CONTRACTION_HIERARCHY_H
@@ -0,0 +1,227 @@
+// Compressed sparse row (CSR) graph storage for the graph engine
+//
+// Node ids are dense (0 to nodeCount - 1). The outgoing edges of node u are
+// targets[offsets[u] .. offsets[u + 1]) with the matching weights, so a
+// traversal reads each adjacency list as one contiguous run instead of
+// chasing tree and vector pointers. CsrGraphBuilder collects nodes and
+// edges incrementally and merges them into a CsrGraph on demand, so a
+// bulk-loaded graph (see graph_file.h) is not copied to grow by a few
+// edges. Each node keeps its edges in insertion order, and edge i of the
+// CSR arrays is the i-th edge in (source, insertion) order. Edges and
+// nodes are removed, and edges reweighted, on a merged CsrGraph in place.
+
+#ifndef CSR_GRAPH_H
+#define CSR_GRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class CsrGraph {
+public:
+    // Outgoing edges of one node
+    struct Neighbors {
+        const int32_t* targets;
+        const int32_t* weights;
+        int first; // CSR index of the first edge
+        int count;
+
+        int size() const {
+            return count;
+        }
+    };
+
+    CsrGraph() = default;
+
+    // Adopt prebuilt arrays: nodeCount + 1 offsets from 0 to the edge
+    // count, and a target and weight per edge
+    CsrGraph(std::vector<int32_t> edgeOffsets, std::vector<int32_t> edgeTargets, std::vector<int32_t> edgeWeights)
+        : offsets(std::move(edgeOffsets)), targets(std::move(edgeTargets)), weights(std::move(edgeWeights)) {}
+
+    int nodeCount() const {
+        return (int)offsets.size() - 1;
+    }
+
+    int edgeCount() const {
+        return targets.size();
+    }
+
+    bool contains(int node) const {
+        return node >= 0 && node < nodeCount();
+    }
+
+    Neighbors neighbors(int node) const {
+        int first = offsets[node];
+        return {targets.data() + first, weights.data() + first, first, offsets[node + 1] - first};
+    }
+
+    const std::vector<int32_t>& edgeOffsets() const {
+        return offsets;
+    }
+
+    const std::vector<int32_t>& edgeTargets() const {
+        return targets;
+    }
+
+    const std::vector<int32_t>& edgeWeights() const {
+        return weights;
+    }
+
+    // Change the weight of an edge (a CSR index) in place
+    void setWeight(int edge, int32_t weight) {
+        weights[edge] = weight;
+    }
+
+    // Remove the edges for which remove(source, target) is true, keeping
+    // the rest in order, and return how many were removed. The arrays are
+    // compacted in one pass over all edges.
+    template <class Remove>
+    int removeEdges(Remove remove) {
+        int kept = 0;
+        int first = 0;
+        for (int u = 0; u < nodeCount(); u++) {
+            int last = offsets[u + 1];
+            for (int e = first; e < last; e++) {
+                if (!remove(u, targets[e])) {
+                    targets[kept] = targets[e];
+                    weights[kept] = weights[e];
+                    kept++;
+                }
+            }
+            first = last;
+            offsets[u + 1] = kept;
+        }
+        int removed = targets.size() - kept;
+        targets.resize(kept);
+        weights.resize(kept);
+        return removed;
+    }
+
+    // Remove a node that no edge leaves or enters; the nodes after it move
+    // down by one
+    void removeNode(int node) {
+        offsets.erase(offsets.begin() + node + 1);
+        for (int32_t& target : targets) {
+            target -= target > node;
+        }
+    }
+
+private:
+    friend class CsrGraphBuilder;
+
+    std::vector<int32_t> offsets = {0}; // nodeCount + 1 entries
+    std::vector<int32_t> targets;
+    std::vector<int32_t> weights;
+};
+
+// Nodes and edges added since the last freeze, merged into the CsrGraph
+// that holds the ones before
+class CsrGraphBuilder {
+public:
+    // Start over from a graph of nodeCount nodes (empty, or one the
+    // caller built) with nothing pending
+    void reset(int nodeCount = 0) {
+        nodes = nodeCount;
+        sources.clear();
+        targets.clear();
+        weights.clear();
+    }
+
+    int nodeCount() const {
+        return nodes;
+    }
+
+    // Edges added since the last freeze
+    int pendingEdgeCount() const {
+        return sources.size();
+    }
+
+    bool contains(int node) const {
+        return node >= 0 && node < nodes;
+    }
+
+    int addNode() {
+        return nodes++;
+    }
+
+    // Add a directed edge; both ends must exist
+    void addEdge(int source, int target, int weight) {
+        sources.push_back(source);
+        targets.push_back(target);
+        weights.push_back(weight);
+    }
+
+    // Merge the pending nodes and edges into graph, which must hold what
+    // was frozen before. Each node's frozen edges come first, then its
+    // pending edges in insertion order (a stable counting sort by source).
+    void freeze(CsrGraph& graph) {
+        int frozenNodes = graph.nodeCount();
+        std::vector<int32_t> offsets(nodes + 1, 0);
+        for (int u = 0; u < frozenNodes; u++) {
+            offsets[u + 1] = graph.offsets[u + 1] - graph.offsets[u];
+        }
+        for (int32_t source : sources) {
+            offsets[source + 1]++;
+        }
+        for (int u = 0; u < nodes; u++) {
+            offsets[u + 1] += offsets[u];
+        }
+
+        int edges = offsets[nodes];
+        std::vector<int32_t> mergedTargets(edges);
+        std::vector<int32_t> mergedWeights(edges);
+        std::vector<int32_t> next(offsets.begin(), offsets.end() - 1);
+        for (int u = 0; u < frozenNodes; u++) {
+            int first = graph.offsets[u];
+            int count = graph.offsets[u + 1] - first;
+            std::copy_n(graph.targets.begin() + first, count, mergedTargets.begin() + next[u]);
+            std::copy_n(graph.weights.begin() + first, count, mergedWeights.begin() + next[u]);
+            next[u] += count;
+        }
+        for (size_t i = 0; i < sources.size(); i++) {
+            int slot = next[sources[i]]++;
+            mergedTargets[slot] = targets[i];
+            mergedWeights[slot] = weights[i];
+        }
+
+        graph.offsets = std::move(offsets);
+        graph.targets = std::move(mergedTargets);
+        graph.weights = std::move(mergedWeights);
+        reset(nodes);
+    }
+
+private:
+    int nodes = 0;
+    std::vector<int32_t> sources;
+    std::vector<int32_t> targets;
+    std::vector<int32_t> weights;
+};
+
+// Reverse every edge: edge (u, v, w) of graph becomes (v, u, w), with each
+// node's incoming edges ordered by source
+inline CsrGraph transposeGraph(const CsrGraph& graph) {
+    int nodes = graph.nodeCount();
+    const std::vector<int32_t>& offsets = graph.edgeOffsets();
+    std::vector<int32_t> reverseOffsets(nodes + 1, 0);
+    for (int32_t target : graph.edgeTargets()) {
+        reverseOffsets[target + 1]++;
+    }
+    for (int u = 0; u < nodes; u++) {
+        reverseOffsets[u + 1] += reverseOffsets[u];
+    }
+
+    std::vector<int32_t> sources(graph.edgeCount());
+    std::vector<int32_t> weights(graph.edgeCount());
+    std::vector<int32_t> next(reverseOffsets.begin(), reverseOffsets.end() - 1);
+    for (int u = 0; u < nodes; u++) {
+        for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+            int slot = next[graph.edgeTargets()[e]]++;
+            sources[slot] = u;
+            weights[slot] = graph.edgeWeights()[e];
+        }
+    }
+    return CsrGraph(std::move(reverseOffsets), std::move(sources), std::move(weights));
+}
+
+#endif // CSR_GRAPH_H
@@ -0,0 +1,321 @@
+// Delta-stepping single-source shortest paths on a CsrGraph
+//
+// Tentative distances are kept in buckets of width delta. The lowest
+// non-empty bucket is settled in light rounds: its nodes relax their light
+// edges (weight <= delta) in parallel, which may refill the same bucket,
+// until it stays empty; then every node settled in the bucket relaxes its
+// heavy edges once. Relaxations lower distances with an atomic min, so
+// rounds split their frontier into chunks across the task pool without
+// locks. Buckets live in a cyclic array covering maxWeight / delta + 2
+// bucket indices, enough for every tentative distance at any time.
+//
+// Distances are exact for non-negative weights. Previous nodes are then
+// chosen as Dijkstra's algorithm with (distance, id) ordered queues
+// chooses them: each node gets the first node in Dijkstra's settle order
+// that reaches it at its final distance. The settle order follows from
+// the distances alone -- (distance, id) order, except that nodes reached
+// only through zero-weight edges within their distance class wait for
+// those edges -- so the result does not depend on scheduling.
+
+#ifndef DELTA_STEPPING_H
+#define DELTA_STEPPING_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "csr_graph.h"
+#include "task_pool.h"
+
+namespace parallel {
+
+// Largest number of bucket indices the cyclic array spans; wider windows
+// raise delta instead
+const int DELTA_STEPPING_MAX_BUCKETS = 1 << 21;
+
+// Frontiers below this size are relaxed by one task
+const int DELTA_STEPPING_PARALLEL_CUTOFF = 1 << 11;
+
+const int DELTA_STEPPING_CHUNKS_PER_THREAD = 4;
+
+// One settled bucket
+struct DeltaSteppingPhase {
+    int bucket; // Distances bucket * delta to (bucket + 1) * delta - 1
+    int settled; // Nodes whose final distance lies in the bucket
+    int lightRounds;
+    long long lightRelaxations;
+    long long heavyRelaxations;
+};
+
+// What a traced run reports besides distances and previous nodes
+struct DeltaSteppingTrace {
+    std::vector<DeltaSteppingPhase> phases;
+    std::vector<int32_t> settleOrder; // Reached nodes, phase by phase in settle order
+    std::vector<int32_t> pathEdges; // CSR index of the edge from previous[node], -1 for none
+};
+
+// The bucket width used for a requested width (<= 0 picks one): about the
+// maximum weight over the average degree, so a light round relaxes a few
+// edges per node, widened until the cyclic bucket array fits
+inline int deltaSteppingWidth(const CsrGraph& graph, int requested, int maxWeight) {
+    int delta = requested;
+    if (delta <= 0) {
+        double degree = graph.nodeCount() > 0 ? (double)graph.edgeCount() / graph.nodeCount() : 1;
+        delta = (int)(maxWeight / std::max(1.0, degree));
+    }
+    return std::max({1, delta, maxWeight / DELTA_STEPPING_MAX_BUCKETS + 1});
+}
+
+namespace detail {
+
+inline int deltaChunkCount(TaskPool& pool, long long work) {
+    if (work < DELTA_STEPPING_PARALLEL_CUTOFF) return 1;
+    return std::max(1, (int)std::min<long long>(pool.concurrency() * DELTA_STEPPING_CHUNKS_PER_THREAD,
+                                                work / DELTA_STEPPING_PARALLEL_CUTOFF));
+}
+
+// Lower value to candidate; true if it was higher
+template <class T>
+inline bool atomicLower(T& value, T candidate) {
+    std::atomic_ref<T> slot(value);
+    T current = slot.load(std::memory_order_relaxed);
+    while (candidate < current) {
+        if (slot.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reorder each run of equal distances in order (sorted by distance, then
+// id) the way Dijkstra settles it: nodes with a positive-weight edge from
+// a lower distance are queued when the run starts and leave lowest id
+// first, the others are queued by the zero-weight edge that reaches them
+inline void settleRuns(const CsrGraph& graph, const std::vector<int>& distances, int source,
+                       std::vector<int32_t>& order, TaskPool& pool) {
+    int nodeCount = graph.nodeCount();
+    const std::vector<int32_t>& offsets = graph.edgeOffsets();
+    const std::vector<int32_t>& targets = graph.edgeTargets();
+    const std::vector<int32_t>& weights = graph.edgeWeights();
+
+    std::vector<uint8_t> entry(nodeCount, 0);
+    std::atomic<bool> zeroRuns(false);
+    int chunks = deltaChunkCount(pool, graph.edgeCount());
+    parallelFor(pool, chunks, [&](int c) {
+        int begin = (int)((long long)nodeCount * c / chunks);
+        int end = (int)((long long)nodeCount * (c + 1) / chunks);
+        bool zero = false;
+        for (int u = begin; u < end; u++) {
+            if (distances[u] == INT_MAX) continue;
+            for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                int v = targets[e];
+                if ((long long)distances[u] + weights[e] != distances[v]) continue;
+                if (weights[e] > 0) {
+                    std::atomic_ref<uint8_t>(entry[v]).store(1, std::memory_order_relaxed);
+                } else {
+                    zero = true;
+                }
+            }
+        }
+        if (zero) {
+            zeroRuns.store(true, std::memory_order_relaxed);
+        }
+    });
+    if (!zeroRuns) return;
+    entry[source] = 1;
+
+    std::vector<uint8_t> queued(nodeCount, 0);
+    std::priority_queue<int32_t, std::vector<int32_t>, std::greater<int32_t>> heap;
+    for (size_t runStart = 0; runStart < order.size();) {
+        int distance = distances[order[runStart]];
+        size_t runEnd = runStart;
+        bool allEntries = true;
+        while (runEnd < order.size() && distances[order[runEnd]] == distance) {
+            allEntries = allEntries && entry[order[runEnd]];
+            runEnd++;
+        }
+        if (!allEntries) {
+            for (size_t i = runStart; i < runEnd; i++) {
+                if (entry[order[i]]) {
+                    heap.push(order[i]);
+                    queued[order[i]] = 1;
+                }
+            }
+            for (size_t i = runStart; i < runEnd; i++) {
+                int32_t u = heap.top();
+                heap.pop();
+                order[i] = u;
+                for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                    int v = targets[e];
+                    if (weights[e] == 0 && distances[v] == distance && !queued[v]) {
+                        queued[v] = 1;
+                        heap.push(v);
+                    }
+                }
+            }
+        }
+        runStart = runEnd;
+    }
+}
+
+} // namespace detail
+
+// Shortest paths from source over non-negative weights at most maxWeight,
+// with the given bucket width (see deltaSteppingWidth). distances gets
+// INT_MAX and previous -1 for unreachable nodes; trace, when given,
+// gets the phases, settle order and path edges.
+inline void deltaStepping(const CsrGraph& graph, int source, int delta, int maxWeight, TaskPool& pool,
+                          std::vector<int>& distances, std::vector<int32_t>& previous,
+                          DeltaSteppingTrace* trace = nullptr) {
+    int nodeCount = graph.nodeCount();
+    distances.assign(nodeCount, INT_MAX);
+    previous.assign(nodeCount, -1);
+    DeltaSteppingTrace local;
+    DeltaSteppingTrace& out = trace ? *trace : local;
+    out.phases.clear();
+    out.settleOrder.clear();
+    out.pathEdges.clear();
+    if (!graph.contains(source)) {
+        return;
+    }
+
+    int bucketCount = maxWeight / delta + 2;
+    std::vector<std::vector<int32_t>> buckets(bucketCount);
+    long long queued = 1;
+    distances[source] = 0;
+    buckets[0].push_back(source);
+
+    std::vector<int> roundStamp(nodeCount, -1); // Last light round a node was in the frontier of
+    std::vector<int> phaseStamp(nodeCount, -1); // Last phase a node was settled in
+    std::vector<int32_t> frontier;
+    std::vector<int32_t>& settled = out.settleOrder;
+    std::vector<uint64_t> keys;
+    int round = 0;
+
+    // Relax the edges of nodes in [begin, end) whose weight is light
+    // (<= delta) or heavy, queueing every node whose distance drops
+    auto relax = [&](const std::vector<int32_t>& nodes, size_t begin, size_t end, bool light) {
+        long long count = end - begin;
+        int chunks = detail::deltaChunkCount(pool, count);
+        std::vector<std::vector<int32_t>> lowered(chunks);
+        std::vector<long long> relaxations(chunks, 0);
+        parallelFor(pool, chunks, [&](int c) {
+            size_t chunkBegin = begin + count * c / chunks;
+            size_t chunkEnd = begin + count * (c + 1) / chunks;
+            for (size_t i = chunkBegin; i < chunkEnd; i++) {
+                int32_t u = nodes[i];
+                long long distance = std::atomic_ref<int>(distances[u]).load(std::memory_order_relaxed);
+                CsrGraph::Neighbors neighbors = graph.neighbors(u);
+                for (int k = 0; k < neighbors.size(); k++) {
+                    if ((neighbors.weights[k] <= delta) != light) continue;
+                    relaxations[c]++;
+                    long long candidate = distance + neighbors.weights[k];
+                    int32_t v = neighbors.targets[k];
+                    if (candidate < INT_MAX && detail::atomicLower(distances[v], (int)candidate)) {
+                        lowered[c].push_back(v);
+                    }
+                }
+            }
+        });
+        long long total = 0;
+        for (int c = 0; c < chunks; c++) {
+            for (int32_t v : lowered[c]) {
+                buckets[(distances[v] / delta) % bucketCount].push_back(v);
+            }
+            queued += lowered[c].size();
+            total += relaxations[c];
+        }
+        return total;
+    };
+
+    // Take the live, not yet queued entries of a bucket as the next frontier
+    auto takeBucket = [&](int bucket) {
+        std::vector<int32_t>& entries = buckets[bucket % bucketCount];
+        queued -= entries.size();
+        frontier.clear();
+        round++;
+        for (int32_t v : entries) {
+            if (distances[v] / delta == bucket && roundStamp[v] != round) {
+                roundStamp[v] = round;
+                frontier.push_back(v);
+            }
+        }
+        entries.clear();
+    };
+
+    for (int bucket = 0; queued > 0; bucket++) {
+        if (buckets[bucket % bucketCount].empty()) continue;
+        takeBucket(bucket);
+        if (frontier.empty()) continue;
+
+        DeltaSteppingPhase phase = {bucket, 0, 0, 0, 0};
+        int phaseIndex = out.phases.size();
+        size_t phaseStart = settled.size();
+        while (!frontier.empty()) {
+            for (int32_t v : frontier) {
+                if (phaseStamp[v] != phaseIndex) {
+                    phaseStamp[v] = phaseIndex;
+                    settled.push_back(v);
+                }
+            }
+            phase.lightRounds++;
+            phase.lightRelaxations += relax(frontier, 0, frontier.size(), true);
+            takeBucket(bucket);
+        }
+        phase.heavyRelaxations = relax(settled, phaseStart, settled.size(), false);
+
+        // Settled nodes in (distance, id) order
+        keys.clear();
+        for (size_t i = phaseStart; i < settled.size(); i++) {
+            keys.push_back(((uint64_t)distances[settled[i]] << 32) | (uint32_t)settled[i]);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < keys.size(); i++) {
+            settled[phaseStart + i] = (int32_t)(keys[i] & 0xFFFFFFFF);
+        }
+        phase.settled = settled.size() - phaseStart;
+        out.phases.push_back(phase);
+    }
+
+    detail::settleRuns(graph, distances, source, settled, pool);
+
+    // Each node's previous node is the first in settle order to reach it
+    // at its final distance, by its first such edge
+    std::vector<int32_t> rank(nodeCount, INT_MAX);
+    for (size_t i = 0; i < settled.size(); i++) {
+        rank[settled[i]] = i;
+    }
+    std::vector<uint64_t> best(nodeCount, UINT64_MAX);
+    int chunks = detail::deltaChunkCount(pool, graph.edgeCount());
+    parallelFor(pool, chunks, [&](int c) {
+        int begin = (int)((long long)nodeCount * c / chunks);
+        int end = (int)((long long)nodeCount * (c + 1) / chunks);
+        for (int32_t u = begin; u < end; u++) {
+            if (distances[u] == INT_MAX) continue;
+            CsrGraph::Neighbors neighbors = graph.neighbors(u);
+            for (int k = 0; k < neighbors.size(); k++) {
+                int32_t v = neighbors.targets[k];
+                if ((long long)distances[u] + neighbors.weights[k] == distances[v] && rank[u] < rank[v]) {
+                    detail::atomicLower(best[v], ((uint64_t)rank[u] << 32) | (uint32_t)(neighbors.first + k));
+                }
+            }
+        }
+    });
+    if (trace) {
+        out.pathEdges.assign(nodeCount, -1);
+    }
+    for (int v = 0; v < nodeCount; v++) {
+        if (best[v] == UINT64_MAX) continue;
+        previous[v] = settled[best[v] >> 32];
+        if (trace) {
+            out.pathEdges[v] = (int32_t)(best[v] & 0xFFFFFFFF);
+        }
+    }
+}
+
+} // namespace parallel
+
+#endif // DELTA_STEPPING_H
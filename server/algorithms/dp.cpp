@@ -5,171 +5,235 @@
 #include <string>
 #include <algorithm>
 #include <map>
-#include <emscripten/bind.h>
-#include <emscripten/emscripten.h>
+#include <cstring>
+#include <cstdlib>
+#include "wasm_compat.h"
+#include "trace_policy.h"
+#include "step_buffer.h"
+#include "step_generator.h"
+#include "step_message.h"
+#include "visual_state.h"
 
 using namespace std;
+#ifdef __EMSCRIPTEN__
 using namespace emscripten;
+#endif
 
-// Visualization structures
-struct CellPosition {
-    int id;
-    string value;
-    double x;
-    double y;
-    bool highlighted;
+// Module internals get internal linkage so the four modules can be linked
+// into one native binary without clashing type names
+namespace {
+
+// Step message templates (see step_message.h)
+enum DPMessage : uint16_t {
+    FIB_START,
+    FIB_STEP,
+    FIB_DONE,
+    KNAPSACK_START,
+    KNAPSACK_TOO_HEAVY,
+    KNAPSACK_CHOOSE,
+    KNAPSACK_ROW,
+    KNAPSACK_DONE,
+    LCS_START,
+    LCS_MATCH,
+    LCS_MISMATCH,
+    LCS_ROW,
+    LCS_DONE,
+    DP_MESSAGE_COUNT
 };
 
-// Structure to hold algorithm state
-struct AlgorithmState {
-    vector<CellPosition> cells;
-    vector<string> memoTable; // For visual representation of the memoization table
-    string message;
-    int step;
-    int totalSteps;
+const char* const DP_MESSAGES[] = {
+    "Calculating Fibonacci({0}) using Dynamic Programming",
+    "Computing Fibonacci({0}) = Fibonacci({1}) + Fibonacci({2}) = {3} + {4} = {5}",
+    "Fibonacci({0}) = {1}",
+    "Solving 0-1 Knapsack Problem with {0} items and capacity {1}\nItems: [{t}]",
+    "Item {0} (weight={1}) is too heavy for capacity {2}, take previous value {3}",
+    "For item {0} (value={1}, weight={2}) and capacity {3}:\nMax of (excluding={4}, including={5}) = {6}",
+    "Processed item {0}: best value for capacity {1} is {2}",
+    "Maximum value: {0}",
+    "Finding Longest Common Subsequence of {t}",
+    "Characters match: {0c} = {1c}, incrementing from diagonal",
+    "Characters don't match: {0c} != {1c}, taking max of up and left",
+    "Processed row for character {0c}: LCS length so far {1}",
+    "Length of LCS: {0}\nLCS: \"{t}\""
 };
+static_assert(sizeof(DP_MESSAGES) / sizeof(DP_MESSAGES[0]) == DP_MESSAGE_COUNT, "one template per message");
 
 // Dynamic Programming class
 class DynamicProgramming {
 private:
-    vector<AlgorithmState> states;
+    vector<VisualState> states;
+    LazySteps<VisualState> lazySteps;
     int currentStep;
     int totalSteps;
+    int lazyWindow; // Steps kept in memory by lazy traces, 0 for eager traces
     
-    // Helper function to create grid visualization
-    void createGrid(vector<CellPosition>& cells, const vector<vector<int>>& grid, int highlightRow = -1, int highlightCol = -1) {
-        cells.clear();
+    // Cell positions of a DP table, shared by all of its steps
+    static shared_ptr<const VisualLayout> createGridLayout(const vector<vector<int>>& grid) {
         const int cellSize = 50;
         const int startX = 100;
         const int startY = 100;
         
+        auto layout = make_shared<VisualLayout>();
         int id = 0;
-        for (int i = 0; i < grid.size(); i++) {
-            for (int j = 0; j < grid[i].size(); j++) {
-                CellPosition cell;
-                cell.id = id++;
-                cell.value = to_string(grid[i][j]);
-                cell.x = startX + j * cellSize;
-                cell.y = startY + i * cellSize;
-                cell.highlighted = (i == highlightRow && j == highlightCol);
-                cells.push_back(cell);
+        for (int i = 0; i < (int)grid.size(); i++) {
+            for (int j = 0; j < (int)grid[i].size(); j++) {
+                layout->addElement(id++, startX + j * cellSize, startY + i * cellSize);
             }
         }
+        return layout;
     }
     
-    // Helper function to create array visualization
-    void createArray(vector<CellPosition>& cells, const vector<int>& array, int highlightIndex = -1) {
-        cells.clear();
+    // Cell positions of a DP array, shared by all of its steps
+    static shared_ptr<const VisualLayout> createArrayLayout(const vector<int>& array) {
         const int cellSize = 50;
         const int startX = 100;
         const int startY = 150;
         
-        for (int i = 0; i < array.size(); i++) {
-            CellPosition cell;
-            cell.id = i;
-            cell.value = to_string(array[i]);
-            cell.x = startX + i * cellSize;
-            cell.y = startY;
-            cell.highlighted = (i == highlightIndex);
-            cells.push_back(cell);
+        auto layout = make_shared<VisualLayout>();
+        for (int i = 0; i < (int)array.size(); i++) {
+            layout->addElement(i, startX + i * cellSize, startY);
         }
+        return layout;
     }
-
-public:
-    DynamicProgramming() : currentStep(0), totalSteps(0) {}
     
-    // Fibonacci using dynamic programming
-    void fibonacci(int n) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.message = "Calculating Fibonacci(" + to_string(n) + ") using Dynamic Programming";
-        initialState.step = 1;
+    // Helper function to show a grid's values in a state laid out by createGridLayout
+    void createGrid(VisualState& state, const vector<vector<int>>& grid, int highlightRow = -1, int highlightCol = -1) {
+        state.values.clear();
+        for (const vector<int>& row : grid) {
+            state.values.insert(state.values.end(), row.begin(), row.end());
+        }
+        state.flags.assign(state.values.size(), 0);
+        if (highlightRow >= 0 && highlightCol >= 0) {
+            state.mark(highlightRow * grid[highlightRow].size() + highlightCol);
+        }
+    }
+    
+    // Helper function to show an array's values in a state laid out by createArrayLayout
+    void createArray(VisualState& state, const vector<int>& array, int highlightIndex = -1) {
+        state.values.assign(array.begin(), array.end());
+        state.flags.assign(array.size(), 0);
+        state.mark(highlightIndex);
+    }
+
+    // Set total steps once a trace is complete
+    void finishTrace() {
+        totalSteps = states.size();
+        currentStep = 0;
         
+        // Update all states with total steps
+        for (auto& state : states) {
+            state.totalSteps = totalSteps;
+        }
+    }
+
+    // Run an algorithm's step generator, storing its result. Eager traces
+    // record every state now; lazy traces compute the result untraced and
+    // replay the traced generator on demand as steps are requested.
+    template <class Trace, class StepsFn, class Result>
+    void runSteps(StepsFn steps, Result& result) {
+        states.clear();
+        lazySteps.clear();
+        if constexpr (Trace::recordsPhases) {
+            if (lazyWindow > 0) {
+                lazySteps.start([steps] { return steps(Trace(), nullptr); }, lazyWindow);
+                steps(TraceOff(), &result).drain();
+                finishTrace();
+                return;
+            }
+        }
+        for (VisualState& state : steps(Trace(), &result)) {
+            state.step = states.size() + 1;
+            states.push_back(move(state));
+        }
+        finishTrace();
+    }
+    
+    // Fibonacci steps; F(n) goes to result when given
+    template <class Trace>
+    StepGenerator<VisualState> fibonacciSteps(int n, int* result) {
         // Initialize DP array
         vector<int> fib(n + 1, 0);
         if (n >= 1) {
             fib[1] = 1;
         }
         
-        // Create visualization for initial state
-        createArray(initialState.cells, fib);
-        
-        // Add initial state
-        states.push_back(initialState);
+        // Create initial state
+        VisualState initialState;
+        if constexpr (Trace::recordsPhases) {
+            initialState = VisualState(createArrayLayout(fib), {FIB_START, n});
+            
+            // Create visualization for initial state
+            createArray(initialState, fib);
+            co_yield VisualState(initialState);
+        }
         
         // Fill the DP array
         for (int i = 2; i <= n; i++) {
             fib[i] = fib[i-1] + fib[i-2];
             
             // Create a state for this step
-            AlgorithmState state = initialState;
-            state.step = states.size() + 1;
-            state.message = "Computing Fibonacci(" + to_string(i) + ") = Fibonacci(" + 
-                           to_string(i-1) + ") + Fibonacci(" + to_string(i-2) + ") = " +
-                           to_string(fib[i-1]) + " + " + to_string(fib[i-2]) + " = " + to_string(fib[i]);
-            
-            // Update array visualization
-            createArray(state.cells, fib, i);
-            
-            // Add this state
-            states.push_back(state);
+            if constexpr (Trace::recordsSteps) {
+                VisualState state = initialState;
+                state.message = StepMessage(FIB_STEP, i, i-1, i-2, fib[i-1], fib[i-2], fib[i]);
+                
+                // Update array visualization
+                createArray(state, fib, i);
+                
+                // Add this state
+                co_yield move(state);
+            }
         }
         
         // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "Fibonacci(" + to_string(n) + ") = " + to_string(fib[n]);
-        
-        createArray(finalState.cells, fib, n);
-        
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        if constexpr (Trace::recordsPhases) {
+            VisualState finalState = move(initialState);
+            finalState.message = StepMessage(FIB_DONE, n, fib[n]);
+            
+            createArray(finalState, fib, n);
+            
+            co_yield move(finalState);
+        }
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        if (result) {
+            *result = fib[n];
         }
     }
     
-    // 0-1 Knapsack Problem
-    void knapsack(const vector<int>& values, const vector<int>& weights, int capacity) {
-        states.clear();
-        
+    // 0-1 Knapsack steps; the maximum value goes to result when given
+    template <class Trace>
+    StepGenerator<VisualState> knapsackSteps(vector<int> values, vector<int> weights, int capacity, int* result) {
         if (values.empty() || weights.empty() || values.size() != weights.size()) {
             // Invalid inputs
-            return;
+            if (result) {
+                *result = 0;
+            }
+            co_return;
         }
         
         int n = values.size();
         
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.message = "Solving 0-1 Knapsack Problem with " + to_string(n) + " items and capacity " + to_string(capacity);
-        initialState.step = 1;
-        
         // Initialize DP table
         vector<vector<int>> dp(n + 1, vector<int>(capacity + 1, 0));
         
-        // Create visualization for initial state
-        createGrid(initialState.cells, dp);
-        
-        // Add the values and weights as part of the message
-        string itemsInfo = "Items: [";
-        for (int i = 0; i < n; i++) {
-            itemsInfo += "(value=" + to_string(values[i]) + ", weight=" + to_string(weights[i]) + ")";
-            if (i < n - 1) itemsInfo += ", ";
+        // Create initial state
+        VisualState initialState;
+        if constexpr (Trace::recordsPhases) {
+            // Add the values and weights as part of the message
+            string itemsInfo;
+            for (int i = 0; i < n; i++) {
+                itemsInfo += "(value=" + to_string(values[i]) + ", weight=" + to_string(weights[i]) + ")";
+                if (i < n - 1) itemsInfo += ", ";
+            }
+            
+            initialState = VisualState(createGridLayout(dp),
+                                       StepMessage::withText(KNAPSACK_START, make_shared<const string>(move(itemsInfo)), n, capacity));
+            
+            // Create visualization for initial state
+            createGrid(initialState, dp);
+            
+            // Add initial state
+            co_yield VisualState(initialState);
         }
-        itemsInfo += "]";
-        
-        initialState.message += "\n" + itemsInfo;
-        
-        // Add initial state
-        states.push_back(initialState);
         
         // Fill the DP table
         for (int i = 1; i <= n; i++) {
@@ -183,72 +247,77 @@ public:
                 }
                 
                 // Create a state for this step
-                AlgorithmState state = initialState;
-                state.step = states.size() + 1;
-                
-                if (weights[i-1] > w) {
-                    state.message = "Item " + to_string(i) + " (weight=" + to_string(weights[i-1]) + 
-                                   ") is too heavy for capacity " + to_string(w) + ", take previous value " + 
-                                   to_string(dp[i-1][w]);
-                } else {
-                    state.message = "For item " + to_string(i) + " (value=" + to_string(values[i-1]) + 
-                                   ", weight=" + to_string(weights[i-1]) + ") and capacity " + to_string(w) + 
-                                   ":\nMax of (excluding=" + to_string(dp[i-1][w]) + ", including=" + 
-                                   to_string(values[i-1] + dp[i-1][w - weights[i-1]]) + ") = " + to_string(dp[i][w]);
+                if constexpr (Trace::recordsSteps) {
+                    VisualState state = initialState;
+                    
+                    if (weights[i-1] > w) {
+                        state.message = StepMessage(KNAPSACK_TOO_HEAVY, i, weights[i-1], w, dp[i-1][w]);
+                    } else {
+                        state.message = StepMessage(KNAPSACK_CHOOSE, i, values[i-1], weights[i-1], w, dp[i-1][w],
+                                                    values[i-1] + dp[i-1][w - weights[i-1]], dp[i][w]);
+                    }
+                    
+                    // Update grid visualization
+                    createGrid(state, dp, i, w);
+                    
+                    // Add this state
+                    co_yield move(state);
                 }
-                
-                // Update grid visualization
-                createGrid(state.cells, dp, i, w);
-                
-                // Add this state
-                states.push_back(state);
+            }
+            
+            // Coarse traces show one state per completed item row
+            if constexpr (Trace::recordsPhases && !Trace::recordsSteps) {
+                VisualState rowState = initialState;
+                rowState.message = StepMessage(KNAPSACK_ROW, i, capacity, dp[i][capacity]);
+                createGrid(rowState, dp, i, capacity);
+                co_yield move(rowState);
             }
         }
         
         // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "Maximum value: " + to_string(dp[n][capacity]);
-        
-        createGrid(finalState.cells, dp);
-        
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        if constexpr (Trace::recordsPhases) {
+            VisualState finalState = move(initialState);
+            finalState.message = StepMessage(KNAPSACK_DONE, dp[n][capacity]);
+            
+            createGrid(finalState, dp);
+            
+            co_yield move(finalState);
+        }
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        if (result) {
+            *result = dp[n][capacity];
         }
     }
     
-    // Longest Common Subsequence (LCS)
-    void longestCommonSubsequence(const string& str1, const string& str2) {
-        states.clear();
-        
+    // Longest Common Subsequence steps; the subsequence goes to result when given
+    template <class Trace>
+    StepGenerator<VisualState> longestCommonSubsequenceSteps(string str1, string str2, string* result) {
         if (str1.empty() || str2.empty()) {
             // Invalid inputs
-            return;
+            if (result) {
+                result->clear();
+            }
+            co_return;
         }
         
         int m = str1.length();
         int n = str2.length();
         
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.message = "Finding Longest Common Subsequence of \"" + str1 + "\" and \"" + str2 + "\"";
-        initialState.step = 1;
-        
         // Initialize DP table
         vector<vector<int>> dp(m + 1, vector<int>(n + 1, 0));
         
-        // Create visualization for initial state
-        createGrid(initialState.cells, dp);
-        
-        // Add initial state
-        states.push_back(initialState);
+        // Create initial state
+        VisualState initialState;
+        if constexpr (Trace::recordsPhases) {
+            auto inputs = make_shared<const string>("\"" + str1 + "\" and \"" + str2 + "\"");
+            initialState = VisualState(createGridLayout(dp), StepMessage::withText(LCS_START, inputs));
+            
+            // Create visualization for initial state
+            createGrid(initialState, dp);
+            
+            // Add initial state
+            co_yield VisualState(initialState);
+        }
         
         // Fill the DP table
         for (int i = 1; i <= m; i++) {
@@ -260,30 +329,32 @@ public:
                 }
                 
                 // Create a state for this step
-                AlgorithmState state = initialState;
-                state.step = states.size() + 1;
-                
-                if (str1[i-1] == str2[j-1]) {
-                    state.message = "Characters match: " + string(1, str1[i-1]) + 
-                                   " = " + string(1, str2[j-1]) + ", incrementing from diagonal";
-                } else {
-                    state.message = "Characters don't match: " + string(1, str1[i-1]) + 
-                                   " != " + string(1, str2[j-1]) + ", taking max of up and left";
+                if constexpr (Trace::recordsSteps) {
+                    VisualState state = initialState;
+                    
+                    if (str1[i-1] == str2[j-1]) {
+                        state.message = StepMessage(LCS_MATCH, str1[i-1], str2[j-1]);
+                    } else {
+                        state.message = StepMessage(LCS_MISMATCH, str1[i-1], str2[j-1]);
+                    }
+                    
+                    // Update grid visualization
+                    createGrid(state, dp, i, j);
+                    
+                    // Add this state
+                    co_yield move(state);
                 }
-                
-                // Update grid visualization
-                createGrid(state.cells, dp, i, j);
-                
-                // Add this state
-                states.push_back(state);
+            }
+            
+            // Coarse traces show one state per completed row
+            if constexpr (Trace::recordsPhases && !Trace::recordsSteps) {
+                VisualState rowState = initialState;
+                rowState.message = StepMessage(LCS_ROW, str1[i-1], dp[i][n]);
+                createGrid(rowState, dp, i, n);
+                co_yield move(rowState);
             }
         }
         
-        // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "Length of LCS: " + to_string(dp[m][n]);
-        
         // Reconstruct the LCS
         string lcs = "";
         int i = m, j = n;
@@ -299,31 +370,107 @@ public:
             }
         }
         
-        finalState.message += "\nLCS: \"" + lcs + "\"";
-        
-        createGrid(finalState.cells, dp);
-        
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        // Final state
+        if constexpr (Trace::recordsPhases) {
+            VisualState finalState = move(initialState);
+            finalState.message = StepMessage::withText(LCS_DONE, make_shared<const string>(lcs), dp[m][n]);
+            
+            createGrid(finalState, dp);
+            
+            co_yield move(finalState);
+        }
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        if (result) {
+            *result = move(lcs);
         }
     }
+
+public:
+    DynamicProgramming() : currentStep(0), totalSteps(0), lazyWindow(0) {}
+    
+    // Generate traced steps on demand, keeping at most window steps in
+    // memory (0 records every step when the algorithm runs)
+    void setLazySteps(int window) {
+        lazyWindow = max(window, 0);
+    }
+    
+    // Fibonacci using dynamic programming
+    template <class Trace = TraceFull>
+    int fibonacci(int n) {
+        int value = 0;
+        runSteps<Trace>([this, n](auto policy, int* result) {
+            return fibonacciSteps<decltype(policy)>(n, result);
+        }, value);
+        return value;
+    }
+    
+    // 0-1 Knapsack Problem, returns the maximum value
+    template <class Trace = TraceFull>
+    int knapsack(const vector<int>& values, const vector<int>& weights, int capacity) {
+        int best = 0;
+        runSteps<Trace>([this, values, weights, capacity](auto policy, int* result) {
+            return knapsackSteps<decltype(policy)>(values, weights, capacity, result);
+        }, best);
+        return best;
+    }
+    
+    // Longest Common Subsequence (LCS), returns the subsequence
+    template <class Trace = TraceFull>
+    string longestCommonSubsequence(const string& str1, const string& str2) {
+        string lcs;
+        runSteps<Trace>([this, str1, str2](auto policy, string* result) {
+            return longestCommonSubsequenceSteps<decltype(policy)>(str1, str2, result);
+        }, lcs);
+        return lcs;
+    }
     
-    // Get the number of steps
+    // Get the number of steps; for lazy traces, the steps generated so far
     int getStepCount() const {
-        return totalSteps;
+        return lazySteps.active() ? lazySteps.count() : totalSteps;
+    }
+
+    // True once every step of the trace is known
+    bool stepsComplete() const {
+        return !lazySteps.active() || lazySteps.complete();
     }
 
-    // Get a specific step
-    AlgorithmState getStep(int step) const {
-        if (step < 0 || step >= states.size()) {
-            return AlgorithmState();
+    // Write a window of steps into a binary step buffer (see step_buffer.h);
+    // cells carry their text as a label and its numeric value
+    void writeSteps(StepBufferWriter& writer, int firstStep, int count) {
+        bool lazy = lazySteps.active();
+        if (lazy) {
+            // Lazy steps are generated up to the end of the window first
+            firstStep = max(firstStep, 0);
+        } else {
+            clampStepWindow(states.size(), firstStep, count);
+        }
+        writer.begin(totalSteps, firstStep);
+        for (int step = firstStep; count < 0 || step < firstStep + count; step++) {
+            const VisualState* state = lazy ? lazySteps.get(step) : &states[step];
+            if (!state) break;
+            writeVisualState(writer, step, *state, DP_MESSAGES, true);
+        }
+        if (lazy) {
+            writer.setTotalSteps(lazySteps.count());
+        }
+        writer.finish();
+    }
+
+    // Get a specific step (generated on demand for lazy traces)
+    VisualState getStep(int step) {
+        if (lazySteps.active()) {
+            const VisualState* lazy = lazySteps.get(step);
+            if (!lazy) {
+                return VisualState();
+            }
+            VisualState state = *lazy;
+            state.step = step + 1;
+            state.totalSteps = lazySteps.count();
+            return state;
+        }
+        
+        if (step < 0 || step >= (int)states.size()) {
+            return VisualState();
         }
         return states[step];
     }
@@ -332,36 +479,71 @@ public:
 // Global instance
 DynamicProgramming dp;
 
+// Trace mode used by performDPOperation and performLCSOperation (see TraceMode)
+int dpTraceMode = TRACE_FULL;
+
+// Binary step buffer handed out by getDPStepBuffer
+StepBufferWriter dpStepBuffer;
+
+} // namespace
+
 // External interface functions
 
 // Perform a DP operation
-extern "C" EMSCRIPTEN_KEEPALIVE int performDPOperation(int algorithm, int param1, int param2 = 0) {
-    switch (algorithm) {
-        case 0: // Fibonacci
-            dp.fibonacci(param1);
-            break;
-        case 1: // Knapsack
-            {
-                // Use predefined values and weights
-                vector<int> values = {60, 100, 120};
-                vector<int> weights = {10, 20, 30};
-                dp.knapsack(values, weights, param1);
-            }
-            break;
-        case 2: // LCS
-            {
-                // Use predefined strings
-                string str1 = "ABCBDAB";
-                string str2 = "BDCABA";
-                dp.longestCommonSubsequence(str1, str2);
-            }
-            break;
-        default:
-            return -1;
-    }
+extern "C" EMSCRIPTEN_KEEPALIVE int performDPOperation(int algorithm, int param1, [[maybe_unused]] int param2 = 0) {
+    bool known = withTracePolicy(dpTraceMode, [&](auto policy) {
+        using Trace = decltype(policy);
+        switch (algorithm) {
+            case 0: // Fibonacci
+                dp.fibonacci<Trace>(param1);
+                return true;
+            case 1: // Knapsack
+                {
+                    // Use predefined values and weights
+                    vector<int> values = {60, 100, 120};
+                    vector<int> weights = {10, 20, 30};
+                    dp.knapsack<Trace>(values, weights, param1);
+                }
+                return true;
+            case 2: // LCS
+                {
+                    // Use predefined strings
+                    string str1 = "ABCBDAB";
+                    string str2 = "BDCABA";
+                    dp.longestCommonSubsequence<Trace>(str1, str2);
+                }
+                return true;
+            default:
+                return false;
+        }
+    });
+    return known ? dp.getStepCount() : -1;
+}
+
+// Run LCS on caller-supplied strings
+extern "C" EMSCRIPTEN_KEEPALIVE int performLCSOperation(const char* str1, const char* str2) {
+    withTracePolicy(dpTraceMode, [&](auto policy) {
+        dp.longestCommonSubsequence<decltype(policy)>(str1, str2);
+    });
     return dp.getStepCount();
 }
 
+// Generate the steps of subsequent traced DP operations on demand, keeping at
+// most window steps in memory (0 records every step up front)
+extern "C" EMSCRIPTEN_KEEPALIVE void setDPLazySteps(int window) {
+    dp.setLazySteps(window);
+}
+
+// 1 once getDPStepCount is the final count, 0 while lazy steps remain
+extern "C" EMSCRIPTEN_KEEPALIVE int isDPStepsComplete() {
+    return dp.stepsComplete() ? 1 : 0;
+}
+
+// Select full, coarse or no tracing for subsequent DP operations
+extern "C" EMSCRIPTEN_KEEPALIVE void setDPTraceMode(int mode) {
+    dpTraceMode = mode;
+}
+
 // Get the number of steps in the current operation
 extern "C" EMSCRIPTEN_KEEPALIVE int getDPStepCount() {
     return dp.getStepCount();
@@ -369,12 +551,12 @@ extern "C" EMSCRIPTEN_KEEPALIVE int getDPStepCount() {
 
 // Get a specific step's data
 extern "C" EMSCRIPTEN_KEEPALIVE char* getDPStepData(int step) {
-    AlgorithmState state = dp.getStep(step);
+    VisualState state = dp.getStep(step);
     
     // Convert state to JSON or another format that can be passed to JavaScript
     string result = "{\"step\":" + to_string(state.step) + 
                     ",\"totalSteps\":" + to_string(state.totalSteps) + 
-                    ",\"message\":\"" + state.message + "\"}";
+                    ",\"message\":\"" + escapeJson(formatStepMessage(DP_MESSAGES, state.message)) + "\"}";
     
     // Allocate memory for the result that JavaScript can free later
     char* buffer = (char*)malloc(result.length() + 1);
@@ -387,13 +569,28 @@ extern "C" EMSCRIPTEN_KEEPALIVE void freeDPStepData(char* ptr) {
     free(ptr);
 }
 
+// Write steps [firstStep, firstStep + count) (count < 0 for all remaining
+// steps) into the binary step buffer and return its address; the buffer
+// stays valid until the next call (layout in step_buffer.h)
+extern "C" EMSCRIPTEN_KEEPALIVE const unsigned char* getDPStepBuffer(int firstStep, int count) {
+    dp.writeSteps(dpStepBuffer, firstStep, count);
+    return dpStepBuffer.data();
+}
+
+// Size in bytes of the last buffer returned by getDPStepBuffer
+extern "C" EMSCRIPTEN_KEEPALIVE int getDPStepBufferSize() {
+    return dpStepBuffer.size();
+}
+
+#ifdef __EMSCRIPTEN__
 // Bind the C++ class and methods to JavaScript
 EMSCRIPTEN_BINDINGS(dp_module) {
     class_<DynamicProgramming>("DynamicProgramming")
         .constructor()
-        .function("fibonacci", &DynamicProgramming::fibonacci)
-        .function("knapsack", &DynamicProgramming::knapsack)
-        .function("longestCommonSubsequence", &DynamicProgramming::longestCommonSubsequence)
+        .function("fibonacci", &DynamicProgramming::fibonacci<TraceFull>)
+        .function("knapsack", &DynamicProgramming::knapsack<TraceFull>)
+        .function("longestCommonSubsequence", &DynamicProgramming::longestCommonSubsequence<TraceFull>)
+        .function("setLazySteps", &DynamicProgramming::setLazySteps)
         .function("getStepCount", &DynamicProgramming::getStepCount);
 }
 
@@ -403,3 +600,4 @@ int main() {
     dp.fibonacci(10);
     return 0;
 }
+#endif
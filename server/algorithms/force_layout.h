@@ -0,0 +1,395 @@
+// Force-directed layout of a CsrGraph with a Barnes-Hut quadtree
+//
+// Nodes repel each other with force C K^2 / d and edges pull their ends
+// together with force d^2 / K (Hu's spring-electrical model, natural
+// length K = 1). Repulsion is approximated with a quadtree: a cell whose
+// size over its distance is below THETA acts as one body at its centre of
+// mass, so an iteration costs O(n log n). Each iteration moves every node
+// along its net force by one step (less for weaker forces), with forces
+// for all nodes computed from the same positions in parallel chunks; the
+// step grows while the energy keeps falling and shrinks when it does not
+// (adaptive cooling).
+//
+// Cold layouts coarsen the graph by matching each node with a neighbor
+// until few nodes remain, lay out the coarsest graph, and refine every
+// finer one from the positions of the one above. Warm layouts keep the
+// positions they are given, place new nodes at the centroid of their
+// placed neighbors, and only refine.
+
+#ifndef FORCE_LAYOUT_H
+#define FORCE_LAYOUT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include "csr_graph.h"
+#include "task_pool.h"
+
+namespace forcelayout {
+
+struct Point {
+    double x;
+    double y;
+};
+
+const double REPULSION = 0.2; // C
+const double THETA = 1.2;
+const double COOLING = 0.9;
+
+// Iteration budgets, and the step a refinement starts with (in units of K)
+const int COARSEST_ITERATIONS = 300;
+const int REFINE_ITERATIONS = 30;
+const double REFINE_STEP = 0.2;
+
+// Layouts stop once the step falls below this (in units of K)
+const double TOLERANCE = 0.02;
+
+// Coarsening stops at this many nodes, or when a level keeps more than
+// MIN_COARSENING of the nodes of the one below
+const int COARSEST_SIZE = 50;
+const double MIN_COARSENING = 0.75;
+
+// Quadtree cells with at most this many points, or this deep, are leaves
+const int LEAF_SIZE = 8;
+const int MAX_DEPTH = 24;
+
+// Graphs below this size are laid out by one task; larger ones by up to
+// MAX_CHUNKS tasks of at least a quarter of it
+const int PARALLEL_CUTOFF = 1 << 10;
+const int MAX_CHUNKS = 256;
+
+// Quadtree over a set of points, each cell holding a range of the points
+// ordered by cell and their centre of mass
+class QuadTree {
+public:
+    void build(const std::vector<Point>& points) {
+        cells.clear();
+        order.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            order[i] = i;
+        }
+        if (points.empty()) return;
+
+        double minX = points[0].x, maxX = points[0].x, minY = points[0].y, maxY = points[0].y;
+        for (const Point& p : points) {
+            minX = std::min(minX, p.x);
+            maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y);
+            maxY = std::max(maxY, p.y);
+        }
+        buildCell(points, 0, points.size(), minX, minY, std::max({maxX - minX, maxY - minY, 1e-9}), 0);
+    }
+
+    // Repulsion on point i from every other point, scaled by strength
+    Point repulsion(const std::vector<Point>& points, int i, double strength) const {
+        Point force = {0, 0};
+        const Point& p = points[i];
+        int stack[4 * MAX_DEPTH + 4];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Cell& cell = cells[stack[--top]];
+            double dx = p.x - cell.x;
+            double dy = p.y - cell.y;
+            double d2 = dx * dx + dy * dy;
+            if (cell.children[0] < 0 && cell.children[1] < 0 && cell.children[2] < 0 && cell.children[3] < 0) {
+                for (int k = cell.first; k < cell.first + cell.count; k++) {
+                    const Point& q = points[order[k]];
+                    double ex = p.x - q.x;
+                    double ey = p.y - q.y;
+                    double e2 = ex * ex + ey * ey;
+                    if (e2 > 0) {
+                        force.x += strength * ex / e2;
+                        force.y += strength * ey / e2;
+                    }
+                }
+            } else if (cell.size * cell.size < THETA * THETA * d2) {
+                force.x += strength * cell.count * dx / d2;
+                force.y += strength * cell.count * dy / d2;
+            } else {
+                for (int child : cell.children) {
+                    if (child >= 0) stack[top++] = child;
+                }
+            }
+        }
+        return force;
+    }
+
+private:
+    struct Cell {
+        double x; // Centre of mass
+        double y;
+        double size; // Side of the square
+        int first; // Points order[first .. first + count)
+        int count;
+        int children[4];
+    };
+
+    std::vector<Cell> cells;
+    std::vector<int32_t> order;
+
+    int buildCell(const std::vector<Point>& points, int first, int count, double x0, double y0, double size, int depth) {
+        int index = cells.size();
+        cells.push_back({0, 0, size, first, count, {-1, -1, -1, -1}});
+        double sumX = 0, sumY = 0;
+        for (int k = first; k < first + count; k++) {
+            sumX += points[order[k]].x;
+            sumY += points[order[k]].y;
+        }
+        cells[index].x = sumX / count;
+        cells[index].y = sumY / count;
+        if (count <= LEAF_SIZE || depth >= MAX_DEPTH) {
+            return index;
+        }
+
+        // Split the range into quadrants: left/right, then bottom/top
+        double half = size / 2;
+        int32_t* begin = order.data() + first;
+        int32_t* end = begin + count;
+        int32_t* middle = std::partition(begin, end, [&](int32_t i) { return points[i].x < x0 + half; });
+        int32_t* bounds[5] = {
+            begin,
+            std::partition(begin, middle, [&](int32_t i) { return points[i].y < y0 + half; }),
+            middle,
+            std::partition(middle, end, [&](int32_t i) { return points[i].y < y0 + half; }),
+            end
+        };
+        for (int q = 0; q < 4; q++) {
+            int childCount = bounds[q + 1] - bounds[q];
+            if (childCount > 0) {
+                int child = buildCell(points, bounds[q] - order.data(), childCount, x0 + (q >= 2 ? half : 0),
+                                      y0 + (q % 2 == 1 ? half : 0), half, depth + 1);
+                cells[index].children[q] = child;
+            }
+        }
+        return index;
+    }
+};
+
+namespace detail {
+
+// Chunks depend on the size alone, so the energy sums, and with them the
+// layout, do not depend on the thread count
+inline int chunkCount(int nodeCount) {
+    if (nodeCount < PARALLEL_CUTOFF) return 1;
+    return std::min(MAX_CHUNKS, nodeCount / (PARALLEL_CUTOFF / 4));
+}
+
+// Small deterministic offset for a node, so nodes started at one point
+// can separate
+inline Point jitter(int node, double scale) {
+    std::mt19937 gen(node);
+    std::uniform_real_distribution<> offset(-scale, scale);
+    double x = offset(gen);
+    return {x, offset(gen)};
+}
+
+// Iterate forces on points; incoming is null when graph is symmetric
+inline void refine(const CsrGraph& graph, const CsrGraph* incoming, std::vector<Point>& points, int iterations,
+                   double step, TaskPool& pool) {
+    int nodeCount = graph.nodeCount();
+    if (nodeCount < 2) return;
+    QuadTree tree;
+    std::vector<Point> next(nodeCount);
+    int chunks = chunkCount(nodeCount);
+    std::vector<double> chunkEnergy(chunks);
+    double energy = std::numeric_limits<double>::max();
+    int progress = 0;
+
+    for (int iteration = 0; iteration < iterations && step >= TOLERANCE; iteration++) {
+        tree.build(points);
+        parallelFor(pool, chunks, [&](int c) {
+            int begin = (int)((long long)nodeCount * c / chunks);
+            int end = (int)((long long)nodeCount * (c + 1) / chunks);
+            chunkEnergy[c] = 0;
+            for (int node = begin; node < end; node++) {
+                const Point& p = points[node];
+                Point force = tree.repulsion(points, node, REPULSION);
+                for (int direction = 0; direction < (incoming ? 2 : 1); direction++) {
+                    CsrGraph::Neighbors neighbors = (direction == 0 ? graph : *incoming).neighbors(node);
+                    for (int k = 0; k < neighbors.size(); k++) {
+                        const Point& q = points[neighbors.targets[k]];
+                        double dx = q.x - p.x;
+                        double dy = q.y - p.y;
+                        double d = std::sqrt(dx * dx + dy * dy);
+                        force.x += dx * d;
+                        force.y += dy * d;
+                    }
+                }
+                double norm = std::sqrt(force.x * force.x + force.y * force.y);
+                next[node] = p;
+                if (norm > 0) {
+                    double move = std::min(step, norm);
+                    next[node].x += move * force.x / norm;
+                    next[node].y += move * force.y / norm;
+                }
+                chunkEnergy[c] += norm * norm;
+            }
+        });
+        points.swap(next);
+
+        double previousEnergy = energy;
+        energy = 0;
+        for (double e : chunkEnergy) {
+            energy += e;
+        }
+        if (energy < previousEnergy) {
+            if (++progress >= 5) {
+                progress = 0;
+                step /= COOLING;
+            }
+        } else {
+            progress = 0;
+            step *= COOLING;
+        }
+    }
+}
+
+// Contract a matching of graph (plus incoming edges when given): each node
+// joins its unmatched neighbor of lowest degree, if any. group gets each
+// node's coarse node; returns the coarse graph, symmetric with unit weights.
+inline CsrGraph coarsen(const CsrGraph& graph, const CsrGraph* incoming, std::vector<int32_t>& group) {
+    int nodeCount = graph.nodeCount();
+    const std::vector<int32_t>& offsets = graph.edgeOffsets();
+    auto degree = [&](int node) {
+        return offsets[node + 1] - offsets[node] + (incoming ? incoming->edgeOffsets()[node + 1] - incoming->edgeOffsets()[node] : 0);
+    };
+
+    group.assign(nodeCount, -1);
+    std::vector<int32_t> members; // Coarse node c holds members[2c] and members[2c + 1] (-1 for none)
+    for (int node = 0; node < nodeCount; node++) {
+        if (group[node] >= 0) continue;
+        int mate = -1;
+        for (int direction = 0; direction < (incoming ? 2 : 1); direction++) {
+            CsrGraph::Neighbors neighbors = (direction == 0 ? graph : *incoming).neighbors(node);
+            for (int k = 0; k < neighbors.size(); k++) {
+                int neighbor = neighbors.targets[k];
+                if (neighbor != node && group[neighbor] < 0 &&
+                    (mate < 0 || degree(neighbor) < degree(mate) || (degree(neighbor) == degree(mate) && neighbor < mate))) {
+                    mate = neighbor;
+                }
+            }
+        }
+        int coarse = members.size() / 2;
+        group[node] = coarse;
+        members.push_back(node);
+        members.push_back(mate);
+        if (mate >= 0) {
+            group[mate] = coarse;
+        }
+    }
+
+    // Edges between distinct coarse nodes, each once per direction
+    int coarseCount = members.size() / 2;
+    std::vector<int32_t> coarseOffsets(1, 0), coarseTargets;
+    std::vector<int32_t> seen(coarseCount, -1);
+    for (int coarse = 0; coarse < coarseCount; coarse++) {
+        for (int m = 2 * coarse; m < 2 * coarse + 2 && members[m] >= 0; m++) {
+            for (int direction = 0; direction < (incoming ? 2 : 1); direction++) {
+                CsrGraph::Neighbors neighbors = (direction == 0 ? graph : *incoming).neighbors(members[m]);
+                for (int k = 0; k < neighbors.size(); k++) {
+                    int target = group[neighbors.targets[k]];
+                    if (target != coarse && seen[target] != coarse) {
+                        seen[target] = coarse;
+                        coarseTargets.push_back(target);
+                    }
+                }
+            }
+        }
+        coarseOffsets.push_back(coarseTargets.size());
+    }
+    std::vector<int32_t> weights(coarseTargets.size(), 1);
+    return CsrGraph(std::move(coarseOffsets), std::move(coarseTargets), std::move(weights));
+}
+
+// Multilevel layout from scratch
+inline void layoutCold(const CsrGraph& graph, const CsrGraph* incoming, std::vector<Point>& points, TaskPool& pool) {
+    std::vector<CsrGraph> levels;
+    std::vector<std::vector<int32_t>> groups;
+    const CsrGraph* fine = &graph;
+    while (fine->nodeCount() > COARSEST_SIZE) {
+        std::vector<int32_t> group;
+        CsrGraph coarse = coarsen(*fine, levels.empty() ? incoming : nullptr, group);
+        if (coarse.nodeCount() > MIN_COARSENING * fine->nodeCount()) break;
+        levels.push_back(std::move(coarse));
+        groups.push_back(std::move(group));
+        fine = &levels.back();
+    }
+
+    // Random positions in a square of the area the coarsest layout needs
+    int coarsest = fine->nodeCount();
+    std::mt19937 gen(coarsest);
+    std::uniform_real_distribution<> coordinate(0, std::sqrt((double)coarsest));
+    points.resize(coarsest);
+    for (Point& p : points) {
+        p.x = coordinate(gen);
+        p.y = coordinate(gen);
+    }
+    refine(*fine, levels.empty() ? incoming : nullptr, points, COARSEST_ITERATIONS, 1, pool);
+
+    // Each finer level starts from its coarse node's position, with the
+    // layout grown to keep the density of nodes
+    for (int level = levels.size() - 1; level >= 0; level--) {
+        const CsrGraph& target = level == 0 ? graph : levels[level - 1];
+        const std::vector<int32_t>& group = groups[level];
+        double scale = std::sqrt((double)target.nodeCount() / levels[level].nodeCount());
+        std::vector<Point> finer(target.nodeCount());
+        for (int node = 0; node < target.nodeCount(); node++) {
+            Point offset = jitter(node, 0.1);
+            finer[node] = {points[group[node]].x * scale + offset.x, points[group[node]].y * scale + offset.y};
+        }
+        points.swap(finer);
+        refine(target, level == 0 ? incoming : nullptr, points, REFINE_ITERATIONS, REFINE_STEP, pool);
+    }
+}
+
+} // namespace detail
+
+// Lay out graph into points, one per node. incoming must hold the reverse
+// edges of graph (graph itself when every edge has a reverse twin). The
+// positions already in points warm-start the layout when they cover at
+// least half of the nodes; otherwise it starts from scratch.
+inline void layout(const CsrGraph& graph, const CsrGraph& incoming, std::vector<Point>& points, TaskPool& pool) {
+    int nodeCount = graph.nodeCount();
+    const CsrGraph* reverse = &incoming == &graph ? nullptr : &incoming;
+    int placed = std::min<int>(points.size(), nodeCount);
+    if (placed * 2 < nodeCount) {
+        detail::layoutCold(graph, reverse, points, pool);
+        return;
+    }
+
+    // New nodes go to the centroid of their placed neighbors, or of all
+    // placed nodes when they have none
+    points.resize(nodeCount);
+    Point centroid = {0, 0};
+    for (int node = 0; node < placed; node++) {
+        centroid.x += points[node].x / placed;
+        centroid.y += points[node].y / placed;
+    }
+    for (int node = placed; node < nodeCount; node++) {
+        Point sum = {0, 0};
+        int count = 0;
+        for (int direction = 0; direction < (reverse ? 2 : 1); direction++) {
+            CsrGraph::Neighbors neighbors = (direction == 0 ? graph : *reverse).neighbors(node);
+            for (int k = 0; k < neighbors.size(); k++) {
+                int neighbor = neighbors.targets[k];
+                if (neighbor < node) {
+                    sum.x += points[neighbor].x;
+                    sum.y += points[neighbor].y;
+                    count++;
+                }
+            }
+        }
+        Point offset = detail::jitter(node, count > 0 ? 0.5 : 1.0);
+        points[node] = count > 0 ? Point{sum.x / count + offset.x, sum.y / count + offset.y}
+                                 : Point{centroid.x + offset.x, centroid.y + offset.y};
+    }
+    detail::refine(graph, reverse, points, REFINE_ITERATIONS, REFINE_STEP, pool);
+}
+
+} // namespace forcelayout
+
+#endif // FORCE_LAYOUT_H
@@ -2,427 +2,2262 @@
 
 #include <iostream>
 #include <vector>
-#include <queue>
-#include <stack>
-#include <map>
-#include <set>
 #include <limits>
 #include <algorithm>
 #include <string>
-#include <emscripten/bind.h>
-#include <emscripten/emscripten.h>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include "wasm_compat.h"
+#include "trace_policy.h"
+#include "step_buffer.h"
+#include "step_generator.h"
+#include "contraction_hierarchy.h"
+#include "csr_graph.h"
+#include "delta_stepping.h"
+#include "force_layout.h"
+#include "graph_file.h"
+#include "graph_generators.h"
+#include "graph_reorder.h"
+#include "multi_source_bfs.h"
+#include "parallel_bfs.h"
+#include "path_query.h"
+#include "priority_queues.h"
+#include "radix_sort.h"
+#include "step_message.h"
+#include "trace_cache.h"
+#include "visual_state.h"
 
 using namespace std;
+#ifdef __EMSCRIPTEN__
 using namespace emscripten;
+#endif
+
+// Module internals get internal linkage so the four modules can be linked
+// into one native binary without clashing type names
+namespace {
 
 // Type definitions for graph representation
 using NodeId = int;
 using Weight = int;
 
-// Node structure for visualization
-struct NodePosition {
-    NodeId id;
-    int value;
-    double x;
-    double y;
-    bool highlighted;
+// Step message templates (see step_message.h)
+enum GraphMessage : uint16_t {
+    GRAPH_DFS_START,
+    GRAPH_DFS_DONE,
+    GRAPH_BFS_START,
+    GRAPH_BFS_DONE,
+    GRAPH_VISIT,
+    GRAPH_DIJKSTRA_START,
+    GRAPH_DIJKSTRA_PROCESS,
+    GRAPH_DIJKSTRA_RELAX,
+    GRAPH_DIJKSTRA_DONE,
+    GRAPH_PARALLEL_BFS_START,
+    GRAPH_PARALLEL_BFS_TOP_DOWN,
+    GRAPH_PARALLEL_BFS_BOTTOM_UP,
+    GRAPH_PARALLEL_BFS_DONE,
+    GRAPH_DELTA_STEPPING_START,
+    GRAPH_DELTA_STEPPING_PHASE,
+    GRAPH_DELTA_STEPPING_DONE,
+    GRAPH_KRUSKAL_START,
+    GRAPH_KRUSKAL_ADD,
+    GRAPH_KRUSKAL_SKIP,
+    GRAPH_KRUSKAL_DONE,
+    GRAPH_PRIM_START,
+    GRAPH_PRIM_ROOT,
+    GRAPH_PRIM_ADD,
+    GRAPH_PRIM_UPDATE,
+    GRAPH_PRIM_DONE,
+    GRAPH_PATH_START,
+    GRAPH_PATH_SETTLE_FORWARD,
+    GRAPH_PATH_SETTLE_BACKWARD,
+    GRAPH_PATH_FOUND,
+    GRAPH_PATH_NONE,
+    GRAPH_REPAIR_START,
+    GRAPH_REPAIR_DONE,
+    GRAPH_MESSAGE_COUNT
 };
 
-// Edge structure for visualization
-struct EdgePosition {
-    NodeId source;
-    NodeId target;
-    Weight weight;
-    bool highlighted;
+const char* const GRAPH_MESSAGES[] = {
+    "Starting DFS from node {0}",
+    "DFS traversal complete",
+    "Starting BFS from node {0}",
+    "BFS traversal complete",
+    "Visiting node {0}",
+    "Starting Dijkstra's algorithm from node {0}",
+    "Processing node {0} with distance {1}",
+    "Updated distance to node {0} to {1}",
+    "Dijkstra's algorithm complete",
+    "Starting parallel BFS from node {0}",
+    "Level {0} top-down: {1} frontier nodes, {2} edges examined",
+    "Level {0} bottom-up: {1} frontier nodes, {2} edges examined",
+    "Parallel BFS complete: {0} nodes reached in {1} levels",
+    "Starting delta-stepping from node {0} with bucket width {1}",
+    "Bucket {0} (distances {1} to {2}): {3} nodes settled in {4} light rounds, {5} light and {6} heavy relaxations",
+    "Delta-stepping complete: {0} nodes reached in {1} buckets",
+    "Starting Kruskal's algorithm on {0} edges",
+    "Adding edge {0}-{1} with weight {2}",
+    "Skipping edge {0}-{1} with weight {2}, which would close a cycle",
+    "Kruskal's algorithm complete: {0} edges with total weight {1}",
+    "Starting Prim's algorithm from node {0}",
+    "Starting a tree at node {0}",
+    "Adding node {0} by edge {1}-{0} with weight {2}",
+    "Cheapest edge to node {0} is now from node {1} with weight {2}",
+    "Prim's algorithm complete: {0} edges with total weight {1}",
+    "Searching for a path from node {0} to node {1}",
+    "Settling node {0} at distance {1} from the source",
+    "Settling node {0} at distance {1} to the target",
+    "Shortest path from node {0} to node {1} has length {2}: {3} nodes settled",
+    "No path from node {0} to node {1}: {2} nodes settled",
+    "Repairing shortest paths from node {0} after {1} graph changes: {2} nodes detached",
+    "Repair complete: {0} nodes settled, {1} distances changed"
 };
+static_assert(sizeof(GRAPH_MESSAGES) / sizeof(GRAPH_MESSAGES[0]) == GRAPH_MESSAGE_COUNT, "one template per message");
 
-// Structure to hold algorithm state
-struct AlgorithmState {
-    vector<NodePosition> nodes;
-    vector<EdgePosition> edges;
-    string message;
-    int step;
-    int totalSteps;
+// Shortest path results indexed by node id
+struct ShortestPaths {
+    vector<int> distances; // numeric_limits<int>::max() when unreachable
+    vector<NodeId> previous; // -1 for the start node and unreachable nodes
+};
+
+// Breadth-first tree results indexed by node id
+struct BfsTree {
+    vector<int> depths; // -1 when unreachable
+    vector<NodeId> parents; // -1 for the start node and unreachable nodes
+};
+
+// Shortest path tree of the last Dijkstra run by CSR node, kept with the
+// graph changes made since so that the next run from the same start
+// repairs it
+struct PathTree {
+    NodeId start;
+    ShortestPaths paths;
+    int changes = 0; // Nodes and edges changed since the tree was computed
+    vector<NodeId> detached; // Nodes whose tree edge was removed or made longer
+    vector<pair<NodeId, NodeId>> shortcuts; // Edges (source, target) added or made shorter
+};
+
+// Minimum spanning forest of the graph with its edges taken as undirected
+struct SpanningForest {
+    vector<int> edges; // CSR indices in the order they were added
+    long long weight = 0;
+};
+
+// Disjoint sets of node ids with path compression and union by rank
+class UnionFind {
+private:
+    vector<int32_t> parent;
+    vector<uint8_t> rank;
+
+public:
+    explicit UnionFind(int count) : parent(count), rank(count, 0) {
+        for (int i = 0; i < count; i++) {
+            parent[i] = i;
+        }
+    }
+
+    int find(int node) {
+        int root = node;
+        while (parent[root] != root) {
+            root = parent[root];
+        }
+        while (parent[node] != root) {
+            int next = parent[node];
+            parent[node] = root;
+            node = next;
+        }
+        return root;
+    }
+
+    // Merge the sets of a and b; false when they already were one
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (rank[a] < rank[b]) swap(a, b);
+        parent[b] = a;
+        if (rank[a] == rank[b]) rank[a]++;
+        return true;
+    }
+};
+
+// Highlight change recorded in a graph trace: a node or edge gets new flags
+struct HighlightChange {
+    enum Kind : unsigned char { Node, Edge };
+    Kind kind;
+    uint8_t flags;
+    int index; // Node id, or CSR index of the edge (layout edge index)
+};
+
+// Parallel edges by CSR index: steps highlight every edge from a source to
+// a target together, so edges are chained into (source, target) groups
+class ParallelEdges {
+private:
+    vector<int32_t> first; // First edge of each edge's group
+    vector<int32_t> next; // Next edge of the group, -1 at the end
+
+public:
+    ParallelEdges() = default;
+
+    explicit ParallelEdges(const CsrGraph& graph) : first(graph.edgeCount()), next(graph.edgeCount(), -1) {
+        // Last edge to each target seen so far; entries from earlier
+        // sources have lower indices than the current node's edges
+        vector<int32_t> last(graph.nodeCount(), -1);
+        for (NodeId node = 0; node < graph.nodeCount(); node++) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(node);
+            for (int i = 0; i < neighbors.size(); i++) {
+                int edge = neighbors.first + i;
+                int& previous = last[neighbors.targets[i]];
+                if (previous >= neighbors.first) {
+                    first[edge] = first[previous];
+                    next[previous] = edge;
+                } else {
+                    first[edge] = edge;
+                }
+                previous = edge;
+            }
+        }
+    }
+
+    // The first edge of the given edge's group, which identifies the group
+    int group(int edge) const {
+        return first[edge];
+    }
+
+    // Call f with every edge of the given edge's group
+    template <class F>
+    void forEach(int edge, F f) const {
+        for (int e = first[edge]; e >= 0; e = next[e]) {
+            f(e);
+        }
+    }
+};
+
+// A step yielded by the graph step generators: its message and the
+// highlights it changes from the step before
+struct GraphStep {
+    StepMessage message;
+    vector<HighlightChange> changes;
+
+    void setNode(NodeId node, uint8_t flags) {
+        changes.push_back({HighlightChange::Node, flags, node});
+    }
+
+    // Move the node highlight from shown (-1 for none) to node
+    void moveNodeHighlight(NodeId& shown, NodeId node) {
+        if (shown == node) return;
+        if (shown >= 0) {
+            setNode(shown, 0);
+        }
+        setNode(node, STEP_HIGHLIGHTED);
+        shown = node;
+    }
+
+    // Set flags on an edge and its parallel copies
+    void setEdges(const ParallelEdges& parallel, int edge, uint8_t flags) {
+        parallel.forEach(edge, [&](int e) {
+            changes.push_back({HighlightChange::Edge, flags, e});
+        });
+    }
+};
+
+// Compact record of one visualization step
+struct GraphStepRecord {
+    int changeEnd; // Number of changes applied when this step is shown
+    StepMessage message;
+};
+
+// Delta-encoded trace: a highlight change log plus periodic keyframes of
+// the node and edge flags. Any step is rebuilt by replaying the log from
+// the nearest keyframe; node values and positions come from the layout
+// shared by all steps.
+class GraphTrace {
+private:
+    static constexpr int MIN_KEYFRAME_INTERVAL = 256;
+
+    struct Highlights {
+        vector<uint8_t> flags;
+        vector<uint8_t> edgeFlags;
+    };
+
+    vector<HighlightChange> changes;
+    vector<GraphStepRecord> steps;
+    vector<Highlights> keyframes; // keyframes[k] holds the flags after k * keyframeInterval changes
+    Highlights current; // Flags after all changes so far
+    int keyframeInterval;
+
+    static void apply(vector<uint8_t>& flags, vector<uint8_t>& edgeFlags, const HighlightChange& change) {
+        (change.kind == HighlightChange::Node ? flags : edgeFlags)[change.index] = change.flags;
+    }
+
+    void start(Highlights highlights) {
+        clear();
+        // One keyframe per node and edge count of changes keeps keyframe
+        // memory on par with the log
+        keyframeInterval = max(MIN_KEYFRAME_INTERVAL, (int)(highlights.flags.size() + highlights.edgeFlags.size()));
+        current = move(highlights);
+        keyframes.push_back(current);
+    }
+
+public:
+    GraphTrace() : keyframeInterval(0) {}
+
+    // Drop all recorded steps
+    void clear() {
+        changes.clear();
+        steps.clear();
+        keyframes.clear();
+    }
+
+    // Start a new trace with nothing highlighted
+    void reset(int nodeCount, int edgeCount) {
+        start({vector<uint8_t>(nodeCount, 0), vector<uint8_t>(edgeCount, 0)});
+    }
+
+    // Start a new trace from the highlights another trace ends with
+    void resetFrom(const GraphTrace& previous) {
+        start(previous.current);
+    }
+
+    // Record a step yielded by a step generator
+    void addStep(GraphStep&& step) {
+        for (const HighlightChange& change : step.changes) {
+            changes.push_back(change);
+            apply(current.flags, current.edgeFlags, change);
+            if (changes.size() % keyframeInterval == 0) {
+                keyframes.push_back(current);
+            }
+        }
+        steps.push_back({(int)changes.size(), move(step.message)});
+    }
+
+    int size() const {
+        return steps.size();
+    }
+
+    // Heap bytes held by the trace
+    size_t memoryBytes() const {
+        size_t bytes = changes.capacity() * sizeof(HighlightChange) + steps.capacity() * sizeof(GraphStepRecord);
+        for (const Highlights& keyframe : keyframes) {
+            bytes += keyframe.flags.capacity() + keyframe.edgeFlags.capacity();
+        }
+        return bytes + current.flags.capacity() + current.edgeFlags.capacity();
+    }
+
+    // Set the flags and message of state to those of the given step
+    void stateAt(int step, VisualState& state) const {
+        int target = steps[step].changeEnd;
+        int keyframe = target / keyframeInterval;
+        state.flags = keyframes[keyframe].flags;
+        state.edgeFlags = keyframes[keyframe].edgeFlags;
+        for (int k = keyframe * keyframeInterval; k < target; k++) {
+            apply(state.flags, state.edgeFlags, changes[k]);
+        }
+        state.message = steps[step].message;
+    }
+
+    // Visit steps [first, first + count) with state set to each, replaying
+    // the log once across the window instead of once per step
+    template <class Visitor>
+    void forEachStep(int first, int count, VisualState& state, Visitor visit) const {
+        if (count <= 0) return;
+        stateAt(first, state);
+        int applied = steps[first].changeEnd;
+        for (int step = first; step < first + count; step++) {
+            for (; applied < steps[step].changeEnd; applied++) {
+                apply(state.flags, state.edgeFlags, changes[applied]);
+            }
+            state.message = steps[step].message;
+            visit(step, state);
+        }
+    }
+};
+
+// A lazily generated step: step index of a delta-encoded chunk of the
+// trace. Chunks hold LAZY_CHUNK_STEPS consecutive steps and are freed once
+// no step in the lazy window refers to them.
+struct LazyGraphStep {
+    shared_ptr<const GraphTrace> chunk;
+    int index;
+
+    LazyGraphStep(shared_ptr<const GraphTrace> c, int i) : chunk(move(c)), index(i) {}
+};
+
+const int LAZY_CHUNK_STEPS = 256;
+
+// What decides the steps of a traced graph operation: the graph's
+// version, the operation (a performGraphOperation algorithm), its start
+// node, the trace mode, the settings the operation reads and, since a
+// Dijkstra run may repair the kept tree instead, the path repair state
+struct TraceKey {
+    uint64_t version;
+    int algorithm;
+    NodeId startNode;
+    int traceMode;
+    int settings[2]; // Delta-stepping bucket width; point-to-point target and method
+    int pathRepair;  // Dijkstra: path repair on
+    int repairs;     // Dijkstra: the run repairs the kept tree
+
+    bool operator==(const TraceKey&) const = default;
+};
+
+struct TraceKeyHash {
+    size_t operator()(const TraceKey& key) const {
+        size_t hash = std::hash<uint64_t>()(key.version);
+        for (int value : {key.algorithm, key.startNode, key.traceMode, key.settings[0], key.settings[1],
+                           key.pathRepair, key.repairs}) {
+            hash = hash * 31 + std::hash<int>()(value);
+        }
+        return hash;
+    }
 };
 
-// Graph class with adjacency list representation
+// A finished eager trace and the layout its steps draw
+struct CachedTrace {
+    shared_ptr<const GraphTrace> trace;
+    shared_ptr<const VisualLayout> layout;
+};
+
+// Memory kept for cached traces unless setTraceCacheBudget changes it
+const size_t DEFAULT_TRACE_CACHE_BYTES = 64 << 20;
+
+// Graph class with compressed sparse row storage (see csr_graph.h)
 class Graph {
 private:
-    struct Edge {
-        NodeId target;
-        Weight weight;
+    CsrGraphBuilder builder; // Nodes and edges as they are added
+    CsrGraph csr; // Adjacency read by the algorithms, builder's edges merged in on demand
+    bool csrCurrent; // False while builder has changes csr lacks
+    bool symmetric; // Every edge has a reverse twin (true unless loaded from directed files)
+    CsrGraph reverseCsr; // Transpose of csr for bottom-up searches on directed graphs
+    bool reverseCurrent; // False while reverseCsr lags csr
+    vector<forcelayout::Point> layoutPoints; // Force-directed layout by node id, before scaling
+    vector<pair<double, double>> nodePositions; // Indexed by node id
+    bool layoutCurrent; // False while nodes or edges were added since the last layout
+    int negativeWeights; // 1 or 0 once csr's weights were checked, -1 before
+    pathquery::Landmarks landmarks; // ALT landmark distances of csr
+    bool landmarksCurrent; // False while landmarks lag csr
+    double pathScale; // A* weight per unit of distance between nodePositions
+    bool pathScaleCurrent; // False while pathScale lags nodePositions
+    contraction::Hierarchy hierarchy; // Contraction hierarchy of csr for PATH_CONTRACTION queries
+    bool hierarchyCurrent; // False while hierarchy lags csr
+    shared_ptr<const GraphTrace> trace; // Steps of the last traced operation
+    shared_ptr<const VisualLayout> traceLayout; // Layout shared by the traced steps
+    LazySteps<LazyGraphStep> lazySteps;
+    int currentStep;
+    int totalSteps;
+    int lazyWindow; // Steps kept in memory by lazy traces, 0 for eager traces
+    uint64_t version; // Bumped by every change to the nodes, edges, layout or hierarchy
+    // Once the nodes are reordered (see graph_reorder.h), CSR node i is
+    // node ids[i] as added and node id v is CSR node slots[v]; both stay
+    // empty while every node is its own id
+    vector<NodeId> ids;
+    vector<NodeId> slots;
+    TraceCache<TraceKey, CachedTrace, TraceKeyHash> traceCache; // Finished traces of this version
+    shared_ptr<PathTree> pathTree; // Last Dijkstra tree while it can be repaired, else null
+    bool pathRepair; // Keep Dijkstra trees to repair after changes
+
+    // CSR node of a node id, and node id of a CSR node; ids out of range
+    // (such as -1 for "none") pass through
+    NodeId slotOf(NodeId id) const {
+        return id >= 0 && id < (int)slots.size() ? slots[id] : id;
+    }
+
+    NodeId idOf(NodeId slot) const {
+        return slot >= 0 && slot < (int)ids.size() ? ids[slot] : slot;
+    }
+
+    // Replace CSR nodes by their ids in place
+    void toIds(vector<NodeId>& nodes) const {
+        if (ids.empty()) return;
+        for (NodeId& node : nodes) {
+            node = idOf(node);
+        }
+    }
+
+    // Shortest paths from CSR nodes to node ids
+    void toIds(ShortestPaths& paths) const {
+        toIds(paths.previous);
+        indexById(paths.previous);
+        indexById(paths.distances);
+    }
+
+    // Reindex values of each CSR node by node id
+    template <class T>
+    void indexById(vector<T>& values) const {
+        if (ids.empty()) return;
+        vector<T> byId(values.size());
+        for (size_t slot = 0; slot < values.size(); slot++) {
+            byId[ids[slot]] = move(values[slot]);
+        }
+        values = move(byId);
+    }
+
+    // Replace CSR edge indices in place by the indices the edges have with
+    // the nodes in id order (each node keeps its edges in order)
+    void toEdgeIds(vector<int>& edges) {
+        if (ids.empty()) return;
+        const vector<int32_t>& offsets = adjacency().edgeOffsets();
+        vector<int32_t> firstById(ids.size() + 1, 0);
+        for (size_t id = 0; id < ids.size(); id++) {
+            firstById[id + 1] = firstById[id] + offsets[slots[id] + 1] - offsets[slots[id]];
+        }
+        for (int& edge : edges) {
+            NodeId source = upper_bound(offsets.begin(), offsets.end(), edge) - offsets.begin() - 1;
+            edge = firstById[ids[source]] + edge - offsets[source];
+        }
+    }
+
+    // Record a change to the graph. Traces of earlier versions can never be
+    // replayed again, so the cache lets go of them at once.
+    void changed() {
+        version++;
+        traceCache.clear();
+        lazySteps.clear();
+    }
+
+    // Record an in-place change to csr's edges
+    void edgesChanged() {
+        reverseCurrent = false;
+        negativeWeights = -1;
+        landmarksCurrent = false;
+        pathScaleCurrent = false;
+        hierarchyCurrent = false;
+        changed();
+    }
+
+    // Keep the shortest paths from start (CSR nodes) for the next Dijkstra
+    // run from start to repair, unless repair is off or some weight is
+    // negative
+    void keepPathTree(NodeId start, const ShortestPaths& paths) {
+        pathTree.reset();
+        if (!pathRepair || !adjacency().contains(start) || hasNegativeWeights()) return;
+        pathTree = make_shared<PathTree>();
+        pathTree->start = start;
+        pathTree->paths = paths;
+    }
+
+    // Note a change to the edges from source to target (CSR nodes) in the
+    // kept tree: a removed or longer tree edge detaches target, and an added
+    // or shorter edge may shorten paths through it
+    void notePathEdge(NodeId source, NodeId target, bool longer, bool shorter) {
+        if (!pathTree) return;
+        const vector<NodeId>& previous = pathTree->paths.previous;
+        if (longer && target < (NodeId)previous.size() && previous[target] == source) {
+            pathTree->detached.push_back(target);
+        }
+        if (shorter) {
+            pathTree->shortcuts.push_back({source, target});
+        }
+        pathTree->changes++;
+    }
+
+    // Set the weight of the edges from source to target (CSR nodes),
+    // returning how many there are
+    int reweightEdges(NodeId source, NodeId target, Weight weight) {
+        CsrGraph::Neighbors neighbors = csr.neighbors(source);
+        int count = 0;
+        bool longer = false, shorter = false;
+        for (int k = 0; k < neighbors.size(); k++) {
+            if (neighbors.targets[k] != target) continue;
+            longer = longer || weight > neighbors.weights[k];
+            shorter = shorter || weight < neighbors.weights[k];
+            csr.setWeight(neighbors.first + k, weight);
+            count++;
+        }
+        if (longer || shorter) {
+            notePathEdge(source, target, longer, shorter);
+        }
+        return count;
+    }
+
+    // Calculate node positions: a force-directed layout (see
+    // force_layout.h) warm-started from the last one, scaled to fit the
+    // visualization area
+    void calculateNodePositions() {
+        const double LEFT = 100; // Visualization area
+        const double TOP = 80;
+        const double WIDTH = 600;
+        const double HEIGHT = 400;
+        
+        const CsrGraph& graph = adjacency();
+        int nodeCount = graph.nodeCount();
+        forcelayout::layout(graph, incomingAdjacency(), layoutPoints, TaskPool::shared());
+        layoutCurrent = true;
+        pathScaleCurrent = false;
+        nodePositions.resize(nodeCount);
+        if (nodeCount == 0) {
+            return;
+        }
+        
+        double minX = layoutPoints[0].x, maxX = minX, minY = layoutPoints[0].y, maxY = minY;
+        for (const forcelayout::Point& p : layoutPoints) {
+            minX = min(minX, p.x);
+            maxX = max(maxX, p.x);
+            minY = min(minY, p.y);
+            maxY = max(maxY, p.y);
+        }
+        
+        // One scale for both axes, centered; a single node sits in the middle
+        double spanX = maxX - minX;
+        double spanY = maxY - minY;
+        double scale = spanX > 0 || spanY > 0 ? min(spanX > 0 ? WIDTH / spanX : HEIGHT / spanY,
+                                                    spanY > 0 ? HEIGHT / spanY : WIDTH / spanX) : 0;
+        for (int i = 0; i < nodeCount; i++) {
+            double x = LEFT + WIDTH / 2 + (layoutPoints[i].x - (minX + maxX) / 2) * scale;
+            double y = TOP + HEIGHT / 2 + (layoutPoints[i].y - (minY + maxY) / 2) * scale;
+            nodePositions[i] = make_pair(x, y);
+        }
+    }
+
+    // The CSR form of the graph, refrozen after nodes or edges were added
+    const CsrGraph& adjacency() {
+        if (!csrCurrent) {
+            builder.freeze(csr);
+            csrCurrent = true;
+            reverseCurrent = false;
+            negativeWeights = -1;
+            landmarksCurrent = false;
+            hierarchyCurrent = false;
+        }
+        return csr;
+    }
+
+    // The contraction hierarchy of the graph, rebuilt after a change
+    // (empty with negative weights)
+    contraction::Hierarchy& contractionHierarchy() {
+        const CsrGraph& graph = adjacency();
+        if (!hierarchyCurrent) {
+            hierarchy.build(graph, TaskPool::shared());
+            hierarchyCurrent = true;
+        }
+        return hierarchy;
+    }
+
+    // True when some edge weight is negative, checked once per change
+    bool hasNegativeWeights() {
+        const CsrGraph& graph = adjacency();
+        if (negativeWeights < 0) {
+            const vector<int32_t>& weights = graph.edgeWeights();
+            negativeWeights = any_of(weights.begin(), weights.end(), [](int32_t weight) { return weight < 0; });
+        }
+        return negativeWeights == 1;
+    }
+
+    // Incoming edges of each node, for bottom-up searches: the graph
+    // itself while it is symmetric, else its transpose
+    const CsrGraph& incomingAdjacency() {
+        const CsrGraph& graph = adjacency();
+        if (symmetric) {
+            return graph;
+        }
+        if (!reverseCurrent) {
+            reverseCsr = transposeGraph(graph);
+            reverseCurrent = true;
+        }
+        return reverseCsr;
+    }
+
+    // Lay out the nodes and edges once for all steps of an operation; layout
+    // edge i is CSR edge i
+    shared_ptr<const VisualLayout> createLayout() {
+        const CsrGraph& graph = adjacency();
+        
+        // Lay out nodes and edges added since the last layout
+        if (!layoutCurrent) {
+            calculateNodePositions();
+        }
+        
+        auto layout = make_shared<VisualLayout>();
+        for (NodeId node = 0; node < graph.nodeCount(); node++) {
+            auto pos = node < (int)nodePositions.size() ? nodePositions[node] : make_pair(0.0, 0.0);
+            layout->addElement(idOf(node), pos.first, pos.second);
+        }
+        for (NodeId node = 0; node < graph.nodeCount(); node++) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(node);
+            for (int i = 0; i < neighbors.size(); i++) {
+                layout->addEdge(idOf(node), idOf(neighbors.targets[i]), neighbors.weights[i]);
+            }
+        }
+        return layout;
+    }
+
+    // A state showing the traced operation's layout with each node's id
+    VisualState createTraceState() const {
+        VisualState state(traceLayout, StepMessage());
+        state.values = traceLayout->ids;
+        return state;
+    }
+
+    // Build the visualization state of a recorded step
+    VisualState createStepState(const GraphTrace& source, int index, int step, int total) const {
+        VisualState state = createTraceState();
+        source.stateAt(index, state);
+        state.step = step + 1;
+        state.totalSteps = total;
+        return state;
+    }
+
+    // Set total steps once a trace is complete
+    void finishTrace() {
+        totalSteps = trace->size();
+        currentStep = 0;
+    }
+
+    // Steps of one operation collected into delta-encoded chunks, for lazy traces
+    static StepGenerator<LazyGraphStep> materializeSteps(StepGenerator<GraphStep> steps, int nodeCount, int edgeCount) {
+        auto chunk = make_shared<GraphTrace>();
+        chunk->reset(nodeCount, edgeCount);
+        for (GraphStep& step : steps) {
+            chunk->addStep(move(step));
+            co_yield LazyGraphStep(chunk, chunk->size() - 1);
+            
+            // Start the next chunk from the highlights as they are now
+            if (chunk->size() >= LAZY_CHUNK_STEPS) {
+                auto next = make_shared<GraphTrace>();
+                next->resetFrom(*chunk);
+                chunk = move(next);
+            }
+        }
+    }
+
+    // Run an algorithm's step generator, storing its result. Eager traces
+    // record every step now; lazy traces compute the result untraced and
+    // replay the traced generator on demand as steps are requested.
+    template <class Trace, class StepsFn, class Result>
+    void runSteps(StepsFn steps, Result& result) {
+        auto recorded = make_shared<GraphTrace>();
+        trace = recorded;
+        lazySteps.clear();
+        if constexpr (Trace::recordsPhases) {
+            traceLayout = createLayout();
+            int nodeCount = traceLayout->size();
+            int edgeCount = traceLayout->edgeCount();
+            if (lazyWindow > 0) {
+                lazySteps.start([steps, nodeCount, edgeCount] {
+                    return materializeSteps(steps(Trace(), nullptr), nodeCount, edgeCount);
+                }, lazyWindow);
+                steps(TraceOff(), &result).drain();
+                finishTrace();
+                return;
+            }
+            recorded->reset(nodeCount, edgeCount);
+        }
+        for (GraphStep& step : steps(Trace(), &result)) {
+            recorded->addStep(move(step));
+        }
+        finishTrace();
+    }
+
+    // Depth-First Search steps; the visit order goes to result when given.
+    // Each step highlights the visited node and the traversal edges found
+    // before it.
+    template <class Trace>
+    StepGenerator<GraphStep> depthFirstSearchSteps(NodeId startNode, vector<NodeId>* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_DFS_START, idOf(startNode));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        // Track visited nodes
+        const CsrGraph& graph = adjacency();
+        vector<NodeId> order;
+        vector<bool> visited(graph.nodeCount(), false);
+        vector<NodeId> nodeStack;
+        NodeId shownNode = -1; // Node highlighted by the last step
+        
+        if (graph.contains(startNode)) {
+            nodeStack.push_back(startNode);
+        }
+        
+        while (!nodeStack.empty()) {
+            NodeId current = nodeStack.back();
+            nodeStack.pop_back();
+            
+            if (visited[current]) {
+                continue;
+            }
+            
+            visited[current] = true;
+            order.push_back(current);
+            
+            // Create a step for this node visit
+            if constexpr (Trace::recordsSteps) {
+                step.moveNodeHighlight(shownNode, current);
+                step.message = StepMessage(GRAPH_VISIT, idOf(current));
+                co_yield step;
+                step.changes.clear();
+            }
+            
+            // Add neighbors to stack in reverse order (to visit in original
+            // order); every edge pushed is a traversal edge, parallel
+            // copies included
+            CsrGraph::Neighbors neighbors = graph.neighbors(current);
+            for (int i = neighbors.size() - 1; i >= 0; i--) {
+                NodeId neighbor = neighbors.targets[i];
+                if (!visited[neighbor]) {
+                    nodeStack.push_back(neighbor);
+                    if constexpr (Trace::recordsPhases) {
+                        step.changes.push_back({HighlightChange::Edge, STEP_HIGHLIGHTED, neighbors.first + i});
+                    }
+                }
+            }
+        }
+        
+        // Final step: the last visited node with every traversal edge
+        if constexpr (Trace::recordsPhases) {
+            if (!order.empty()) {
+                step.moveNodeHighlight(shownNode, order.back());
+            }
+            step.message = StepMessage(GRAPH_DFS_DONE);
+            co_yield step;
+        }
+        if (result) {
+            *result = move(order);
+        }
+    }
+
+    // Breadth-First Search steps; the visit order goes to result when
+    // given. Each step highlights the visited node and the traversal edges
+    // found before it.
+    template <class Trace>
+    StepGenerator<GraphStep> breadthFirstSearchSteps(NodeId startNode, vector<NodeId>* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_BFS_START, idOf(startNode));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        // Track visited nodes; the visit order doubles as the queue
+        const CsrGraph& graph = adjacency();
+        vector<NodeId> order;
+        vector<bool> visited(graph.nodeCount(), false);
+        ParallelEdges parallel;
+        NodeId shownNode = -1; // Node highlighted by the last step
+        if constexpr (Trace::recordsPhases) {
+            parallel = ParallelEdges(graph);
+        }
+        
+        if (graph.contains(startNode)) {
+            visited[startNode] = true;
+            order.push_back(startNode);
+        }
+        
+        for (size_t head = 0; head < order.size(); head++) {
+            NodeId current = order[head];
+            
+            // Create a step for this node visit
+            if constexpr (Trace::recordsSteps) {
+                step.moveNodeHighlight(shownNode, current);
+                step.message = StepMessage(GRAPH_VISIT, idOf(current));
+                co_yield step;
+                step.changes.clear();
+            }
+            
+            // Add all neighbors to queue
+            CsrGraph::Neighbors neighbors = graph.neighbors(current);
+            for (int i = 0; i < neighbors.size(); i++) {
+                NodeId neighbor = neighbors.targets[i];
+                if (!visited[neighbor]) {
+                    visited[neighbor] = true;
+                    order.push_back(neighbor);
+                    if constexpr (Trace::recordsPhases) {
+                        step.setEdges(parallel, neighbors.first + i, STEP_HIGHLIGHTED);
+                    }
+                }
+            }
+        }
+        
+        // Final step: the last visited node with every traversal edge
+        if constexpr (Trace::recordsPhases) {
+            if (!order.empty()) {
+                step.moveNodeHighlight(shownNode, order.back());
+            }
+            step.message = StepMessage(GRAPH_BFS_DONE);
+            co_yield step;
+        }
+        if (result) {
+            *result = move(order);
+        }
+    }
+
+    // Dijkstra's algorithm steps on the given queue class (see
+    // priority_queues.h); the shortest paths go to result when given. Each
+    // processing step highlights the node and the shortest path edges
+    // found before it; a relaxation step adds the relaxed edge.
+    template <class Trace, class Queue>
+    StepGenerator<GraphStep> dijkstraSteps(NodeId startNode, int maxWeight, ShortestPaths* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_DIJKSTRA_START, idOf(startNode));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        // Initialize distances with infinity
+        const CsrGraph& graph = adjacency();
+        int nodeCount = graph.nodeCount();
+        vector<int> distances(nodeCount, numeric_limits<int>::max());
+        vector<NodeId> previous(nodeCount, -1);
+        vector<bool> settled(nodeCount, false);
+        Queue queue(distances, maxWeight);
+        
+        if (graph.contains(startNode)) {
+            distances[startNode] = 0;
+            queue.update(startNode);
+        }
+        
+        // Path edges by node for traces: the edge from previous[node] now
+        // and as the last processing step showed it (-1 for none), and the
+        // nodes whose path edge changed since that step
+        ParallelEdges parallel;
+        vector<int> pathEdges(Trace::recordsPhases ? nodeCount : 0, -1);
+        vector<int> shownPathEdges(pathEdges);
+        vector<NodeId> pathChanges;
+        NodeId shownNode = -1; // Node highlighted by the last processing step
+        int relaxedEdge = -1; // Edge relaxed since then, which the final step shows
+        if constexpr (Trace::recordsPhases) {
+            parallel = ParallelEdges(graph);
+        }
+        
+        // Only reached nodes are queued, so the loop ends when the rest
+        // are unreachable
+        while (!queue.empty()) {
+            // Take the unvisited node with minimum distance (lowest id on ties)
+            NodeId current = queue.pop();
+            
+            // Create a step for this node visit
+            if constexpr (Trace::recordsPhases) {
+                step.moveNodeHighlight(shownNode, current);
+                for (NodeId node : pathChanges) {
+                    if (shownPathEdges[node] != pathEdges[node]) {
+                        if (shownPathEdges[node] >= 0) {
+                            step.setEdges(parallel, shownPathEdges[node], 0);
+                        }
+                        step.setEdges(parallel, pathEdges[node], STEP_HIGHLIGHTED);
+                        shownPathEdges[node] = pathEdges[node];
+                    }
+                }
+                pathChanges.clear();
+                relaxedEdge = -1;
+                step.message = StepMessage(GRAPH_DIJKSTRA_PROCESS, idOf(current), distances[current]);
+                co_yield step;
+                step.changes.clear();
+            }
+            
+            // Remove the current node from unvisited
+            settled[current] = true;
+            
+            // Check all neighbors
+            CsrGraph::Neighbors neighbors = graph.neighbors(current);
+            for (int i = 0; i < neighbors.size(); i++) {
+                NodeId neighbor = neighbors.targets[i];
+                int alt = distances[current] + neighbors.weights[i];
+                
+                if (alt < distances[neighbor]) {
+                    distances[neighbor] = alt;
+                    previous[neighbor] = current;
+                    if (!settled[neighbor]) {
+                        queue.update(neighbor);
+                    }
+                    if constexpr (Trace::recordsPhases) {
+                        pathEdges[neighbor] = neighbors.first + i;
+                        pathChanges.push_back(neighbor);
+                    }
+                    
+                    // Create a step for this relaxation, highlighting the
+                    // relaxed edge for that step only
+                    if constexpr (Trace::recordsSteps) {
+                        relaxedEdge = neighbors.first + i;
+                        step.setEdges(parallel, relaxedEdge, STEP_HIGHLIGHTED);
+                        step.message = StepMessage(GRAPH_DIJKSTRA_RELAX, idOf(neighbor), alt);
+                        co_yield step;
+                        step.changes.clear();
+                        step.setEdges(parallel, relaxedEdge, 0);
+                    }
+                }
+            }
+        }
+        
+        // Final step: the last processing step's highlights plus all
+        // shortest paths (and the last relaxed edge, as the step before did)
+        if constexpr (Trace::recordsPhases) {
+            for (NodeId node : pathChanges) {
+                if (shownPathEdges[node] != pathEdges[node]) {
+                    step.setEdges(parallel, pathEdges[node], STEP_HIGHLIGHTED);
+                }
+            }
+            if (relaxedEdge >= 0) {
+                step.setEdges(parallel, relaxedEdge, STEP_HIGHLIGHTED);
+            }
+            step.message = StepMessage(GRAPH_DIJKSTRA_DONE);
+            co_yield step;
+        }
+        
+        if (!result) {
+            co_return;
+        }
+        
+        // The results are already indexed by node id
+        result->distances = move(distances);
+        result->previous = move(previous);
+    }
+
+    // Repair of a kept shortest path tree after graph changes (Ramalingam
+    // and Reps); the shortest paths go to result when given. In order of old
+    // distance, each node whose tree edge was removed or made longer keeps
+    // its distance when another closer node not detached still reaches it by
+    // a shortest path, and is detached with its tree children otherwise.
+    // Dijkstra's algorithm then runs from the detached nodes' remaining
+    // in-edges and from added or shorter edges, settling only the nodes
+    // whose distance may change. Distances match a full run; on ties a node
+    // may keep a different parent. The first step shows the surviving tree
+    // with the detached nodes marked, and the rest follow the search over
+    // the affected region as dijkstraSteps does.
+    template <class Trace>
+    StepGenerator<GraphStep> repairSteps(shared_ptr<const PathTree> base, ShortestPaths* result) {
+        GraphStep step;
+        const CsrGraph& graph = adjacency();
+        const CsrGraph& incoming = incomingAdjacency();
+        int nodeCount = graph.nodeCount();
+        const int UNREACHED = numeric_limits<int>::max();
+        vector<int> distances = base->paths.distances;
+        vector<NodeId> previous = base->paths.previous;
+        distances.resize(nodeCount, UNREACHED);
+        previous.resize(nodeCount, -1);
+        
+        // Detach the nodes left without a shortest path, closest first: a
+        // node detached later is never closer than one kept before it
+        enum : uint8_t { UNCHECKED, KEPT, DETACHED };
+        vector<uint8_t> state(nodeCount, UNCHECKED);
+        vector<NodeId> detached;
+        priority_queue<pair<int, NodeId>, vector<pair<int, NodeId>>, greater<pair<int, NodeId>>> candidates;
+        for (NodeId node : base->detached) {
+            if (node != base->start && distances[node] != UNREACHED) {
+                candidates.push({distances[node], node});
+            }
+        }
+        while (!candidates.empty()) {
+            NodeId node = candidates.top().second;
+            candidates.pop();
+            if (state[node] != UNCHECKED) continue;
+            int distance = distances[node];
+            NodeId parent = -1;
+            CsrGraph::Neighbors sources = incoming.neighbors(node);
+            for (int k = 0; k < sources.size() && parent < 0; k++) {
+                NodeId source = sources.targets[k];
+                if (state[source] != DETACHED && distances[source] < distance &&
+                    distances[source] + sources.weights[k] == distance) {
+                    parent = source;
+                }
+            }
+            if (parent >= 0) {
+                previous[node] = parent;
+                state[node] = KEPT;
+                continue;
+            }
+            state[node] = DETACHED;
+            detached.push_back(node);
+            CsrGraph::Neighbors children = graph.neighbors(node);
+            for (int k = 0; k < children.size(); k++) {
+                NodeId child = children.targets[k];
+                if (previous[child] == node && state[child] == UNCHECKED) {
+                    candidates.push({distances[child], child});
+                }
+            }
+        }
+        vector<int> oldDistances(detached.size());
+        for (size_t i = 0; i < detached.size(); i++) {
+            oldDistances[i] = distances[detached[i]];
+            distances[detached[i]] = UNREACHED;
+            previous[detached[i]] = -1;
+        }
+        
+        // Path edges by node for traces, as in dijkstraSteps
+        ParallelEdges parallel;
+        vector<int> pathEdges(Trace::recordsPhases ? nodeCount : 0, -1);
+        vector<int> shownPathEdges;
+        vector<NodeId> pathChanges;
+        NodeId shownNode = -1;
+        int relaxedEdge = -1;
+        
+        // The edge from source to target on a shortest path
+        auto pathEdge = [&](NodeId source, NodeId target) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(source);
+            for (int k = 0; k < neighbors.size(); k++) {
+                if (neighbors.targets[k] == target && distances[source] + neighbors.weights[k] == distances[target]) {
+                    return neighbors.first + k;
+                }
+            }
+            return -1;
+        };
+        
+        if constexpr (Trace::recordsPhases) {
+            parallel = ParallelEdges(graph);
+            for (NodeId node = 0; node < nodeCount; node++) {
+                if (previous[node] >= 0) {
+                    pathEdges[node] = pathEdge(previous[node], node);
+                    if (pathEdges[node] >= 0) {
+                        step.setEdges(parallel, pathEdges[node], STEP_HIGHLIGHTED);
+                    }
+                }
+            }
+            for (NodeId node : detached) {
+                step.setNode(node, STEP_SWAPPING);
+            }
+            shownPathEdges = pathEdges;
+            step.message = StepMessage(GRAPH_REPAIR_START, idOf(base->start), base->changes, (int)detached.size());
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        // Seed the search with the detached nodes' in-edges from the rest
+        // and with the added or shorter edges
+        DaryHeap<4> queue(distances, 0);
+        auto relax = [&](NodeId source, NodeId target, int weight, int edge) {
+            int alt = distances[source] + weight;
+            if (alt >= distances[target]) return false;
+            distances[target] = alt;
+            previous[target] = source;
+            queue.update(target);
+            if constexpr (Trace::recordsPhases) {
+                pathEdges[target] = edge;
+                pathChanges.push_back(target);
+            }
+            return true;
+        };
+        for (NodeId node : detached) {
+            CsrGraph::Neighbors sources = incoming.neighbors(node);
+            for (int k = 0; k < sources.size(); k++) {
+                NodeId source = sources.targets[k];
+                if (state[source] != DETACHED && distances[source] != UNREACHED &&
+                    distances[source] + sources.weights[k] < distances[node]) {
+                    relax(source, node, sources.weights[k], -1);
+                }
+            }
+        }
+        for (const pair<NodeId, NodeId>& shortcut : base->shortcuts) {
+            NodeId source = shortcut.first;
+            if (distances[source] == UNREACHED) continue;
+            CsrGraph::Neighbors neighbors = graph.neighbors(source);
+            for (int k = 0; k < neighbors.size(); k++) {
+                if (neighbors.targets[k] == shortcut.second) {
+                    relax(source, shortcut.second, neighbors.weights[k], neighbors.first + k);
+                }
+            }
+        }
+        if constexpr (Trace::recordsPhases) {
+            // Seeds through in-edges have no out-edge index yet
+            for (NodeId node : pathChanges) {
+                if (pathEdges[node] < 0) {
+                    pathEdges[node] = pathEdge(previous[node], node);
+                }
+            }
+        }
+        
+        int settledCount = 0;
+        int changedCount = 0;
+        while (!queue.empty()) {
+            NodeId current = queue.pop();
+            settledCount++;
+            
+            if constexpr (Trace::recordsPhases) {
+                step.moveNodeHighlight(shownNode, current);
+                for (NodeId node : pathChanges) {
+                    if (shownPathEdges[node] != pathEdges[node]) {
+                        if (shownPathEdges[node] >= 0) {
+                            step.setEdges(parallel, shownPathEdges[node], 0);
+                        }
+                        step.setEdges(parallel, pathEdges[node], STEP_HIGHLIGHTED);
+                        shownPathEdges[node] = pathEdges[node];
+                    }
+                }
+                pathChanges.clear();
+                relaxedEdge = -1;
+                step.message = StepMessage(GRAPH_DIJKSTRA_PROCESS, idOf(current), distances[current]);
+                co_yield step;
+                step.changes.clear();
+            }
+            
+            CsrGraph::Neighbors neighbors = graph.neighbors(current);
+            for (int i = 0; i < neighbors.size(); i++) {
+                NodeId neighbor = neighbors.targets[i];
+                if (relax(current, neighbor, neighbors.weights[i], neighbors.first + i)) {
+                    if constexpr (Trace::recordsSteps) {
+                        relaxedEdge = neighbors.first + i;
+                        step.setEdges(parallel, relaxedEdge, STEP_HIGHLIGHTED);
+                        step.message = StepMessage(GRAPH_DIJKSTRA_RELAX, idOf(neighbor), distances[neighbor]);
+                        co_yield step;
+                        step.changes.clear();
+                        step.setEdges(parallel, relaxedEdge, 0);
+                    }
+                }
+            }
+        }
+        
+        // A node changed distance when it was settled at a new one, or was
+        // detached and is now out of reach
+        vector<bool> counted(nodeCount, false);
+        for (size_t i = 0; i < detached.size(); i++) {
+            if (distances[detached[i]] != oldDistances[i]) {
+                counted[detached[i]] = true;
+                changedCount++;
+            }
+        }
+        for (const pair<NodeId, NodeId>& shortcut : base->shortcuts) {
+            NodeId node = shortcut.second;
+            int old = node < (NodeId)base->paths.distances.size() ? base->paths.distances[node] : UNREACHED;
+            if (!counted[node] && distances[node] != old) {
+                counted[node] = true;
+                changedCount++;
+            }
+        }
+        
+        // Final step: the last processing step's highlights plus all
+        // shortest paths, with the detached nodes left out of reach unmarked
+        if constexpr (Trace::recordsPhases) {
+            for (NodeId node : pathChanges) {
+                if (shownPathEdges[node] != pathEdges[node]) {
+                    step.setEdges(parallel, pathEdges[node], STEP_HIGHLIGHTED);
+                }
+            }
+            if (relaxedEdge >= 0) {
+                step.setEdges(parallel, relaxedEdge, STEP_HIGHLIGHTED);
+            }
+            for (NodeId node : detached) {
+                if (distances[node] == UNREACHED) {
+                    step.setNode(node, 0);
+                }
+            }
+            step.message = StepMessage(GRAPH_REPAIR_DONE, settledCount, changedCount);
+            co_yield step;
+        }
+        
+        if (result) {
+            result->distances = move(distances);
+            result->previous = move(previous);
+        }
+    }
+
+    // Direction-optimizing parallel BFS steps (see parallel_bfs.h); the
+    // BFS tree goes to result when given. The search runs to the end
+    // first, then every expanded level becomes a phase step with its
+    // statistics that highlights its frontier.
+    template <class Trace>
+    StepGenerator<GraphStep> parallelBreadthFirstSearchSteps(NodeId startNode, BfsTree* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_PARALLEL_BFS_START, idOf(startNode));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        const CsrGraph& graph = adjacency();
+        const CsrGraph& incoming = incomingAdjacency();
+        BfsTree tree;
+        vector<parallel::BfsLevel> levels;
+        parallel::breadthFirstSearch(graph, incoming, startNode, TaskPool::shared(), tree.depths, tree.parents,
+                                     Trace::recordsPhases ? &levels : nullptr);
+        
+        if constexpr (Trace::recordsPhases) {
+            // Group the reached nodes by depth
+            vector<int> levelStart(levels.size() + 1, 0);
+            for (int depth : tree.depths) {
+                if (depth >= 0) levelStart[depth + 1]++;
+            }
+            for (size_t level = 0; level < levels.size(); level++) {
+                levelStart[level + 1] += levelStart[level];
+            }
+            vector<NodeId> byDepth(levelStart.back());
+            vector<int> next(levelStart.begin(), levelStart.end() - 1);
+            for (NodeId node = 0; node < (NodeId)tree.depths.size(); node++) {
+                if (tree.depths[node] >= 0) byDepth[next[tree.depths[node]]++] = node;
+            }
+            
+            for (size_t level = 0; level < levels.size(); level++) {
+                // Highlight this level's frontier in place of the one before
+                if (level > 0) {
+                    for (int i = levelStart[level - 1]; i < levelStart[level]; i++) {
+                        step.setNode(byDepth[i], 0);
+                    }
+                }
+                for (int i = levelStart[level]; i < levelStart[level + 1]; i++) {
+                    step.setNode(byDepth[i], STEP_HIGHLIGHTED);
+                }
+                const parallel::BfsLevel& stats = levels[level];
+                step.message = StepMessage(stats.direction == parallel::BFS_TOP_DOWN ? GRAPH_PARALLEL_BFS_TOP_DOWN
+                                                                                   : GRAPH_PARALLEL_BFS_BOTTOM_UP,
+                                           stats.depth, stats.frontier, stats.edgesExamined);
+                co_yield step;
+                step.changes.clear();
+            }
+            
+            step.message = StepMessage(GRAPH_PARALLEL_BFS_DONE, byDepth.size(), levels.size());
+            co_yield step;
+        }
+        if (result) {
+            *result = move(tree);
+        }
+    }
+
+    // Delta-stepping steps (see delta_stepping.h) with bucket width delta
+    // over non-negative weights up to maxWeight; the shortest paths go to
+    // result when given. The search runs to the end first, then every
+    // settled bucket becomes a phase step with its statistics that
+    // highlights the nodes it settled, and the final step adds the
+    // shortest path edges.
+    template <class Trace>
+    StepGenerator<GraphStep> deltaSteppingSteps(NodeId startNode, int delta, int maxWeight, ShortestPaths* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_DELTA_STEPPING_START, idOf(startNode), delta);
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        const CsrGraph& graph = adjacency();
+        ShortestPaths paths;
+        parallel::DeltaSteppingTrace phaseTrace;
+        parallel::deltaStepping(graph, startNode, delta, maxWeight, TaskPool::shared(), paths.distances, paths.previous,
+                                Trace::recordsPhases ? &phaseTrace : nullptr);
+        
+        if constexpr (Trace::recordsPhases) {
+            // Phases settle consecutive runs of the settle order
+            int phaseStart = 0;
+            int previousStart = 0;
+            for (const parallel::DeltaSteppingPhase& phase : phaseTrace.phases) {
+                for (int i = previousStart; i < phaseStart; i++) {
+                    step.setNode(phaseTrace.settleOrder[i], 0);
+                }
+                for (int i = phaseStart; i < phaseStart + phase.settled; i++) {
+                    step.setNode(phaseTrace.settleOrder[i], STEP_HIGHLIGHTED);
+                }
+                long long low = (long long)phase.bucket * delta;
+                long long high = min<long long>(low + delta - 1, numeric_limits<int>::max());
+                step.message = StepMessage(GRAPH_DELTA_STEPPING_PHASE, phase.bucket, low, high, phase.settled,
+                                           phase.lightRounds, phase.lightRelaxations, phase.heavyRelaxations);
+                co_yield step;
+                step.changes.clear();
+                previousStart = phaseStart;
+                phaseStart += phase.settled;
+            }
+            
+            ParallelEdges parallel(graph);
+            for (int edge : phaseTrace.pathEdges) {
+                if (edge >= 0) {
+                    step.setEdges(parallel, edge, STEP_HIGHLIGHTED);
+                }
+            }
+            step.message = StepMessage(GRAPH_DELTA_STEPPING_DONE, phaseTrace.settleOrder.size(), phaseTrace.phases.size());
+            co_yield step;
+        }
+        if (result) {
+            *result = move(paths);
+        }
+    }
+
+    // Kruskal's algorithm steps; the minimum spanning forest goes to result
+    // when given. Edges are taken in weight order (CSR order on ties) from
+    // a radix-sorted list holding each undirected edge once. Every added
+    // edge stays highlighted with its endpoints; full traces also flash
+    // each skipped edge for one step.
+    template <class Trace>
+    StepGenerator<GraphStep> kruskalSteps(SpanningForest* result) {
+        GraphStep step;
+        const CsrGraph& graph = adjacency();
+        int nodeCount = graph.nodeCount();
+        
+        // Both directions of a symmetric graph's edges are stored, so only
+        // the one from the lower id is a candidate there
+        vector<NodeId> sources;
+        vector<int32_t> candidates;
+        vector<int> keys;
+        for (NodeId node = 0; node < nodeCount; node++) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(node);
+            for (int i = 0; i < neighbors.size(); i++) {
+                NodeId target = neighbors.targets[i];
+                if (target == node || (symmetric && target < node)) continue;
+                sources.push_back(node);
+                candidates.push_back(neighbors.first + i);
+                keys.push_back(neighbors.weights[i]);
+            }
+        }
+        vector<int32_t> order;
+        radix::sortIndices(keys.data(), keys.size(), order);
+        
+        ParallelEdges parallel;
+        vector<uint8_t> treeGroups; // Groups holding a tree edge, by group
+        if constexpr (Trace::recordsPhases) {
+            parallel = ParallelEdges(graph);
+            treeGroups.assign(graph.edgeCount(), 0);
+            step.message = StepMessage(GRAPH_KRUSKAL_START, candidates.size());
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        // A spanning forest has at most nodeCount - 1 edges
+        SpanningForest forest;
+        UnionFind components(nodeCount);
+        for (size_t k = 0; k < order.size() && (int)forest.edges.size() < nodeCount - 1; k++) {
+            int32_t candidate = order[k];
+            int edge = candidates[candidate];
+            NodeId source = sources[candidate];
+            NodeId target = graph.edgeTargets()[edge];
+            if (components.unite(source, target)) {
+                forest.edges.push_back(edge);
+                forest.weight += keys[candidate];
+                if constexpr (Trace::recordsPhases) {
+                    treeGroups[parallel.group(edge)] = 1;
+                    step.setNode(source, STEP_HIGHLIGHTED);
+                    step.setNode(target, STEP_HIGHLIGHTED);
+                    step.setEdges(parallel, edge, STEP_HIGHLIGHTED);
+                    step.message = StepMessage(GRAPH_KRUSKAL_ADD, idOf(source), idOf(target), keys[candidate]);
+                    co_yield step;
+                    step.changes.clear();
+                }
+            } else if constexpr (Trace::recordsSteps) {
+                step.setEdges(parallel, edge, STEP_SWAPPING);
+                step.message = StepMessage(GRAPH_KRUSKAL_SKIP, idOf(source), idOf(target), keys[candidate]);
+                co_yield step;
+                step.changes.clear();
+                step.setEdges(parallel, edge, treeGroups[parallel.group(edge)] ? uint8_t(STEP_HIGHLIGHTED) : uint8_t(0));
+            }
+        }
+        
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_KRUSKAL_DONE, forest.edges.size(), forest.weight);
+            co_yield step;
+        }
+        if (result) {
+            *result = move(forest);
+        }
+    }
+
+    // Prim's algorithm steps from startNode on an indexed d-ary heap of
+    // each outside node's cheapest edge into the tree; the minimum spanning
+    // forest goes to result when given. When the tree runs out of edges,
+    // the lowest-id node outside starts the next one. Edges count in both
+    // directions, so directed graphs also scan their incoming edges. Each
+    // added node stays highlighted with its tree edge; full traces also
+    // flash each cheaper edge found for one step.
+    template <class Trace>
+    StepGenerator<GraphStep> primSteps(NodeId startNode, SpanningForest* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_PRIM_START, idOf(startNode));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        const CsrGraph& graph = adjacency();
+        const CsrGraph& incoming = incomingAdjacency();
+        int nodeCount = graph.nodeCount();
+        vector<int> keys(nodeCount, numeric_limits<int>::max());
+        vector<NodeId> parents(nodeCount, -1);
+        vector<int> parentEdges(nodeCount, -1); // CSR index, or ~index in incoming for edges into the parent
+        vector<bool> inTree(nodeCount, false);
+        DaryHeap<4> heap(keys, 0);
+        
+        // The CSR index of an edge from node into its parent, which every
+        // edge into node from its parent has in reverse
+        auto edgeToParent = [&](NodeId node, int incomingEdge) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(node);
+            int weight = incoming.edgeWeights()[incomingEdge];
+            int i = 0;
+            while (i < neighbors.size() && (neighbors.targets[i] != parents[node] || neighbors.weights[i] != weight)) {
+                i++;
+            }
+            assert(i < neighbors.size());
+            return neighbors.first + i;
+        };
+        
+        ParallelEdges parallel;
+        if constexpr (Trace::recordsPhases) {
+            parallel = ParallelEdges(graph);
+        }
+        
+        SpanningForest forest;
+        for (NodeId next = -1; next < nodeCount; next++) {
+            NodeId root = next < 0 ? startNode : next;
+            if (!graph.contains(root) || inTree[root]) continue;
+            keys[root] = 0;
+            heap.update(root);
+            
+            while (!heap.empty()) {
+                NodeId current = heap.pop();
+                inTree[current] = true;
+                if (parents[current] < 0) {
+                    if constexpr (Trace::recordsPhases) {
+                        step.setNode(current, STEP_HIGHLIGHTED);
+                        step.message = StepMessage(GRAPH_PRIM_ROOT, idOf(current));
+                        co_yield step;
+                        step.changes.clear();
+                    }
+                } else {
+                    int edge = parentEdges[current];
+                    if (edge < 0) {
+                        edge = edgeToParent(current, ~edge);
+                    }
+                    forest.edges.push_back(edge);
+                    forest.weight += keys[current];
+                    if constexpr (Trace::recordsPhases) {
+                        step.setNode(current, STEP_HIGHLIGHTED);
+                        step.setEdges(parallel, edge, STEP_HIGHLIGHTED);
+                        step.message = StepMessage(GRAPH_PRIM_ADD, idOf(current), idOf(parents[current]),
+                                                   keys[current]);
+                        co_yield step;
+                        step.changes.clear();
+                    }
+                }
+                
+                // Outgoing edges, then incoming ones unless every edge has
+                // a reverse twin
+                for (int direction = 0; direction < (symmetric ? 1 : 2); direction++) {
+                    CsrGraph::Neighbors neighbors = (direction == 0 ? graph : incoming).neighbors(current);
+                    for (int i = 0; i < neighbors.size(); i++) {
+                        NodeId neighbor = neighbors.targets[i];
+                        if (inTree[neighbor] || neighbors.weights[i] >= keys[neighbor]) continue;
+                        keys[neighbor] = neighbors.weights[i];
+                        parents[neighbor] = current;
+                        parentEdges[neighbor] = direction == 0 ? neighbors.first + i : ~(neighbors.first + i);
+                        heap.update(neighbor);
+                        
+                        if constexpr (Trace::recordsSteps) {
+                            int edge = direction == 0 ? neighbors.first + i : edgeToParent(neighbor, neighbors.first + i);
+                            step.setEdges(parallel, edge, STEP_SWAPPING);
+                            step.message = StepMessage(GRAPH_PRIM_UPDATE, idOf(neighbor), idOf(current), keys[neighbor]);
+                            co_yield step;
+                            step.changes.clear();
+                            step.setEdges(parallel, edge, 0);
+                        }
+                    }
+                }
+            }
+        }
+        
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_PRIM_DONE, forest.edges.size(), forest.weight);
+            co_yield step;
+        }
+        if (result) {
+            *result = move(forest);
+        }
+    }
+
+    // Point-to-point search steps from source to target by the given
+    // PathMethod (see path_query.h) over non-negative weights; the path goes
+    // to result when given. The search runs to the end first, then full
+    // traces highlight the settled nodes one step each, in settle order,
+    // with the second highlight for those settled from the target (the
+    // downward search space of a contraction hierarchy query), and the
+    // final step adds the path's nodes and edges.
+    template <class Trace>
+    StepGenerator<GraphStep> pathQuerySteps(NodeId source, NodeId target, int method, pathquery::PathResult* result) {
+        GraphStep step;
+        if constexpr (Trace::recordsPhases) {
+            step.message = StepMessage(GRAPH_PATH_START, idOf(source), idOf(target));
+            co_yield step;
+            step.changes.clear();
+        }
+        
+        const CsrGraph& graph = adjacency();
+        vector<pathquery::SettledNode> log;
+        vector<pathquery::SettledNode>* settled = Trace::recordsSteps ? &log : nullptr;
+        pathquery::PathResult path;
+        if (method == pathquery::PATH_BIDIRECTIONAL) {
+            path = pathquery::bidirectionalDijkstra(graph, incomingAdjacency(), source, target, settled);
+        } else if (method == pathquery::PATH_CONTRACTION) {
+            path = contractionHierarchy().query(source, target, settled);
+        } else if (method == pathquery::PATH_ALT) {
+            if (!landmarksCurrent) {
+                landmarks.build(graph, incomingAdjacency(), pathquery::DEFAULT_LANDMARKS);
+                landmarksCurrent = true;
+            }
+            path = pathquery::aStar(graph, source, target, [&](int node) {
+                return landmarks.bound(node, target);
+            }, settled);
+        } else {
+            // Straight-line estimates on the current layout
+            if (!layoutCurrent) {
+                calculateNodePositions();
+            }
+            if (!pathScaleCurrent) {
+                pathScale = pathquery::coordinateScale(graph, nodePositions);
+                pathScaleCurrent = true;
+            }
+            pair<double, double> goal = graph.contains(target) ? nodePositions[target] : make_pair(0.0, 0.0);
+            path = pathquery::aStar(graph, source, target, [&](int node) {
+                double length = hypot(nodePositions[node].first - goal.first, nodePositions[node].second - goal.second);
+                return (int)min(pathScale * length, (double)numeric_limits<int>::max());
+            }, settled);
+        }
+        
+        if constexpr (Trace::recordsSteps) {
+            for (const pathquery::SettledNode& node : log) {
+                step.setNode(node.node, node.backward ? STEP_SWAPPING : STEP_HIGHLIGHTED);
+                step.message = StepMessage(node.backward ? GRAPH_PATH_SETTLE_BACKWARD : GRAPH_PATH_SETTLE_FORWARD,
+                                           idOf(node.node), node.distance);
+                co_yield step;
+                step.changes.clear();
+            }
+        }
+        if constexpr (Trace::recordsPhases) {
+            // The lightest edge joins each pair of consecutive path nodes
+            ParallelEdges parallel(graph);
+            for (size_t i = 0; i < path.path.size(); i++) {
+                step.setNode(path.path[i], STEP_HIGHLIGHTED);
+                if (i == 0) continue;
+                CsrGraph::Neighbors neighbors = graph.neighbors(path.path[i - 1]);
+                int edge = -1;
+                for (int k = 0; k < neighbors.size(); k++) {
+                    if (neighbors.targets[k] == path.path[i] && (edge < 0 || neighbors.weights[k] < neighbors.weights[edge])) {
+                        edge = k;
+                    }
+                }
+                step.setEdges(parallel, neighbors.first + edge, STEP_HIGHLIGHTED);
+            }
+            NodeId from = idOf(source), to = idOf(target);
+            step.message = path.path.empty() ? StepMessage(GRAPH_PATH_NONE, from, to, path.settled)
+                                             : StepMessage(GRAPH_PATH_FOUND, from, to, path.distance, path.settled);
+            co_yield step;
+        }
+        if (result) {
+            *result = move(path);
+        }
+    }
+
+public:
+    Graph() : csrCurrent(true), symmetric(true), reverseCurrent(false), layoutCurrent(true), negativeWeights(-1),
+              landmarksCurrent(false), pathScale(0), pathScaleCurrent(false), hierarchyCurrent(false),
+              trace(make_shared<GraphTrace>()), traceLayout(make_shared<VisualLayout>()), currentStep(0), totalSteps(0),
+              lazyWindow(0), version(0), traceCache(DEFAULT_TRACE_CACHE_BYTES), pathRepair(true) {}
+
+    // Add a node to the graph
+    NodeId addNode() {
+        NodeId id = builder.addNode();
+        if (!ids.empty()) {
+            ids.push_back(id);
+            slots.push_back(id);
+        }
+        if (pathTree) {
+            pathTree->changes++;
+        }
+        csrCurrent = false;
+        layoutCurrent = false;
+        changed();
+        // Position will be calculated when needed
+        return id;
+    }
+
+    // Add an edge between nodes
+    void addEdge(NodeId source, NodeId target, Weight weight = 1) {
+        if (builder.contains(source) && builder.contains(target)) {
+            builder.addEdge(slotOf(source), slotOf(target), weight);
+            // For undirected graph, add the reverse edge
+            builder.addEdge(slotOf(target), slotOf(source), weight);
+            notePathEdge(slotOf(source), slotOf(target), false, true);
+            notePathEdge(slotOf(target), slotOf(source), false, true);
+            csrCurrent = false;
+            layoutCurrent = false;
+            changed();
+        }
+    }
+
+    // Remove the edges from source to target and, unless the graph is
+    // directed, those from target to source; returns how many were removed.
+    // The CSR arrays are compacted in place, one pass over all edges.
+    int removeEdge(NodeId source, NodeId target) {
+        const CsrGraph& graph = adjacency();
+        if (!graph.contains(source) || !graph.contains(target)) {
+            return 0;
+        }
+        NodeId from = slotOf(source), to = slotOf(target);
+        bool both = symmetric && from != to;
+        CsrGraph::Neighbors neighbors = graph.neighbors(from);
+        if (find(neighbors.targets, neighbors.targets + neighbors.size(), to) == neighbors.targets + neighbors.size()) {
+            return 0;
+        }
+        int removed = csr.removeEdges([from, to, both](int u, int v) {
+            return (u == from && v == to) || (both && u == to && v == from);
+        });
+        notePathEdge(from, to, true, false);
+        if (both) {
+            notePathEdge(to, from, true, false);
+        }
+        layoutCurrent = false;
+        edgesChanged();
+        return removed;
+    }
+
+    // Set the weight of the edges from source to target and, unless the
+    // graph is directed, those from target to source; returns how many
+    // there are
+    int setEdgeWeight(NodeId source, NodeId target, Weight weight) {
+        const CsrGraph& graph = adjacency();
+        if (!graph.contains(source) || !graph.contains(target)) {
+            return 0;
+        }
+        NodeId from = slotOf(source), to = slotOf(target);
+        int count = reweightEdges(from, to, weight);
+        if (count > 0 && symmetric && from != to) {
+            count += reweightEdges(to, from, weight);
+        }
+        if (count > 0) {
+            edgesChanged();
+        }
+        return count;
+    }
+
+    // Remove a node with its edges; the nodes with higher ids move down by
+    // one. False when there is no such node.
+    bool removeNode(NodeId node) {
+        const CsrGraph& graph = adjacency();
+        if (!graph.contains(node)) {
+            return false;
+        }
+        NodeId slot = slotOf(node);
+        if (pathTree && pathTree->start == slot) {
+            pathTree.reset();
+        } else if (pathTree) {
+            // Its tree children lose their tree edge
+            CsrGraph::Neighbors neighbors = graph.neighbors(slot);
+            for (int k = 0; k < neighbors.size(); k++) {
+                notePathEdge(slot, neighbors.targets[k], true, false);
+            }
+        }
+        csr.removeEdges([slot](int u, int v) { return u == slot || v == slot; });
+        csr.removeNode(slot);
+        builder.reset(csr.nodeCount());
+
+        if (!ids.empty()) {
+            ids.erase(ids.begin() + slot);
+            slots.erase(slots.begin() + node);
+            for (NodeId& id : ids) {
+                id -= id > node;
+            }
+            for (NodeId& other : slots) {
+                other -= other > slot;
+            }
+        }
+        if (layoutPoints.size() == nodePositions.size() && slot < (NodeId)layoutPoints.size()) {
+            layoutPoints.erase(layoutPoints.begin() + slot);
+            nodePositions.erase(nodePositions.begin() + slot);
+        } else {
+            layoutPoints.clear();
+        }
+
+        // Renumber the kept tree; the removed node's children are detached
+        if (pathTree) {
+            auto renumber = [slot](NodeId& other) {
+                if (other == slot) {
+                    other = -1;
+                } else {
+                    other -= other > slot;
+                }
+            };
+            ShortestPaths& paths = pathTree->paths;
+            if (slot < (NodeId)paths.distances.size()) {
+                paths.distances.erase(paths.distances.begin() + slot);
+                paths.previous.erase(paths.previous.begin() + slot);
+            }
+            for (NodeId& previous : paths.previous) {
+                renumber(previous);
+            }
+            erase(pathTree->detached, slot);
+            for (NodeId& detached : pathTree->detached) {
+                renumber(detached);
+            }
+            erase_if(pathTree->shortcuts, [slot](const pair<NodeId, NodeId>& edge) {
+                return edge.first == slot || edge.second == slot;
+            });
+            for (pair<NodeId, NodeId>& edge : pathTree->shortcuts) {
+                renumber(edge.first);
+                renumber(edge.second);
+            }
+            pathTree->start -= pathTree->start > slot;
+            pathTree->changes++;
+        }
+        layoutCurrent = false;
+        edgesChanged();
+        return true;
+    }
+
+    // Keep the last Dijkstra tree to repair after graph changes (the
+    // default), or run every Dijkstra from scratch
+    void setPathRepair(bool enabled) {
+        pathRepair = enabled;
+        if (!enabled) {
+            pathTree.reset();
+        }
+    }
+
+    bool getPathRepair() const {
+        return pathRepair;
+    }
+
+    // Whether a Dijkstra run from startNode now would repair the kept tree
+    // rather than run from scratch
+    bool repairsPathsFrom(NodeId startNode) {
+        return pathTree && pathTree->start == slotOf(startNode) && pathTree->changes > 0 && !hasNegativeWeights();
+    }
+
+    // Generate traced steps on demand, keeping at most window steps in
+    // memory (0 records every step when the algorithm runs). Lazy steps
+    // read the graph as it is, so changing the graph drops them.
+    void setLazySteps(int window) {
+        lazyWindow = max(window, 0);
+    }
+
+    // Depth-First Search implementation, returns the visit order
+    template <class Trace = TraceFull>
+    vector<NodeId> depthFirstSearch(NodeId startNode) {
+        vector<NodeId> order;
+        NodeId start = slotOf(startNode);
+        runSteps<Trace>([this, start](auto policy, vector<NodeId>* result) {
+            return depthFirstSearchSteps<decltype(policy)>(start, result);
+        }, order);
+        toIds(order);
+        return order;
+    }
 
-        Edge(NodeId t, Weight w) : target(t), weight(w) {}
-    };
+    // Breadth-First Search implementation, returns the visit order
+    template <class Trace = TraceFull>
+    vector<NodeId> breadthFirstSearch(NodeId startNode) {
+        vector<NodeId> order;
+        NodeId start = slotOf(startNode);
+        runSteps<Trace>([this, start](auto policy, vector<NodeId>* result) {
+            return breadthFirstSearchSteps<decltype(policy)>(start, result);
+        }, order);
+        toIds(order);
+        return order;
+    }
 
-    map<NodeId, vector<Edge>> adjacencyList;
-    map<NodeId, pair<double, double>> nodePositions;
-    int nextNodeId;
-    vector<AlgorithmState> states;
-    int currentStep;
-    int totalSteps;
+    // Direction-optimizing parallel BFS, returns the depth and parent of
+    // every node
+    template <class Trace = TraceFull>
+    BfsTree parallelBreadthFirstSearch(NodeId startNode) {
+        BfsTree tree;
+        NodeId start = slotOf(startNode);
+        runSteps<Trace>([this, start](auto policy, BfsTree* result) {
+            return parallelBreadthFirstSearchSteps<decltype(policy)>(start, result);
+        }, tree);
+        toIds(tree.parents);
+        indexById(tree.parents);
+        indexById(tree.depths);
+        return tree;
+    }
 
-    // Calculate node positions (arrange in a grid or circular layout)
-    void calculateNodePositions() {
-        const int GRID_SIZE = 4; // For grid layout
-        const double CENTER_X = 400; // Center of visualization
-        const double CENTER_Y = 250;
-        const double RADIUS = 150; // For circular layout
-        
-        if (adjacencyList.size() <= 1) {
-            // Only one node, place in center
-            for (auto& node : adjacencyList) {
-                nodePositions[node.first] = make_pair(CENTER_X, CENTER_Y);
-            }
-            return;
+    // Untraced bit-parallel BFS from every node of sources at once (see
+    // multi_source_bfs.h); depths, when given, gets one row of depths by
+    // node id per source
+    parallel::MultiBfsStats multiSourceBreadthFirstSearch(const vector<NodeId>& sources, vector<int>* depths = nullptr) {
+        const CsrGraph& graph = adjacency();
+        vector<int32_t> starts(sources.size());
+        for (size_t i = 0; i < sources.size(); i++) {
+            starts[i] = slotOf(sources[i]);
         }
-        
-        // Choose layout based on number of nodes
-        if (adjacencyList.size() <= 8) {
-            // Circular layout for small graphs
-            int i = 0;
-            for (auto& node : adjacencyList) {
-                double angle = 2 * M_PI * i / adjacencyList.size();
-                double x = CENTER_X + RADIUS * cos(angle);
-                double y = CENTER_Y + RADIUS * sin(angle);
-                nodePositions[node.first] = make_pair(x, y);
-                i++;
+        parallel::MultiBfsStats stats;
+        parallel::multiSourceBfs(graph, incomingAdjacency(), starts, TaskPool::shared(), stats, depths);
+        if (depths && !ids.empty()) {
+            int nodes = graph.nodeCount();
+            vector<int> row(nodes);
+            for (size_t first = 0; first < depths->size(); first += nodes) {
+                for (int slot = 0; slot < nodes; slot++) {
+                    row[ids[slot]] = (*depths)[first + slot];
+                }
+                copy(row.begin(), row.end(), depths->begin() + first);
             }
+        }
+        return stats;
+    }
+
+    // Dijkstra's algorithm implementation on the selected priority queue
+    // (QueueKind). Graphs with negative or large weights use the d-ary heap
+    // in place of the bucket queue; the steps are the same for every queue.
+    // After graph changes, a run from the same start as the last one
+    // repairs its shortest path tree (see repairSteps) unless path repair
+    // was turned off.
+    template <class Trace = TraceFull>
+    ShortestPaths dijkstraAlgorithm(NodeId startNode, int queue = QUEUE_DARY_HEAP) {
+        ShortestPaths paths;
+        NodeId start = slotOf(startNode);
+        if (repairsPathsFrom(startNode)) {
+            shared_ptr<const PathTree> base = pathTree;
+            runSteps<Trace>([this, base](auto policy, ShortestPaths* result) {
+                return repairSteps<decltype(policy)>(base, result);
+            }, paths);
         } else {
-            // Grid layout for larger graphs
-            int rows = ceil(sqrt(adjacencyList.size()));
-            int cols = ceil(adjacencyList.size() / (double)rows);
-            int i = 0;
-            
-            for (auto& node : adjacencyList) {
-                int row = i / cols;
-                int col = i % cols;
-                double x = 100 + col * (600 / (cols - 1));
-                double y = 80 + row * (400 / (rows - 1));
-                nodePositions[node.first] = make_pair(x, y);
-                i++;
+            int maxWeight = 0;
+            if (queue == QUEUE_BUCKET) {
+                for (int32_t weight : adjacency().edgeWeights()) {
+                    if (weight < 0 || weight > BUCKET_QUEUE_MAX_WEIGHT) {
+                        queue = QUEUE_DARY_HEAP;
+                        break;
+                    }
+                    maxWeight = max(maxWeight, (int)weight);
+                }
             }
+            runSteps<Trace>([this, start, queue, maxWeight](auto policy, ShortestPaths* result) {
+                return withPriorityQueue(queue, [&](auto queueType) {
+                    using Queue = typename decltype(queueType)::type;
+                    return dijkstraSteps<decltype(policy), Queue>(start, maxWeight, result);
+                });
+            }, paths);
         }
+        keepPathTree(start, paths);
+        toIds(paths);
+        return paths;
     }
 
-    // Create the initial state for visualization
-    AlgorithmState createInitialState(const string& message) {
-        AlgorithmState state;
-        state.message = message;
-        state.step = 1;
-        
-        // Make sure node positions are calculated
-        if (nodePositions.empty() && !adjacencyList.empty()) {
-            calculateNodePositions();
-        }
-        
-        // Add nodes to state
-        for (const auto& node : adjacencyList) {
-            auto pos = nodePositions[node.first];
-            state.nodes.push_back({node.first, node.first, pos.first, pos.second, false});
-        }
-        
-        // Add edges to state
-        for (const auto& node : adjacencyList) {
-            for (const auto& edge : node.second) {
-                state.edges.push_back({node.first, edge.target, edge.weight, false});
+    // Delta-stepping shortest paths with the given bucket width (0 picks
+    // one from the weights and average degree). The results match
+    // dijkstraAlgorithm; graphs with negative weights run it instead.
+    template <class Trace = TraceFull>
+    ShortestPaths deltaSteppingAlgorithm(NodeId startNode, int delta = 0) {
+        int maxWeight = 0;
+        for (int32_t weight : adjacency().edgeWeights()) {
+            if (weight < 0) {
+                return dijkstraAlgorithm<Trace>(startNode);
             }
+            maxWeight = max(maxWeight, (int)weight);
         }
+        delta = parallel::deltaSteppingWidth(adjacency(), delta, maxWeight);
         
-        return state;
+        ShortestPaths paths;
+        NodeId start = slotOf(startNode);
+        runSteps<Trace>([this, start, delta, maxWeight](auto policy, ShortestPaths* result) {
+            return deltaSteppingSteps<decltype(policy)>(start, delta, maxWeight, result);
+        }, paths);
+        toIds(paths);
+        return paths;
     }
 
-public:
-    Graph() : nextNodeId(0), currentStep(0), totalSteps(0) {}
-
-    // Add a node to the graph
-    NodeId addNode() {
-        NodeId id = nextNodeId++;
-        adjacencyList[id] = vector<Edge>();
-        // Position will be calculated when needed
-        return id;
+    // Kruskal's minimum spanning forest, with edges taken as undirected
+    template <class Trace = TraceFull>
+    SpanningForest kruskalAlgorithm() {
+        SpanningForest forest;
+        runSteps<Trace>([this](auto policy, SpanningForest* result) {
+            return kruskalSteps<decltype(policy)>(result);
+        }, forest);
+        toEdgeIds(forest.edges);
+        return forest;
     }
 
-    // Add an edge between nodes
-    void addEdge(NodeId source, NodeId target, Weight weight = 1) {
-        if (adjacencyList.find(source) != adjacencyList.end() && 
-            adjacencyList.find(target) != adjacencyList.end()) {
-            adjacencyList[source].push_back(Edge(target, weight));
-            // For undirected graph, add the reverse edge
-            adjacencyList[target].push_back(Edge(source, weight));
-        }
+    // Prim's minimum spanning forest grown from startNode first, with
+    // edges taken as undirected
+    template <class Trace = TraceFull>
+    SpanningForest primAlgorithm(NodeId startNode) {
+        SpanningForest forest;
+        NodeId start = slotOf(startNode);
+        runSteps<Trace>([this, start](auto policy, SpanningForest* result) {
+            return primSteps<decltype(policy)>(start, result);
+        }, forest);
+        toEdgeIds(forest.edges);
+        return forest;
     }
 
-    // Depth-First Search implementation
-    void depthFirstSearch(NodeId startNode) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState = createInitialState("Starting DFS from node " + to_string(startNode));
-        states.push_back(initialState);
-        
-        // Track visited nodes
-        set<NodeId> visited;
-        stack<NodeId> nodeStack;
-        vector<pair<NodeId, NodeId>> traversalEdges; // (source, target) pairs
-        
-        nodeStack.push(startNode);
-        
-        while (!nodeStack.empty()) {
-            NodeId current = nodeStack.top();
-            nodeStack.pop();
-            
-            if (visited.find(current) != visited.end()) {
-                continue;
-            }
-            
-            visited.insert(current);
-            
-            // Create a state for this node visit
-            AlgorithmState state = initialState;
-            state.step = states.size() + 1;
-            state.message = "Visiting node " + to_string(current);
-            
-            // Highlight the current node
-            for (auto& node : state.nodes) {
-                node.highlighted = (node.id == current);
+    // Shortest path from source to target by the given PathMethod:
+    // bidirectional Dijkstra, A* on the node coordinates (laying the graph
+    // out first when it changed), ALT on landmarks picked at the first
+    // query after a change, or a contraction hierarchy query (built at the
+    // first one after a change unless loaded with loadHierarchy). Graphs with negative weights take the path
+    // from a full dijkstraAlgorithm run instead, settling every reachable
+    // node (no path when negative cycles leave none).
+    template <class Trace = TraceFull>
+    pathquery::PathResult pathQuery(NodeId source, NodeId target, int method) {
+        pathquery::PathResult path;
+        if (hasNegativeWeights()) {
+            ShortestPaths paths = dijkstraAlgorithm<Trace>(source);
+            if (!adjacency().contains(target)) {
+                return path;
             }
-            
-            // Highlight edges in the traversal path
-            for (auto& edge : state.edges) {
-                for (const auto& tEdge : traversalEdges) {
-                    if (edge.source == tEdge.first && edge.target == tEdge.second) {
-                        edge.highlighted = true;
-                    }
+            path.settled = count_if(paths.distances.begin(), paths.distances.end(),
+                                    [](int distance) { return distance != numeric_limits<int>::max(); });
+            path.distance = paths.distances[target];
+            if (path.distance != numeric_limits<int>::max()) {
+                // Negative cycles can close the chain of previous nodes
+                for (NodeId node = target; node >= 0 && (int)path.path.size() <= path.settled; node = paths.previous[node]) {
+                    path.path.push_back(node);
                 }
-            }
-            
-            states.push_back(state);
-            
-            // Add neighbors to stack in reverse order (to visit in original order)
-            vector<Edge> neighbors = adjacencyList[current];
-            for (int i = neighbors.size() - 1; i >= 0; i--) {
-                NodeId neighbor = neighbors[i].target;
-                if (visited.find(neighbor) == visited.end()) {
-                    nodeStack.push(neighbor);
-                    traversalEdges.push_back(make_pair(current, neighbor));
+                if ((int)path.path.size() > path.settled) {
+                    path.path.clear();
                 }
+                reverse(path.path.begin(), path.path.end());
             }
+            return path;
         }
         
-        // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "DFS traversal complete";
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
-        
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        NodeId from = slotOf(source), to = slotOf(target);
+        runSteps<Trace>([this, from, to, method](auto policy, pathquery::PathResult* result) {
+            return pathQuerySteps<decltype(policy)>(from, to, method, result);
+        }, path);
+        toIds(path.path);
+        return path;
+    }
+
+    // Get the number of steps; for lazy traces, the steps generated so far
+    int getStepCount() const {
+        return lazySteps.active() ? lazySteps.count() : totalSteps;
+    }
+
+    // True once every step of the trace is known
+    bool stepsComplete() const {
+        return !lazySteps.active() || lazySteps.complete();
+    }
+
+    // Number of changes made to the graph, 0 until the first
+    uint64_t getVersion() const {
+        return version;
+    }
+
+    // Show the cached trace of the operation key describes in place of
+    // running it again; false when none is cached for this version
+    bool replayTrace(const TraceKey& key) {
+        if (key.version != version) {
+            return false;
+        }
+        shared_ptr<const CachedTrace> cached = traceCache.find(key);
+        if (!cached) {
+            return false;
         }
+        trace = cached->trace;
+        traceLayout = cached->layout;
+        lazySteps.clear();
+        finishTrace();
+        return true;
     }
 
-    // Breadth-First Search implementation
-    void breadthFirstSearch(NodeId startNode) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState = createInitialState("Starting BFS from node " + to_string(startNode));
-        states.push_back(initialState);
-        
-        // Track visited nodes
-        set<NodeId> visited;
-        queue<NodeId> nodeQueue;
-        vector<pair<NodeId, NodeId>> traversalEdges; // (source, target) pairs
-        
-        visited.insert(startNode);
-        nodeQueue.push(startNode);
-        
-        while (!nodeQueue.empty()) {
-            NodeId current = nodeQueue.front();
-            nodeQueue.pop();
-            
-            // Create a state for this node visit
-            AlgorithmState state = initialState;
-            state.step = states.size() + 1;
-            state.message = "Visiting node " + to_string(current);
-            
-            // Highlight the current node
-            for (auto& node : state.nodes) {
-                node.highlighted = (node.id == current);
-            }
-            
-            // Highlight edges in the traversal path
-            for (auto& edge : state.edges) {
-                for (const auto& tEdge : traversalEdges) {
-                    if (edge.source == tEdge.first && edge.target == tEdge.second) {
-                        edge.highlighted = true;
-                    }
-                }
-            }
-            
-            states.push_back(state);
-            
-            // Add all neighbors to queue
-            for (const auto& edge : adjacencyList[current]) {
-                NodeId neighbor = edge.target;
-                if (visited.find(neighbor) == visited.end()) {
-                    visited.insert(neighbor);
-                    nodeQueue.push(neighbor);
-                    traversalEdges.push_back(make_pair(current, neighbor));
-                }
+    // Cache the trace of the operation just run, which key describes;
+    // untraced and lazy runs leave no finished trace to keep
+    void cacheTrace(const TraceKey& key) {
+        if (key.version != version || lazySteps.active() || trace->size() == 0) {
+            return;
+        }
+        traceCache.insert(key, make_shared<CachedTrace>(CachedTrace{trace, traceLayout}),
+                          trace->memoryBytes() + traceLayout->memoryBytes());
+    }
+
+    // Memory kept for cached traces, evicting the least recently used
+    // beyond it (0 turns the cache off)
+    void setTraceCacheBudget(size_t bytes) {
+        traceCache.setBudget(bytes);
+    }
+
+    // Write a window of steps into a binary step buffer (see step_buffer.h)
+    void writeSteps(StepBufferWriter& writer, int firstStep, int count) {
+        VisualState state = createTraceState();
+        if (lazySteps.active()) {
+            // Lazy steps are generated up to the end of the window first
+            firstStep = max(firstStep, 0);
+            writer.begin(0, firstStep);
+            for (int step = firstStep; count < 0 || step < firstStep + count; step++) {
+                const LazyGraphStep* lazy = lazySteps.get(step);
+                if (!lazy) break;
+                lazy->chunk->stateAt(lazy->index, state);
+                writeVisualState(writer, step, state, GRAPH_MESSAGES);
             }
+            writer.setTotalSteps(lazySteps.count());
+            writer.finish();
+            return;
         }
         
-        // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "BFS traversal complete";
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        clampStepWindow(trace->size(), firstStep, count);
+        writer.begin(totalSteps, firstStep);
+        trace->forEachStep(firstStep, count, state, [&](int step, const VisualState& stepState) {
+            writeVisualState(writer, step, stepState, GRAPH_MESSAGES);
+        });
+        writer.finish();
+    }
+
+    // Get a specific step, rebuilt from the nearest keyframe (of its chunk
+    // for lazy traces, generating the steps up to it on demand)
+    VisualState getStep(int step) {
+        if (lazySteps.active()) {
+            const LazyGraphStep* lazy = lazySteps.get(step);
+            if (!lazy) {
+                return VisualState();
+            }
+            return createStepState(*lazy->chunk, lazy->index, step, lazySteps.count());
+        }
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        if (step < 0 || step >= trace->size()) {
+            return VisualState();
         }
+        return createStepState(*trace, step, step, totalSteps);
     }
 
-    // Dijkstra's algorithm implementation
-    void dijkstraAlgorithm(NodeId startNode) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState = createInitialState("Starting Dijkstra's algorithm from node " + to_string(startNode));
-        states.push_back(initialState);
-        
-        // Initialize distances with infinity
-        map<NodeId, int> distances;
-        map<NodeId, NodeId> previous;
-        set<NodeId> unvisited;
-        
-        for (const auto& node : adjacencyList) {
-            distances[node.first] = numeric_limits<int>::max();
-            unvisited.insert(node.first);
+    // Get the number of nodes
+    int getNodeCount() const {
+        return builder.nodeCount();
+    }
+
+    // Replace the graph with one read from a file of the given
+    // GraphFileFormat (see graph_file.h); false leaves the graph unchanged
+    bool loadFile(const char* path, int format) {
+        CsrGraph loaded;
+        if (!graphfile::load(path, format, loaded, TaskPool::shared())) {
+            return false;
         }
-        
-        distances[startNode] = 0;
-        
-        while (!unvisited.empty()) {
-            // Find the unvisited node with minimum distance
-            NodeId current = *unvisited.begin();
-            for (const auto& node : unvisited) {
-                if (distances[node] < distances[current]) {
-                    current = node;
-                }
-            }
-            
-            // If we've reached a node with infinite distance, we're done
-            if (distances[current] == numeric_limits<int>::max()) {
-                break;
-            }
-            
-            // Create a state for this node visit
-            AlgorithmState state = initialState;
-            state.step = states.size() + 1;
-            state.message = "Processing node " + to_string(current) + " with distance " + to_string(distances[current]);
-            
-            // Highlight the current node and its path
-            for (auto& node : state.nodes) {
-                if (node.id == current) {
-                    node.highlighted = true;
-                }
-            }
-            
-            // Highlight the shortest path edges found so far
-            for (auto& edge : state.edges) {
-                NodeId to = edge.target;
-                if (previous.find(to) != previous.end() && previous[to] == edge.source) {
-                    edge.highlighted = true;
-                }
-            }
-            
-            states.push_back(state);
-            
-            // Remove the current node from unvisited
-            unvisited.erase(current);
-            
-            // Check all neighbors
-            for (const auto& edge : adjacencyList[current]) {
-                NodeId neighbor = edge.target;
-                int alt = distances[current] + edge.weight;
-                
-                if (alt < distances[neighbor]) {
-                    distances[neighbor] = alt;
-                    previous[neighbor] = current;
-                    
-                    // Create a state for this relaxation
-                    AlgorithmState relaxState = state;
-                    relaxState.step = states.size() + 1;
-                    relaxState.message = "Updated distance to node " + to_string(neighbor) + " to " + to_string(alt);
-                    
-                    // Highlight the edge being relaxed
-                    for (auto& e : relaxState.edges) {
-                        if (e.source == current && e.target == neighbor) {
-                            e.highlighted = true;
-                        }
-                    }
-                    
-                    states.push_back(relaxState);
-                }
+        clear();
+        csr = move(loaded);
+        builder.reset(csr.nodeCount());
+        layoutCurrent = false;
+        // DIMACS arcs and binary CSR files may be one-way
+        symmetric = format == GRAPH_FILE_EDGE_LIST;
+        return true;
+    }
+
+    // Replace the graph with a synthetic one of the given GraphGeneratorKind
+    // (see graph_generators.h), the same for the same seed; false leaves the
+    // graph unchanged
+    bool generate(int kind, int nodes, int degree, unsigned seed) {
+        CsrGraph generated;
+        if (!graphgen::generate(kind, nodes, degree, seed, generated, TaskPool::shared())) {
+            return false;
+        }
+        clear();
+        csr = move(generated);
+        builder.reset(csr.nodeCount());
+        layoutCurrent = false;
+        return true;
+    }
+
+    // Write the graph as a binary CSR file for fast reloads
+    bool saveFile(const char* path) {
+        if (!ids.empty()) {
+            return graphfile::save(path, nodeorder::permute(adjacency(), slots, TaskPool::shared()));
+        }
+        return graphfile::save(path, adjacency());
+    }
+
+    // Renumber the nodes inside the CSR arrays by the given NodeOrder (see
+    // graph_reorder.h) so traversals touch fewer cache lines; nodes keep
+    // their ids in every result and trace. NODE_ORDER_ORIGINAL goes back to
+    // id order. False for an unknown order.
+    bool reorder(int kind) {
+        const CsrGraph& graph = adjacency();
+        vector<int32_t> order;
+        if (!nodeorder::computeOrder(kind, graph, incomingAdjacency(), order)) {
+            return false;
+        }
+        if (kind == NODE_ORDER_ORIGINAL && !ids.empty()) {
+            order = slots;
+        }
+        int nodeCount = graph.nodeCount();
+        csr = nodeorder::permute(graph, order, TaskPool::shared());
+        builder.reset(nodeCount);
+
+        // CSR node i was CSR node order[i]
+        vector<NodeId> reorderedIds(nodeCount);
+        bool identity = true;
+        for (int slot = 0; slot < nodeCount; slot++) {
+            reorderedIds[slot] = idOf(order[slot]);
+            identity = identity && reorderedIds[slot] == slot;
+        }
+        ids.clear();
+        slots.clear();
+        if (!identity) {
+            ids = move(reorderedIds);
+            slots.resize(nodeCount);
+            for (int slot = 0; slot < nodeCount; slot++) {
+                slots[ids[slot]] = slot;
             }
         }
-        
-        // Final state
-        AlgorithmState finalState = states.back();
-        finalState.step = states.size() + 1;
-        finalState.message = "Dijkstra's algorithm complete";
-        
-        // Highlight all shortest paths
-        for (auto& edge : finalState.edges) {
-            NodeId to = edge.target;
-            if (previous.find(to) != previous.end() && previous[to] == edge.source) {
-                edge.highlighted = true;
+        if ((int)layoutPoints.size() == nodeCount && (int)nodePositions.size() == nodeCount) {
+            vector<forcelayout::Point> points(nodeCount);
+            vector<pair<double, double>> positions(nodeCount);
+            for (int slot = 0; slot < nodeCount; slot++) {
+                points[slot] = layoutPoints[order[slot]];
+                positions[slot] = nodePositions[order[slot]];
             }
+            layoutPoints = move(points);
+            nodePositions = move(positions);
+        } else {
+            layoutPoints.clear();
+            layoutCurrent = false;
         }
-        
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
-        
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+
+        reverseCurrent = false;
+        landmarksCurrent = false;
+        hierarchyCurrent = false;
+        pathTree.reset();
+        changed();
+        return true;
+    }
+
+    // Write the graph's contraction hierarchy, building it first when the
+    // graph changed; false with negative weights or when writing fails
+    bool saveHierarchy(const char* path) {
+        return !hasNegativeWeights() && contractionHierarchy().save(path);
+    }
+
+    // Use the contraction hierarchy index at path, saved for this same
+    // graph, in place of building one; false leaves the hierarchy unchanged
+    bool loadHierarchy(const char* path) {
+        if (!hierarchy.load(path, adjacency())) {
+            return false;
         }
+        hierarchyCurrent = true;
+        // Ties may break differently from the hierarchy queries ran on so far
+        changed();
+        return true;
     }
 
-    // Get the number of steps
-    int getStepCount() const {
-        return totalSteps;
+    // Arcs of the contraction hierarchy, shortcuts included
+    int getHierarchyArcCount() {
+        return contractionHierarchy().arcCount();
     }
 
-    // Get a specific step
-    AlgorithmState getStep(int step) const {
-        if (step < 0 || step >= states.size()) {
-            return AlgorithmState();
+    // Lay out the graph again, from scratch unless incremental (warm-started
+    // from the last layout), and return the node positions by node id
+    vector<pair<double, double>> layoutNodes(bool incremental) {
+        if (!incremental) {
+            layoutPoints.clear();
         }
-        return states[step];
+        calculateNodePositions();
+        changed();
+        vector<pair<double, double>> positions = nodePositions;
+        indexById(positions);
+        return positions;
+    }
+
+    // Get the number of edges (each undirected edge counts twice)
+    int getEdgeCount() {
+        return adjacency().edgeCount();
+    }
+
+    // Remove all nodes, edges, recorded steps and cached traces
+    void clear() {
+        builder.reset();
+        csr = CsrGraph();
+        csrCurrent = true;
+        symmetric = true;
+        reverseCsr = CsrGraph();
+        reverseCurrent = false;
+        layoutPoints.clear();
+        nodePositions.clear();
+        layoutCurrent = true;
+        negativeWeights = -1;
+        landmarksCurrent = false;
+        pathScaleCurrent = false;
+        hierarchy = contraction::Hierarchy();
+        hierarchyCurrent = false;
+        ids.clear();
+        slots.clear();
+        pathTree.reset();
+        trace = make_shared<GraphTrace>();
+        changed();
+        currentStep = 0;
+        totalSteps = 0;
     }
 
     // Create a demo graph
     void createDemoGraph() {
         // Clear existing graph
-        adjacencyList.clear();
-        nodePositions.clear();
-        nextNodeId = 0;
+        clear();
         
         // Add nodes
         for (int i = 0; i < 6; i++) {
@@ -448,32 +2283,238 @@ public:
 // Global instance of Graph
 Graph graph;
 
+// Trace mode used by performGraphOperation (see TraceMode)
+int graphTraceMode = TRACE_FULL;
+
+// Priority queue used by performGraphOperation's Dijkstra (see QueueKind)
+int graphDijkstraQueue = QUEUE_DARY_HEAP;
+
+// Bucket width used by performGraphOperation's delta-stepping (0 picks one)
+int graphDeltaSteppingWidth = 0;
+
+// Target and PathMethod of performGraphOperation's point-to-point query
+int graphPathTarget = 0;
+int graphPathMethod = pathquery::PATH_BIDIRECTIONAL;
+
+// Binary step buffer handed out by getGraphStepBuffer
+StepBufferWriter graphStepBuffer;
+
+} // namespace
+
 // External interface functions
 
 // Perform an operation on the Graph
 extern "C" EMSCRIPTEN_KEEPALIVE int performGraphOperation(int algorithm, int startNode) {
-    // Create a demo graph if not initialized
-    if (graph.getStepCount() == 0) {
+    // Create a demo graph unless a graph was built or loaded (an emptied
+    // graph stays empty)
+    if (graph.getVersion() == 0) {
         graph.createDemoGraph();
     }
-    
-    switch (algorithm) {
-        case 0: // DFS
-            graph.depthFirstSearch(startNode);
-            break;
-        case 1: // BFS
-            graph.breadthFirstSearch(startNode);
-            break;
-        case 2: // Dijkstra
-            graph.dijkstraAlgorithm(startNode);
-            break;
-        // Other algorithms can be added here
-        default:
-            return -1;
+
+    // Replay the steps of the same operation on this version of the graph
+    TraceKey key = {graph.getVersion(), algorithm, startNode, graphTraceMode, {0, 0}, 0, 0};
+    if (algorithm == 2) {
+        key.pathRepair = graph.getPathRepair();
+        key.repairs = graph.repairsPathsFrom(startNode);
+    } else if (algorithm == 4) {
+        key.settings[0] = graphDeltaSteppingWidth;
+    } else if (algorithm == 7) {
+        key.settings[0] = graphPathTarget;
+        key.settings[1] = graphPathMethod;
+    }
+    if (graph.replayTrace(key)) {
+        return graph.getStepCount();
     }
+
+    bool known = withTracePolicy(graphTraceMode, [&](auto policy) {
+        using Trace = decltype(policy);
+        switch (algorithm) {
+            case 0: // DFS
+                graph.depthFirstSearch<Trace>(startNode);
+                return true;
+            case 1: // BFS
+                graph.breadthFirstSearch<Trace>(startNode);
+                return true;
+            case 2: // Dijkstra
+                graph.dijkstraAlgorithm<Trace>(startNode, graphDijkstraQueue);
+                return true;
+            case 3: // Direction-optimizing parallel BFS
+                graph.parallelBreadthFirstSearch<Trace>(startNode);
+                return true;
+            case 4: // Delta-stepping shortest paths
+                graph.deltaSteppingAlgorithm<Trace>(startNode, graphDeltaSteppingWidth);
+                return true;
+            case 5: // Kruskal's minimum spanning tree
+                graph.kruskalAlgorithm<Trace>();
+                return true;
+            case 6: // Prim's minimum spanning tree
+                graph.primAlgorithm<Trace>(startNode);
+                return true;
+            case 7: // Point-to-point shortest path to the query target
+                graph.pathQuery<Trace>(startNode, graphPathTarget, graphPathMethod);
+                return true;
+            // Other algorithms can be added here
+            default:
+                return false;
+        }
+    });
+    if (!known) {
+        return -1;
+    }
+    graph.cacheTrace(key);
     return graph.getStepCount();
 }
 
+// Keep the traces of up to megabytes of graph operations so that repeating
+// one on the unchanged graph replays its steps (0 turns the cache off)
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphTraceCacheBudget(int megabytes) {
+    graph.setTraceCacheBudget((size_t)max(megabytes, 0) << 20);
+}
+
+// Generate the steps of subsequent traced graph operations on demand, keeping at
+// most window steps in memory (0 records every step up front)
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphLazySteps(int window) {
+    graph.setLazySteps(window);
+}
+
+// 1 once getGraphStepCount is the final count, 0 while lazy steps remain
+extern "C" EMSCRIPTEN_KEEPALIVE int isGraphStepsComplete() {
+    return graph.stepsComplete() ? 1 : 0;
+}
+
+// Select full, coarse or no tracing for subsequent graph operations
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphTraceMode(int mode) {
+    graphTraceMode = mode;
+}
+
+// Select the priority queue of subsequent Dijkstra operations (0 d-ary
+// heap, 1 pairing heap, 2 bucket queue; see QueueKind)
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphDijkstraQueue(int queue) {
+    graphDijkstraQueue = queue;
+}
+
+// Set the bucket width of subsequent delta-stepping operations (0 picks
+// one from the weights and average degree)
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphDeltaSteppingWidth(int delta) {
+    graphDeltaSteppingWidth = delta;
+}
+
+// Set the target node and method (0 bidirectional Dijkstra, 1 A*, 2 ALT,
+// 3 contraction hierarchy; see PathMethod) of subsequent point-to-point queries
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphPathQuery(int target, int method) {
+    graphPathTarget = target;
+    graphPathMethod = method;
+}
+
+// Untraced Dijkstra from startNode on the given queue, writing each node's
+// distance (INT_MAX when unreachable) to distances when it is not null.
+// Returns the number of reachable nodes.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeShortestPaths(int startNode, int queue, int* distances) {
+    ShortestPaths paths = graph.dijkstraAlgorithm<TraceOff>(startNode, queue);
+    int reachable = 0;
+    for (size_t node = 0; node < paths.distances.size(); node++) {
+        if (distances) {
+            distances[node] = paths.distances[node];
+        }
+        reachable += paths.distances[node] != numeric_limits<int>::max();
+    }
+    return reachable;
+}
+
+// Untraced delta-stepping from startNode with bucket width delta (0 picks
+// one), writing each node's distance (INT_MAX when unreachable) to
+// distances when it is not null. Returns the number of reachable nodes.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeDeltaSteppingPaths(int startNode, int delta, int* distances) {
+    ShortestPaths paths = graph.deltaSteppingAlgorithm<TraceOff>(startNode, delta);
+    int reachable = 0;
+    for (size_t node = 0; node < paths.distances.size(); node++) {
+        if (distances) {
+            distances[node] = paths.distances[node];
+        }
+        reachable += paths.distances[node] != numeric_limits<int>::max();
+    }
+    return reachable;
+}
+
+// Untraced point-to-point shortest path from source to target by method
+// (0 bidirectional Dijkstra, 1 A*, 2 ALT, 3 contraction hierarchy), writing its length (INT_MAX
+// when unreachable) to distance when it is not null. Returns the number
+// of nodes the search settled, or -1 for an unknown method.
+extern "C" EMSCRIPTEN_KEEPALIVE int computePointToPointPath(int source, int target, int method, int* distance) {
+    if (method < pathquery::PATH_BIDIRECTIONAL || method > pathquery::PATH_CONTRACTION) {
+        return -1;
+    }
+    pathquery::PathResult path = graph.pathQuery<TraceOff>(source, target, method);
+    if (distance) {
+        *distance = path.distance;
+    }
+    return path.settled;
+}
+
+// Untraced minimum spanning forest by Kruskal's (algorithm 0) or Prim's
+// (1, growing from startNode first) algorithm, writing the CSR indices of
+// its edges to edges and their total weight to weight when they are not
+// null. Returns the number of edges, or -1 for an unknown algorithm.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeSpanningForest(int algorithm, int startNode, int* edges, long long* weight) {
+    if (algorithm != 0 && algorithm != 1) {
+        return -1;
+    }
+    SpanningForest forest = algorithm == 0 ? graph.kruskalAlgorithm<TraceOff>() : graph.primAlgorithm<TraceOff>(startNode);
+    if (edges) {
+        copy(forest.edges.begin(), forest.edges.end(), edges);
+    }
+    if (weight) {
+        *weight = forest.weight;
+    }
+    return forest.edges.size();
+}
+
+// Untraced direction-optimizing parallel BFS from startNode, writing each
+// node's depth (-1 when unreachable) to depths when it is not null.
+// Returns the number of reachable nodes.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeParallelBfs(int startNode, int* depths) {
+    BfsTree tree = graph.parallelBreadthFirstSearch<TraceOff>(startNode);
+    int reachable = 0;
+    for (size_t node = 0; node < tree.depths.size(); node++) {
+        if (depths) {
+            depths[node] = tree.depths[node];
+        }
+        reachable += tree.depths[node] >= 0;
+    }
+    return reachable;
+}
+
+// Untraced bit-parallel BFS from count start nodes at once. For start
+// node i, writes the nodes it reaches (itself included) to reached[i],
+// the sum of their depths to distanceSums[i] and the largest depth to
+// eccentricities[i] (-1 for a node outside the graph), and, when depths is
+// not null, every node's depth from it (-1 when unreachable) to row i of
+// count rows of node count entries. Any output may be null. Returns the
+// number of start nodes in the graph.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeMultiSourceBfs(const int* sources, int count, int* reached,
+                                                          long long* distanceSums, int* eccentricities, int* depths) {
+    vector<NodeId> starts(sources, sources + max(count, 0));
+    vector<int> rows;
+    parallel::MultiBfsStats stats = graph.multiSourceBreadthFirstSearch(starts, depths ? &rows : nullptr);
+    int found = 0;
+    for (size_t i = 0; i < starts.size(); i++) {
+        if (reached) {
+            reached[i] = stats.reached[i];
+        }
+        if (distanceSums) {
+            distanceSums[i] = stats.distanceSums[i];
+        }
+        if (eccentricities) {
+            eccentricities[i] = stats.eccentricities[i];
+        }
+        found += stats.eccentricities[i] >= 0;
+    }
+    if (depths) {
+        copy(rows.begin(), rows.end(), depths);
+    }
+    return found;
+}
+
 // Get the number of steps in the current operation
 extern "C" EMSCRIPTEN_KEEPALIVE int getGraphStepCount() {
     return graph.getStepCount();
@@ -481,12 +2522,12 @@ extern "C" EMSCRIPTEN_KEEPALIVE int getGraphStepCount() {
 
 // Get a specific step's data
 extern "C" EMSCRIPTEN_KEEPALIVE char* getGraphStepData(int step) {
-    AlgorithmState state = graph.getStep(step);
+    VisualState state = graph.getStep(step);
     
     // Convert state to JSON or another format that can be passed to JavaScript
     string result = "{\"step\":" + to_string(state.step) + 
                     ",\"totalSteps\":" + to_string(state.totalSteps) + 
-                    ",\"message\":\"" + state.message + "\"}";
+                    ",\"message\":\"" + escapeJson(formatStepMessage(GRAPH_MESSAGES, state.message)) + "\"}";
     
     // Allocate memory for the result that JavaScript can free later
     char* buffer = (char*)malloc(result.length() + 1);
@@ -499,15 +2540,154 @@ extern "C" EMSCRIPTEN_KEEPALIVE void freeGraphStepData(char* ptr) {
     free(ptr);
 }
 
+// Write steps [firstStep, firstStep + count) (count < 0 for all remaining
+// steps) into the binary step buffer and return its address; the buffer
+// stays valid until the next call (layout in step_buffer.h)
+extern "C" EMSCRIPTEN_KEEPALIVE const unsigned char* getGraphStepBuffer(int firstStep, int count) {
+    graph.writeSteps(graphStepBuffer, firstStep, count);
+    return graphStepBuffer.data();
+}
+
+// Size in bytes of the last buffer returned by getGraphStepBuffer
+extern "C" EMSCRIPTEN_KEEPALIVE int getGraphStepBufferSize() {
+    return graphStepBuffer.size();
+}
+
+// Remove all nodes and edges from the graph
+extern "C" EMSCRIPTEN_KEEPALIVE void resetGraph() {
+    graph.clear();
+}
+
+// Add a node to the graph, returning its id
+extern "C" EMSCRIPTEN_KEEPALIVE int addGraphNode() {
+    return graph.addNode();
+}
+
+// Add an undirected weighted edge to the graph
+extern "C" EMSCRIPTEN_KEEPALIVE void addGraphEdge(int source, int target, int weight) {
+    graph.addEdge(source, target, weight);
+}
+
+// Remove the edges between source and target (only those from source to
+// target when the graph was loaded as directed), returning how many were
+// removed
+extern "C" EMSCRIPTEN_KEEPALIVE int removeGraphEdge(int source, int target) {
+    return graph.removeEdge(source, target);
+}
+
+// Set the weight of the edges between source and target (only those from
+// source to target when the graph was loaded as directed), returning how
+// many there are
+extern "C" EMSCRIPTEN_KEEPALIVE int setGraphEdgeWeight(int source, int target, int weight) {
+    return graph.setEdgeWeight(source, target, weight);
+}
+
+// Remove a node and its edges; the nodes with higher ids move down by one.
+// Returns the new node count, or -1 when there is no such node.
+extern "C" EMSCRIPTEN_KEEPALIVE int removeGraphNode(int node) {
+    return graph.removeNode(node) ? graph.getNodeCount() : -1;
+}
+
+// Repair the last Dijkstra result after graph changes when the next run
+// starts from the same node (1, the default), or recompute every run (0)
+extern "C" EMSCRIPTEN_KEEPALIVE void setGraphPathRepair(int enabled) {
+    graph.setPathRepair(enabled != 0);
+}
+
+// Replace the graph with one read from a local file: 0 edge list, 1 DIMACS
+// .gr, 2 binary CSR (see graph_file.h). Returns the node count, or -1 when
+// the file cannot be read or parsed, leaving the graph unchanged.
+extern "C" EMSCRIPTEN_KEEPALIVE int loadGraphFile(const char* path, int format) {
+    return graph.loadFile(path, format) ? graph.getNodeCount() : -1;
+}
+
+// Replace the graph with a synthetic one: 0 R-MAT, 1 Erdos-Renyi, 2
+// road-like grid, 3 Barabasi-Albert (see graph_generators.h), with about
+// degree edges per node, the same for the same seed. Returns the number of
+// directed edges, or -1 for an unknown kind or a size out of range,
+// leaving the graph unchanged.
+extern "C" EMSCRIPTEN_KEEPALIVE int generateGraph(int kind, int nodes, int degree, int seed) {
+    return graph.generate(kind, nodes, degree, seed) ? graph.getEdgeCount() : -1;
+}
+
+// Renumber the graph's nodes internally for cache locality: 0 back to id
+// order, 1 reverse Cuthill-McKee, 2 by degree, 3 Gorder, 4 a fixed shuffle
+// (see graph_reorder.h). Results and traces keep reporting node ids.
+// Returns the node count, or -1 for an unknown order.
+extern "C" EMSCRIPTEN_KEEPALIVE int reorderGraph(int order) {
+    return graph.reorder(order) ? graph.getNodeCount() : -1;
+}
+
+// Lay out the graph again, warm-started from the last layout unless
+// incremental is 0, writing each node's x and y to positions when it is
+// not null. Returns the node count.
+extern "C" EMSCRIPTEN_KEEPALIVE int computeGraphLayout(int incremental, double* positions) {
+    vector<pair<double, double>> layout = graph.layoutNodes(incremental != 0);
+    if (positions) {
+        for (size_t node = 0; node < layout.size(); node++) {
+            positions[2 * node] = layout[node].first;
+            positions[2 * node + 1] = layout[node].second;
+        }
+    }
+    return layout.size();
+}
+
+// Write the graph's contraction hierarchy as an index file, building it
+// first if the graph changed; returns the number of hierarchy arcs,
+// shortcuts included, or -1 with negative weights or on failure
+extern "C" EMSCRIPTEN_KEEPALIVE int saveContractionHierarchy(const char* path) {
+    return graph.saveHierarchy(path) ? graph.getHierarchyArcCount() : -1;
+}
+
+// Load a contraction hierarchy index saved for the current graph so
+// queries skip preprocessing; returns the node count, or -1 when the file
+// cannot be read, is malformed or was saved for another graph
+extern "C" EMSCRIPTEN_KEEPALIVE int loadContractionHierarchy(const char* path) {
+    return graph.loadHierarchy(path) ? graph.getNodeCount() : -1;
+}
+
+// Write the graph as a binary CSR file (format 2); returns the number of
+// directed edges written, or -1 on failure
+extern "C" EMSCRIPTEN_KEEPALIVE int saveGraphFile(const char* path) {
+    return graph.saveFile(path) ? graph.getEdgeCount() : -1;
+}
+
+#ifdef __EMSCRIPTEN__
 // Bind the C++ class and methods to JavaScript
 EMSCRIPTEN_BINDINGS(graph_module) {
+    register_vector<int>("IntVector");
+    value_object<ShortestPaths>("ShortestPaths")
+        .field("distances", &ShortestPaths::distances)
+        .field("previous", &ShortestPaths::previous);
+    value_object<SpanningForest>("SpanningForest")
+        .field("edges", &SpanningForest::edges);
+    value_object<pathquery::PathResult>("PathQuery")
+        .field("distance", &pathquery::PathResult::distance)
+        .field("path", &pathquery::PathResult::path)
+        .field("settled", &pathquery::PathResult::settled);
+    value_object<BfsTree>("BfsTree")
+        .field("depths", &BfsTree::depths)
+        .field("parents", &BfsTree::parents);
+    
     class_<Graph>("Graph")
         .constructor()
         .function("addNode", &Graph::addNode)
         .function("addEdge", &Graph::addEdge)
-        .function("depthFirstSearch", &Graph::depthFirstSearch)
-        .function("breadthFirstSearch", &Graph::breadthFirstSearch)
-        .function("dijkstraAlgorithm", &Graph::dijkstraAlgorithm)
+        .function("removeEdge", &Graph::removeEdge)
+        .function("setEdgeWeight", &Graph::setEdgeWeight)
+        .function("removeNode", &Graph::removeNode)
+        .function("setPathRepair", &Graph::setPathRepair)
+        .function("depthFirstSearch", &Graph::depthFirstSearch<TraceFull>)
+        .function("breadthFirstSearch", &Graph::breadthFirstSearch<TraceFull>)
+        .function("parallelBreadthFirstSearch", &Graph::parallelBreadthFirstSearch<TraceFull>)
+        .function("dijkstraAlgorithm", &Graph::dijkstraAlgorithm<TraceFull>)
+        .function("deltaSteppingAlgorithm", &Graph::deltaSteppingAlgorithm<TraceFull>)
+        .function("kruskalAlgorithm", &Graph::kruskalAlgorithm<TraceFull>)
+        .function("primAlgorithm", &Graph::primAlgorithm<TraceFull>)
+        .function("pathQuery", &Graph::pathQuery<TraceFull>)
+        .function("generate", &Graph::generate)
+        .function("reorder", &Graph::reorder)
+        .function("setLazySteps", &Graph::setLazySteps)
         .function("getStepCount", &Graph::getStepCount)
         .function("createDemoGraph", &Graph::createDemoGraph);
 }
@@ -518,3 +2698,4 @@ int main() {
     graph.createDemoGraph();
     return 0;
 }
+#endif
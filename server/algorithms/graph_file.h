@@ -0,0 +1,376 @@
+// Bulk graph files read through a memory map straight into a CsrGraph
+//
+// - GRAPH_FILE_EDGE_LIST: one "source target [weight]" line per undirected
+//   edge with 0-based ids (weight 1 when left out), added in both
+//   directions as addGraphEdge does. Lines starting with '#' or '%' are
+//   comments; the node count is the largest id + 1.
+// - GRAPH_FILE_DIMACS: 9th DIMACS Challenge ".gr" files, a "p sp n m"
+//   line and one "a u v w" line per directed arc with 1-based ids; lines
+//   starting with 'c' are comments
+// - GRAPH_FILE_BINARY: the CSR arrays as graphfile::save writes them, a
+//   16-byte header (magic "CSRG", version, node count, edge count) then
+//   offsets, targets and weights as little-endian int32s. Loading one is
+//   a validated copy of the mapped arrays.
+//
+// Text files are split at line boundaries into chunks that the task pool
+// parses in parallel into flat per-chunk arrays. One counting sort by
+// source then places every edge into CSR order, keeping file order within
+// each node, so a file loads into the same graph as adding its edges one
+// at a time.
+
+#ifndef GRAPH_FILE_H
+#define GRAPH_FILE_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "csr_graph.h"
+#include "task_pool.h"
+
+// File formats as passed through the C interface
+enum GraphFileFormat {
+    GRAPH_FILE_EDGE_LIST = 0,
+    GRAPH_FILE_DIMACS = 1,
+    GRAPH_FILE_BINARY = 2
+};
+
+namespace graphfile {
+
+const char BINARY_MAGIC[4] = {'C', 'S', 'R', 'G'};
+const int32_t BINARY_VERSION = 1;
+
+// Text chunks per thread, so threads that finish early can steal the rest
+const int CHUNKS_PER_THREAD = 4;
+
+// Smallest text chunk worth a task of its own
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// Most nodes a text file can give, so the node count + 1 CSR offsets stay
+// within an int; larger ids are malformed
+const int32_t MAX_NODES = INT_MAX - 1;
+
+struct BinaryHeader {
+    char magic[4];
+    int32_t version;
+    int32_t nodeCount;
+    int32_t edgeCount;
+};
+
+// Read-only memory map of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const char* path) : bytes(nullptr), length(0), opened(false) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            length = info.st_size;
+            if (length == 0) {
+                opened = true;
+            } else {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    bytes = (const char*)mapped;
+                    opened = true;
+                    madvise(mapped, length, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (bytes) {
+            munmap((void*)bytes, length);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const {
+        return opened;
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* bytes;
+    size_t length;
+    bool opened;
+};
+
+// Edges parsed from one chunk of a text file, in file order
+struct EdgeChunk {
+    std::vector<int32_t> sources;
+    std::vector<int32_t> targets;
+    std::vector<int32_t> weights;
+    int32_t maxNode = -1;
+    int32_t declaredNodes = -1; // n of a DIMACS "p" line in this chunk
+    bool ok = true;
+};
+
+// Line scanner over [p, end) that never reads past end
+struct TextCursor {
+    const char* p;
+    const char* end;
+
+    void skipBlanks() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    }
+
+    bool atLineEnd() {
+        skipBlanks();
+        return p == end || *p == '\n';
+    }
+
+    void nextLine() {
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        p = newline ? newline + 1 : end;
+    }
+
+    // Parse a decimal int32 after optional blanks
+    bool readInt(int32_t& value) {
+        skipBlanks();
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+        if (p == end || *p < '0' || *p > '9') return false;
+        long long result = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            result = result * 10 + (*p++ - '0');
+            if (result > INT_MAX) return false;
+        }
+        value = negative ? -result : result;
+        return true;
+    }
+};
+
+// Parse the edge list or DIMACS lines of [begin, end), which starts at a
+// line start and ends after a newline or at the end of the file
+inline void parseChunk(const char* begin, const char* end, int format, EdgeChunk& chunk) {
+    // Edge lines take at least 4 bytes; reserving a quarter of that
+    // average keeps regrowth rare without over-committing
+    size_t estimate = (end - begin) / 16;
+    chunk.sources.reserve(estimate);
+    chunk.targets.reserve(estimate);
+    chunk.weights.reserve(estimate);
+
+    TextCursor cursor{begin, end};
+    while (cursor.p < end) {
+        if (cursor.atLineEnd()) {
+            cursor.nextLine();
+            continue;
+        }
+        char lead = *cursor.p;
+        int32_t source, target, weight = 1;
+        if (format == GRAPH_FILE_DIMACS) {
+            if (lead == 'c') {
+                cursor.nextLine();
+                continue;
+            }
+            cursor.p++;
+            if (lead == 'p') {
+                // "p sp <nodes> <arcs>"
+                cursor.skipBlanks();
+                while (cursor.p < end && *cursor.p != ' ' && *cursor.p != '\t' && *cursor.p != '\n') cursor.p++;
+                int32_t arcs;
+                if (!cursor.readInt(chunk.declaredNodes) || !cursor.readInt(arcs) || chunk.declaredNodes < 0 ||
+                    chunk.declaredNodes > MAX_NODES) {
+                    chunk.ok = false;
+                    return;
+                }
+                cursor.nextLine();
+                continue;
+            }
+            if (lead != 'a' || !cursor.readInt(source) || !cursor.readInt(target) || !cursor.readInt(weight)) {
+                chunk.ok = false;
+                return;
+            }
+            source--;
+            target--;
+        } else {
+            if (lead == '#' || lead == '%') {
+                cursor.nextLine();
+                continue;
+            }
+            if (!cursor.readInt(source) || !cursor.readInt(target)) {
+                chunk.ok = false;
+                return;
+            }
+            if (!cursor.atLineEnd() && !cursor.readInt(weight)) {
+                chunk.ok = false;
+                return;
+            }
+        }
+        if (source < 0 || target < 0 || source >= MAX_NODES || target >= MAX_NODES || !cursor.atLineEnd()) {
+            chunk.ok = false;
+            return;
+        }
+        chunk.sources.push_back(source);
+        chunk.targets.push_back(target);
+        chunk.weights.push_back(weight);
+        chunk.maxNode = std::max(chunk.maxNode, std::max(source, target));
+        cursor.nextLine();
+    }
+}
+
+// Build the CSR arrays of parsed chunks with a stable counting sort by
+// source; undirected chunks add every edge in both directions
+inline bool buildFromChunks(std::vector<EdgeChunk>& chunks, int nodeCount, bool undirected, CsrGraph& graph) {
+    long long edges = 0;
+    for (const EdgeChunk& chunk : chunks) {
+        edges += chunk.sources.size() * (undirected ? 2 : 1);
+    }
+    if (edges > INT_MAX) return false;
+
+    std::vector<int32_t> offsets(nodeCount + 1, 0);
+    for (const EdgeChunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.sources.size(); i++) {
+            offsets[chunk.sources[i] + 1]++;
+            if (undirected) {
+                offsets[chunk.targets[i] + 1]++;
+            }
+        }
+    }
+    for (int u = 0; u < nodeCount; u++) {
+        offsets[u + 1] += offsets[u];
+    }
+
+    std::vector<int32_t> targets(edges);
+    std::vector<int32_t> weights(edges);
+    std::vector<int32_t> next(offsets.begin(), offsets.end() - 1);
+    for (EdgeChunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.sources.size(); i++) {
+            int32_t source = chunk.sources[i];
+            int32_t target = chunk.targets[i];
+            int slot = next[source]++;
+            targets[slot] = target;
+            weights[slot] = chunk.weights[i];
+            if (undirected) {
+                slot = next[target]++;
+                targets[slot] = source;
+                weights[slot] = chunk.weights[i];
+            }
+        }
+        chunk = EdgeChunk();
+    }
+    graph = CsrGraph(std::move(offsets), std::move(targets), std::move(weights));
+    return true;
+}
+
+// Parse an edge list or DIMACS file in parallel chunks
+inline bool loadText(const MappedFile& file, int format, CsrGraph& graph, TaskPool& pool) {
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // Split at the first line start after each even cut
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(pool.concurrency() * CHUNKS_PER_THREAD,
+                                                             file.size() / MIN_CHUNK_BYTES));
+    std::vector<const char*> starts(chunkCount + 1, end);
+    starts[0] = begin;
+    for (size_t c = 1; c < chunkCount; c++) {
+        const char* cut = std::max(begin + file.size() * c / chunkCount, starts[c - 1]);
+        const char* newline = cut < end ? (const char*)memchr(cut, '\n', end - cut) : nullptr;
+        starts[c] = newline ? newline + 1 : end;
+    }
+
+    std::vector<EdgeChunk> chunks(chunkCount);
+    parallelFor(pool, chunkCount, [&](int c) {
+        parseChunk(starts[c], starts[c + 1], format, chunks[c]);
+    });
+
+    int32_t maxNode = -1;
+    int32_t declaredNodes = -1;
+    for (const EdgeChunk& chunk : chunks) {
+        if (!chunk.ok) return false;
+        maxNode = std::max(maxNode, chunk.maxNode);
+        declaredNodes = std::max(declaredNodes, chunk.declaredNodes);
+    }
+
+    int nodeCount = maxNode + 1;
+    if (format == GRAPH_FILE_DIMACS) {
+        // Arcs must stay within the declared node count
+        if (declaredNodes < 0 || maxNode >= declaredNodes) return false;
+        nodeCount = declaredNodes;
+    }
+    return buildFromChunks(chunks, nodeCount, format == GRAPH_FILE_EDGE_LIST, graph);
+}
+
+// Copy the arrays of a binary CSR file after checking that they form a
+// valid graph
+inline bool loadBinary(const MappedFile& file, CsrGraph& graph) {
+    BinaryHeader header;
+    if (file.size() < sizeof(header)) return false;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.version != BINARY_VERSION ||
+        header.nodeCount < 0 || header.edgeCount < 0 ||
+        file.size() != sizeof(header) + sizeof(int32_t) * ((size_t)header.nodeCount + 1 + 2 * (size_t)header.edgeCount)) {
+        return false;
+    }
+
+    const int32_t* arrays = (const int32_t*)(file.data() + sizeof(header));
+    std::vector<int32_t> offsets(arrays, arrays + header.nodeCount + 1);
+    arrays += header.nodeCount + 1;
+    std::vector<int32_t> targets(arrays, arrays + header.edgeCount);
+    arrays += header.edgeCount;
+    std::vector<int32_t> weights(arrays, arrays + header.edgeCount);
+
+    if (offsets[0] != 0 || offsets[header.nodeCount] != header.edgeCount) return false;
+    for (int u = 0; u < header.nodeCount; u++) {
+        if (offsets[u + 1] < offsets[u]) return false;
+    }
+    for (int32_t target : targets) {
+        if (target < 0 || target >= header.nodeCount) return false;
+    }
+    graph = CsrGraph(std::move(offsets), std::move(targets), std::move(weights));
+    return true;
+}
+
+// Load a graph file of the given GraphFileFormat into graph; false (with
+// graph unchanged) if the file cannot be read or is malformed
+inline bool load(const char* path, int format, CsrGraph& graph, TaskPool& pool) {
+    MappedFile file(path);
+    if (!file.valid()) return false;
+    switch (format) {
+        case GRAPH_FILE_EDGE_LIST:
+        case GRAPH_FILE_DIMACS:
+            return loadText(file, format, graph, pool);
+        case GRAPH_FILE_BINARY:
+            return loadBinary(file, graph);
+        default:
+            return false;
+    }
+}
+
+// Write a graph as a binary CSR file
+inline bool save(const char* path, const CsrGraph& graph) {
+    FILE* out = fopen(path, "wb");
+    if (!out) return false;
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.nodeCount = graph.nodeCount();
+    header.edgeCount = graph.edgeCount();
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+        fwrite(graph.edgeOffsets().data(), sizeof(int32_t), graph.edgeOffsets().size(), out) == graph.edgeOffsets().size() &&
+        fwrite(graph.edgeTargets().data(), sizeof(int32_t), graph.edgeTargets().size(), out) == graph.edgeTargets().size() &&
+        fwrite(graph.edgeWeights().data(), sizeof(int32_t), graph.edgeWeights().size(), out) == graph.edgeWeights().size();
+    return fclose(out) == 0 && written;
+}
+
+} // namespace graphfile
+
+#endif // GRAPH_FILE_H
@@ -0,0 +1,226 @@
+// Synthetic graph generators for scaling runs, built straight into a CsrGraph
+//
+// - GRAPH_GENERATOR_RMAT: R-MAT (a Kronecker graph): each edge picks one
+//   quadrant of the adjacency matrix per id bit with probabilities
+//   a = 0.57, b = c = 0.19, d = 0.05, which gives a power-law degree
+//   distribution with the hubs at low ids. Endpoints past the node count
+//   are drawn again; self-loops and repeated edges are kept.
+// - GRAPH_GENERATOR_ERDOS_RENYI: G(n, m), every edge joins two distinct
+//   nodes drawn uniformly
+// - GRAPH_GENERATOR_GRID: a road-like grid with 4-neighbour streets,
+//   about one in ten missing, and segment lengths of 10 to 100; the degree
+//   is left at about 3.6
+// - GRAPH_GENERATOR_BARABASI_ALBERT: preferential attachment, each node
+//   after the first joining degree / 2 (at least one) earlier nodes chosen with
+//   probability proportional to their degree (an edge may repeat)
+//
+// Degree is the average number of edges per node, so a graph of n nodes
+// gets n * degree / 2 undirected edges, stored in both directions as
+// addGraphEdge does. Weights other than grid lengths are 1 to 20.
+//
+// Every random number comes from a counter-based stream keyed by the seed
+// and the index of the edge (grid: node) it belongs to, so edges can be
+// generated in parallel chunks and the graph is the same for a seed
+// whatever the thread count. Barabasi-Albert edges stay independent with
+// the endpoint-copy formulation: an edge's target copies a uniformly chosen
+// endpoint of an earlier node's edges, and a copied target is resolved by
+// following that edge's own choice. The chunks then go through the same
+// counting sort by source as graph files (see graph_file.h).
+
+#ifndef GRAPH_GENERATORS_H
+#define GRAPH_GENERATORS_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "csr_graph.h"
+#include "graph_file.h"
+#include "task_pool.h"
+
+// Generators as passed through the C interface
+enum GraphGeneratorKind {
+    GRAPH_GENERATOR_RMAT = 0,
+    GRAPH_GENERATOR_ERDOS_RENYI = 1,
+    GRAPH_GENERATOR_GRID = 2,
+    GRAPH_GENERATOR_BARABASI_ALBERT = 3
+};
+
+namespace graphgen {
+
+// Edge (grid: node) ranges per thread, so threads that finish early can
+// steal the rest
+const int CHUNKS_PER_THREAD = 4;
+
+// Smallest range worth a task of its own
+const long long MIN_CHUNK_ITEMS = 1 << 16;
+
+const int MAX_WEIGHT = 20;
+
+// R-MAT quadrant probabilities a, a + b and a + b + c in 16-bit fixed
+// point, so one 64-bit random number picks four quadrants
+const uint32_t RMAT_A = 0.57 * 65536;
+const uint32_t RMAT_AB = 0.76 * 65536;
+const uint32_t RMAT_ABC = 0.95 * 65536;
+
+// SplitMix64 stream keyed by (seed, index)
+class Random {
+public:
+    Random(uint64_t seed, uint64_t index) : state(finalize(finalize(seed) ^ index)) {}
+
+    uint64_t next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        return finalize(state);
+    }
+
+    // Uniform in [0, bound)
+    uint64_t below(uint64_t bound) {
+        return (uint64_t)(((unsigned __int128)next() * bound) >> 64);
+    }
+
+private:
+    uint64_t state;
+
+    static uint64_t finalize(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+// Call body(item, chunk) for items [0, count) in parallel ranges, one
+// chunk of edges per range in item order
+template <class Body>
+std::vector<graphfile::EdgeChunk> generateChunks(long long count, TaskPool& pool, Body body) {
+    long long chunkCount = std::max(1LL, std::min<long long>((long long)pool.concurrency() * CHUNKS_PER_THREAD,
+                                                             count / MIN_CHUNK_ITEMS));
+    std::vector<graphfile::EdgeChunk> chunks(chunkCount);
+    parallelFor(pool, chunkCount, [&](int c) {
+        long long first = count * c / chunkCount;
+        long long last = count * (c + 1) / chunkCount;
+        for (long long item = first; item < last; item++) {
+            body(item, chunks[c]);
+        }
+    });
+    return chunks;
+}
+
+inline void addEdge(graphfile::EdgeChunk& chunk, int32_t source, int32_t target, int32_t weight) {
+    chunk.sources.push_back(source);
+    chunk.targets.push_back(target);
+    chunk.weights.push_back(weight);
+}
+
+inline std::vector<graphfile::EdgeChunk> rmat(int nodes, long long edges, uint64_t seed, TaskPool& pool) {
+    int scale = 0;
+    while ((1LL << scale) < nodes) {
+        scale++;
+    }
+    return generateChunks(edges, pool, [&](long long edge, graphfile::EdgeChunk& chunk) {
+        Random random(seed, edge);
+        int source, target;
+        do {
+            source = target = 0;
+            uint64_t bits = 0;
+            for (int bit = 0; bit < scale; bit++) {
+                if (bit % 4 == 0) {
+                    bits = random.next();
+                }
+                uint32_t p = bits & 0xffff;
+                bits >>= 16;
+                source = source * 2 + (p >= RMAT_AB);
+                target = target * 2 + (p >= RMAT_A) - (p >= RMAT_AB) + (p >= RMAT_ABC);
+            }
+        } while (source >= nodes || target >= nodes);
+        addEdge(chunk, source, target, 1 + random.below(MAX_WEIGHT));
+    });
+}
+
+inline std::vector<graphfile::EdgeChunk> erdosRenyi(int nodes, long long edges, uint64_t seed, TaskPool& pool) {
+    return generateChunks(edges, pool, [&](long long edge, graphfile::EdgeChunk& chunk) {
+        Random random(seed, edge);
+        int source = random.below(nodes);
+        int target;
+        do {
+            target = random.below(nodes);
+        } while (target == source);
+        addEdge(chunk, source, target, 1 + random.below(MAX_WEIGHT));
+    });
+}
+
+inline std::vector<graphfile::EdgeChunk> grid(int nodes, uint64_t seed, TaskPool& pool) {
+    const int MIN_LENGTH = 10;
+    const int MAX_LENGTH = 100;
+    int side = std::max(1, (int)std::sqrt((double)nodes));
+    return generateChunks(nodes, pool, [&](long long item, graphfile::EdgeChunk& chunk) {
+        int node = item;
+        Random random(seed, node);
+        if ((node + 1) % side != 0 && node + 1 < nodes && random.below(10) != 0) {
+            addEdge(chunk, node, node + 1, MIN_LENGTH + random.below(MAX_LENGTH - MIN_LENGTH + 1));
+        }
+        if (node + side < nodes && random.below(10) != 0) {
+            addEdge(chunk, node, node + side, MIN_LENGTH + random.below(MAX_LENGTH - MIN_LENGTH + 1));
+        }
+    });
+}
+
+inline std::vector<graphfile::EdgeChunk> barabasiAlbert(int nodes, int perNode, uint64_t seed, TaskPool& pool) {
+    // Node v >= 1 adds edges (v - 1) * perNode .. v * perNode - 1; the
+    // endpoints of edge e sit at slots 2e (source) and 2e + 1 (target)
+    auto sourceOf = [perNode](long long edge) {
+        return (int)(edge / perNode + 1);
+    };
+    auto targetOf = [&](long long edge) {
+        while (true) {
+            int source = sourceOf(edge);
+            if (source == 1) {
+                return 0;
+            }
+            // A slot among the edges of nodes before source, so the
+            // target already exists and is never source itself
+            long long slot = Random(seed, edge).below(2LL * (source - 1) * perNode);
+            if (slot % 2 == 0) {
+                return sourceOf(slot / 2);
+            }
+            edge = slot / 2;
+        }
+    };
+    return generateChunks((long long)(nodes - 1) * perNode, pool, [&](long long edge, graphfile::EdgeChunk& chunk) {
+        Random random(seed ^ 0x5851f42d4c957f2dULL, edge);
+        addEdge(chunk, sourceOf(edge), targetOf(edge), 1 + random.below(MAX_WEIGHT));
+    });
+}
+
+// Generate a graph of the given GraphGeneratorKind with nodes nodes and
+// about degree edges per node; false (with graph unchanged) for an unknown
+// kind, no nodes, or too many edges for int32 offsets
+inline bool generate(int kind, int nodes, int degree, uint64_t seed, CsrGraph& graph, TaskPool& pool) {
+    if (nodes <= 0 || degree < 0) return false;
+    int perNode = std::max(1, degree / 2);
+    long long edges = nodes < 2 ? 0 : (long long)nodes * degree / 2;
+    if (2 * std::max(edges, (long long)(nodes - 1) * perNode) > INT_MAX) return false;
+
+    std::vector<graphfile::EdgeChunk> chunks;
+    switch (kind) {
+        case GRAPH_GENERATOR_RMAT:
+            chunks = rmat(nodes, edges, seed, pool);
+            break;
+        case GRAPH_GENERATOR_ERDOS_RENYI:
+            chunks = erdosRenyi(nodes, edges, seed, pool);
+            break;
+        case GRAPH_GENERATOR_GRID:
+            chunks = grid(nodes, seed, pool);
+            break;
+        case GRAPH_GENERATOR_BARABASI_ALBERT:
+            chunks = barabasiAlbert(nodes, perNode, seed, pool);
+            break;
+        default:
+            return false;
+    }
+    return graphfile::buildFromChunks(chunks, nodes, true, graph);
+}
+
+} // namespace graphgen
+
+#endif // GRAPH_GENERATORS_H
@@ -0,0 +1,339 @@
+// Node orders that improve the cache locality of graph traversals
+//
+// Node ids follow insertion order, so the neighbours a traversal reads
+// next sit anywhere in the per-node arrays (distances, parents, visited
+// marks) and the CSR offsets. Renumbering the nodes so that nodes used
+// together get nearby numbers turns many of those misses into hits:
+//
+// - NODE_ORDER_RCM: reverse Cuthill-McKee. A BFS from a pseudo-peripheral
+//   node of each component, taking unvisited neighbours by ascending
+//   degree, reversed at the end. Neighbours get close numbers (a small
+//   bandwidth), which suits meshes and road networks.
+// - NODE_ORDER_DEGREE: descending degree, ties by number. The hubs of a
+//   power-law graph, which most edges lead to, share a few cache lines.
+// - NODE_ORDER_GORDER: Gorder (Wei et al., 2016). Greedily place next the
+//   node that shares the most edges and in-neighbours with the last
+//   GORDER_WINDOW nodes placed. Scores live in a unit heap, a bucket list
+//   per score that moves a node by one bucket per change. In-neighbours
+//   of more than sqrt(n) out-edges are skipped when counting shared ones,
+//   as in the paper, since a hub relates everything to everything.
+// - NODE_ORDER_RANDOM: a fixed shuffle, the worst case for locality, as
+//   a baseline
+// - NODE_ORDER_ORIGINAL: the ids themselves (the caller's identity order)
+//
+// An order lists the nodes by new number: order[i] is the node numbered
+// i. permute renumbers a CsrGraph by one, keeping each node's edge order.
+// Directed graphs are ordered over their out-edges, and Gorder also reads
+// the in-edges.
+
+#ifndef GRAPH_REORDER_H
+#define GRAPH_REORDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "csr_graph.h"
+#include "task_pool.h"
+
+// Node orders as passed through the C interface
+enum NodeOrder {
+    NODE_ORDER_ORIGINAL = 0,
+    NODE_ORDER_RCM = 1,
+    NODE_ORDER_DEGREE = 2,
+    NODE_ORDER_GORDER = 3,
+    NODE_ORDER_RANDOM = 4
+};
+
+namespace nodeorder {
+
+// Nodes placed before the next one whose relations count in Gorder
+const int GORDER_WINDOW = 5;
+
+// Nodes per task when permuting
+const int PERMUTE_BLOCK = 1 << 12;
+
+const unsigned RANDOM_SEED = 42;
+
+inline int degree(const CsrGraph& graph, int node) {
+    return graph.edgeOffsets()[node + 1] - graph.edgeOffsets()[node];
+}
+
+// Nodes by descending degree, ties by number (a counting sort)
+inline std::vector<int32_t> degreeOrder(const CsrGraph& graph) {
+    int nodes = graph.nodeCount();
+    int maxDegree = 0;
+    for (int node = 0; node < nodes; node++) {
+        maxDegree = std::max(maxDegree, degree(graph, node));
+    }
+    std::vector<int32_t> starts(maxDegree + 2, 0); // Output slot of the first node of each degree, highest first
+    for (int node = 0; node < nodes; node++) {
+        starts[maxDegree - degree(graph, node) + 1]++;
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<int32_t> order(nodes);
+    for (int node = 0; node < nodes; node++) {
+        order[starts[maxDegree - degree(graph, node)]++] = node;
+    }
+    return order;
+}
+
+// BFS from start over unplaced nodes, appending the nodes reached to
+// order with each node's neighbours by ascending degree. Returns the
+// number of levels; lastLevel is set to the index in order of the first
+// node of the last one.
+inline int cuthillMcKeeLevels(const CsrGraph& graph, int start, std::vector<bool>& placed,
+                              std::vector<int32_t>& order, std::vector<int32_t>& neighbors, int& lastLevel) {
+    int levels = 1;
+    lastLevel = order.size();
+    order.push_back(start);
+    placed[start] = true;
+    size_t levelEnd = order.size();
+    for (size_t head = lastLevel; head < order.size(); head++) {
+        if (head == levelEnd) {
+            levels++;
+            lastLevel = head;
+            levelEnd = order.size();
+        }
+        CsrGraph::Neighbors edges = graph.neighbors(order[head]);
+        neighbors.clear();
+        for (int k = 0; k < edges.size(); k++) {
+            if (!placed[edges.targets[k]]) {
+                placed[edges.targets[k]] = true;
+                neighbors.push_back(edges.targets[k]);
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end(), [&](int32_t a, int32_t b) {
+            int da = degree(graph, a), db = degree(graph, b);
+            return da < db || (da == db && a < b);
+        });
+        order.insert(order.end(), neighbors.begin(), neighbors.end());
+    }
+    return levels;
+}
+
+inline std::vector<int32_t> reverseCuthillMcKee(const CsrGraph& graph) {
+    int nodes = graph.nodeCount();
+    std::vector<int32_t> order;
+    order.reserve(nodes);
+    std::vector<bool> placed(nodes, false);
+    std::vector<int32_t> neighbors;
+
+    // Components start from their lowest-degree node, moved to a
+    // pseudo-peripheral one: the lowest-degree node of the last BFS level,
+    // as long as that lengthens the BFS (George and Liu)
+    std::vector<int32_t> byDegree = degreeOrder(graph);
+    std::reverse(byDegree.begin(), byDegree.end());
+    for (int32_t start : byDegree) {
+        if (placed[start]) continue;
+        int first = order.size();
+        int lastLevel;
+        int levels = cuthillMcKeeLevels(graph, start, placed, order, neighbors, lastLevel);
+        while (true) {
+            int candidate = order[lastLevel];
+            for (size_t i = lastLevel; i < order.size(); i++) {
+                if (degree(graph, order[i]) < degree(graph, candidate)) {
+                    candidate = order[i];
+                }
+            }
+            for (size_t i = first; i < order.size(); i++) {
+                placed[order[i]] = false;
+            }
+            order.resize(first);
+            int candidateLevels = cuthillMcKeeLevels(graph, candidate, placed, order, neighbors, lastLevel);
+            if (candidateLevels <= levels) break;
+            levels = candidateLevels;
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// Max-priority queue of nodes by small integer scores changed one step at
+// a time: a doubly linked list per score
+class UnitHeap {
+public:
+    explicit UnitHeap(int nodes) : scores(nodes, 0), previous(nodes), next(nodes), queued(nodes, true), heads(1, -1), top(0) {
+        for (int node = nodes - 1; node >= 0; node--) {
+            link(node);
+        }
+    }
+
+    bool contains(int node) const {
+        return queued[node];
+    }
+
+    void add(int node, int delta) {
+        unlink(node);
+        scores[node] += delta;
+        link(node);
+    }
+
+    // A node of the highest score, the one changed last on ties; the
+    // heap must not be empty
+    int pop() {
+        while (heads[top] < 0) {
+            top--;
+        }
+        int node = heads[top];
+        unlink(node);
+        queued[node] = false;
+        return node;
+    }
+
+    void remove(int node) {
+        unlink(node);
+        queued[node] = false;
+    }
+
+private:
+    std::vector<int> scores;
+    std::vector<int32_t> previous;
+    std::vector<int32_t> next;
+    std::vector<bool> queued;
+    std::vector<int32_t> heads; // First node of each score's list, -1 when empty
+    int top; // No list above is non-empty
+
+    void link(int node) {
+        int score = scores[node];
+        if (score >= (int)heads.size()) {
+            heads.resize(score + 1, -1);
+        }
+        previous[node] = -1;
+        next[node] = heads[score];
+        if (heads[score] >= 0) {
+            previous[heads[score]] = node;
+        }
+        heads[score] = node;
+        top = std::max(top, score);
+    }
+
+    void unlink(int node) {
+        if (previous[node] >= 0) {
+            next[previous[node]] = next[node];
+        } else {
+            heads[scores[node]] = next[node];
+        }
+        if (next[node] >= 0) {
+            previous[next[node]] = previous[node];
+        }
+    }
+};
+
+// Gorder; incoming holds the reverse edges of graph (graph itself when
+// every edge has a reverse twin)
+inline std::vector<int32_t> gorder(const CsrGraph& graph, const CsrGraph& incoming, int window = GORDER_WINDOW) {
+    int nodes = graph.nodeCount();
+    std::vector<int32_t> order;
+    if (nodes == 0) return order;
+    order.reserve(nodes);
+    int hubDegree = std::sqrt((double)nodes);
+    bool symmetric = &graph == &incoming;
+    UnitHeap heap(nodes);
+
+    // Score change of every node related to node: its neighbours, and
+    // the other out-neighbours of its in-neighbours
+    auto relate = [&](int node, int delta) {
+        for (const CsrGraph* edges : {&graph, &incoming}) {
+            if (edges == &incoming && symmetric) break;
+            CsrGraph::Neighbors neighbors = edges->neighbors(node);
+            for (int k = 0; k < neighbors.size(); k++) {
+                if (heap.contains(neighbors.targets[k])) {
+                    heap.add(neighbors.targets[k], delta);
+                }
+            }
+        }
+        CsrGraph::Neighbors sources = incoming.neighbors(node);
+        for (int k = 0; k < sources.size(); k++) {
+            CsrGraph::Neighbors siblings = graph.neighbors(sources.targets[k]);
+            if (siblings.size() > hubDegree) continue;
+            for (int j = 0; j < siblings.size(); j++) {
+                if (heap.contains(siblings.targets[j])) {
+                    heap.add(siblings.targets[j], delta);
+                }
+            }
+        }
+    };
+
+    // Start from the node with the most in-edges
+    int start = 0;
+    for (int node = 1; node < nodes; node++) {
+        if (degree(incoming, node) > degree(incoming, start)) {
+            start = node;
+        }
+    }
+    heap.remove(start);
+    order.push_back(start);
+    while ((int)order.size() < nodes) {
+        relate(order.back(), 1);
+        if ((int)order.size() > window) {
+            relate(order[order.size() - 1 - window], -1);
+        }
+        order.push_back(heap.pop());
+    }
+    return order;
+}
+
+inline std::vector<int32_t> randomOrder(int nodes) {
+    std::vector<int32_t> order(nodes);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(RANDOM_SEED));
+    return order;
+}
+
+// The order of the given NodeOrder kind; false for an unknown kind. The
+// original order is the identity (the caller maps it back to its ids).
+inline bool computeOrder(int kind, const CsrGraph& graph, const CsrGraph& incoming, std::vector<int32_t>& order) {
+    switch (kind) {
+        case NODE_ORDER_ORIGINAL:
+            order.resize(graph.nodeCount());
+            std::iota(order.begin(), order.end(), 0);
+            return true;
+        case NODE_ORDER_RCM:
+            order = reverseCuthillMcKee(graph);
+            return true;
+        case NODE_ORDER_DEGREE:
+            order = degreeOrder(graph);
+            return true;
+        case NODE_ORDER_GORDER:
+            order = gorder(graph, incoming);
+            return true;
+        case NODE_ORDER_RANDOM:
+            order = randomOrder(graph.nodeCount());
+            return true;
+        default:
+            return false;
+    }
+}
+
+// graph with node order[i] renumbered i, each node's edges in their order
+inline CsrGraph permute(const CsrGraph& graph, const std::vector<int32_t>& order, TaskPool& pool) {
+    int nodes = graph.nodeCount();
+    std::vector<int32_t> numbers(nodes);
+    for (int i = 0; i < nodes; i++) {
+        numbers[order[i]] = i;
+    }
+    std::vector<int32_t> offsets(nodes + 1, 0);
+    for (int i = 0; i < nodes; i++) {
+        offsets[i + 1] = offsets[i] + degree(graph, order[i]);
+    }
+    std::vector<int32_t> targets(graph.edgeCount());
+    std::vector<int32_t> weights(graph.edgeCount());
+    parallelFor(pool, (nodes + PERMUTE_BLOCK - 1) / PERMUTE_BLOCK, [&](int block) {
+        int last = std::min(nodes, (block + 1) * PERMUTE_BLOCK);
+        for (int i = block * PERMUTE_BLOCK; i < last; i++) {
+            CsrGraph::Neighbors neighbors = graph.neighbors(order[i]);
+            for (int k = 0; k < neighbors.size(); k++) {
+                targets[offsets[i] + k] = numbers[neighbors.targets[k]];
+                weights[offsets[i] + k] = neighbors.weights[k];
+            }
+        }
+    });
+    return CsrGraph(std::move(offsets), std::move(targets), std::move(weights));
+}
+
+} // namespace nodeorder
+
+#endif // GRAPH_REORDER_H
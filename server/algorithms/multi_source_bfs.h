@@ -0,0 +1,313 @@
+// Bit-parallel multi-source breadth-first search (MS-BFS) on a CsrGraph
+//
+// Runs one BFS per source, up to MS_BFS_MAX_LANES sources at a time. Every
+// node keeps a bitset with one lane per source of the batch: the sources
+// that have reached it (seen) and those that reached it in the last level
+// (visit). One scan of a node's edges then advances every BFS whose
+// frontier holds the node (Then et al., 2015). As in parallel_bfs.h, a
+// level either pushes each frontier node's lanes to its neighbors, OR-ing
+// them into their bitsets for the next level, or, once the frontier's
+// edges pass 1/MS_BFS_ALPHA of the edges of nodes some lane has not seen,
+// lets each of those nodes pull the lanes of its incoming edges. Both
+// split the level into chunks across the task pool.
+//
+// Sources share scans only while their searches overlap: small-world
+// graphs gain the most, while on high-diameter graphs such as road
+// networks each source's wave reaches a node at its own level.
+//
+// The results are aggregates per source (nodes reached, sum of their
+// depths, eccentricity) and, optionally, every node's depth from each
+// source. Aggregates are counted per level with bit-sliced lane counters
+// rather than bit by bit. A batch takes three bitsets of 8 bytes per 64
+// lanes per node: 192 bytes per node for a full batch of 512.
+
+#ifndef MULTI_SOURCE_BFS_H
+#define MULTI_SOURCE_BFS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "csr_graph.h"
+#include "parallel_bfs.h"
+#include "task_pool.h"
+
+namespace parallel {
+
+// Sources per batch, 64 per bitset word
+const int MS_BFS_MAX_LANES = 512;
+
+const int MS_BFS_ALPHA = 16;
+
+// Aggregates of a multi-source BFS, one entry per source in source order
+struct MultiBfsStats {
+    std::vector<int64_t> reached; // Nodes reached, the source included; 0 for a source outside the graph
+    std::vector<int64_t> distanceSums; // Sum of the depths of the nodes reached
+    std::vector<int32_t> eccentricities; // Largest depth reached, -1 for a source outside the graph
+};
+
+namespace detail {
+
+template <int W>
+using Lanes = std::array<uint64_t, W>;
+
+template <int W>
+bool anyLane(const Lanes<W>& lanes) {
+    uint64_t any = 0;
+    for (int w = 0; w < W; w++) {
+        any |= lanes[w];
+    }
+    return any != 0;
+}
+
+// Per-lane counts of the bitsets added, kept bit-sliced: planes[k] holds
+// bit k of every lane's count, so adding a bitset is a ripple-carry add
+// of a few word operations on average
+template <int W>
+class LaneCounter {
+public:
+    LaneCounter() : planes(), used(0) {}
+
+    void add(const Lanes<W>& lanes) {
+        for (int w = 0; w < W; w++) {
+            uint64_t carry = lanes[w];
+            for (int k = 0; carry; k++) {
+                uint64_t overflow = planes[k][w] & carry;
+                planes[k][w] ^= carry;
+                carry = overflow;
+                used = std::max(used, k + 1);
+            }
+        }
+    }
+
+    // Add the counts to totals, one per lane, and start over from zero
+    void flush(int64_t* totals) {
+        for (int k = 0; k < used; k++) {
+            for (int w = 0; w < W; w++) {
+                for (uint64_t bits = planes[k][w]; bits; bits &= bits - 1) {
+                    totals[w * 64 + __builtin_ctzll(bits)] += int64_t(1) << k;
+                }
+                planes[k][w] = 0;
+            }
+        }
+        used = 0;
+    }
+
+private:
+    std::array<Lanes<W>, 32> planes; // Enough for counts below 2^32
+    int used; // Planes that may be non-zero
+};
+
+// One batch of count <= 64 * W sources; depths, when given, holds count
+// rows of one entry per node, filled with -1
+template <int W>
+void multiSourceBfsBatch(const CsrGraph& graph, const CsrGraph& incoming, const int32_t* sources, int count,
+                         TaskPool& pool, int64_t* reached, int64_t* distanceSums, int32_t* eccentricities,
+                         int32_t* depths) {
+    using Bits = Lanes<W>;
+    int nodeCount = graph.nodeCount();
+    const std::vector<int32_t>& offsets = graph.edgeOffsets();
+    std::vector<Bits> seen(nodeCount), visit(nodeCount), next(nodeCount);
+    std::vector<uint8_t> claimed(nodeCount, 0); // Node queued for settling in a push level
+    std::vector<int32_t> frontier;
+    long long frontierEdges = 0;
+    long long openEdges = graph.edgeCount(); // Edges of nodes some lane has not seen
+
+    Bits all = {};
+    for (int lane = 0; lane < count; lane++) {
+        all[lane >> 6] |= uint64_t(1) << (lane & 63);
+        reached[lane] = 0;
+        distanceSums[lane] = 0;
+        eccentricities[lane] = -1;
+        int32_t source = sources[lane];
+        if (!graph.contains(source)) continue;
+        if (!anyLane<W>(visit[source])) {
+            frontier.push_back(source);
+            frontierEdges += offsets[source + 1] - offsets[source];
+        }
+        seen[source][lane >> 6] |= uint64_t(1) << (lane & 63);
+        visit[source][lane >> 6] |= uint64_t(1) << (lane & 63);
+        reached[lane] = 1;
+        eccentricities[lane] = 0;
+        if (depths) {
+            depths[(size_t)lane * nodeCount + source] = 0;
+        }
+    }
+
+    std::vector<int64_t> levelCounts(64 * W);
+    for (int depth = 1; !frontier.empty(); depth++) {
+        bool pull = frontierEdges > openEdges / MS_BFS_ALPHA;
+        int chunks = detail::bfsChunkCount(pool, pull ? nodeCount : frontierEdges);
+        std::vector<std::vector<int32_t>> found(chunks);
+        std::vector<long long> foundEdges(chunks, 0);
+        std::vector<long long> closedEdges(chunks, 0);
+        std::vector<LaneCounter<W>> counters(chunks);
+
+        // Record node as reached by the lanes of bits at this depth
+        auto settle = [&](int c, int32_t node, const Bits& bits) {
+            uint64_t open = 0;
+            for (int w = 0; w < W; w++) {
+                seen[node][w] |= bits[w];
+                open |= all[w] & ~seen[node][w];
+            }
+            int degree = offsets[node + 1] - offsets[node];
+            counters[c].add(bits);
+            found[c].push_back(node);
+            foundEdges[c] += degree;
+            if (!open) {
+                closedEdges[c] += degree;
+            }
+            if (depths) {
+                for (int w = 0; w < W; w++) {
+                    for (uint64_t lanes = bits[w]; lanes; lanes &= lanes - 1) {
+                        depths[(size_t)(w * 64 + __builtin_ctzll(lanes)) * nodeCount + node] = depth;
+                    }
+                }
+            }
+        };
+
+        if (!pull) {
+            // OR the lanes new to each neighbor into its next bitset, the
+            // first chunk to do so queueing it; atomics only when chunks
+            // run side by side
+            std::vector<std::vector<int32_t>> queued(chunks);
+            bool shared = chunks > 1;
+            int frontierCount = frontier.size();
+            parallelFor(pool, chunks, [&](int c) {
+                int begin = (int)((long long)frontierCount * c / chunks);
+                int end = (int)((long long)frontierCount * (c + 1) / chunks);
+                for (int i = begin; i < end; i++) {
+                    const Bits& bits = visit[frontier[i]];
+                    CsrGraph::Neighbors neighbors = graph.neighbors(frontier[i]);
+                    for (int k = 0; k < neighbors.size(); k++) {
+                        int32_t neighbor = neighbors.targets[k];
+                        Bits fresh;
+                        for (int w = 0; w < W; w++) {
+                            fresh[w] = bits[w] & ~seen[neighbor][w];
+                        }
+                        if (!anyLane<W>(fresh)) continue;
+                        if (shared) {
+                            for (int w = 0; w < W; w++) {
+                                if (fresh[w] & ~std::atomic_ref<uint64_t>(next[neighbor][w]).load(std::memory_order_relaxed)) {
+                                    std::atomic_ref<uint64_t>(next[neighbor][w]).fetch_or(fresh[w], std::memory_order_relaxed);
+                                }
+                            }
+                            if (std::atomic_ref<uint8_t>(claimed[neighbor]).exchange(1, std::memory_order_relaxed) == 0) {
+                                queued[c].push_back(neighbor);
+                            }
+                        } else {
+                            for (int w = 0; w < W; w++) {
+                                next[neighbor][w] |= fresh[w];
+                            }
+                            if (!claimed[neighbor]) {
+                                claimed[neighbor] = 1;
+                                queued[c].push_back(neighbor);
+                            }
+                        }
+                    }
+                }
+            });
+            parallelFor(pool, chunks, [&](int c) {
+                for (int32_t node : queued[c]) {
+                    claimed[node] = 0;
+                    settle(c, node, next[node]);
+                }
+            });
+        } else {
+            // Nodes some lane has not seen gather the lanes of their
+            // incoming edges, stopping once every missing lane arrived
+            parallelFor(pool, chunks, [&](int c) {
+                int begin = (int)((long long)nodeCount * c / chunks);
+                int end = (int)((long long)nodeCount * (c + 1) / chunks);
+                for (int32_t node = begin; node < end; node++) {
+                    Bits missing;
+                    for (int w = 0; w < W; w++) {
+                        missing[w] = all[w] & ~seen[node][w];
+                    }
+                    if (!anyLane<W>(missing)) continue;
+                    Bits gathered = {};
+                    CsrGraph::Neighbors inEdges = incoming.neighbors(node);
+                    for (int k = 0; k < inEdges.size(); k++) {
+                        const Bits& bits = visit[inEdges.targets[k]];
+                        uint64_t open = 0;
+                        for (int w = 0; w < W; w++) {
+                            gathered[w] |= bits[w];
+                            open |= missing[w] & ~gathered[w];
+                        }
+                        if (!open) break;
+                    }
+                    for (int w = 0; w < W; w++) {
+                        gathered[w] &= missing[w];
+                    }
+                    if (!anyLane<W>(gathered)) continue;
+                    next[node] = gathered;
+                    settle(c, node, gathered);
+                }
+            });
+        }
+
+        // The visit bitsets become the (all-zero) next ones
+        for (int32_t node : frontier) {
+            visit[node] = Bits();
+        }
+        visit.swap(next);
+        frontier.clear();
+        frontierEdges = 0;
+        std::fill(levelCounts.begin(), levelCounts.end(), 0);
+        for (int c = 0; c < chunks; c++) {
+            frontier.insert(frontier.end(), found[c].begin(), found[c].end());
+            frontierEdges += foundEdges[c];
+            openEdges -= closedEdges[c];
+            counters[c].flush(levelCounts.data());
+        }
+        for (int lane = 0; lane < count; lane++) {
+            if (levelCounts[lane] == 0) continue;
+            reached[lane] += levelCounts[lane];
+            distanceSums[lane] += levelCounts[lane] * depth;
+            eccentricities[lane] = depth;
+        }
+    }
+}
+
+} // namespace detail
+
+// Breadth-first search from each of sources, in batches of up to
+// MS_BFS_MAX_LANES. incoming must hold the reverse edges of graph (graph
+// itself when every edge has a reverse twin). depths, when given, gets one
+// row of nodeCount entries per source: each node's depth from it, -1 when
+// unreached.
+inline void multiSourceBfs(const CsrGraph& graph, const CsrGraph& incoming, const std::vector<int32_t>& sources,
+                           TaskPool& pool, MultiBfsStats& stats, std::vector<int32_t>* depths = nullptr) {
+    int count = sources.size();
+    stats.reached.assign(count, 0);
+    stats.distanceSums.assign(count, 0);
+    stats.eccentricities.assign(count, -1);
+    if (depths) {
+        depths->assign((size_t)count * graph.nodeCount(), -1);
+    }
+    for (int first = 0; first < count; first += MS_BFS_MAX_LANES) {
+        int lanes = std::min(MS_BFS_MAX_LANES, count - first);
+        auto run = [&](auto words) {
+            detail::multiSourceBfsBatch<decltype(words)::value>(
+                graph, incoming, sources.data() + first, lanes, pool, stats.reached.data() + first,
+                stats.distanceSums.data() + first, stats.eccentricities.data() + first,
+                depths ? depths->data() + (size_t)first * graph.nodeCount() : nullptr);
+        };
+        // The narrowest bitsets that hold the batch
+        if (lanes <= 64) {
+            run(std::integral_constant<int, 1>());
+        } else if (lanes <= 128) {
+            run(std::integral_constant<int, 2>());
+        } else if (lanes <= 256) {
+            run(std::integral_constant<int, 4>());
+        } else {
+            run(std::integral_constant<int, 8>());
+        }
+    }
+}
+
+} // namespace parallel
+
+#endif // MULTI_SOURCE_BFS_H
@@ -0,0 +1,205 @@
+// Direction-optimizing parallel breadth-first search on a CsrGraph
+//
+// Each level expands the frontier either top-down (frontier nodes claim
+// their unvisited neighbors) or bottom-up (unvisited nodes look for a
+// parent in the frontier bitmap and stop at the first one found), chosen
+// with Beamer's heuristic: go bottom-up once the frontier's edges exceed
+// 1/BFS_ALPHA of the edges left unexplored, and back top-down once the
+// frontier shrinks below 1/BFS_BETA of the nodes. Levels are split into
+// chunks across the task pool; low-diameter graphs spend most of their
+// time in a few wide bottom-up levels, which parallelize without atomics.
+//
+// Depths do not depend on scheduling, and neither do parents: a top-down
+// level gives each node its lowest-id frontier neighbor, a bottom-up level
+// its first frontier neighbor in incoming edge order.
+
+#ifndef PARALLEL_BFS_H
+#define PARALLEL_BFS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "csr_graph.h"
+#include "task_pool.h"
+
+namespace parallel {
+
+const int BFS_ALPHA = 14;
+const int BFS_BETA = 24;
+
+// Frontiers below this size are expanded by one task
+const int BFS_PARALLEL_CUTOFF = 1 << 12;
+
+// Work items per thread, so threads that finish early can steal the rest
+const int BFS_CHUNKS_PER_THREAD = 4;
+
+enum BfsDirection {
+    BFS_TOP_DOWN = 0,
+    BFS_BOTTOM_UP = 1
+};
+
+// One expanded level: the frontier of nodes at depth `depth` and the
+// edges examined to find the next one
+struct BfsLevel {
+    int depth;
+    int frontier;
+    long long edgesExamined;
+    BfsDirection direction;
+};
+
+namespace detail {
+
+inline int bfsChunkCount(TaskPool& pool, long long work) {
+    if (work < BFS_PARALLEL_CUTOFF) return 1;
+    return std::max(1, (int)std::min<long long>(pool.concurrency() * BFS_CHUNKS_PER_THREAD, work / BFS_PARALLEL_CUTOFF));
+}
+
+// Set parent to candidate when it is unset (-1) or higher
+inline void lowerParent(int32_t& parent, int32_t candidate) {
+    std::atomic_ref<int32_t> slot(parent);
+    int32_t current = slot.load(std::memory_order_relaxed);
+    while ((current < 0 || candidate < current) &&
+           !slot.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace detail
+
+// Breadth-first search from source. incoming must hold the reverse edges
+// of graph (graph itself when every edge has a reverse twin). depths and
+// parents get one entry per node, -1 when unreached (parents also for
+// source); levels, when given, gets one record per expanded level.
+inline void breadthFirstSearch(const CsrGraph& graph, const CsrGraph& incoming, int source, TaskPool& pool,
+                               std::vector<int32_t>& depths, std::vector<int32_t>& parents,
+                               std::vector<BfsLevel>* levels = nullptr) {
+    int nodeCount = graph.nodeCount();
+    const std::vector<int32_t>& offsets = graph.edgeOffsets();
+    depths.assign(nodeCount, -1);
+    parents.assign(nodeCount, -1);
+    if (levels) {
+        levels->clear();
+    }
+    if (!graph.contains(source)) {
+        return;
+    }
+
+    int words = (nodeCount + 63) / 64;
+    std::vector<int32_t> queue = {source}; // Frontier while top-down
+    std::vector<uint64_t> bitmap; // Frontier while bottom-up
+    std::vector<uint64_t> nextBitmap;
+    depths[source] = 0;
+
+    BfsDirection direction = BFS_TOP_DOWN;
+    long long frontierEdges = offsets[source + 1] - offsets[source];
+    long long unexploredEdges = graph.edgeCount() - frontierEdges;
+    int frontierSize = 1;
+
+    for (int depth = 0; frontierSize > 0; depth++) {
+        // Beamer's heuristic, converting the frontier when it switches
+        if (direction == BFS_TOP_DOWN && frontierEdges > unexploredEdges / BFS_ALPHA) {
+            direction = BFS_BOTTOM_UP;
+            bitmap.assign(words, 0);
+            for (int32_t node : queue) {
+                bitmap[node >> 6] |= uint64_t(1) << (node & 63);
+            }
+        } else if (direction == BFS_BOTTOM_UP && frontierSize < nodeCount / BFS_BETA) {
+            direction = BFS_TOP_DOWN;
+            queue.clear();
+            for (int w = 0; w < words; w++) {
+                for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1) {
+                    queue.push_back(w * 64 + __builtin_ctzll(bits));
+                }
+            }
+        }
+
+        int next = depth + 1;
+        long long examined = 0;
+        long long nextEdges = 0;
+        int nextSize = 0;
+
+        if (direction == BFS_TOP_DOWN) {
+            // Claim unvisited neighbors; every frontier neighbor of a node
+            // found this level offers itself as its parent
+            int chunks = detail::bfsChunkCount(pool, frontierEdges);
+            std::vector<std::vector<int32_t>> found(chunks);
+            std::vector<long long> foundEdges(chunks, 0);
+            int frontierCount = queue.size();
+            parallelFor(pool, chunks, [&](int c) {
+                int begin = (int)((long long)frontierCount * c / chunks);
+                int end = (int)((long long)frontierCount * (c + 1) / chunks);
+                for (int i = begin; i < end; i++) {
+                    int32_t node = queue[i];
+                    CsrGraph::Neighbors neighbors = graph.neighbors(node);
+                    for (int k = 0; k < neighbors.size(); k++) {
+                        int32_t neighbor = neighbors.targets[k];
+                        std::atomic_ref<int32_t> depthRef(depths[neighbor]);
+                        int32_t seen = depthRef.load(std::memory_order_relaxed);
+                        if (seen == -1 && depthRef.compare_exchange_strong(seen, next, std::memory_order_relaxed)) {
+                            found[c].push_back(neighbor);
+                            foundEdges[c] += offsets[neighbor + 1] - offsets[neighbor];
+                            seen = next;
+                        }
+                        if (seen == next) {
+                            detail::lowerParent(parents[neighbor], node);
+                        }
+                    }
+                }
+            });
+            examined = frontierEdges;
+            queue.clear();
+            for (int c = 0; c < chunks; c++) {
+                queue.insert(queue.end(), found[c].begin(), found[c].end());
+                nextEdges += foundEdges[c];
+            }
+            nextSize = queue.size();
+        } else {
+            // Unvisited nodes search their incoming edges for a frontier
+            // node; chunks own whole bitmap words, so no writes are shared
+            nextBitmap.assign(words, 0);
+            int chunks = detail::bfsChunkCount(pool, nodeCount);
+            std::vector<long long> chunkExamined(chunks, 0), chunkEdges(chunks, 0);
+            std::vector<int> chunkFound(chunks, 0);
+            parallelFor(pool, chunks, [&](int c) {
+                int wordBegin = (int)((long long)words * c / chunks);
+                int wordEnd = (int)((long long)words * (c + 1) / chunks);
+                int nodeEnd = std::min(nodeCount, wordEnd * 64);
+                for (int32_t node = wordBegin * 64; node < nodeEnd; node++) {
+                    if (depths[node] != -1) continue;
+                    CsrGraph::Neighbors sources = incoming.neighbors(node);
+                    int k = 0;
+                    while (k < sources.size() && !(bitmap[sources.targets[k] >> 6] & (uint64_t(1) << (sources.targets[k] & 63)))) {
+                        k++;
+                    }
+                    if (k == sources.size()) {
+                        chunkExamined[c] += k;
+                        continue;
+                    }
+                    chunkExamined[c] += k + 1;
+                    depths[node] = next;
+                    parents[node] = sources.targets[k];
+                    nextBitmap[node >> 6] |= uint64_t(1) << (node & 63);
+                    chunkFound[c]++;
+                    chunkEdges[c] += offsets[node + 1] - offsets[node];
+                }
+            });
+            for (int c = 0; c < chunks; c++) {
+                examined += chunkExamined[c];
+                nextEdges += chunkEdges[c];
+                nextSize += chunkFound[c];
+            }
+            bitmap.swap(nextBitmap);
+        }
+
+        if (levels) {
+            levels->push_back({depth, frontierSize, examined, direction});
+        }
+        frontierSize = nextSize;
+        frontierEdges = nextEdges;
+        unexploredEdges -= nextEdges;
+    }
+}
+
+} // namespace parallel
+
+#endif // PARALLEL_BFS_H
@@ -0,0 +1,210 @@
+// Parallel untraced QuickSort and MergeSort on top of the task pool
+//
+// - quickSort: forks the smaller side of every partition above
+//   PARALLEL_SORT_CUTOFF; ranges above PARALLEL_PARTITION_CUTOFF are
+//   partitioned in chunks across the pool as well
+// - mergeSort: forks both halves above the cutoff, then merges them with
+//   a merge-path split so every thread merges an equal share
+//
+// Ranges below the cutoffs are finished with the simd_sort.h kernels.
+
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include "simd_sort.h"
+#include "task_pool.h"
+
+namespace parallel {
+
+// Ranges at or below this size are sorted sequentially by one task
+const int PARALLEL_SORT_CUTOFF = 1 << 16;
+
+// Ranges above this size are partitioned and merged by several tasks
+const int PARALLEL_PARTITION_CUTOFF = 1 << 20;
+
+// Work items per thread for chunked partitions and merges, so threads
+// that finish early can steal the remainder
+const int CHUNKS_PER_THREAD = 4;
+
+// Per-thread scratch for the partition kernel (needs n + 8 ints)
+inline int* threadScratch(int n) {
+    thread_local std::vector<int> scratch;
+    if ((int)scratch.size() < n + 8) {
+        scratch.resize(n + 8);
+    }
+    return scratch.data();
+}
+
+inline int chunkCount(TaskPool& pool, int n) {
+    return std::max(1, std::min(pool.concurrency() * CHUNKS_PER_THREAD, n / PARALLEL_SORT_CUTOFF));
+}
+
+// Pseudo-median of nine samples; large ranges need a better pivot than
+// medianOfThree because an unbalanced split serializes the recursion
+inline int ninther(const int* a, int n) {
+    int step = n / 8;
+    auto median = [](int x, int y, int z) {
+        return std::max(std::min(x, y), std::min(std::max(x, y), z));
+    };
+    return median(median(a[0], a[step], a[2 * step]),
+                  median(a[3 * step], a[4 * step], a[5 * step]),
+                  median(a[6 * step], a[7 * step], a[n - 1]));
+}
+
+// Stable partition of a[0, n) into < pivot and >= pivot; buffer[0, n) is
+// used for the chunked version. Returns the number of values < pivot.
+inline int partition(int* a, int n, int pivot, int* buffer, TaskPool& pool, const simd::Kernels& k) {
+    if (n <= PARALLEL_PARTITION_CUTOFF) {
+        return k.partition(a, n, pivot, threadScratch(n));
+    }
+
+    // Partition every chunk in place, then scatter both sides into the
+    // buffer at their prefix-sum offsets and copy back
+    int chunks = chunkCount(pool, n);
+    std::vector<int> less(chunks);
+    auto chunkStart = [n, chunks](int c) { return (int)((long long)n * c / chunks); };
+
+    parallelFor(pool, chunks, [&](int c) {
+        int start = chunkStart(c);
+        int size = chunkStart(c + 1) - start;
+        less[c] = k.partition(a + start, size, pivot, threadScratch(size));
+    });
+
+    std::vector<int> lessOffset(chunks), greaterOffset(chunks);
+    int totalLess = 0;
+    for (int c = 0; c < chunks; c++) {
+        lessOffset[c] = totalLess;
+        totalLess += less[c];
+    }
+    int greaterEnd = totalLess;
+    for (int c = 0; c < chunks; c++) {
+        greaterOffset[c] = greaterEnd;
+        greaterEnd += chunkStart(c + 1) - chunkStart(c) - less[c];
+    }
+
+    parallelFor(pool, chunks, [&](int c) {
+        int start = chunkStart(c);
+        int size = chunkStart(c + 1) - start;
+        memcpy(buffer + lessOffset[c], a + start, less[c] * sizeof(int));
+        memcpy(buffer + greaterOffset[c], a + start + less[c], (size - less[c]) * sizeof(int));
+    });
+    parallelFor(pool, chunks, [&](int c) {
+        int start = chunkStart(c);
+        memcpy(a + start, buffer + start, (chunkStart(c + 1) - start) * sizeof(int));
+    });
+    return totalLess;
+}
+
+// Three-way quicksort as in simd::quickSortRange, forking the smaller side.
+// Concurrent tasks work on disjoint ranges of a and of buffer.
+inline void quickSortRange(int* a, int n, int* buffer, TaskPool& pool, const simd::Kernels& k) {
+    TaskGroup group(pool);
+    while (n > PARALLEL_SORT_CUTOFF) {
+        int pivot = ninther(a, n);
+        int less = partition(a, n, pivot, buffer, pool, k);
+        int equal = pivot == INT_MAX
+            ? n - less
+            : partition(a + less, n - less, pivot + 1, buffer + less, pool, k);
+        int greaterOffset = less + equal;
+        int greater = n - greaterOffset;
+
+        // Fork the smaller side, keep going on the larger one
+        if (less < greater) {
+            group.run([a, less, buffer, &pool, &k] { quickSortRange(a, less, buffer, pool, k); });
+            a += greaterOffset;
+            buffer += greaterOffset;
+            n = greater;
+        } else {
+            group.run([a, greaterOffset, greater, buffer, &pool, &k] {
+                quickSortRange(a + greaterOffset, greater, buffer + greaterOffset, pool, k);
+            });
+            n = less;
+        }
+    }
+    simd::quickSortRange(a, n, threadScratch(n), k);
+    group.wait();
+}
+
+inline void quickSort(int* a, int n, TaskPool& pool) {
+    if (n <= PARALLEL_SORT_CUTOFF || pool.concurrency() == 1) {
+        simd::quickSort(a, n);
+        return;
+    }
+    std::vector<int> buffer(n);
+    quickSortRange(a, n, buffer.data(), pool, simd::kernels());
+}
+
+// Number of values taken from x among the first d outputs of a stable
+// merge of x and y (ties go to x)
+inline int mergePathSplit(const int* x, int nx, const int* y, int ny, int d) {
+    int lo = std::max(0, d - ny);
+    int hi = std::min(d, nx);
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (x[mid] <= y[d - mid - 1]) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Merge two sorted runs into out, split along the merge path into
+// independent chunks of equal output size
+inline void merge(const int* x, int nx, const int* y, int ny, int* out, TaskPool& pool, const simd::Kernels& k) {
+    int total = nx + ny;
+    if (total <= PARALLEL_PARTITION_CUTOFF) {
+        k.merge(x, nx, y, ny, out);
+        return;
+    }
+
+    int chunks = chunkCount(pool, total);
+    parallelFor(pool, chunks, [&](int c) {
+        int begin = (int)((long long)total * c / chunks);
+        int end = (int)((long long)total * (c + 1) / chunks);
+        int xBegin = mergePathSplit(x, nx, y, ny, begin);
+        int xEnd = mergePathSplit(x, nx, y, ny, end);
+        k.merge(x + xBegin, xEnd - xBegin, y + (begin - xBegin), (end - xEnd) - (begin - xBegin), out + begin);
+    });
+}
+
+// Sort a[0, n), leaving the result in buffer when intoBuffer is set and in
+// a otherwise; the halves are sorted into the other array and merged back
+inline void mergeSortRange(int* a, int* buffer, int n, bool intoBuffer, TaskPool& pool, const simd::Kernels& k) {
+    if (n <= PARALLEL_SORT_CUTOFF) {
+        simd::mergeSort(a, n);
+        if (intoBuffer) {
+            memcpy(buffer, a, n * sizeof(int));
+        }
+        return;
+    }
+
+    int half = n / 2;
+    {
+        TaskGroup group(pool);
+        group.run([=, &pool, &k] { mergeSortRange(a, buffer, half, !intoBuffer, pool, k); });
+        mergeSortRange(a + half, buffer + half, n - half, !intoBuffer, pool, k);
+    }
+
+    const int* from = intoBuffer ? a : buffer;
+    int* to = intoBuffer ? buffer : a;
+    merge(from, half, from + half, n - half, to, pool, k);
+}
+
+inline void mergeSort(int* a, int n, TaskPool& pool) {
+    if (n <= PARALLEL_SORT_CUTOFF || pool.concurrency() == 1) {
+        simd::mergeSort(a, n);
+        return;
+    }
+    std::vector<int> buffer(n);
+    mergeSortRange(a, buffer.data(), n, false, pool, simd::kernels());
+}
+
+} // namespace parallel
+
+#endif // PARALLEL_SORT_H
@@ -0,0 +1,301 @@
+// Point-to-point shortest path queries on a CsrGraph
+//
+// Three searches answer one (source, target) query over non-negative
+// weights without exploring the whole graph:
+//
+//   - Bidirectional Dijkstra grows one search from the source over the
+//     edges and one from the target over the reverse edges, always
+//     advancing the side with the smaller queue head, and stops once the
+//     two heads together reach the best path seen through a meeting node.
+//   - A* orders a Dijkstra search by distance plus a lower bound of the
+//     distance left. With node coordinates the bound is the straight-line
+//     distance times the lowest weight per unit of length over all edges,
+//     which keeps it consistent (see coordinateScale).
+//   - ALT is A* with landmark bounds: distances to and from a few
+//     landmarks are computed once, and the triangle inequality bounds
+//     dist(v, t) by dist(L, t) - dist(L, v) and by dist(v, L) - dist(t, L).
+//     Landmarks are picked farthest-first, which covers the graph's
+//     periphery where the bounds are tightest.
+//
+// Every search reports the nodes it settled, the usual measure of the
+// work a query does. PATH_CONTRACTION queries run on a preprocessed
+// contraction hierarchy (see contraction_hierarchy.h).
+
+#ifndef PATH_QUERY_H
+#define PATH_QUERY_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "csr_graph.h"
+#include "priority_queues.h"
+
+namespace pathquery {
+
+enum PathMethod {
+    PATH_BIDIRECTIONAL = 0,
+    PATH_ASTAR = 1,
+    PATH_ALT = 2,
+    PATH_CONTRACTION = 3
+};
+
+const int DEFAULT_LANDMARKS = 8;
+
+const int UNREACHABLE = INT_MAX;
+
+struct PathResult {
+    int distance = UNREACHABLE;
+    std::vector<int32_t> path; // Source to target, empty when unreachable
+    int settled = 0;
+};
+
+// A node settled by a search, in settle order
+struct SettledNode {
+    int32_t node;
+    int distance; // From the source, or to the target for backward settles
+    bool backward;
+};
+
+// Dijkstra distances from source over graph's edges
+inline void distancesFrom(const CsrGraph& graph, int source, std::vector<int>& distances) {
+    distances.assign(graph.nodeCount(), UNREACHABLE);
+    DaryHeap<4> queue(distances, 0);
+    distances[source] = 0;
+    queue.update(source);
+    while (!queue.empty()) {
+        int node = queue.pop();
+        CsrGraph::Neighbors neighbors = graph.neighbors(node);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int neighbor = neighbors.targets[k];
+            long long candidate = (long long)distances[node] + neighbors.weights[k];
+            if (candidate < distances[neighbor]) {
+                distances[neighbor] = candidate;
+                queue.update(neighbor);
+            }
+        }
+    }
+}
+
+// Landmark distances for ALT bounds
+class Landmarks {
+public:
+    // Pick count landmarks farthest-first from node 0 and store the
+    // distances from each (over graph) and to each (over incoming, the
+    // reverse edges; graph itself when every edge has a reverse twin)
+    void build(const CsrGraph& graph, const CsrGraph& incoming, int count) {
+        nodeCount = graph.nodeCount();
+        symmetric = &graph == &incoming;
+        nodes.clear();
+        landmarkCount = std::min(count, nodeCount);
+        from.assign((size_t)nodeCount * landmarkCount, UNREACHABLE);
+        to.assign(symmetric ? 0 : from.size(), UNREACHABLE);
+        if (nodeCount == 0) return;
+
+        // Each landmark is the node farthest from those picked so far
+        // (unreachable counts as farthest, lowest id on ties), starting
+        // from the node farthest from node 0
+        std::vector<int> nearest(nodeCount, -1); // Distance to the closest landmark, -1 before the first
+        std::vector<int> distances;
+        distancesFrom(graph, 0, distances);
+        int next = std::max_element(distances.begin(), distances.end()) - distances.begin();
+        for (int i = 0; i < landmarkCount; i++) {
+            nodes.push_back(next);
+            distancesFrom(graph, next, distances);
+            for (int node = 0; node < nodeCount; node++) {
+                from[(size_t)node * landmarkCount + i] = distances[node];
+            }
+            if (!symmetric) {
+                std::vector<int> reverse;
+                distancesFrom(incoming, next, reverse);
+                for (int node = 0; node < nodeCount; node++) {
+                    to[(size_t)node * landmarkCount + i] = reverse[node];
+                }
+            }
+            next = 0;
+            for (int node = 0; node < nodeCount; node++) {
+                if (nearest[node] < 0 || distances[node] < nearest[node]) {
+                    nearest[node] = distances[node];
+                }
+                if (nearest[node] > nearest[next]) {
+                    next = node;
+                }
+            }
+        }
+    }
+
+    int count() const {
+        return landmarkCount;
+    }
+
+    // Lower bound of the distance from node to target
+    int bound(int node, int target) const {
+        const std::vector<int>& toLandmark = symmetric ? from : to;
+        const int* fromNode = &from[(size_t)node * landmarkCount];
+        const int* fromTarget = &from[(size_t)target * landmarkCount];
+        const int* toNode = &toLandmark[(size_t)node * landmarkCount];
+        const int* toTarget = &toLandmark[(size_t)target * landmarkCount];
+        int best = 0;
+        for (int i = 0; i < landmarkCount; i++) {
+            if (fromTarget[i] != UNREACHABLE && fromNode[i] != UNREACHABLE) {
+                best = std::max(best, fromTarget[i] - fromNode[i]);
+            }
+            if (toNode[i] != UNREACHABLE && toTarget[i] != UNREACHABLE) {
+                best = std::max(best, toNode[i] - toTarget[i]);
+            }
+        }
+        return best;
+    }
+
+private:
+    int nodeCount = 0;
+    int landmarkCount = 0;
+    bool symmetric = true;
+    std::vector<int32_t> nodes;
+    // Interleaved by node so one node's bounds share a cache line:
+    // from[v * landmarkCount + i] is the distance from landmark i to v
+    std::vector<int> from;
+    std::vector<int> to; // Distance from v to landmark i (from, when symmetric)
+};
+
+// Largest factor that keeps factor * (straight-line distance) a lower
+// bound of path weights: the lowest weight per unit of length over all
+// edges (0 when some edge has no weight but has length), shaved so that
+// rounding in the estimates cannot overshoot
+inline double coordinateScale(const CsrGraph& graph, const std::vector<std::pair<double, double>>& positions) {
+    double scale = -1;
+    for (int node = 0; node < graph.nodeCount(); node++) {
+        CsrGraph::Neighbors neighbors = graph.neighbors(node);
+        for (int k = 0; k < neighbors.size(); k++) {
+            const std::pair<double, double>& p = positions[node];
+            const std::pair<double, double>& q = positions[neighbors.targets[k]];
+            double length = std::hypot(p.first - q.first, p.second - q.second);
+            if (length > 0 && (scale < 0 || neighbors.weights[k] < scale * length)) {
+                scale = neighbors.weights[k] / length;
+            }
+        }
+    }
+    return std::max(scale, 0.0) * (1 - 1e-9);
+}
+
+// A* from source to target with a consistent lower bound estimate(node)
+// of the distance to target (0 everywhere for plain Dijkstra)
+template <class Estimate>
+PathResult aStar(const CsrGraph& graph, int source, int target, Estimate estimate,
+                 std::vector<SettledNode>* log = nullptr) {
+    PathResult result;
+    if (!graph.contains(source) || !graph.contains(target)) {
+        return result;
+    }
+    int nodeCount = graph.nodeCount();
+    std::vector<int> distances(nodeCount, UNREACHABLE);
+    std::vector<int> keys(nodeCount, UNREACHABLE); // Distance plus estimate
+    std::vector<int32_t> parents(nodeCount, -1);
+    std::vector<bool> settled(nodeCount, false);
+    DaryHeap<4> queue(keys, 0);
+    distances[source] = 0;
+    keys[source] = estimate(source);
+    queue.update(source);
+
+    while (!queue.empty()) {
+        int node = queue.pop();
+        settled[node] = true;
+        result.settled++;
+        if (log) {
+            log->push_back({node, distances[node], false});
+        }
+        if (node == target) break;
+
+        CsrGraph::Neighbors neighbors = graph.neighbors(node);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int neighbor = neighbors.targets[k];
+            long long candidate = (long long)distances[node] + neighbors.weights[k];
+            if (!settled[neighbor] && candidate < distances[neighbor]) {
+                distances[neighbor] = candidate;
+                keys[neighbor] = std::min<long long>(candidate + estimate(neighbor), UNREACHABLE - 1);
+                parents[neighbor] = node;
+                queue.update(neighbor);
+            }
+        }
+    }
+
+    if (settled[target]) {
+        result.distance = distances[target];
+        for (int node = target; node >= 0; node = parents[node]) {
+            result.path.push_back(node);
+        }
+        std::reverse(result.path.begin(), result.path.end());
+    }
+    return result;
+}
+
+// Bidirectional Dijkstra from source to target; incoming holds the
+// reverse edges of graph
+inline PathResult bidirectionalDijkstra(const CsrGraph& graph, const CsrGraph& incoming, int source, int target,
+                                        std::vector<SettledNode>* log = nullptr) {
+    PathResult result;
+    if (!graph.contains(source) || !graph.contains(target)) {
+        return result;
+    }
+    int nodeCount = graph.nodeCount();
+    std::vector<int> distances[2] = {std::vector<int>(nodeCount, UNREACHABLE), std::vector<int>(nodeCount, UNREACHABLE)};
+    std::vector<int32_t> parents[2] = {std::vector<int32_t>(nodeCount, -1), std::vector<int32_t>(nodeCount, -1)};
+    DaryHeap<4> queues[2] = {DaryHeap<4>(distances[0], 0), DaryHeap<4>(distances[1], 0)};
+    const CsrGraph* edges[2] = {&graph, &incoming};
+    distances[0][source] = 0;
+    distances[1][target] = 0;
+    queues[0].update(source);
+    queues[1].update(target);
+
+    // Best path seen: through meeting node, of length best
+    long long best = source == target ? 0 : UNREACHABLE;
+    int meeting = source == target ? source : -1;
+    int heads[2] = {0, 0};
+    while (!queues[0].empty() && !queues[1].empty() && (long long)heads[0] + heads[1] < best) {
+        int side = heads[0] <= heads[1] ? 0 : 1;
+        int node = queues[side].pop();
+        result.settled++;
+        if (log) {
+            log->push_back({node, distances[side][node], side == 1});
+        }
+
+        CsrGraph::Neighbors neighbors = edges[side]->neighbors(node);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int neighbor = neighbors.targets[k];
+            long long candidate = (long long)distances[side][node] + neighbors.weights[k];
+            if (candidate < distances[side][neighbor]) {
+                distances[side][neighbor] = candidate;
+                parents[side][neighbor] = node;
+                queues[side].update(neighbor);
+            }
+            if (distances[1 - side][neighbor] != UNREACHABLE &&
+                candidate + distances[1 - side][neighbor] < best) {
+                best = candidate + distances[1 - side][neighbor];
+                meeting = neighbor;
+            }
+        }
+
+        // The heads only grow; an empty side ends the search
+        for (int s = 0; s < 2; s++) {
+            heads[s] = queues[s].empty() ? UNREACHABLE : distances[s][queues[s].top()];
+        }
+    }
+
+    if (meeting >= 0) {
+        result.distance = best;
+        for (int node = meeting; node >= 0; node = parents[0][node]) {
+            result.path.push_back(node);
+        }
+        std::reverse(result.path.begin(), result.path.end());
+        for (int node = parents[1][meeting]; node >= 0; node = parents[1][node]) {
+            result.path.push_back(node);
+        }
+    }
+    return result;
+}
+
+} // namespace pathquery
+
+#endif // PATH_QUERY_H
@@ -0,0 +1,276 @@
+// Addressable priority queues for Dijkstra's algorithm
+//
+// All queues order node ids by (keys[node], node), reading the keys from
+// the caller's distance array, so every queue settles nodes in the same
+// order as a linear scan for the lowest distance with the lowest id on
+// ties. update(node) inserts a node or, when it is queued already,
+// restores the order after its key decreased.
+//
+// - DaryHeap: implicit d-ary heap with a position index for decrease-key
+// - PairingHeap: pairing heap over per-node links, O(1) insert and
+//   decrease-key, amortized O(log n) pop
+// - BucketQueue: Dial's bucket queue for non-negative integer weights up
+//   to BUCKET_QUEUE_MAX_WEIGHT; one bucket per distance modulo
+//   maxWeight + 1, each a min-heap of ids for the tie-break
+
+#ifndef PRIORITY_QUEUES_H
+#define PRIORITY_QUEUES_H
+
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// Runtime queue selection as passed through the C interface
+enum QueueKind {
+    QUEUE_DARY_HEAP = 0,
+    QUEUE_PAIRING_HEAP = 1,
+    QUEUE_BUCKET = 2
+};
+
+// Largest edge weight the bucket queue accepts (one bucket per distance
+// in a window of maxWeight + 1)
+const int BUCKET_QUEUE_MAX_WEIGHT = 1 << 16;
+
+template <int D = 4>
+class DaryHeap {
+public:
+    DaryHeap(const std::vector<int>& nodeKeys, int) : keys(nodeKeys), position(nodeKeys.size(), -1) {}
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    void update(int node) {
+        int index = position[node];
+        if (index < 0) {
+            index = heap.size();
+            heap.push_back(node);
+        }
+        siftUp(index, node);
+    }
+
+    int pop() {
+        int top = heap[0];
+        int last = heap.back();
+        heap.pop_back();
+        position[top] = -1;
+        if (!heap.empty()) {
+            siftDown(0, last);
+        }
+        return top;
+    }
+
+    // Node pop() would return, without removing it
+    int top() const {
+        return heap[0];
+    }
+
+    // Remove every queued node
+    void clear() {
+        for (int node : heap) {
+            position[node] = -1;
+        }
+        heap.clear();
+    }
+
+private:
+    const std::vector<int>& keys;
+    std::vector<int> heap;
+    std::vector<int> position; // Heap index of each node, -1 when not queued
+
+    bool less(int a, int b) const {
+        return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+    }
+
+    // Move node up from a hole at index
+    void siftUp(int index, int node) {
+        while (index > 0) {
+            int parent = (index - 1) / D;
+            if (!less(node, heap[parent])) break;
+            heap[index] = heap[parent];
+            position[heap[index]] = index;
+            index = parent;
+        }
+        heap[index] = node;
+        position[node] = index;
+    }
+
+    // Move node down from a hole at index
+    void siftDown(int index, int node) {
+        int size = heap.size();
+        while (true) {
+            int first = index * D + 1;
+            if (first >= size) break;
+            int best = first;
+            int last = std::min(first + D, size);
+            for (int child = first + 1; child < last; child++) {
+                if (less(heap[child], heap[best])) best = child;
+            }
+            if (!less(heap[best], node)) break;
+            heap[index] = heap[best];
+            position[heap[index]] = index;
+            index = best;
+        }
+        heap[index] = node;
+        position[node] = index;
+    }
+};
+
+class PairingHeap {
+public:
+    PairingHeap(const std::vector<int>& nodeKeys, int) : keys(nodeKeys), links(nodeKeys.size()), root(-1) {}
+
+    bool empty() const {
+        return root < 0;
+    }
+
+    void update(int node) {
+        Link& link = links[node];
+        if (!link.queued) {
+            link = {-1, -1, -1, true};
+            root = root < 0 ? node : meld(root, node);
+            return;
+        }
+        if (node == root) return;
+
+        // Cut the node's subtree out and meld it back at the root
+        if (links[link.prev].child == node) {
+            links[link.prev].child = link.next;
+        } else {
+            links[link.prev].next = link.next;
+        }
+        if (link.next >= 0) {
+            links[link.next].prev = link.prev;
+        }
+        link.next = link.prev = -1;
+        root = meld(root, node);
+    }
+
+    int pop() {
+        int top = root;
+        links[top].queued = false;
+        root = mergePairs(links[top].child);
+        if (root >= 0) {
+            links[root].prev = -1;
+        }
+        return top;
+    }
+
+private:
+    struct Link {
+        int child; // First child
+        int next;  // Next sibling
+        int prev;  // Previous sibling, or the parent for a first child
+        bool queued;
+    };
+
+    const std::vector<int>& keys;
+    std::vector<Link> links;
+    std::vector<int> pairs; // Scratch for mergePairs
+    int root;
+
+    bool less(int a, int b) const {
+        return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+    }
+
+    // Meld two roots, returning the new root
+    int meld(int a, int b) {
+        if (less(b, a)) std::swap(a, b);
+        Link& child = links[b];
+        child.prev = a;
+        child.next = links[a].child;
+        if (child.next >= 0) {
+            links[child.next].prev = b;
+        }
+        links[a].child = b;
+        links[a].next = -1;
+        return a;
+    }
+
+    // Two-pass merge of a sibling list: pair left to right, then fold the
+    // pairs right to left
+    int mergePairs(int first) {
+        pairs.clear();
+        while (first >= 0) {
+            int a = first;
+            int b = links[a].next;
+            if (b < 0) {
+                links[a].next = links[a].prev = -1;
+                pairs.push_back(a);
+                break;
+            }
+            first = links[b].next;
+            links[a].next = links[a].prev = -1;
+            links[b].next = links[b].prev = -1;
+            pairs.push_back(meld(a, b));
+        }
+        if (pairs.empty()) return -1;
+        int merged = pairs.back();
+        for (int i = (int)pairs.size() - 2; i >= 0; i--) {
+            merged = meld(pairs[i], merged);
+        }
+        return merged;
+    }
+};
+
+class BucketQueue {
+public:
+    // Keys must be non-negative and grow by at most maxWeight per relaxation
+    BucketQueue(const std::vector<int>& nodeKeys, int maxWeight)
+        : keys(nodeKeys), buckets(maxWeight + 1), queued(nodeKeys.size(), false), cursor(0), live(0) {}
+
+    bool empty() const {
+        return live == 0;
+    }
+
+    // A node whose key decreased is queued again; the old copy is dropped on pop
+    void update(int node) {
+        std::vector<int>& bucket = buckets[keys[node] % buckets.size()];
+        bucket.push_back(node);
+        std::push_heap(bucket.begin(), bucket.end(), std::greater<int>());
+        if (!queued[node]) {
+            queued[node] = true;
+            live++;
+        }
+    }
+
+    int pop() {
+        while (true) {
+            std::vector<int>& bucket = buckets[cursor % buckets.size()];
+            while (!bucket.empty()) {
+                std::pop_heap(bucket.begin(), bucket.end(), std::greater<int>());
+                int node = bucket.back();
+                bucket.pop_back();
+                if (queued[node] && keys[node] == cursor) {
+                    queued[node] = false;
+                    live--;
+                    return node;
+                }
+            }
+            cursor++;
+        }
+    }
+
+private:
+    const std::vector<int>& keys;
+    std::vector<std::vector<int>> buckets;
+    std::vector<bool> queued;
+    int cursor; // Distance of the bucket being drained
+    int live;   // Queued nodes, not counting stale copies
+};
+
+// Call f with a std::type_identity of the queue class for a QueueKind
+template <class F>
+auto withPriorityQueue(int kind, F&& f) {
+    switch (kind) {
+        case QUEUE_PAIRING_HEAP:
+            return f(std::type_identity<PairingHeap>());
+        case QUEUE_BUCKET:
+            return f(std::type_identity<BucketQueue>());
+        default:
+            return f(std::type_identity<DaryHeap<4>>());
+    }
+}
+
+#endif // PRIORITY_QUEUES_H
@@ -0,0 +1,238 @@
+// LSD radix sort for the sorting engine
+//
+// Digits are taken from value - min, so the number of passes follows the
+// spread of the input rather than the width of int: the 10..100 arrays the
+// visualizer generates need a single 8-bit pass. Large inputs use 11-bit
+// (three passes for full-range ints) or 16-bit digits. All histograms come
+// from one read pass, passes where every value shares a digit are skipped,
+// and the scatter stages values in cache-line sized write-combining buffers
+// so each bucket is flushed to memory a full aligned line at a time.
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "simd_sort.h"
+
+#if defined(__SSE2__)
+#define RADIX_SORT_STREAM 1
+#include <emmintrin.h>
+#endif
+
+namespace radix {
+
+// Ints per write-combining buffer (one 64-byte cache line)
+const int WRITE_COMBINE_INTS = 16;
+
+// Widest digit whose write-combining buffers still fit in L2
+// (2048 buckets x 64 bytes); wider digits scatter directly
+const int MAX_COMBINED_DIGIT_BITS = 11;
+
+// Outputs of at least this many ints (4 MB) bypass the cache on flush
+const int STREAMING_MIN_SIZE = 1 << 20;
+
+// Digit width and pass count chosen for one input
+struct RadixPlan {
+    unsigned base; // Smallest value; digits are taken from value - base
+    int digitBits;
+    int passes;
+};
+
+inline int digitOf(int value, const RadixPlan& plan, int pass) {
+    unsigned key = (unsigned)value - plan.base;
+    return (key >> (pass * plan.digitBits)) & ((1u << plan.digitBits) - 1);
+}
+
+// Wider digits mean fewer passes but larger histograms, so they are only
+// used when there are enough values to fill the buckets
+inline int chooseDigitBits(int keyBits, int n) {
+    if (keyBits <= 8 || n < (1 << 12)) return 8;
+    if (keyBits <= 16 && n >= (1 << 16)) return 16;
+    if (n >= (1 << 16)) return 11;
+    return 8;
+}
+
+inline RadixPlan planSort(const int* a, int n) {
+    RadixPlan plan = {0, 8, 0};
+    if (n == 0) return plan;
+
+    int low = a[0], high = a[0];
+    for (int i = 1; i < n; i++) {
+        low = std::min(low, a[i]);
+        high = std::max(high, a[i]);
+    }
+    unsigned spread = (unsigned)high - (unsigned)low;
+    int keyBits = spread == 0 ? 0 : 32 - __builtin_clz(spread);
+
+    plan.base = (unsigned)low;
+    plan.digitBits = chooseDigitBits(keyBits, n);
+    plan.passes = (keyBits + plan.digitBits - 1) / plan.digitBits;
+    return plan;
+}
+
+// Histograms of every pass in one read; counts[pass << digitBits | digit]
+inline void countDigits(const int* a, int n, const RadixPlan& plan, std::vector<int>& counts) {
+    counts.assign(plan.passes << plan.digitBits, 0);
+    for (int i = 0; i < n; i++) {
+        for (int pass = 0; pass < plan.passes; pass++) {
+            counts[(pass << plan.digitBits) | digitOf(a[i], plan, pass)]++;
+        }
+    }
+}
+
+// True when one bucket holds every value and the pass would not move anything
+inline bool isTrivialPass(const int* counts, int buckets, int n) {
+    return std::find(counts, counts + buckets, n) != counts + buckets;
+}
+
+// Exclusive prefix sum of a histogram: the first output slot of each bucket
+inline void bucketOffsets(const int* counts, int buckets, std::vector<int>& offsets) {
+    offsets.resize(buckets);
+    int sum = 0;
+    for (int d = 0; d < buckets; d++) {
+        offsets[d] = sum;
+        sum += counts[d];
+    }
+}
+
+// Copy one full buffer to an aligned destination line. Large outputs use
+// non-temporal stores so the scatter does not evict the buffers from cache.
+inline void flushLine(int* out, const int* line, bool stream) {
+#if defined(RADIX_SORT_STREAM)
+    if (stream) {
+        const __m128i* in = (const __m128i*)line;
+        _mm_stream_si128((__m128i*)out, _mm_load_si128(in));
+        _mm_stream_si128((__m128i*)out + 1, _mm_load_si128(in + 1));
+        _mm_stream_si128((__m128i*)out + 2, _mm_load_si128(in + 2));
+        _mm_stream_si128((__m128i*)out + 3, _mm_load_si128(in + 3));
+        return;
+    }
+#endif
+    memcpy(out, line, WRITE_COMBINE_INTS * sizeof(int));
+}
+
+// Stable scatter of src into dst by digit; offsets are consumed
+inline void scatterPass(const int* src, int* dst, int n, const RadixPlan& plan, int pass, std::vector<int>& offsets) {
+    int buckets = 1 << plan.digitBits;
+    if (plan.digitBits > MAX_COMBINED_DIGIT_BITS) {
+        for (int i = 0; i < n; i++) {
+            dst[offsets[digitOf(src[i], plan, pass)]++] = src[i];
+        }
+        return;
+    }
+
+    struct alignas(64) Line {
+        int values[WRITE_COMBINE_INTS];
+    };
+    std::vector<Line> lines(buckets);
+    std::vector<unsigned char> fill(buckets), first(buckets);
+    std::vector<int> lineStart(buckets);
+
+    // Slot k of a bucket's buffer maps to position k of a destination cache
+    // line, so every flush after the bucket's first covers one aligned line
+    for (int d = 0; d < buckets; d++) {
+        int misalign = ((uintptr_t)(dst + offsets[d]) / sizeof(int)) % WRITE_COMBINE_INTS;
+        first[d] = fill[d] = misalign;
+        lineStart[d] = offsets[d] - misalign;
+    }
+
+    bool stream = n >= STREAMING_MIN_SIZE;
+    unsigned shift = pass * plan.digitBits;
+    unsigned mask = buckets - 1;
+    for (int i = 0; i < n; i++) {
+        int value = src[i];
+        unsigned d = (((unsigned)value - plan.base) >> shift) & mask;
+        unsigned f = fill[d];
+        lines[d].values[f] = value;
+        if (f + 1 < WRITE_COMBINE_INTS) {
+            fill[d] = f + 1;
+            continue;
+        }
+
+        // The first line of a bucket is shared with the previous bucket
+        int* out = dst + lineStart[d];
+        if (first[d] == 0) {
+            flushLine(out, lines[d].values, stream);
+        } else {
+            memcpy(out + first[d], lines[d].values + first[d], (WRITE_COMBINE_INTS - first[d]) * sizeof(int));
+            first[d] = 0;
+        }
+        lineStart[d] += WRITE_COMBINE_INTS;
+        fill[d] = 0;
+    }
+#if defined(RADIX_SORT_STREAM)
+    _mm_sfence();
+#endif
+
+    for (int d = 0; d < buckets; d++) {
+        memcpy(dst + lineStart[d] + first[d], lines[d].values + first[d], (fill[d] - first[d]) * sizeof(int));
+    }
+}
+
+inline void sort(int* a, int n) {
+    if (n <= simd::SMALL_SORT_LIMIT) {
+        simd::kernels().sortSmall(a, n);
+        return;
+    }
+
+    RadixPlan plan = planSort(a, n);
+    int buckets = 1 << plan.digitBits;
+    std::vector<int> counts, offsets;
+    countDigits(a, n, plan, counts);
+
+    // Ping-pong between the array and a buffer, one scatter per pass
+    std::vector<int> buffer(n);
+    int* from = a;
+    int* to = buffer.data();
+    for (int pass = 0; pass < plan.passes; pass++) {
+        const int* histogram = &counts[pass << plan.digitBits];
+        if (isTrivialPass(histogram, buckets, n)) {
+            continue;
+        }
+        bucketOffsets(histogram, buckets, offsets);
+        scatterPass(from, to, n, plan, pass, offsets);
+        std::swap(from, to);
+    }
+    if (from != a) {
+        memcpy(a, from, n * sizeof(int));
+    }
+}
+
+// Indices 0..n-1 ordered by keys[index], equal keys in index order. Each
+// pass moves a key and its index together, so the scatter writes directly
+// instead of through write-combining buffers.
+inline void sortIndices(const int* keys, int n, std::vector<int32_t>& order) {
+    order.resize(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    RadixPlan plan = planSort(keys, n);
+    int buckets = 1 << plan.digitBits;
+    std::vector<int> counts, offsets;
+    countDigits(keys, n, plan, counts);
+
+    std::vector<int> fromKeys(keys, keys + n), toKeys(n);
+    std::vector<int32_t> toOrder(n);
+    for (int pass = 0; pass < plan.passes; pass++) {
+        const int* histogram = &counts[pass << plan.digitBits];
+        if (isTrivialPass(histogram, buckets, n)) {
+            continue;
+        }
+        bucketOffsets(histogram, buckets, offsets);
+        for (int i = 0; i < n; i++) {
+            int slot = offsets[digitOf(fromKeys[i], plan, pass)]++;
+            toKeys[slot] = fromKeys[i];
+            toOrder[slot] = order[i];
+        }
+        fromKeys.swap(toKeys);
+        order.swap(toOrder);
+    }
+}
+
+} // namespace radix
+
+#endif // RADIX_SORT_H
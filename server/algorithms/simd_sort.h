@@ -0,0 +1,532 @@
+// Vectorized sorting kernels used by the untraced sorting paths
+//
+// - sortSmall: bitonic sorting network for up to SMALL_SORT_LIMIT ints
+// - merge: branchless merge built on an in-register bitonic merge network
+// - partition: compress-store partition around a pivot
+// - quickSort / mergeSort: complete sorts built from the kernels above
+//
+// Natively the AVX2 kernels are selected at runtime when the CPU supports
+// them; the browser build uses WASM SIMD128 when compiled with -msimd128.
+// Everything else falls back to the scalar kernels.
+
+#ifndef SIMD_SORT_H
+#define SIMD_SORT_H
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_SORT_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__wasm_simd128__)
+#define SIMD_SORT_WASM 1
+#include <wasm_simd128.h>
+#endif
+
+namespace simd {
+
+// Partitions at or below this size are finished with sortSmall
+const int SMALL_SORT_LIMIT = 64;
+
+// ---------------------------------------------------------------------------
+// Scalar kernels
+
+// Insertion sort for small ranges
+inline void sortSmallScalar(int* a, int n) {
+    for (int i = 1; i < n; i++) {
+        int value = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > value) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = value;
+    }
+}
+
+// Branchless merge of two sorted runs into out
+inline void mergeScalar(const int* a, int na, const int* b, int nb, int* out) {
+    int i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        int x = a[i];
+        int y = b[j];
+        bool takeA = x <= y;
+        out[k++] = takeA ? x : y;
+        i += takeA;
+        j += !takeA;
+    }
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+// Stable partition: values < pivot first, returns how many there are.
+// scratch must hold n + 8 ints.
+inline int partitionScalar(int* a, int n, int pivot, int* scratch) {
+    int left = 0, greater = 0;
+    for (int i = 0; i < n; i++) {
+        int x = a[i];
+        bool less = x < pivot;
+        a[left] = x;
+        scratch[greater] = x;
+        left += less;
+        greater += !less;
+    }
+    memcpy(a + left, scratch, greater * sizeof(int));
+    return left;
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels (8 x int32 lanes)
+
+#ifdef SIMD_SORT_AVX2
+
+// Permutation table for compress-store: entry m moves the lanes whose bit
+// is set in m to the front (in order), followed by the remaining lanes
+struct CompressTable {
+    alignas(32) int indices[256][8];
+
+    CompressTable() {
+        for (int m = 0; m < 256; m++) {
+            int k = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if (m & (1 << lane)) indices[m][k++] = lane;
+            }
+            for (int lane = 0; lane < 8; lane++) {
+                if (!(m & (1 << lane))) indices[m][k++] = lane;
+            }
+        }
+    }
+};
+
+inline const CompressTable& compressTable() {
+    static const CompressTable table;
+    return table;
+}
+
+// One compare-exchange stage between lanes at distance j < 8 within a
+// vector whose first element sits at index base of a bitonic sequence of
+// block size k
+__attribute__((target("avx2")))
+inline __m256i bitonicLaneStageAvx2(__m256i v, int base, int j, int k) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i partner = _mm256_permutevar8x32_epi32(v, _mm256_xor_si256(lanes, _mm256_set1_epi32(j)));
+    __m256i mn = _mm256_min_epi32(v, partner);
+    __m256i mx = _mm256_max_epi32(v, partner);
+    __m256i lowLane = _mm256_cmpeq_epi32(_mm256_and_si256(lanes, _mm256_set1_epi32(j)), zero);
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(base), lanes);
+    __m256i ascending = _mm256_cmpeq_epi32(_mm256_and_si256(index, _mm256_set1_epi32(k)), zero);
+    __m256i takeMin = _mm256_cmpeq_epi32(lowLane, ascending);
+    return _mm256_blendv_epi8(mx, mn, takeMin);
+}
+
+__attribute__((target("avx2")))
+inline void sortSmallAvx2(int* a, int n) {
+    if (n <= 8) {
+        sortSmallScalar(a, n);
+        return;
+    }
+
+    int size = 16;
+    while (size < n) size <<= 1;
+    int vectors = size / 8;
+
+    alignas(32) int buffer[SMALL_SORT_LIMIT];
+    memcpy(buffer, a, n * sizeof(int));
+    for (int i = n; i < size; i++) buffer[i] = INT_MAX;
+
+    __m256i v[SMALL_SORT_LIMIT / 8];
+    for (int i = 0; i < vectors; i++) {
+        v[i] = _mm256_load_si256((const __m256i*)(buffer + 8 * i));
+    }
+
+    for (int k = 2; k <= size; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+            if (j >= 8) {
+                // Compare-exchange whole vectors; direction is uniform per vector
+                int stride = j / 8;
+                for (int i = 0; i < vectors; i++) {
+                    if (i & stride) continue;
+                    __m256i mn = _mm256_min_epi32(v[i], v[i + stride]);
+                    __m256i mx = _mm256_max_epi32(v[i], v[i + stride]);
+                    bool ascending = ((8 * i) & k) == 0;
+                    v[i] = ascending ? mn : mx;
+                    v[i + stride] = ascending ? mx : mn;
+                }
+            } else {
+                for (int i = 0; i < vectors; i++) {
+                    v[i] = bitonicLaneStageAvx2(v[i], 8 * i, j, k);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < vectors; i++) {
+        _mm256_store_si256((__m256i*)(buffer + 8 * i), v[i]);
+    }
+    memcpy(a, buffer, n * sizeof(int));
+}
+
+// Merge two sorted vectors: lo receives the 8 smallest, hi the 8 largest
+__attribute__((target("avx2")))
+inline void bitonicMerge16Avx2(__m256i& lo, __m256i& hi) {
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i reversed = _mm256_permutevar8x32_epi32(hi, reverse);
+    __m256i mn = _mm256_min_epi32(lo, reversed);
+    __m256i mx = _mm256_max_epi32(lo, reversed);
+    for (int j = 4; j > 0; j >>= 1) {
+        // k = 16 keeps every lane ascending within each half
+        mn = bitonicLaneStageAvx2(mn, 0, j, 16);
+        mx = bitonicLaneStageAvx2(mx, 0, j, 16);
+    }
+    lo = mn;
+    hi = mx;
+}
+
+__attribute__((target("avx2")))
+inline void mergeAvx2(const int* a, int na, const int* b, int nb, int* out) {
+    if (na < 8 || nb < 8) {
+        mergeScalar(a, na, b, nb, out);
+        return;
+    }
+
+    __m256i lo = _mm256_loadu_si256((const __m256i*)a);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)b);
+    int i = 8, j = 8;
+
+    while (true) {
+        bitonicMerge16Avx2(lo, hi);
+        _mm256_storeu_si256((__m256i*)out, lo);
+        out += 8;
+
+        // The next block must come from the run with the smaller head
+        bool takeA = j >= nb || (i < na && a[i] <= b[j]);
+        if (takeA && i + 8 <= na) {
+            lo = _mm256_loadu_si256((const __m256i*)(a + i));
+            i += 8;
+        } else if (!takeA && j + 8 <= nb) {
+            lo = _mm256_loadu_si256((const __m256i*)(b + j));
+            j += 8;
+        } else {
+            break;
+        }
+    }
+
+    // Finish with the 8 pending values and the remaining tails
+    alignas(32) int pending[8];
+    _mm256_store_si256((__m256i*)pending, hi);
+    if (i + 8 > na) {
+        int merged[16];
+        mergeScalar(pending, 8, a + i, na - i, merged);
+        mergeScalar(merged, 8 + na - i, b + j, nb - j, out);
+    } else {
+        int merged[16];
+        mergeScalar(pending, 8, b + j, nb - j, merged);
+        mergeScalar(merged, 8 + nb - j, a + i, na - i, out);
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+inline int partitionAvx2(int* a, int n, int pivot, int* scratch) {
+    const CompressTable& table = compressTable();
+    const __m256i pivotVector = _mm256_set1_epi32(pivot);
+    int left = 0, greater = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivotVector, v)));
+        __m256i lessFirst = _mm256_load_si256((const __m256i*)table.indices[mask]);
+        __m256i greaterFirst = _mm256_load_si256((const __m256i*)table.indices[~mask & 0xFF]);
+        // Writes never pass the block just loaded, since left <= i
+        _mm256_storeu_si256((__m256i*)(a + left), _mm256_permutevar8x32_epi32(v, lessFirst));
+        _mm256_storeu_si256((__m256i*)(scratch + greater), _mm256_permutevar8x32_epi32(v, greaterFirst));
+        int count = _mm_popcnt_u32(mask);
+        left += count;
+        greater += 8 - count;
+    }
+
+    for (; i < n; i++) {
+        int x = a[i];
+        bool less = x < pivot;
+        a[left] = x;
+        scratch[greater] = x;
+        left += less;
+        greater += !less;
+    }
+
+    memcpy(a + left, scratch, greater * sizeof(int));
+    return left;
+}
+
+#endif // SIMD_SORT_AVX2
+
+// ---------------------------------------------------------------------------
+// WASM SIMD128 kernels (4 x int32 lanes)
+
+#ifdef SIMD_SORT_WASM
+
+inline v128_t bitonicLaneStageWasm(v128_t v, int base, int j, int k) {
+    const v128_t lanes = wasm_i32x4_make(0, 1, 2, 3);
+    const v128_t zero = wasm_i32x4_splat(0);
+    v128_t partner = j == 1 ? wasm_i32x4_shuffle(v, v, 1, 0, 3, 2) : wasm_i32x4_shuffle(v, v, 2, 3, 0, 1);
+    v128_t mn = wasm_i32x4_min(v, partner);
+    v128_t mx = wasm_i32x4_max(v, partner);
+    v128_t lowLane = wasm_i32x4_eq(wasm_v128_and(lanes, wasm_i32x4_splat(j)), zero);
+    v128_t index = wasm_i32x4_add(wasm_i32x4_splat(base), lanes);
+    v128_t ascending = wasm_i32x4_eq(wasm_v128_and(index, wasm_i32x4_splat(k)), zero);
+    v128_t takeMin = wasm_i32x4_eq(lowLane, ascending);
+    return wasm_v128_bitselect(mn, mx, takeMin);
+}
+
+inline void sortSmallWasm(int* a, int n) {
+    if (n <= 8) {
+        sortSmallScalar(a, n);
+        return;
+    }
+
+    int size = 16;
+    while (size < n) size <<= 1;
+    int vectors = size / 4;
+
+    alignas(16) int buffer[SMALL_SORT_LIMIT];
+    memcpy(buffer, a, n * sizeof(int));
+    for (int i = n; i < size; i++) buffer[i] = INT_MAX;
+
+    v128_t v[SMALL_SORT_LIMIT / 4];
+    for (int i = 0; i < vectors; i++) {
+        v[i] = wasm_v128_load(buffer + 4 * i);
+    }
+
+    for (int k = 2; k <= size; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+            if (j >= 4) {
+                int stride = j / 4;
+                for (int i = 0; i < vectors; i++) {
+                    if (i & stride) continue;
+                    v128_t mn = wasm_i32x4_min(v[i], v[i + stride]);
+                    v128_t mx = wasm_i32x4_max(v[i], v[i + stride]);
+                    bool ascending = ((4 * i) & k) == 0;
+                    v[i] = ascending ? mn : mx;
+                    v[i + stride] = ascending ? mx : mn;
+                }
+            } else {
+                for (int i = 0; i < vectors; i++) {
+                    v[i] = bitonicLaneStageWasm(v[i], 4 * i, j, k);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < vectors; i++) {
+        wasm_v128_store(buffer + 4 * i, v[i]);
+    }
+    memcpy(a, buffer, n * sizeof(int));
+}
+
+inline void bitonicMerge8Wasm(v128_t& lo, v128_t& hi) {
+    v128_t reversed = wasm_i32x4_shuffle(hi, hi, 3, 2, 1, 0);
+    v128_t mn = wasm_i32x4_min(lo, reversed);
+    v128_t mx = wasm_i32x4_max(lo, reversed);
+    for (int j = 2; j > 0; j >>= 1) {
+        mn = bitonicLaneStageWasm(mn, 0, j, 8);
+        mx = bitonicLaneStageWasm(mx, 0, j, 8);
+    }
+    lo = mn;
+    hi = mx;
+}
+
+inline void mergeWasm(const int* a, int na, const int* b, int nb, int* out) {
+    if (na < 4 || nb < 4) {
+        mergeScalar(a, na, b, nb, out);
+        return;
+    }
+
+    v128_t lo = wasm_v128_load(a);
+    v128_t hi = wasm_v128_load(b);
+    int i = 4, j = 4;
+
+    while (true) {
+        bitonicMerge8Wasm(lo, hi);
+        wasm_v128_store(out, lo);
+        out += 4;
+
+        bool takeA = j >= nb || (i < na && a[i] <= b[j]);
+        if (takeA && i + 4 <= na) {
+            lo = wasm_v128_load(a + i);
+            i += 4;
+        } else if (!takeA && j + 4 <= nb) {
+            lo = wasm_v128_load(b + j);
+            j += 4;
+        } else {
+            break;
+        }
+    }
+
+    alignas(16) int pending[4];
+    wasm_v128_store(pending, hi);
+    int merged[8];
+    if (i + 4 > na) {
+        mergeScalar(pending, 4, a + i, na - i, merged);
+        mergeScalar(merged, 4 + na - i, b + j, nb - j, out);
+    } else {
+        mergeScalar(pending, 4, b + j, nb - j, merged);
+        mergeScalar(merged, 4 + nb - j, a + i, na - i, out);
+    }
+}
+
+// Byte shuffle table for compress-store over 4 lanes
+struct CompressTableWasm {
+    alignas(16) unsigned char bytes[16][16];
+
+    CompressTableWasm() {
+        for (int m = 0; m < 16; m++) {
+            int k = 0;
+            for (int pass = 0; pass < 2; pass++) {
+                for (int lane = 0; lane < 4; lane++) {
+                    bool selected = (m & (1 << lane)) != 0;
+                    if (selected != (pass == 0)) continue;
+                    for (int byte = 0; byte < 4; byte++) {
+                        bytes[m][4 * k + byte] = 4 * lane + byte;
+                    }
+                    k++;
+                }
+            }
+        }
+    }
+};
+
+inline int partitionWasm(int* a, int n, int pivot, int* scratch) {
+    static const CompressTableWasm table;
+    const v128_t pivotVector = wasm_i32x4_splat(pivot);
+    int left = 0, greater = 0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        v128_t v = wasm_v128_load(a + i);
+        int mask = wasm_i32x4_bitmask(wasm_i32x4_lt(v, pivotVector));
+        v128_t lessFirst = wasm_i8x16_swizzle(v, wasm_v128_load(table.bytes[mask]));
+        v128_t greaterFirst = wasm_i8x16_swizzle(v, wasm_v128_load(table.bytes[~mask & 0xF]));
+        wasm_v128_store(a + left, lessFirst);
+        wasm_v128_store(scratch + greater, greaterFirst);
+        int count = __builtin_popcount(mask);
+        left += count;
+        greater += 4 - count;
+    }
+
+    for (; i < n; i++) {
+        int x = a[i];
+        bool less = x < pivot;
+        a[left] = x;
+        scratch[greater] = x;
+        left += less;
+        greater += !less;
+    }
+
+    memcpy(a + left, scratch, greater * sizeof(int));
+    return left;
+}
+
+#endif // SIMD_SORT_WASM
+
+// ---------------------------------------------------------------------------
+// Kernel selection
+
+struct Kernels {
+    void (*sortSmall)(int* a, int n);
+    void (*merge)(const int* a, int na, const int* b, int nb, int* out);
+    int (*partition)(int* a, int n, int pivot, int* scratch);
+    const char* name;
+};
+
+inline Kernels selectKernels() {
+#if defined(SIMD_SORT_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return {sortSmallAvx2, mergeAvx2, partitionAvx2, "avx2"};
+    }
+#elif defined(SIMD_SORT_WASM)
+    return {sortSmallWasm, mergeWasm, partitionWasm, "simd128"};
+#endif
+    return {sortSmallScalar, mergeScalar, partitionScalar, "scalar"};
+}
+
+// Kernels chosen once for the running CPU
+inline const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+// ---------------------------------------------------------------------------
+// Complete sorts
+
+// Median of first, middle and last element
+inline int medianOfThree(const int* a, int n) {
+    int x = a[0], y = a[n / 2], z = a[n - 1];
+    return std::max(std::min(x, y), std::min(std::max(x, y), z));
+}
+
+// Three-way quicksort: two vectorized partitions split each range into
+// < pivot, == pivot and > pivot, so heavy duplicates stay O(n log n)
+inline void quickSortRange(int* a, int n, int* scratch, const Kernels& k) {
+    while (n > SMALL_SORT_LIMIT) {
+        int pivot = medianOfThree(a, n);
+        int less = k.partition(a, n, pivot, scratch);
+        int equal = pivot == INT_MAX
+            ? n - less
+            : k.partition(a + less, n - less, pivot + 1, scratch);
+        int* greaterStart = a + less + equal;
+        int greater = n - less - equal;
+
+        // Recurse into the smaller side, loop on the larger one
+        if (less < greater) {
+            quickSortRange(a, less, scratch, k);
+            a = greaterStart;
+            n = greater;
+        } else {
+            quickSortRange(greaterStart, greater, scratch, k);
+            n = less;
+        }
+    }
+    k.sortSmall(a, n);
+}
+
+inline void quickSort(int* a, int n) {
+    if (n < 2) return;
+    std::vector<int> scratch(n + 8);
+    quickSortRange(a, n, scratch.data(), kernels());
+}
+
+// Bottom-up merge sort: sort small blocks, then merge passes that
+// ping-pong between the array and a buffer
+inline void mergeSort(int* a, int n) {
+    if (n < 2) return;
+    const Kernels& k = kernels();
+
+    for (int start = 0; start < n; start += SMALL_SORT_LIMIT) {
+        k.sortSmall(a + start, std::min(SMALL_SORT_LIMIT, n - start));
+    }
+
+    std::vector<int> buffer(n);
+    int* from = a;
+    int* to = buffer.data();
+    for (int width = SMALL_SORT_LIMIT; width < n; width *= 2) {
+        for (int left = 0; left < n; left += 2 * width) {
+            int mid = std::min(left + width, n);
+            int right = std::min(left + 2 * width, n);
+            k.merge(from + left, mid - left, from + mid, right - mid, to + left);
+        }
+        std::swap(from, to);
+    }
+    if (from != a) {
+        memcpy(a, from, n * sizeof(int));
+    }
+}
+
+} // namespace simd
+
+#endif // SIMD_SORT_H
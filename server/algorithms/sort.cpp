@@ -5,135 +5,347 @@
 #include <string>
 #include <algorithm>
 #include <random>
-#include <emscripten/bind.h>
-#include <emscripten/emscripten.h>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include "wasm_compat.h"
+#include "trace_policy.h"
+#include "simd_sort.h"
+#include "parallel_sort.h"
+#include "radix_sort.h"
+#include "step_buffer.h"
+#include "step_generator.h"
+#include "step_message.h"
+#include "visual_state.h"
+#include "task_pool.h"
 
 using namespace std;
+#ifdef __EMSCRIPTEN__
 using namespace emscripten;
+#endif
 
-// Array element visualization
-struct ArrayElement {
-    int id;
-    int value;
-    double x;
-    double y;
-    bool highlighted;
+// Module internals get internal linkage so the four modules can be linked
+// into one native binary without clashing type names
+namespace {
+
+// Array mutation recorded in the trace (swap i,j or write k=v)
+struct ArrayOperation {
+    enum Kind : unsigned char { Swap, Write };
+    Kind kind;
+    int index;
+    int operand; // Second index for Swap, value for Write
+};
+
+// Step message templates (see step_message.h)
+enum SortMessage : uint16_t {
+    SORT_INITIAL,
+    SORT_DONE,
+    SORT_SEGMENT,
+    SORT_PIVOT,
+    SORT_COMPARE_PIVOT,
+    SORT_SWAP,
+    SORT_AFTER_SWAP,
+    SORT_SWAP_PIVOT,
+    SORT_PIVOT_PLACED,
+    SORT_COPY_TEMP,
+    SORT_COMPARE,
+    SORT_PLACE,
+    SORT_COPY_LEFT,
+    SORT_COPY_RIGHT,
+    SORT_SPLIT,
+    SORT_HEAPIFY,
+    SORT_COMPARE_LEFT,
+    SORT_COMPARE_RIGHT,
+    SORT_BUILD_HEAP,
+    SORT_HEAP_BUILT,
+    SORT_MOVE_ROOT,
+    SORT_REHEAPIFY,
+    SORT_RADIX_PLAN,
+    SORT_RADIX_HISTOGRAM,
+    SORT_RADIX_SKIPPED,
+    SORT_RADIX_DIGIT,
+    SORT_RADIX_PASS_DONE,
+    SORT_MESSAGE_COUNT
+};
+
+const char* const SORT_MESSAGES[] = {
+    "Initial array for {t}",
+    "Array sorted with {t}",
+    "Sorting segment [{0} to {1}]",
+    "Pivot: {0} (index {1})",
+    "Compare {0} with pivot {1}",
+    "Swap {0} and {1}",
+    "After swap",
+    "Swap {0} and pivot {1}",
+    "After placing pivot at position {0}",
+    "Copying elements to temporary arrays",
+    "Compare {0} and {1}",
+    "Place {0} at position {1}",
+    "Copy remaining element {0} from left array",
+    "Copy remaining element {0} from right array",
+    "Split into [{0} to {1}] and [{2} to {3}]",
+    "Heapifying subtree rooted at index {0}",
+    "Compare {0} with left child {1}",
+    "Compare {0} with right child {1}",
+    "Building heap (rearranging array)",
+    "Heap built successfully",
+    "Move root {0} to end",
+    "After moving root, re-heapify remaining heap",
+    "Sorting by {0}-bit digits of value - {1} in {2} pass(es)",
+    "Pass {0} histogram:{t}",
+    "Pass {0} skipped: all values share one digit",
+    "Digit {0} of {1}: goes to position {2}",
+    "After pass {0}"
+};
+static_assert(sizeof(SORT_MESSAGES) / sizeof(SORT_MESSAGES[0]) == SORT_MESSAGE_COUNT, "one template per message");
+
+// Compact record of one visualization step
+struct StepRecord {
+    int operationEnd; // Number of operations applied when this step is shown
+    int highlight1;
+    int highlight2;
     bool swapping;
+    StepMessage message;
 };
 
-// Structure to hold algorithm state
-struct AlgorithmState {
-    vector<ArrayElement> elements;
-    string message;
-    int step;
-    int totalSteps;
+// Delta-encoded trace: an operation log plus periodic full keyframes.
+// Any step is rebuilt by replaying the log from the nearest keyframe.
+class SortTrace {
+private:
+    static constexpr int MIN_KEYFRAME_INTERVAL = 256;
+
+    vector<ArrayOperation> operations;
+    vector<StepRecord> steps;
+    vector<vector<int>> keyframes; // keyframes[k] is the array after k * keyframeInterval operations
+    int keyframeInterval; // 0 for a segment, which keeps no keyframes until appended
+
+    void recordOperation(const vector<int>& arr, ArrayOperation op) {
+        operations.push_back(op);
+        if (keyframeInterval > 0 && operations.size() % keyframeInterval == 0) {
+            keyframes.push_back(arr);
+        }
+    }
+
+public:
+    SortTrace() : keyframeInterval(0) {}
+
+    // Drop all recorded steps
+    void clear() {
+        operations.clear();
+        steps.clear();
+        keyframes.clear();
+    }
+
+    // Start a new trace from the given initial array
+    void reset(const vector<int>& arr) {
+        clear();
+        // One keyframe per n operations keeps keyframe memory on par with the log
+        keyframeInterval = max(MIN_KEYFRAME_INTERVAL, (int)arr.size());
+        keyframes.push_back(arr);
+    }
+
+    // Swap two elements and record the operation
+    void swapElements(vector<int>& arr, int i, int j) {
+        swap(arr[i], arr[j]);
+        recordOperation(arr, {ArrayOperation::Swap, i, j});
+    }
+
+    // Write a value and record the operation
+    void writeElement(vector<int>& arr, int k, int value) {
+        arr[k] = value;
+        recordOperation(arr, {ArrayOperation::Write, k, value});
+    }
+
+    // Record a step showing the array after all operations so far
+    void addStep(StepMessage message, int highlight1 = -1, int highlight2 = -1, bool swapping = false) {
+        steps.push_back({(int)operations.size(), highlight1, highlight2, swapping, move(message)});
+    }
+
+    // Record a step yielded by a step generator
+    void addStep(StepRecord&& record) {
+        record.operationEnd = operations.size();
+        steps.push_back(move(record));
+    }
+
+    // Append the steps of a segment recorded from the array state replay
+    // holds now; replay is advanced past the segment's operations
+    void appendSegment(SortTrace& segment, vector<int>& replay) {
+        int base = operations.size();
+        for (const ArrayOperation& op : segment.operations) {
+            if (op.kind == ArrayOperation::Swap) {
+                swap(replay[op.index], replay[op.operand]);
+            } else {
+                replay[op.index] = op.operand;
+            }
+            recordOperation(replay, op);
+        }
+        for (StepRecord& step : segment.steps) {
+            step.operationEnd += base;
+            steps.push_back(move(step));
+        }
+        segment.clear();
+    }
+
+    int size() const {
+        return steps.size();
+    }
+
+    const StepRecord& stepRecord(int step) const {
+        return steps[step];
+    }
+
+    // Rebuild the array as it looked at the given step
+    vector<int> arrayAt(int step) const {
+        int target = steps[step].operationEnd;
+        int keyframe = target / keyframeInterval;
+        vector<int> arr = keyframes[keyframe];
+        
+        for (int k = keyframe * keyframeInterval; k < target; k++) {
+            const ArrayOperation& op = operations[k];
+            if (op.kind == ArrayOperation::Swap) {
+                swap(arr[op.index], arr[op.operand]);
+            } else {
+                arr[op.index] = op.operand;
+            }
+        }
+        return arr;
+    }
+
+    // Visit steps [first, first + count) with the array of each, replaying
+    // the log once across the window instead of once per step
+    template <class Visitor>
+    void forEachStep(int first, int count, Visitor visit) const {
+        if (count <= 0) return;
+        vector<int> arr = arrayAt(first);
+        int applied = steps[first].operationEnd;
+        for (int step = first; step < first + count; step++) {
+            for (; applied < steps[step].operationEnd; applied++) {
+                const ArrayOperation& op = operations[applied];
+                if (op.kind == ArrayOperation::Swap) {
+                    swap(arr[op.index], arr[op.operand]);
+                } else {
+                    arr[op.index] = op.operand;
+                }
+            }
+            visit(step, steps[step], arr);
+        }
+    }
 };
 
-// Sorting algorithms class
-class SortingAlgorithms {
+// Step generators for the traced sorts. Each sort is a coroutine that
+// yields its steps one at a time and logs its array mutations into the
+// trace it was given, so parallel tasks can each fill a segment of their
+// own and lazy traces can move on to a new chunk between steps.
+class SortStepRecorder {
 private:
-    vector<AlgorithmState> states;
-    int currentStep;
-    int totalSteps;
+    SortTrace* trace;
+
+    // Steps get their operationEnd when the trace records them
+    static StepRecord step(StepMessage message, int highlight1 = -1, int highlight2 = -1, bool swapping = false) {
+        return {0, highlight1, highlight2, swapping, move(message)};
+    }
+
+public:
+    explicit SortStepRecorder(SortTrace* initialTrace) : trace(initialTrace) {}
     
-    // Helper function to create array visualization
-    void createArrayVisualization(vector<ArrayElement>& elements, const vector<int>& arr, 
-                                 int highlight1 = -1, int highlight2 = -1, bool swapping = false) {
-        elements.clear();
-        const int barWidth = 40;
-        const int barSpacing = 10;
-        const int startX = 50;
-        const int baseY = 300;
-        const double heightScale = 2.0; // Scale factor for bar height
-        
-        for (int i = 0; i < arr.size(); i++) {
-            ArrayElement element;
-            element.id = i;
-            element.value = arr[i];
-            element.x = startX + i * (barWidth + barSpacing);
-            element.y = baseY - arr[i] * heightScale; // Height based on value
-            element.highlighted = (i == highlight1 || i == highlight2);
-            element.swapping = swapping && (i == highlight1 || i == highlight2);
-            elements.push_back(element);
+    // Log subsequent array mutations into another trace
+    void setTrace(SortTrace* newTrace) {
+        trace = newTrace;
+    }
+    
+    // Array mutations are logged whenever any steps are recorded. Detailed
+    // steps (compare, swap) are only yielded when Trace::recordsSteps,
+    // phase steps (segment, merge, heap built) when Trace::recordsPhases.
+    template <class Trace>
+    void swapElements(vector<int>& arr, int i, int j) {
+        if constexpr (Trace::recordsPhases) {
+            trace->swapElements(arr, i, j);
+        } else {
+            swap(arr[i], arr[j]);
         }
     }
     
-    // Generate steps for QuickSort
-    void quickSortSteps(vector<int>& arr, int low, int high) {
-        if (low < high) {
-            // Create a state for the current segment
-            AlgorithmState segmentState;
-            segmentState.step = states.size() + 1;
-            segmentState.message = "Sorting segment [" + to_string(low) + " to " + to_string(high) + "]";
-            createArrayVisualization(segmentState.elements, arr, low, high);
-            states.push_back(segmentState);
-            
-            // Partition the array
-            int pivot = arr[high];
-            int i = low - 1;
-            
-            // Create a state for the pivot selection
-            AlgorithmState pivotState;
-            pivotState.step = states.size() + 1;
-            pivotState.message = "Pivot: " + to_string(pivot) + " (index " + to_string(high) + ")";
-            createArrayVisualization(pivotState.elements, arr, high);
-            states.push_back(pivotState);
+    template <class Trace>
+    void writeElement(vector<int>& arr, int k, int value) {
+        if constexpr (Trace::recordsPhases) {
+            trace->writeElement(arr, k, value);
+        } else {
+            arr[k] = value;
+        }
+    }
+    
+    // Partition arr[low..high] (low < high) around arr[high]; the pivot's
+    // final position is stored in pivotIndex
+    template <class Trace>
+    StepGenerator<StepRecord> partitionSteps(vector<int>& arr, int low, int high, int& pivotIndex) {
+        // Create a state for the current segment
+        if constexpr (Trace::recordsPhases) {
+            co_yield step({SORT_SEGMENT, low, high}, low, high);
+        }
+        
+        // Partition the array
+        int pivot = arr[high];
+        int i = low - 1;
+        
+        // Create a state for the pivot selection
+        if constexpr (Trace::recordsSteps) {
+            co_yield step({SORT_PIVOT, pivot, high}, high);
+        }
+        
+        for (int j = low; j <= high - 1; j++) {
+            // Create a state for comparing with pivot
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_COMPARE_PIVOT, arr[j], pivot}, j, high);
+            }
             
-            for (int j = low; j <= high - 1; j++) {
-                // Create a state for comparing with pivot
-                AlgorithmState compareState;
-                compareState.step = states.size() + 1;
-                compareState.message = "Compare " + to_string(arr[j]) + " with pivot " + to_string(pivot);
-                createArrayVisualization(compareState.elements, arr, j, high);
-                states.push_back(compareState);
+            if (arr[j] < pivot) {
+                i++;
                 
-                if (arr[j] < pivot) {
-                    i++;
-                    
-                    // Create a state for swapping
-                    AlgorithmState swapState;
-                    swapState.step = states.size() + 1;
-                    swapState.message = "Swap " + to_string(arr[i]) + " and " + to_string(arr[j]);
-                    createArrayVisualization(swapState.elements, arr, i, j, true);
-                    states.push_back(swapState);
-                    
-                    // Perform the swap
-                    swap(arr[i], arr[j]);
-                    
-                    // Create a state after swapping
-                    AlgorithmState afterSwapState;
-                    afterSwapState.step = states.size() + 1;
-                    afterSwapState.message = "After swap";
-                    createArrayVisualization(afterSwapState.elements, arr, i, j);
-                    states.push_back(afterSwapState);
+                // Create a state for swapping
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_SWAP, arr[i], arr[j]}, i, j, true);
+                }
+                
+                // Perform the swap
+                swapElements<Trace>(arr, i, j);
+                
+                // Create a state after swapping
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step(SORT_AFTER_SWAP, i, j);
                 }
             }
-            
-            // Swap arr[i+1] and arr[high] (the pivot)
-            AlgorithmState swapPivotState;
-            swapPivotState.step = states.size() + 1;
-            swapPivotState.message = "Swap " + to_string(arr[i+1]) + " and pivot " + to_string(arr[high]);
-            createArrayVisualization(swapPivotState.elements, arr, i+1, high, true);
-            states.push_back(swapPivotState);
-            
-            swap(arr[i+1], arr[high]);
-            
-            AlgorithmState afterPivotState;
-            afterPivotState.step = states.size() + 1;
-            afterPivotState.message = "After placing pivot at position " + to_string(i+1);
-            createArrayVisualization(afterPivotState.elements, arr, i+1);
-            states.push_back(afterPivotState);
-            
-            int pi = i + 1;
+        }
+        
+        // Swap arr[i+1] and arr[high] (the pivot)
+        if constexpr (Trace::recordsSteps) {
+            co_yield step({SORT_SWAP_PIVOT, arr[i+1], arr[high]}, i+1, high, true);
+        }
+        
+        swapElements<Trace>(arr, i+1, high);
+        
+        if constexpr (Trace::recordsPhases) {
+            co_yield step({SORT_PIVOT_PLACED, i+1}, i+1);
+        }
+        
+        pivotIndex = i + 1;
+    }
+    
+    // Generate steps for QuickSort
+    template <class Trace>
+    StepGenerator<StepRecord> quickSortSteps(vector<int>& arr, int low, int high) {
+        if (low < high) {
+            int pi;
+            co_yield partitionSteps<Trace>(arr, low, high, pi);
             
             // Recursively sort the sub-arrays
-            quickSortSteps(arr, low, pi - 1);
-            quickSortSteps(arr, pi + 1, high);
+            co_yield quickSortSteps<Trace>(arr, low, pi - 1);
+            co_yield quickSortSteps<Trace>(arr, pi + 1, high);
         }
     }
     
     // Helper for merge sort
-    void mergeSteps(vector<int>& arr, int left, int mid, int right) {
+    template <class Trace>
+    StepGenerator<StepRecord> mergeSteps(vector<int>& arr, int left, int mid, int right) {
         int n1 = mid - left + 1;
         int n2 = right - mid;
         
@@ -141,11 +353,9 @@ private:
         vector<int> L(n1), R(n2);
         
         // Create a state for copying to temp arrays
-        AlgorithmState copyState;
-        copyState.step = states.size() + 1;
-        copyState.message = "Copying elements to temporary arrays";
-        createArrayVisualization(copyState.elements, arr, left, right);
-        states.push_back(copyState);
+        if constexpr (Trace::recordsPhases) {
+            co_yield step(SORT_COPY_TEMP, left, right);
+        }
         
         // Copy data to temp arrays L[] and R[]
         for (int i = 0; i < n1; i++)
@@ -158,29 +368,23 @@ private:
         
         while (i < n1 && j < n2) {
             // Create a state for comparing elements
-            AlgorithmState compareState;
-            compareState.step = states.size() + 1;
-            compareState.message = "Compare " + to_string(L[i]) + " and " + to_string(R[j]);
-            createArrayVisualization(compareState.elements, arr, left + i, mid + 1 + j);
-            states.push_back(compareState);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_COMPARE, L[i], R[j]}, left + i, mid + 1 + j);
+            }
             
             if (L[i] <= R[j]) {
                 // Create a state for placing element from L
-                AlgorithmState placeState;
-                placeState.step = states.size() + 1;
-                placeState.message = "Place " + to_string(L[i]) + " at position " + to_string(k);
-                arr[k] = L[i];
-                createArrayVisualization(placeState.elements, arr, k);
-                states.push_back(placeState);
+                writeElement<Trace>(arr, k, L[i]);
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_PLACE, L[i], k}, k);
+                }
                 i++;
             } else {
                 // Create a state for placing element from R
-                AlgorithmState placeState;
-                placeState.step = states.size() + 1;
-                placeState.message = "Place " + to_string(R[j]) + " at position " + to_string(k);
-                arr[k] = R[j];
-                createArrayVisualization(placeState.elements, arr, k);
-                states.push_back(placeState);
+                writeElement<Trace>(arr, k, R[j]);
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_PLACE, R[j], k}, k);
+                }
                 j++;
             }
             k++;
@@ -189,12 +393,10 @@ private:
         // Copy remaining elements of L[]
         while (i < n1) {
             // Create a state for copying remaining elements
-            AlgorithmState copyRemState;
-            copyRemState.step = states.size() + 1;
-            copyRemState.message = "Copy remaining element " + to_string(L[i]) + " from left array";
-            arr[k] = L[i];
-            createArrayVisualization(copyRemState.elements, arr, k);
-            states.push_back(copyRemState);
+            writeElement<Trace>(arr, k, L[i]);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_COPY_LEFT, L[i]}, k);
+            }
             i++;
             k++;
         }
@@ -202,249 +404,529 @@ private:
         // Copy remaining elements of R[]
         while (j < n2) {
             // Create a state for copying remaining elements
-            AlgorithmState copyRemState;
-            copyRemState.step = states.size() + 1;
-            copyRemState.message = "Copy remaining element " + to_string(R[j]) + " from right array";
-            arr[k] = R[j];
-            createArrayVisualization(copyRemState.elements, arr, k);
-            states.push_back(copyRemState);
+            writeElement<Trace>(arr, k, R[j]);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_COPY_RIGHT, R[j]}, k);
+            }
             j++;
             k++;
         }
     }
     
+    // Split arr[left..right] (left < right); the middle is stored in mid
+    template <class Trace>
+    StepGenerator<StepRecord> splitSteps(int left, int right, int& mid) {
+        // Create a state for the current segment
+        if constexpr (Trace::recordsPhases) {
+            co_yield step({SORT_SEGMENT, left, right}, left, right);
+        }
+        
+        // Find the middle point
+        mid = left + (right - left) / 2;
+        
+        // Create a state for splitting
+        if constexpr (Trace::recordsPhases) {
+            co_yield step({SORT_SPLIT, left, mid, mid+1, right});
+        }
+    }
+    
     // Generate steps for MergeSort
-    void mergeSortSteps(vector<int>& arr, int left, int right) {
+    template <class Trace>
+    StepGenerator<StepRecord> mergeSortSteps(vector<int>& arr, int left, int right) {
         if (left < right) {
-            // Create a state for the current segment
-            AlgorithmState segmentState;
-            segmentState.step = states.size() + 1;
-            segmentState.message = "Sorting segment [" + to_string(left) + " to " + to_string(right) + "]";
-            createArrayVisualization(segmentState.elements, arr, left, right);
-            states.push_back(segmentState);
-            
-            // Find the middle point
-            int mid = left + (right - left) / 2;
-            
-            // Create a state for splitting
-            AlgorithmState splitState;
-            splitState.step = states.size() + 1;
-            splitState.message = "Split into [" + to_string(left) + " to " + to_string(mid) + "] and [" +
-                               to_string(mid+1) + " to " + to_string(right) + "]";
-            createArrayVisualization(splitState.elements, arr);
-            states.push_back(splitState);
+            int mid;
+            co_yield splitSteps<Trace>(left, right, mid);
             
             // Recursively sort first and second halves
-            mergeSortSteps(arr, left, mid);
-            mergeSortSteps(arr, mid + 1, right);
+            co_yield mergeSortSteps<Trace>(arr, left, mid);
+            co_yield mergeSortSteps<Trace>(arr, mid + 1, right);
             
             // Merge the sorted halves
-            mergeSteps(arr, left, mid, right);
-        }
-    }
-    
-    // Helper for heapify
-    void heapifySteps(vector<int>& arr, int n, int i) {
-        int largest = i;
-        int left = 2 * i + 1;
-        int right = 2 * i + 2;
-        
-        // Create a state for the current subtree
-        AlgorithmState subtreeState;
-        subtreeState.step = states.size() + 1;
-        subtreeState.message = "Heapifying subtree rooted at index " + to_string(i);
-        createArrayVisualization(subtreeState.elements, arr, i);
-        states.push_back(subtreeState);
-        
-        // If left child is larger than root
-        if (left < n) {
-            // Create a state for comparing with left child
-            AlgorithmState compareLeftState;
-            compareLeftState.step = states.size() + 1;
-            compareLeftState.message = "Compare " + to_string(arr[i]) + " with left child " + to_string(arr[left]);
-            createArrayVisualization(compareLeftState.elements, arr, i, left);
-            states.push_back(compareLeftState);
+            co_yield mergeSteps<Trace>(arr, left, mid, right);
+        }
+    }
+    
+    // Helper for heapify; sifts down iteratively, one level per round
+    template <class Trace>
+    StepGenerator<StepRecord> heapifySteps(vector<int>& arr, int n, int i) {
+        while (true) {
+            int largest = i;
+            int left = 2 * i + 1;
+            int right = 2 * i + 2;
             
-            if (arr[left] > arr[largest])
-                largest = left;
-        }
-        
-        // If right child is larger than largest so far
-        if (right < n) {
-            // Create a state for comparing with right child
-            AlgorithmState compareRightState;
-            compareRightState.step = states.size() + 1;
-            compareRightState.message = "Compare " + to_string(arr[largest]) + " with right child " + to_string(arr[right]);
-            createArrayVisualization(compareRightState.elements, arr, largest, right);
-            states.push_back(compareRightState);
+            // Create a state for the current subtree
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_HEAPIFY, i}, i);
+            }
+            
+            // If left child is larger than root
+            if (left < n) {
+                // Create a state for comparing with left child
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_COMPARE_LEFT, arr[i], arr[left]}, i, left);
+                }
+                
+                if (arr[left] > arr[largest])
+                    largest = left;
+            }
+            
+            // If right child is larger than largest so far
+            if (right < n) {
+                // Create a state for comparing with right child
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_COMPARE_RIGHT, arr[largest], arr[right]}, largest, right);
+                }
+                
+                if (arr[right] > arr[largest])
+                    largest = right;
+            }
+            
+            // Stop once the root is the largest
+            if (largest == i) {
+                break;
+            }
             
-            if (arr[right] > arr[largest])
-                largest = right;
-        }
-        
-        // If largest is not root
-        if (largest != i) {
             // Create a state for swapping
-            AlgorithmState swapState;
-            swapState.step = states.size() + 1;
-            swapState.message = "Swap " + to_string(arr[i]) + " and " + to_string(arr[largest]);
-            createArrayVisualization(swapState.elements, arr, i, largest, true);
-            states.push_back(swapState);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_SWAP, arr[i], arr[largest]}, i, largest, true);
+            }
             
-            swap(arr[i], arr[largest]);
+            swapElements<Trace>(arr, i, largest);
             
             // Create a state after swapping
-            AlgorithmState afterSwapState;
-            afterSwapState.step = states.size() + 1;
-            afterSwapState.message = "After swap";
-            createArrayVisualization(afterSwapState.elements, arr, i, largest);
-            states.push_back(afterSwapState);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step(SORT_AFTER_SWAP, i, largest);
+            }
             
-            // Recursively heapify the affected sub-tree
-            heapifySteps(arr, n, largest);
+            // Continue with the affected sub-tree
+            i = largest;
         }
     }
     
     // Generate steps for HeapSort
-    void heapSortSteps(vector<int>& arr) {
+    template <class Trace>
+    StepGenerator<StepRecord> heapSortSteps(vector<int>& arr) {
         int n = arr.size();
         
         // Create a state for the initial array
-        AlgorithmState initialState;
-        initialState.step = states.size() + 1;
-        initialState.message = "Building heap (rearranging array)";
-        createArrayVisualization(initialState.elements, arr);
-        states.push_back(initialState);
+        if constexpr (Trace::recordsPhases) {
+            co_yield step(SORT_BUILD_HEAP);
+        }
         
         // Build heap (rearrange array)
         for (int i = n / 2 - 1; i >= 0; i--)
-            heapifySteps(arr, n, i);
+            co_yield heapifySteps<Trace>(arr, n, i);
         
         // Create a state after building the heap
-        AlgorithmState heapState;
-        heapState.step = states.size() + 1;
-        heapState.message = "Heap built successfully";
-        createArrayVisualization(heapState.elements, arr);
-        states.push_back(heapState);
+        if constexpr (Trace::recordsPhases) {
+            co_yield step(SORT_HEAP_BUILT);
+        }
         
         // One by one extract an element from heap
         for (int i = n - 1; i > 0; i--) {
             // Create a state for extracting the root
-            AlgorithmState extractState;
-            extractState.step = states.size() + 1;
-            extractState.message = "Move root " + to_string(arr[0]) + " to end";
-            createArrayVisualization(extractState.elements, arr, 0, i, true);
-            states.push_back(extractState);
+            if constexpr (Trace::recordsSteps) {
+                co_yield step({SORT_MOVE_ROOT, arr[0]}, 0, i, true);
+            }
             
             // Move current root to end
-            swap(arr[0], arr[i]);
+            swapElements<Trace>(arr, 0, i);
             
             // Create a state after moving root
-            AlgorithmState afterMoveState;
-            afterMoveState.step = states.size() + 1;
-            afterMoveState.message = "After moving root, re-heapify remaining heap";
-            createArrayVisualization(afterMoveState.elements, arr, 0, i);
-            states.push_back(afterMoveState);
+            if constexpr (Trace::recordsPhases) {
+                co_yield step(SORT_REHEAPIFY, 0, i);
+            }
             
             // Call max heapify on the reduced heap
-            heapifySteps(arr, i, 0);
+            co_yield heapifySteps<Trace>(arr, i, 0);
+        }
+    }
+    
+    // Generate steps for RadixSort (LSD, see radix_sort.h)
+    template <class Trace>
+    StepGenerator<StepRecord> radixSortSteps(vector<int>& arr) {
+        int n = arr.size();
+        if (n < 2) co_return;
+        
+        radix::RadixPlan plan = radix::planSort(arr.data(), n);
+        int buckets = 1 << plan.digitBits;
+        
+        // Create a state for the chosen digit width
+        if constexpr (Trace::recordsPhases) {
+            co_yield step({SORT_RADIX_PLAN, plan.digitBits, (int)plan.base, plan.passes});
+        }
+        
+        vector<int> counts, offsets, output(n);
+        for (int pass = 0; pass < plan.passes; pass++) {
+            counts.assign(buckets, 0);
+            for (int value : arr)
+                counts[radix::digitOf(value, plan, pass)]++;
+            
+            // Create a state with the bucket histogram of this pass
+            if constexpr (Trace::recordsPhases) {
+                string histogram;
+                for (int d = 0; d < buckets; d++)
+                    if (counts[d] > 0) {
+                        histogram += ' ';
+                        histogram += to_string(d);
+                        histogram += '=';
+                        histogram += to_string(counts[d]);
+                    }
+                co_yield step(StepMessage::withText(SORT_RADIX_HISTOGRAM, make_shared<const string>(move(histogram)), pass + 1));
+            }
+            
+            if (radix::isTrivialPass(counts.data(), buckets, n)) {
+                if constexpr (Trace::recordsPhases) {
+                    co_yield step({SORT_RADIX_SKIPPED, pass + 1});
+                }
+                continue;
+            }
+            
+            // Scatter each value to the next free slot of its bucket
+            radix::bucketOffsets(counts.data(), buckets, offsets);
+            for (int i = 0; i < n; i++) {
+                int digit = radix::digitOf(arr[i], plan, pass);
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_RADIX_DIGIT, digit, arr[i], offsets[digit]}, i);
+                }
+                output[offsets[digit]++] = arr[i];
+            }
+            
+            // Copy the pass result back
+            for (int k = 0; k < n; k++) {
+                writeElement<Trace>(arr, k, output[k]);
+                if constexpr (Trace::recordsSteps) {
+                    co_yield step({SORT_PLACE, output[k], k}, k);
+                }
+            }
+            
+            if constexpr (Trace::recordsPhases) {
+                co_yield step({SORT_RADIX_PASS_DONE, pass + 1});
+            }
         }
     }
+};
 
-public:
-    SortingAlgorithms() : currentStep(0), totalSteps(0) {}
+// Record every step of a generator into the trace it logs its mutations to
+void recordSteps(SortTrace& trace, StepGenerator<StepRecord> steps) {
+    for (StepRecord& record : steps) {
+        trace.addStep(move(record));
+    }
+}
+
+// Steps recorded by one parallel task: its own steps, then the steps of
+// its forked children in sequential order, then the steps after the join
+struct TraceSegment {
+    SortTrace head;
+    unique_ptr<TraceSegment> left;
+    unique_ptr<TraceSegment> right;
+    SortTrace tail;
+};
+
+// Traced parallel sorts fork only ranges larger than this
+const int PARALLEL_TRACE_CUTOFF = 2048;
+
+// A lazily generated step: step index of a delta-encoded chunk of the
+// trace. Chunks hold LAZY_CHUNK_STEPS consecutive steps and are freed once
+// no step in the lazy window refers to them.
+struct LazySortStep {
+    shared_ptr<const SortTrace> chunk;
+    int index;
+
+    LazySortStep(shared_ptr<const SortTrace> c, int i) : chunk(move(c)), index(i) {}
+};
+
+const int LAZY_CHUNK_STEPS = 256;
+
+// Sorting algorithms class
+class SortingAlgorithms {
+private:
+    SortTrace trace;
+    LazySteps<LazySortStep> lazySteps;
+    int currentStep;
+    int totalSteps;
+    int lazyWindow; // Steps kept in memory by lazy traces, 0 for eager traces
+    bool parallelEnabled;
+    shared_ptr<const VisualLayout> arrayLayout; // Bars of the traced array
+    shared_ptr<const string> traceName; // Algorithm name shown by the first and last steps
     
-    // QuickSort driver
-    void quickSort(vector<int>& arr) {
-        states.clear();
+    // Bar positions of the traced array, shared by all of its steps
+    static shared_ptr<const VisualLayout> createArrayLayout(int size) {
+        const int barWidth = 40;
+        const int barSpacing = 10;
+        const int startX = 50;
+        const int baseY = 300;
+        const double heightScale = 2.0; // Scale factor for bar height
+        
+        auto layout = make_shared<VisualLayout>();
+        for (int i = 0; i < size; i++) {
+            layout->addElement(i, startX + i * (barWidth + barSpacing), baseY);
+        }
+        layout->yPerValue = -heightScale; // Height based on value
+        return layout;
+    }
+    
+    // Helper function to fill a state with the array's bars
+    void createArrayState(VisualState& state, const vector<int>& arr,
+                          int highlight1 = -1, int highlight2 = -1, bool swapping = false) const {
+        state.layout = arrayLayout;
+        state.values.assign(arr.begin(), arr.end());
+        state.flags.assign(arr.size(), 0);
+        uint8_t flag = swapping ? STEP_HIGHLIGHTED | STEP_SWAPPING : uint8_t(STEP_HIGHLIGHTED);
+        state.mark(highlight1, flag);
+        state.mark(highlight2, flag);
+    }
+    
+    // Parallel mode only pays off when the pool has threads to offer
+    bool runsParallel() const {
+        return parallelEnabled && TaskPool::shared().concurrency() > 1;
+    }
+    
+    // Parallel QuickSort steps: each task partitions its range into its own
+    // segment, then forks the left part and recurses into the right one
+    template <class Trace>
+    void parallelQuickSortSteps(vector<int>& arr, int low, int high, TraceSegment& segment) {
+        SortStepRecorder recorder(&segment.head);
+        if (high - low + 1 <= PARALLEL_TRACE_CUTOFF) {
+            recordSteps(segment.head, recorder.quickSortSteps<Trace>(arr, low, high));
+            return;
+        }
         
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.step = 1;
-        initialState.message = "Initial array for QuickSort";
-        createArrayVisualization(initialState.elements, arr);
-        states.push_back(initialState);
+        int pi;
+        recordSteps(segment.head, recorder.partitionSteps<Trace>(arr, low, high, pi));
+        segment.left.reset(new TraceSegment());
+        segment.right.reset(new TraceSegment());
         
-        // Call recursive function to generate steps
-        quickSortSteps(arr, 0, arr.size() - 1);
+        TaskGroup group(TaskPool::shared());
+        group.run([&] { parallelQuickSortSteps<Trace>(arr, low, pi - 1, *segment.left); });
+        parallelQuickSortSteps<Trace>(arr, pi + 1, high, *segment.right);
+        group.wait();
+    }
+    
+    // Parallel MergeSort steps: both halves are sorted by forked tasks and
+    // the merge is recorded into the segment's tail after the join
+    template <class Trace>
+    void parallelMergeSortSteps(vector<int>& arr, int left, int right, TraceSegment& segment) {
+        SortStepRecorder recorder(&segment.head);
+        if (right - left + 1 <= PARALLEL_TRACE_CUTOFF) {
+            recordSteps(segment.head, recorder.mergeSortSteps<Trace>(arr, left, right));
+            return;
+        }
         
-        // Final state
-        AlgorithmState finalState;
-        finalState.step = states.size() + 1;
-        finalState.message = "Array sorted with QuickSort";
-        createArrayVisualization(finalState.elements, arr);
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        int mid;
+        recordSteps(segment.head, recorder.splitSteps<Trace>(left, right, mid));
+        segment.left.reset(new TraceSegment());
+        segment.right.reset(new TraceSegment());
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        TaskGroup group(TaskPool::shared());
+        group.run([&] { parallelMergeSortSteps<Trace>(arr, left, mid, *segment.left); });
+        parallelMergeSortSteps<Trace>(arr, mid + 1, right, *segment.right);
+        group.wait();
+        
+        SortStepRecorder tailRecorder(&segment.tail);
+        recordSteps(segment.tail, tailRecorder.mergeSteps<Trace>(arr, left, mid, right));
+    }
+    
+    // Append a segment tree to the trace in the order the sequential sort
+    // records it, so the result does not depend on thread scheduling
+    void appendSegments(TraceSegment& segment, vector<int>& replay) {
+        trace.appendSegment(segment.head, replay);
+        if (segment.left) {
+            appendSegments(*segment.left, replay);
         }
+        if (segment.right) {
+            appendSegments(*segment.right, replay);
+        }
+        trace.appendSegment(segment.tail, replay);
     }
     
-    // MergeSort driver
-    void mergeSort(vector<int>& arr) {
-        states.clear();
+    // Steps of one sort generated from a copy of its input, for lazy traces
+    template <class Trace, class StepsFn>
+    StepGenerator<LazySortStep> materializeSteps(vector<int> arr, shared_ptr<const string> name, StepsFn steps) {
+        auto chunk = make_shared<SortTrace>();
+        chunk->reset(arr);
+        chunk->addStep(StepMessage::withText(SORT_INITIAL, name));
+        co_yield LazySortStep(chunk, 0);
         
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.step = 1;
-        initialState.message = "Initial array for MergeSort";
-        createArrayVisualization(initialState.elements, arr);
-        states.push_back(initialState);
+        SortStepRecorder recorder(chunk.get());
+        for (StepRecord& record : steps(recorder, arr)) {
+            chunk->addStep(move(record));
+            co_yield LazySortStep(chunk, chunk->size() - 1);
+            
+            // Start the next chunk from the array as it is now
+            if (chunk->size() >= LAZY_CHUNK_STEPS) {
+                chunk = make_shared<SortTrace>();
+                chunk->reset(arr);
+                recorder.setTrace(chunk.get());
+            }
+        }
+        
+        chunk->addStep(StepMessage::withText(SORT_DONE, name));
+        co_yield LazySortStep(chunk, chunk->size() - 1);
+    }
+    
+    // Build the visualization state of a recorded step
+    VisualState createStepState(const SortTrace& source, int index, int step, int total) const {
+        const StepRecord& record = source.stepRecord(index);
+        VisualState state;
+        state.step = step + 1;
+        state.totalSteps = total;
+        state.message = record.message;
+        createArrayState(state, source.arrayAt(index), record.highlight1, record.highlight2, record.swapping);
+        return state;
+    }
+    
+    // Start a trace for the given input (or drop the old one when untraced).
+    // Returns true when the caller should record the steps now; lazy traces
+    // instead generate them on demand from a copy of the input, so the
+    // caller only sorts the array.
+    template <class Trace, class StepsFn>
+    bool beginTrace(const vector<int>& arr, const char* name, StepsFn steps) {
+        lazySteps.clear();
+        trace.clear();
+        if constexpr (Trace::recordsPhases) {
+            arrayLayout = createArrayLayout(arr.size());
+            traceName = make_shared<const string>(name);
+            if (lazyWindow > 0) {
+                lazySteps.start([this, input = arr, name = traceName, steps] {
+                    return materializeSteps<Trace>(input, name, steps);
+                }, lazyWindow);
+                return false;
+            }
+            trace.reset(arr);
+            trace.addStep(StepMessage::withText(SORT_INITIAL, traceName));
+            return true;
+        }
+        return false;
+    }
+
+    // Add the final state and set total steps
+    template <class Trace>
+    void finishTrace() {
+        if constexpr (Trace::recordsPhases) {
+            if (!lazySteps.active()) {
+                trace.addStep(StepMessage::withText(SORT_DONE, traceName));
+            }
+        }
+        totalSteps = trace.size();
+        currentStep = 0;
+    }
+
+public:
+    SortingAlgorithms() : currentStep(0), totalSteps(0), lazyWindow(0), parallelEnabled(false) {}
+    
+    // Run QuickSort and MergeSort on the shared task pool
+    void setParallel(bool enabled) {
+        parallelEnabled = enabled;
+    }
+    
+    bool isParallel() const {
+        return parallelEnabled;
+    }
+    
+    // Generate traced steps on demand, keeping at most window steps in
+    // memory (0 records every step when the sort runs)
+    void setLazySteps(int window) {
+        lazyWindow = max(window, 0);
+    }
+    
+    // QuickSort driver
+    template <class Trace = TraceFull>
+    void quickSort(vector<int>& arr) {
+        auto steps = [](SortStepRecorder& recorder, vector<int>& a) {
+            return recorder.quickSortSteps<Trace>(a, 0, a.size() - 1);
+        };
         
-        // Call recursive function to generate steps
-        mergeSortSteps(arr, 0, arr.size() - 1);
+        // Create initial state, then generate the steps; untraced and
+        // lazily traced sorts use the vectorized kernels instead
+        if (beginTrace<Trace>(arr, "QuickSort", steps)) {
+            if (runsParallel()) {
+                TraceSegment root;
+                vector<int> replay = arr;
+                parallelQuickSortSteps<Trace>(arr, 0, arr.size() - 1, root);
+                appendSegments(root, replay);
+            } else {
+                SortStepRecorder recorder(&trace);
+                recordSteps(trace, steps(recorder, arr));
+            }
+        } else if (runsParallel()) {
+            parallel::quickSort(arr.data(), arr.size(), TaskPool::shared());
+        } else {
+            simd::quickSort(arr.data(), arr.size());
+        }
         
         // Final state
-        AlgorithmState finalState;
-        finalState.step = states.size() + 1;
-        finalState.message = "Array sorted with MergeSort";
-        createArrayVisualization(finalState.elements, arr);
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        finishTrace<Trace>();
+    }
+    
+    // MergeSort driver
+    template <class Trace = TraceFull>
+    void mergeSort(vector<int>& arr) {
+        auto steps = [](SortStepRecorder& recorder, vector<int>& a) {
+            return recorder.mergeSortSteps<Trace>(a, 0, a.size() - 1);
+        };
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        // Create initial state, then generate the steps; untraced and
+        // lazily traced sorts use the vectorized kernels instead
+        if (beginTrace<Trace>(arr, "MergeSort", steps)) {
+            if (runsParallel()) {
+                TraceSegment root;
+                vector<int> replay = arr;
+                parallelMergeSortSteps<Trace>(arr, 0, arr.size() - 1, root);
+                appendSegments(root, replay);
+            } else {
+                SortStepRecorder recorder(&trace);
+                recordSteps(trace, steps(recorder, arr));
+            }
+        } else if (runsParallel()) {
+            parallel::mergeSort(arr.data(), arr.size(), TaskPool::shared());
+        } else {
+            simd::mergeSort(arr.data(), arr.size());
         }
+        
+        // Final state
+        finishTrace<Trace>();
     }
     
     // HeapSort driver
+    template <class Trace = TraceFull>
     void heapSort(vector<int>& arr) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.step = 1;
-        initialState.message = "Initial array for HeapSort";
-        createArrayVisualization(initialState.elements, arr);
-        states.push_back(initialState);
+        auto steps = [](SortStepRecorder& recorder, vector<int>& a) {
+            return recorder.heapSortSteps<Trace>(a);
+        };
         
-        // Call function to generate steps
-        heapSortSteps(arr);
+        // Create initial state, then generate the steps; untraced and
+        // lazily traced sorts use the standard heap algorithms
+        if (beginTrace<Trace>(arr, "HeapSort", steps)) {
+            SortStepRecorder recorder(&trace);
+            recordSteps(trace, steps(recorder, arr));
+        } else {
+            make_heap(arr.begin(), arr.end());
+            sort_heap(arr.begin(), arr.end());
+        }
         
         // Final state
-        AlgorithmState finalState;
-        finalState.step = states.size() + 1;
-        finalState.message = "Array sorted with HeapSort";
-        createArrayVisualization(finalState.elements, arr);
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
+        finishTrace<Trace>();
+    }
+    
+    // RadixSort driver
+    template <class Trace = TraceFull>
+    void radixSort(vector<int>& arr) {
+        auto steps = [](SortStepRecorder& recorder, vector<int>& a) {
+            return recorder.radixSortSteps<Trace>(a);
+        };
         
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
+        // Create initial state, then generate the steps; untraced and
+        // lazily traced sorts use the write-combining kernel
+        if (beginTrace<Trace>(arr, "RadixSort", steps)) {
+            SortStepRecorder recorder(&trace);
+            recordSteps(trace, steps(recorder, arr));
+        } else {
+            radix::sort(arr.data(), arr.size());
         }
+        
+        // Final state
+        finishTrace<Trace>();
     }
     
     // Generate a random array for sorting
@@ -461,23 +943,77 @@ public:
         return arr;
     }
     
-    // Get the number of steps
+    // Get the number of steps; for lazy traces, the steps generated so far
     int getStepCount() const {
-        return totalSteps;
+        return lazySteps.active() ? lazySteps.count() : totalSteps;
+    }
+    
+    // True once every step of the trace is known
+    bool stepsComplete() const {
+        return !lazySteps.active() || lazySteps.complete();
     }
 
-    // Get a specific step
-    AlgorithmState getStep(int step) const {
-        if (step < 0 || step >= states.size()) {
-            return AlgorithmState();
+    // Write a window of steps into a binary step buffer (see step_buffer.h)
+    void writeSteps(StepBufferWriter& writer, int firstStep, int count) {
+        if (lazySteps.active()) {
+            // Lazy steps are generated up to the end of the window first
+            firstStep = max(firstStep, 0);
+            writer.begin(0, firstStep);
+            VisualState state;
+            for (int step = firstStep; count < 0 || step < firstStep + count; step++) {
+                const LazySortStep* lazy = lazySteps.get(step);
+                if (!lazy) break;
+                const StepRecord& record = lazy->chunk->stepRecord(lazy->index);
+                createArrayState(state, lazy->chunk->arrayAt(lazy->index),
+                                 record.highlight1, record.highlight2, record.swapping);
+                state.message = record.message;
+                writeVisualState(writer, step, state, SORT_MESSAGES);
+            }
+            writer.setTotalSteps(lazySteps.count());
+            writer.finish();
+            return;
+        }
+        
+        clampStepWindow(trace.size(), firstStep, count);
+        writer.begin(totalSteps, firstStep);
+        VisualState state;
+        trace.forEachStep(firstStep, count, [&](int step, const StepRecord& record, const vector<int>& arr) {
+            createArrayState(state, arr, record.highlight1, record.highlight2, record.swapping);
+            state.message = record.message;
+            writeVisualState(writer, step, state, SORT_MESSAGES);
+        });
+        writer.finish();
+    }
+
+    // Get a specific step, rebuilt from the nearest keyframe (of its chunk
+    // for lazy traces, generating the steps up to it on demand)
+    VisualState getStep(int step) {
+        if (lazySteps.active()) {
+            const LazySortStep* lazy = lazySteps.get(step);
+            if (!lazy) {
+                return VisualState();
+            }
+            return createStepState(*lazy->chunk, lazy->index, step, lazySteps.count());
+        }
+        
+        if (step < 0 || step >= trace.size()) {
+            return VisualState();
         }
-        return states[step];
+        return createStepState(trace, step, step, totalSteps);
     }
 };
 
 // Global instance
 SortingAlgorithms sorting;
 
+// Trace mode used by performSortingOperation (see TraceMode)
+int sortingTraceMode = TRACE_FULL;
+
+// Binary step buffer handed out by getSortingStepBuffer
+StepBufferWriter sortingStepBuffer;
+
+} // namespace
+
 // External interface functions
 
 // Perform a sorting operation
@@ -485,20 +1021,84 @@ extern "C" EMSCRIPTEN_KEEPALIVE int performSortingOperation(int algorithm, int a
     // Generate a random array
     vector<int> arr = sorting.generateRandomArray(arraySize > 0 ? arraySize : 10, 10, 100);
     
+    bool known = withTracePolicy(sortingTraceMode, [&](auto policy) {
+        using Trace = decltype(policy);
+        switch (algorithm) {
+            case 0: // QuickSort
+                sorting.quickSort<Trace>(arr);
+                return true;
+            case 1: // MergeSort
+                sorting.mergeSort<Trace>(arr);
+                return true;
+            case 2: // HeapSort
+                sorting.heapSort<Trace>(arr);
+                return true;
+            case 3: // RadixSort
+                sorting.radixSort<Trace>(arr);
+                return true;
+            default:
+                return false;
+        }
+    });
+    return known ? sorting.getStepCount() : -1;
+}
+
+// Sort a caller-owned array in place without tracing (0 = QuickSort,
+// 1 = MergeSort, 2 = HeapSort, 3 = RadixSort); returns -1 for an unknown algorithm.
+// Runs on its own instance so the trace of the last operation stays intact.
+extern "C" EMSCRIPTEN_KEEPALIVE int sortIntArray(int* data, int size, int algorithm) {
+    SortingAlgorithms sorter;
+    sorter.setParallel(sorting.isParallel());
+    vector<int> arr(data, data + size);
     switch (algorithm) {
-        case 0: // QuickSort
-            sorting.quickSort(arr);
+        case 0:
+            sorter.quickSort<TraceOff>(arr);
             break;
-        case 1: // MergeSort
-            sorting.mergeSort(arr);
+        case 1:
+            sorter.mergeSort<TraceOff>(arr);
             break;
-        case 2: // HeapSort
-            sorting.heapSort(arr);
+        case 2:
+            sorter.heapSort<TraceOff>(arr);
+            break;
+        case 3:
+            sorter.radixSort<TraceOff>(arr);
             break;
         default:
             return -1;
     }
-    return sorting.getStepCount();
+    copy(arr.begin(), arr.end(), data);
+    return 0;
+}
+
+// Name of the sorting kernels selected for this CPU ("avx2", "simd128" or "scalar")
+extern "C" EMSCRIPTEN_KEEPALIVE const char* getSortingKernelName() {
+    return simd::kernels().name;
+}
+
+// Run QuickSort and MergeSort on all cores (non-zero) or on one (0)
+extern "C" EMSCRIPTEN_KEEPALIVE void setSortingParallel(int enabled) {
+    sorting.setParallel(enabled != 0);
+}
+
+// Number of threads the parallel sorts use
+extern "C" EMSCRIPTEN_KEEPALIVE int getSortingThreadCount() {
+    return TaskPool::shared().concurrency();
+}
+
+// Generate the steps of subsequent traced sorts on demand, keeping at most
+// window steps in memory (0 records every step up front)
+extern "C" EMSCRIPTEN_KEEPALIVE void setSortingLazySteps(int window) {
+    sorting.setLazySteps(window);
+}
+
+// 1 once getSortingStepCount is the final count, 0 while lazy steps remain
+extern "C" EMSCRIPTEN_KEEPALIVE int isSortingStepsComplete() {
+    return sorting.stepsComplete() ? 1 : 0;
+}
+
+// Select full, coarse or no tracing for subsequent sorting operations
+extern "C" EMSCRIPTEN_KEEPALIVE void setSortingTraceMode(int mode) {
+    sortingTraceMode = mode;
 }
 
 // Get the number of steps in the current operation
@@ -508,12 +1108,12 @@ extern "C" EMSCRIPTEN_KEEPALIVE int getSortingStepCount() {
 
 // Get a specific step's data
 extern "C" EMSCRIPTEN_KEEPALIVE char* getSortingStepData(int step) {
-    AlgorithmState state = sorting.getStep(step);
+    VisualState state = sorting.getStep(step);
     
     // Convert state to JSON or another format that can be passed to JavaScript
     string result = "{\"step\":" + to_string(state.step) + 
                     ",\"totalSteps\":" + to_string(state.totalSteps) + 
-                    ",\"message\":\"" + state.message + "\"}";
+                    ",\"message\":\"" + escapeJson(formatStepMessage(SORT_MESSAGES, state.message)) + "\"}";
     
     // Allocate memory for the result that JavaScript can free later
     char* buffer = (char*)malloc(result.length() + 1);
@@ -526,13 +1126,30 @@ extern "C" EMSCRIPTEN_KEEPALIVE void freeSortingStepData(char* ptr) {
     free(ptr);
 }
 
+// Write steps [firstStep, firstStep + count) (count < 0 for all remaining
+// steps) into the binary step buffer and return its address; the buffer
+// stays valid until the next call (layout in step_buffer.h)
+extern "C" EMSCRIPTEN_KEEPALIVE const unsigned char* getSortingStepBuffer(int firstStep, int count) {
+    sorting.writeSteps(sortingStepBuffer, firstStep, count);
+    return sortingStepBuffer.data();
+}
+
+// Size in bytes of the last buffer returned by getSortingStepBuffer
+extern "C" EMSCRIPTEN_KEEPALIVE int getSortingStepBufferSize() {
+    return sortingStepBuffer.size();
+}
+
+#ifdef __EMSCRIPTEN__
 // Bind the C++ class and methods to JavaScript
 EMSCRIPTEN_BINDINGS(sorting_module) {
     class_<SortingAlgorithms>("SortingAlgorithms")
         .constructor()
-        .function("quickSort", &SortingAlgorithms::quickSort)
-        .function("mergeSort", &SortingAlgorithms::mergeSort)
-        .function("heapSort", &SortingAlgorithms::heapSort)
+        .function("quickSort", &SortingAlgorithms::quickSort<TraceFull>)
+        .function("mergeSort", &SortingAlgorithms::mergeSort<TraceFull>)
+        .function("heapSort", &SortingAlgorithms::heapSort<TraceFull>)
+        .function("radixSort", &SortingAlgorithms::radixSort<TraceFull>)
+        .function("setParallel", &SortingAlgorithms::setParallel)
+        .function("setLazySteps", &SortingAlgorithms::setLazySteps)
         .function("getStepCount", &SortingAlgorithms::getStepCount)
         .function("generateRandomArray", &SortingAlgorithms::generateRandomArray);
 }
@@ -544,3 +1161,4 @@ int main() {
     sorting.quickSort(arr);
     return 0;
 }
+#endif
@@ -0,0 +1,195 @@
+// Flat binary step buffer shared by the algorithm modules
+//
+// getSortingStepBuffer, getGraphStepBuffer, getDPStepBuffer and
+// getStepBuffer write a window of steps into one buffer that JavaScript
+// reads through typed-array views over HEAPU8, with no parsing and no
+// allocation per step. All fields are little-endian 32-bit values and
+// every section starts at a 4-byte aligned offset from the buffer start:
+//
+//   Header       12 x uint32 (see StepBufferHeader)
+//   Steps        stepCount x StepBufferStep         (6 x uint32, 24 bytes)
+//   Elements     elementCount x StepBufferElement   (6 x 32-bit, 24 bytes)
+//   Edges        edgeCount x StepBufferEdge         (4 x 32-bit, 16 bytes)
+//   String index (stringCount + 1) x uint32: byte offsets into the pool
+//   String pool  UTF-8 bytes; string i is pool[index[i], index[i + 1])
+//
+// Elements are array bars, graph and tree nodes or DP cells; each step owns
+// a contiguous run of elements and edges. Messages and labels are interned
+// in the string pool and referenced by index (NO_STRING when absent).
+//
+// The buffer belongs to the module and stays valid until the module's next
+// buffer request. Views must be recreated after any call that can grow
+// wasm memory, since growth detaches HEAPU8.buffer.
+
+#ifndef STEP_BUFFER_H
+#define STEP_BUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t STEP_BUFFER_MAGIC = 0x50455453; // "STEP"
+const uint32_t STEP_BUFFER_VERSION = 1;
+const uint32_t NO_STRING = 0xFFFFFFFF;
+
+// Element and edge flags
+enum StepBufferFlags : uint32_t {
+    STEP_HIGHLIGHTED = 1,
+    STEP_SWAPPING = 2
+};
+
+struct StepBufferHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t totalSteps;   // Steps in the whole trace
+    uint32_t firstStep;    // Index of the first step in this buffer
+    uint32_t stepCount;
+    uint32_t elementCount;
+    uint32_t edgeCount;
+    uint32_t stringCount;
+    uint32_t stepsOffset;  // Byte offsets of the sections below
+    uint32_t elementsOffset;
+    uint32_t edgesOffset;
+    uint32_t stringsOffset; // String index; the pool follows it
+};
+
+struct StepBufferStep {
+    uint32_t firstElement;
+    uint32_t elementCount;
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+    uint32_t message; // String index
+    uint32_t step;    // 1-based step number
+};
+
+struct StepBufferElement {
+    int32_t id;
+    int32_t value;
+    float x;
+    float y;
+    uint32_t flags;
+    uint32_t label; // String index, NO_STRING for plain values
+};
+
+struct StepBufferEdge {
+    int32_t source;
+    int32_t target;
+    int32_t weight;
+    uint32_t flags;
+};
+
+// Collects steps and serializes them into the layout above. Storage is
+// reused between buffers, so steady-state stepping does not allocate.
+class StepBufferWriter {
+public:
+    // Start a buffer for steps [firstStep, firstStep + count) of a trace
+    void begin(int totalSteps, int firstStep) {
+        header = StepBufferHeader();
+        header.magic = STEP_BUFFER_MAGIC;
+        header.version = STEP_BUFFER_VERSION;
+        header.totalSteps = totalSteps;
+        header.firstStep = firstStep;
+        steps.clear();
+        elements.clear();
+        edges.clear();
+        stringIds.clear();
+        stringOffsets.assign(1, 0);
+        stringPool.clear();
+    }
+
+    // Lazily generated traces only know their total once the window is written
+    void setTotalSteps(int totalSteps) {
+        header.totalSteps = totalSteps;
+    }
+
+    void addStep(int step, const std::string& message) {
+        steps.push_back({(uint32_t)elements.size(), 0, (uint32_t)edges.size(), 0, intern(message), (uint32_t)step});
+    }
+
+    void addElement(int id, int value, double x, double y, uint32_t flags, const std::string* label = nullptr) {
+        elements.push_back({id, value, (float)x, (float)y, flags, label ? intern(*label) : NO_STRING});
+        steps.back().elementCount++;
+    }
+
+    void addEdge(int source, int target, int weight, uint32_t flags) {
+        edges.push_back({source, target, weight, flags});
+        steps.back().edgeCount++;
+    }
+
+    // Lay out all sections in one contiguous buffer
+    const unsigned char* finish() {
+        header.stepCount = steps.size();
+        header.elementCount = elements.size();
+        header.edgeCount = edges.size();
+        header.stringCount = stringOffsets.size() - 1;
+
+        size_t offset = sizeof(StepBufferHeader);
+        header.stepsOffset = offset;
+        offset += steps.size() * sizeof(StepBufferStep);
+        header.elementsOffset = offset;
+        offset += elements.size() * sizeof(StepBufferElement);
+        header.edgesOffset = offset;
+        offset += edges.size() * sizeof(StepBufferEdge);
+        header.stringsOffset = offset;
+        offset += stringOffsets.size() * sizeof(uint32_t);
+
+        bytes.resize(offset + stringPool.size());
+        unsigned char* out = bytes.data();
+        memcpy(out, &header, sizeof(header));
+        copySection(out + header.stepsOffset, steps);
+        copySection(out + header.elementsOffset, elements);
+        copySection(out + header.edgesOffset, edges);
+        copySection(out + header.stringsOffset, stringOffsets);
+        memcpy(out + offset, stringPool.data(), stringPool.size());
+        return bytes.data();
+    }
+
+    const unsigned char* data() const {
+        return bytes.data();
+    }
+
+    int size() const {
+        return bytes.size();
+    }
+
+private:
+    StepBufferHeader header;
+    std::vector<StepBufferStep> steps;
+    std::vector<StepBufferElement> elements;
+    std::vector<StepBufferEdge> edges;
+    std::unordered_map<std::string, uint32_t> stringIds;
+    std::vector<uint32_t> stringOffsets; // stringOffsets[i] is where string i starts in the pool
+    std::string stringPool;
+    std::vector<unsigned char> bytes;
+
+    uint32_t intern(const std::string& text) {
+        auto found = stringIds.find(text);
+        if (found != stringIds.end()) {
+            return found->second;
+        }
+        uint32_t id = stringOffsets.size() - 1;
+        stringIds.emplace(text, id);
+        stringPool += text;
+        stringOffsets.push_back(stringPool.size());
+        return id;
+    }
+
+    template <class Record>
+    static void copySection(unsigned char* out, const std::vector<Record>& records) {
+        if (!records.empty()) {
+            memcpy(out, records.data(), records.size() * sizeof(Record));
+        }
+    }
+};
+
+// Clamp a requested window to the steps that exist; count < 0 means all
+// remaining steps
+inline void clampStepWindow(int totalSteps, int& firstStep, int& count) {
+    if (firstStep < 0) firstStep = 0;
+    if (firstStep > totalSteps) firstStep = totalSteps;
+    if (count < 0 || count > totalSteps - firstStep) count = totalSteps - firstStep;
+}
+
+#endif // STEP_BUFFER_H
@@ -0,0 +1,291 @@
+// Coroutine step generators and the lazy step window built on them
+//
+// Engines write their step sequences as C++20 coroutines that co_yield one
+// step at a time. A generator can also co_yield another generator, whose
+// steps are then produced in place (recursive sorts yield their sub-sorts
+// this way without re-yielding every step at each level).
+//
+// The same generator feeds both trace modes: eager traces drain it into the
+// module's step list, while LazySteps keeps only a bounded window of steps
+// and advances the generator when a step past the window is requested.
+// Consumers may move from the step a generator yields, so a generator must
+// not rely on a yielded object afterwards.
+
+#ifndef STEP_GENERATOR_H
+#define STEP_GENERATOR_H
+
+#include <algorithm>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+template <class T>
+class StepGenerator {
+public:
+    struct promise_type {
+        T* value = nullptr;
+        promise_type* root = this;
+        std::coroutine_handle<promise_type> parent;
+        std::coroutine_handle<promise_type> leaf; // Innermost running generator (root only)
+        std::exception_ptr exception;
+
+        StepGenerator get_return_object() {
+            leaf = std::coroutine_handle<promise_type>::from_promise(*this);
+            return StepGenerator(leaf);
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        // A finished nested generator hands control back to its parent
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                promise_type& promise = handle.promise();
+                if (promise.parent) {
+                    promise.root->leaf = promise.parent;
+                    return promise.parent;
+                }
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_always yield_value(T& step) noexcept {
+            root->value = std::addressof(step);
+            return {};
+        }
+
+        std::suspend_always yield_value(T&& step) noexcept {
+            root->value = std::addressof(step);
+            return {};
+        }
+
+        // co_yield of a nested generator runs it to completion in place
+        struct NestedAwaiter {
+            std::coroutine_handle<promise_type> nested;
+
+            bool await_ready() noexcept {
+                return !nested || nested.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                promise_type& outer = handle.promise();
+                promise_type& inner = nested.promise();
+                inner.root = outer.root;
+                inner.parent = handle;
+                outer.root->leaf = nested;
+                return nested;
+            }
+            void await_resume() {
+                if (nested && nested.promise().exception) {
+                    std::rethrow_exception(nested.promise().exception);
+                }
+            }
+        };
+
+        NestedAwaiter yield_value(StepGenerator&& generator) noexcept {
+            return {generator.handle};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+
+        // Steps are only produced through co_yield
+        void await_transform() = delete;
+    };
+
+    StepGenerator() = default;
+
+    StepGenerator(StepGenerator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    StepGenerator& operator=(StepGenerator&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~StepGenerator() {
+        reset();
+    }
+
+    // Advance to the next step; false once the generator has finished
+    bool next() {
+        if (!handle || handle.done()) {
+            return false;
+        }
+        promise_type& promise = handle.promise();
+        promise.value = nullptr;
+        promise.leaf.resume();
+        if (handle.done()) {
+            if (promise.exception) {
+                std::rethrow_exception(promise.exception);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // Run to completion, discarding the steps (untraced runs for a result)
+    void drain() {
+        while (next()) {
+        }
+    }
+
+    // The step produced by the last successful next()
+    T& current() const {
+        return *handle.promise().value;
+    }
+
+    // Range-for support: for (T& step : generator)
+    struct Sentinel {};
+
+    struct Iterator {
+        StepGenerator* generator;
+
+        T& operator*() const {
+            return generator->current();
+        }
+        Iterator& operator++() {
+            if (!generator->next()) {
+                generator = nullptr;
+            }
+            return *this;
+        }
+        bool operator==(Sentinel) const {
+            return generator == nullptr;
+        }
+    };
+
+    Iterator begin() {
+        return next() ? Iterator{this} : Iterator{nullptr};
+    }
+
+    Sentinel end() {
+        return {};
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit StepGenerator(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+
+    void reset() {
+        if (handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+};
+
+// Default size of the lazy step window and how far ahead of the requested
+// step it is filled
+const int DEFAULT_STEP_WINDOW = 1024;
+const int STEP_LOOK_AHEAD = 32;
+
+// Lazily generated steps: keeps at most `window` consecutive steps and
+// advances the generator only as far as requested steps need. Going back
+// past the window restarts the generator from its factory.
+template <class T>
+class LazySteps {
+public:
+    using Factory = std::function<StepGenerator<T>()>;
+
+    LazySteps() : window(0), windowStart(0), produced(0), finished(true) {}
+
+    // Start a new sequence and produce its first steps
+    void start(Factory newFactory, int windowSize) {
+        factory = std::move(newFactory);
+        window = std::max(windowSize, 2 * STEP_LOOK_AHEAD);
+        restart();
+        get(0);
+    }
+
+    // Drop the sequence (and the inputs captured by its factory)
+    void clear() {
+        factory = nullptr;
+        generator.reset();
+        steps.clear();
+        windowStart = 0;
+        produced = 0;
+        finished = true;
+    }
+
+    bool active() const {
+        return static_cast<bool>(factory);
+    }
+
+    // Steps produced so far; the total once complete() is true
+    int count() const {
+        return produced;
+    }
+
+    bool complete() const {
+        return finished;
+    }
+
+    // The step at the given index, or nullptr past the end of the sequence
+    const T* get(int step) {
+        if (step < 0 || !factory) {
+            return nullptr;
+        }
+        if (step < windowStart) {
+            restart();
+        }
+        advanceTo(step + STEP_LOOK_AHEAD);
+        if (step >= produced) {
+            return nullptr;
+        }
+        return &steps[step - windowStart];
+    }
+
+private:
+    Factory factory;
+    std::optional<StepGenerator<T>> generator;
+    std::deque<T> steps; // steps[i] is step windowStart + i
+    int window;
+    int windowStart;
+    int produced;
+    bool finished;
+
+    void restart() {
+        generator.emplace(factory());
+        steps.clear();
+        windowStart = 0;
+        produced = 0;
+        finished = false;
+    }
+
+    void advanceTo(int last) {
+        while (!finished && produced <= last) {
+            if (!generator->next()) {
+                finished = true;
+                generator.reset();
+                break;
+            }
+            steps.push_back(std::move(generator->current()));
+            produced++;
+            if ((int)steps.size() > window) {
+                steps.pop_front();
+                windowStart++;
+            }
+        }
+    }
+};
+
+#endif // STEP_GENERATOR_H
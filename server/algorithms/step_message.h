@@ -0,0 +1,110 @@
+// Step messages stored as a template id plus integer arguments
+//
+// Traces record many steps whose messages are rarely all read. Instead of
+// formatting every message when a step is recorded, a step keeps the id of
+// a template from its module's message table and the values to fill in;
+// the text is formatted only when the step is fetched. Templates use these
+// placeholders:
+//
+//   {N}   argument N as a decimal integer (N = 0 to MAX_MESSAGE_ARGS - 1)
+//   {Nc}  argument N as a single character
+//   {t}   the message's text, shared by the steps of a trace (input
+//         strings, item lists) and computed once
+//
+// Message tables are arrays of templates indexed by the module's message
+// enum, for example SORT_MESSAGES in sort.cpp.
+
+#ifndef STEP_MESSAGE_H
+#define STEP_MESSAGE_H
+
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+const int MAX_MESSAGE_ARGS = 7;
+
+// Templates of one module, indexed by StepMessage::id
+using MessageTable = const char* const*;
+
+struct StepMessage {
+    uint16_t id = 0;
+    int32_t args[MAX_MESSAGE_ARGS] = {};
+    std::shared_ptr<const std::string> text;
+
+    StepMessage() = default;
+
+    template <class... Args>
+    StepMessage(uint16_t templateId, Args... values) : id(templateId), args{(int32_t)values...} {
+        static_assert(sizeof...(Args) <= MAX_MESSAGE_ARGS, "too many message arguments");
+    }
+
+    // A message whose {t} placeholder is filled with the given text
+    template <class... Args>
+    static StepMessage withText(uint16_t templateId, std::shared_ptr<const std::string> text, Args... values) {
+        StepMessage message(templateId, values...);
+        message.text = std::move(text);
+        return message;
+    }
+};
+
+// Append a message formatted with its module's table
+inline void appendStepMessage(std::string& out, MessageTable messages, const StepMessage& message) {
+    for (const char* p = messages[message.id]; *p; p++) {
+        if (*p != '{') {
+            out += *p;
+            continue;
+        }
+        if (p[1] == 't') {
+            if (message.text) {
+                out += *message.text;
+            }
+            p += 2;
+            continue;
+        }
+
+        int32_t value = message.args[p[1] - '0'];
+        if (p[2] == 'c') {
+            out += (char)value;
+            p += 3;
+        } else {
+            char digits[12];
+            char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+            out.append(digits, end);
+            p += 2;
+        }
+    }
+}
+
+inline std::string formatStepMessage(MessageTable messages, const StepMessage& message) {
+    std::string out;
+    appendStepMessage(out, messages, message);
+    return out;
+}
+
+// Escape text for use inside a JSON string literal
+inline std::string escapeJson(const std::string& text) {
+    static const char HEX[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    out += "\\u00";
+                    out += HEX[(c >> 4) & 0xF];
+                    out += HEX[c & 0xF];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+#endif // STEP_MESSAGE_H
@@ -0,0 +1,216 @@
+// Work-stealing task pool used by the parallel engines
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// (LIFO, cache friendly for fork-join recursion) while idle workers steal
+// from the front of other deques. Threads that wait on a TaskGroup run
+// queued tasks themselves, so nested fork-join never deadlocks and a pool
+// without workers still completes everything on the calling thread.
+//
+// Natively the pool uses std::thread; the browser build needs Emscripten
+// pthreads (-pthread, SharedArrayBuffer) and otherwise runs with no workers.
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define TASK_POOL_NO_THREADS 1
+#endif
+
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit TaskPool(int workerCount) : queued(0), stopping(false) {
+#ifdef TASK_POOL_NO_THREADS
+        workerCount = 0;
+#endif
+        // One queue per worker plus a shared one for outside submitters
+        for (int i = 0; i <= workerCount; i++) {
+            queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+        }
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Process-wide pool with one thread per hardware thread (the caller
+    // counts as one); ALGO_THREADS overrides the total
+    static TaskPool& shared() {
+        static TaskPool pool(defaultThreadCount() - 1);
+        return pool;
+    }
+
+    // Threads that can run tasks concurrently, including the waiting caller
+    int concurrency() const {
+        return workers.size() + 1;
+    }
+
+    void submit(Task task) {
+        int index = currentPool == this ? currentIndex : externalQueue();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    // Run one queued task on the calling thread; false if none was found
+    bool runPendingTask() {
+        int index = currentPool == this ? currentIndex : externalQueue();
+        Task task;
+        if (popTask(index, task)) {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued;
+    bool stopping;
+
+    inline static thread_local const TaskPool* currentPool = nullptr;
+    inline static thread_local int currentIndex = 0;
+
+    static int defaultThreadCount() {
+        if (const char* env = std::getenv("ALGO_THREADS")) {
+            int threads = std::atoi(env);
+            if (threads > 0) return threads;
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    int externalQueue() const {
+        return queues.size() - 1;
+    }
+
+    // Own queue from the back, then steal from the front of the others
+    bool popTask(int index, Task& task) {
+        {
+            TaskQueue& own = *queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        int count = queues.size();
+        for (int offset = 1; offset < count; offset++) {
+            TaskQueue& victim = *queues[(index + offset) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int index) {
+        currentPool = this;
+        currentIndex = index;
+        while (true) {
+            Task task;
+            if (popTask(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+};
+
+// Fork-join scope: run() forks a task, wait() joins all of them while
+// helping with queued work
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool& owner) : pool(owner), pending(0) {}
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(TaskPool::Task task) {
+        pending++;
+        pool.submit([this, task] {
+            task();
+            pending--;
+        });
+    }
+
+    void wait() {
+        while (pending > 0) {
+            if (!pool.runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    TaskPool& pool;
+    std::atomic<int> pending;
+};
+
+// Run body(i) for i in [0, count) across the pool
+template <class Body>
+void parallelFor(TaskPool& pool, int count, const Body& body) {
+    TaskGroup group(pool);
+    for (int i = 1; i < count; i++) {
+        group.run([&body, i] { body(i); });
+    }
+    if (count > 0) {
+        body(0);
+    }
+    group.wait();
+}
+
+#endif // TASK_POOL_H
@@ -0,0 +1,301 @@
+// Graph engines against plain reference implementations on random
+// graphs, in id order and renumbered by each node order:
+// - Dijkstra on every queue, delta-stepping, bidirectional Dijkstra, A*,
+//   ALT and contraction hierarchy queries, and traced Dijkstra, against a
+//   textbook Dijkstra
+// - direction-optimizing and multi-source BFS depths, and the nodes traced
+//   BFS and DFS visit, against a textbook BFS
+// - Kruskal and Prim forest weights against each other and a reference
+//   Kruskal
+// - edge list and DIMACS files with node ids too large for a node count,
+//   which must fail to load and leave the graph as it was
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "algorithms.h"
+#include "test_support.h"
+#include "trace_policy.h"
+
+using namespace std;
+
+namespace {
+
+struct Edge {
+    int source;
+    int target;
+    int weight;
+};
+
+// An undirected graph built both in the engine and here
+struct TestGraph {
+    int nodes = 0;
+    vector<Edge> edges;
+};
+
+// Random graph with some isolated nodes, parallel edges and self-loops,
+// or a grid with a few streets missing
+TestGraph buildGraph(int nodes, bool grid, int maxWeight, mt19937& gen) {
+    TestGraph graph;
+    graph.nodes = nodes;
+    if (grid) {
+        int side = max(1, (int)sqrt((double)nodes));
+        for (int node = 0; node < nodes; node++) {
+            if ((node + 1) % side != 0 && node + 1 < nodes && gen() % 10 != 0) {
+                graph.edges.push_back({node, node + 1, 1 + (int)(gen() % maxWeight)});
+            }
+            if (node + side < nodes && gen() % 10 != 0) {
+                graph.edges.push_back({node, node + side, 1 + (int)(gen() % maxWeight)});
+            }
+        }
+    } else {
+        int edgeCount = nodes * (1 + gen() % 3);
+        for (int i = 0; i < edgeCount; i++) {
+            graph.edges.push_back({(int)(gen() % nodes), (int)(gen() % nodes), (int)(gen() % (maxWeight + 1))});
+        }
+    }
+    resetGraph();
+    for (int node = 0; node < nodes; node++) {
+        addGraphNode();
+    }
+    for (const Edge& edge : graph.edges) {
+        addGraphEdge(edge.source, edge.target, edge.weight);
+    }
+    return graph;
+}
+
+vector<vector<pair<int, int>>> adjacencyOf(const TestGraph& graph) {
+    vector<vector<pair<int, int>>> adjacency(graph.nodes);
+    for (const Edge& edge : graph.edges) {
+        adjacency[edge.source].push_back({edge.target, edge.weight});
+        adjacency[edge.target].push_back({edge.source, edge.weight});
+    }
+    return adjacency;
+}
+
+vector<int> referenceDijkstra(const TestGraph& graph, int start) {
+    vector<vector<pair<int, int>>> adjacency = adjacencyOf(graph);
+    vector<int> distances(graph.nodes, INT_MAX);
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> queue;
+    distances[start] = 0;
+    queue.push({0, start});
+    while (!queue.empty()) {
+        auto [distance, node] = queue.top();
+        queue.pop();
+        if (distance > distances[node]) continue;
+        for (auto [neighbor, weight] : adjacency[node]) {
+            if (distance + weight < distances[neighbor]) {
+                distances[neighbor] = distance + weight;
+                queue.push({distances[neighbor], neighbor});
+            }
+        }
+    }
+    return distances;
+}
+
+vector<int> referenceBfs(const TestGraph& graph, int start) {
+    vector<vector<pair<int, int>>> adjacency = adjacencyOf(graph);
+    vector<int> depths(graph.nodes, -1);
+    vector<int> queue = {start};
+    depths[start] = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+        for (auto [neighbor, weight] : adjacency[queue[head]]) {
+            if (depths[neighbor] < 0) {
+                depths[neighbor] = depths[queue[head]] + 1;
+                queue.push_back(neighbor);
+            }
+        }
+    }
+    return depths;
+}
+
+long long referenceForestWeight(const TestGraph& graph) {
+    vector<Edge> edges = graph.edges;
+    sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.weight < b.weight; });
+    vector<int> parent(graph.nodes);
+    iota(parent.begin(), parent.end(), 0);
+    function<int(int)> find = [&](int node) { return parent[node] == node ? node : parent[node] = find(parent[node]); };
+    long long weight = 0;
+    for (const Edge& edge : edges) {
+        int a = find(edge.source), b = find(edge.target);
+        if (a != b) {
+            parent[a] = b;
+            weight += edge.weight;
+        }
+    }
+    return weight;
+}
+
+// Messages of every step of the current graph trace
+vector<string> traceMessages() {
+    vector<string> messages;
+    for (const test::Step& step : test::readSteps(getGraphStepBuffer(0, -1))) {
+        messages.push_back(step.message);
+    }
+    return messages;
+}
+
+void testShortestPaths(const TestGraph& graph, int start, const string& name) {
+    vector<int> expected = referenceDijkstra(graph, start);
+    vector<int> distances(graph.nodes);
+    for (int queue = 0; queue < 3; queue++) {
+        computeShortestPaths(start, queue, distances.data());
+        CHECK(distances == expected, name + ": Dijkstra on queue " + to_string(queue));
+    }
+    for (int delta : {0, 1, 7, 1000}) {
+        computeDeltaSteppingPaths(start, delta, distances.data());
+        CHECK(distances == expected, name + ": delta-stepping with width " + to_string(delta));
+    }
+
+    mt19937 gen(start);
+    for (int query = 0; query < 8; query++) {
+        int target = gen() % graph.nodes;
+        for (int method = 0; method < 4; method++) {
+            int distance = -1;
+            computePointToPointPath(start, target, method, &distance);
+            CHECK(distance == expected[target], name + ": point-to-point method " + to_string(method) + " from " +
+                                                    to_string(start) + " to " + to_string(target));
+        }
+    }
+
+    // Traced Dijkstra processes each reachable node once at its distance
+    setGraphTraceMode(TRACE_FULL);
+    performGraphOperation(2, start);
+    vector<int> processed(graph.nodes, -1);
+    for (const string& message : traceMessages()) {
+        int node, distance;
+        if (sscanf(message.c_str(), "Processing node %d with distance %d", &node, &distance) == 2) {
+            CHECK(node >= 0 && node < graph.nodes && processed[node] < 0, name + ": node processed twice");
+            if (node >= 0 && node < graph.nodes) {
+                processed[node] = distance;
+            }
+        }
+    }
+    for (int node = 0; node < graph.nodes; node++) {
+        CHECK(processed[node] == (expected[node] == INT_MAX ? -1 : expected[node]),
+              name + ": traced Dijkstra at node " + to_string(node));
+    }
+}
+
+void testSearches(const TestGraph& graph, int start, const string& name) {
+    vector<int> expected = referenceBfs(graph, start);
+    vector<int> depths(graph.nodes);
+    computeParallelBfs(start, depths.data());
+    CHECK(depths == expected, name + ": direction-optimizing BFS");
+
+    // Traced BFS visits by depth and DFS visits the same nodes
+    for (int algorithm : {0, 1}) {
+        performGraphOperation(algorithm, start);
+        vector<bool> visited(graph.nodes, false);
+        int lastDepth = 0;
+        for (const string& message : traceMessages()) {
+            int node;
+            if (sscanf(message.c_str(), "Visiting node %d", &node) != 1) continue;
+            bool valid = node >= 0 && node < graph.nodes && !visited[node] && expected[node] >= 0;
+            CHECK(valid, name + ": " + (algorithm ? "BFS" : "DFS") + " visits node " + to_string(node));
+            if (!valid) continue;
+            visited[node] = true;
+            if (algorithm == 1) {
+                CHECK(expected[node] >= lastDepth, name + ": BFS visits out of depth order");
+                lastDepth = expected[node];
+            }
+        }
+        for (int node = 0; node < graph.nodes; node++) {
+            CHECK(visited[node] == (expected[node] >= 0), name + ": " + (algorithm ? "BFS" : "DFS") + " misses node " +
+                                                                  to_string(node));
+        }
+    }
+}
+
+void testMultiSourceBfs(const TestGraph& graph, const string& name) {
+    mt19937 gen(graph.nodes);
+    for (int count : {1, 5, 64, 130}) {
+        vector<int> sources(count);
+        for (int& source : sources) {
+            source = gen() % graph.nodes;
+        }
+        vector<int> reached(count), eccentricities(count), depths((size_t)count * graph.nodes);
+        vector<long long> sums(count);
+        computeMultiSourceBfs(sources.data(), count, reached.data(), sums.data(), eccentricities.data(), depths.data());
+        for (int i = 0; i < count; i++) {
+            vector<int> expected = referenceBfs(graph, sources[i]);
+            int expectedReached = 0, expectedEccentricity = 0;
+            long long expectedSum = 0;
+            for (int depth : expected) {
+                if (depth < 0) continue;
+                expectedReached++;
+                expectedSum += depth;
+                expectedEccentricity = max(expectedEccentricity, depth);
+            }
+            bool same = equal(expected.begin(), expected.end(), depths.begin() + (size_t)i * graph.nodes);
+            CHECK(same, name + ": multi-source BFS depths from " + to_string(sources[i]));
+            CHECK(reached[i] == expectedReached && sums[i] == expectedSum && eccentricities[i] == expectedEccentricity,
+                  name + ": multi-source BFS aggregates from " + to_string(sources[i]));
+        }
+    }
+}
+
+void testSpanningForests(const TestGraph& graph, const string& name) {
+    long long expected = referenceForestWeight(graph);
+    long long kruskal = -1, prim = -1;
+    int kruskalEdges = computeSpanningForest(0, 0, nullptr, &kruskal);
+    int primEdges = computeSpanningForest(1, 0, nullptr, &prim);
+    CHECK(kruskal == expected, name + ": Kruskal forest weight");
+    CHECK(prim == expected, name + ": Prim forest weight");
+    CHECK(kruskalEdges == primEdges, name + ": forest edge counts differ");
+}
+
+// Write text to path and load it as format
+int loadText(const char* path, const string& text, int format) {
+    FILE* file = fopen(path, "w");
+    CHECK(file != nullptr, string("cannot write ") + path);
+    if (!file) return -1;
+    fputs(text.c_str(), file);
+    fclose(file);
+    int nodes = loadGraphFile(path, format);
+    remove(path);
+    return nodes;
+}
+
+void testGraphFileIds() {
+    const char* path = "graph_test_ids.txt";
+    CHECK(loadText(path, "0 1 3\n1 4\n", 0) == 5, "edge list node count");
+    for (const char* ids : {"0 2147483647 1", "2147483647 0", "0 2147483646"}) {
+        CHECK(loadText(path, string(ids) + "\n", 0) == -1, string("edge list with ids ") + ids + " loaded");
+    }
+    CHECK(loadText(path, "p sp 2147483647 1\na 1 2 1\n", 1) == -1, "DIMACS file with 2147483647 nodes loaded");
+    CHECK(reorderGraph(0) == 5, "failed loads changed the graph");
+}
+
+} // namespace
+
+int main() {
+    mt19937 gen(7);
+    const char* orderNames[] = {"ids", "RCM", "degree", "Gorder", "random"};
+    for (int round = 0; round < 24; round++) {
+        bool grid = round % 3 == 2;
+        int nodes = round < 16 ? 2 + gen() % 40 : 200 + gen() % 800;
+        int maxWeight = round % 4 == 0 ? 1 : 20;
+        TestGraph graph = buildGraph(nodes, grid, maxWeight, gen);
+        for (int order = 0; order < 5; order++) {
+            reorderGraph(order);
+            string name = string(grid ? "grid" : "random") + " graph " + to_string(round) + " (" + orderNames[order] + ")";
+            for (int start : {0, (int)(gen() % nodes)}) {
+                testShortestPaths(graph, start, name);
+                testSearches(graph, start, name);
+            }
+            testMultiSourceBfs(graph, name);
+            testSpanningForests(graph, name);
+        }
+    }
+    testGraphFileIds();
+    return test::finish("graph_test");
+}
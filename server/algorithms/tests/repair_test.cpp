@@ -0,0 +1,267 @@
+// Shortest path repair against recomputation: random graphs take rounds of
+// random edge removals, reweightings, insertions and node removals and
+// additions, mirrored here, and after each round Dijkstra from the same
+// start node, untraced or traced, eager or lazy, must give a textbook
+// Dijkstra's distances on the changed graph. A traced run after a change
+// must be a fresh repair, not a cached or lazily replayed trace of the
+// graph before it, and a run after that must not replay the repair.
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "algorithms.h"
+#include "test_support.h"
+#include "trace_policy.h"
+
+using namespace std;
+
+namespace {
+
+struct Edge {
+    int source;
+    int target;
+    int weight;
+};
+
+// The engine's graph as it should be after the mutations so far
+struct MirrorGraph {
+    int nodes = 0;
+    vector<Edge> edges;
+
+    bool joins(const Edge& edge, int a, int b) const {
+        return (edge.source == a && edge.target == b) || (edge.source == b && edge.target == a);
+    }
+
+    int removeEdge(int a, int b) {
+        size_t before = edges.size();
+        erase_if(edges, [&](const Edge& edge) { return joins(edge, a, b); });
+        return before - edges.size();
+    }
+
+    // Whether any edge between a and b changes weight
+    bool setWeight(int a, int b, int weight) {
+        bool changed = false;
+        for (Edge& edge : edges) {
+            if (joins(edge, a, b)) {
+                changed = changed || edge.weight != weight;
+                edge.weight = weight;
+            }
+        }
+        return changed;
+    }
+
+    void removeNode(int node) {
+        erase_if(edges, [node](const Edge& edge) { return edge.source == node || edge.target == node; });
+        for (Edge& edge : edges) {
+            edge.source -= edge.source > node;
+            edge.target -= edge.target > node;
+        }
+        nodes--;
+    }
+};
+
+vector<int> referenceDijkstra(const MirrorGraph& graph, int start) {
+    vector<vector<pair<int, int>>> adjacency(graph.nodes);
+    for (const Edge& edge : graph.edges) {
+        adjacency[edge.source].push_back({edge.target, edge.weight});
+        adjacency[edge.target].push_back({edge.source, edge.weight});
+    }
+    vector<int> distances(graph.nodes, INT_MAX);
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> queue;
+    distances[start] = 0;
+    queue.push({0, start});
+    while (!queue.empty()) {
+        auto [distance, node] = queue.top();
+        queue.pop();
+        if (distance > distances[node]) continue;
+        for (auto [neighbor, weight] : adjacency[node]) {
+            if (distance + weight < distances[neighbor]) {
+                distances[neighbor] = distance + weight;
+                queue.push({distances[neighbor], neighbor});
+            }
+        }
+    }
+    return distances;
+}
+
+// Random graph with parallel edges and self-loops, or a grid with a few
+// streets missing, built in the engine and mirrored
+MirrorGraph buildGraph(int nodes, bool grid, mt19937& gen) {
+    MirrorGraph graph;
+    graph.nodes = nodes;
+    if (grid) {
+        int side = 1;
+        while ((side + 1) * (side + 1) <= nodes) side++;
+        for (int node = 0; node < nodes; node++) {
+            if ((node + 1) % side != 0 && node + 1 < nodes && gen() % 10 != 0) {
+                graph.edges.push_back({node, node + 1, 1 + (int)(gen() % 9)});
+            }
+            if (node + side < nodes && gen() % 10 != 0) {
+                graph.edges.push_back({node, node + side, 1 + (int)(gen() % 9)});
+            }
+        }
+    } else {
+        int edgeCount = nodes * (1 + gen() % 3);
+        for (int i = 0; i < edgeCount; i++) {
+            graph.edges.push_back({(int)(gen() % nodes), (int)(gen() % nodes), (int)(gen() % 10)});
+        }
+    }
+    resetGraph();
+    for (int node = 0; node < nodes; node++) {
+        addGraphNode();
+    }
+    for (const Edge& edge : graph.edges) {
+        addGraphEdge(edge.source, edge.target, edge.weight);
+    }
+    return graph;
+}
+
+// One random mutation applied to the engine and the mirror; false when
+// it left the graph unchanged. Keeps start out of node removals and
+// renumbers it when a lower node goes.
+bool mutate(MirrorGraph& graph, int& start, mt19937& gen) {
+    int a = gen() % graph.nodes, b = gen() % graph.nodes;
+    int kind = gen() % 10;
+    if (kind < 4 && !graph.edges.empty()) {
+        // Mostly existing edges, whose removal or reweighting can detach nodes
+        const Edge& edge = graph.edges[gen() % graph.edges.size()];
+        if (gen() % 4 != 0) {
+            a = edge.source;
+            b = edge.target;
+        }
+        if (kind < 2) {
+            int removed = graph.removeEdge(a, b);
+            CHECK((removeGraphEdge(a, b) > 0) == (removed > 0), "removeGraphEdge count");
+            return removed > 0;
+        }
+        int weight = gen() % 12;
+        bool changed = graph.setWeight(a, b, weight);
+        setGraphEdgeWeight(a, b, weight);
+        return changed;
+    }
+    if (kind < 7) {
+        int weight = gen() % 10;
+        graph.edges.push_back({a, b, weight});
+        addGraphEdge(a, b, weight);
+        return true;
+    }
+    if (kind < 9) {
+        if (a == start || graph.nodes < 3) return false;
+        graph.removeNode(a);
+        CHECK(removeGraphNode(a) == graph.nodes, "removeGraphNode count");
+        start -= a < start;
+        return true;
+    }
+    CHECK(addGraphNode() == graph.nodes, "addGraphNode id");
+    graph.nodes++;
+    return true;
+}
+
+// Messages of the whole graph trace, read in windows smaller than a lazy
+// trace keeps so later steps are generated as they are read
+vector<string> traceMessages() {
+    vector<string> messages;
+    while (true) {
+        vector<test::Step> steps = test::readSteps(getGraphStepBuffer(messages.size(), 16));
+        if (steps.empty()) break;
+        for (const test::Step& step : steps) {
+            messages.push_back(step.message);
+        }
+    }
+    return messages;
+}
+
+// A traced Dijkstra from start whose first step begins with expectedStart;
+// in full mode every node it processes gets its final
+// distance
+void checkTracedRun(const MirrorGraph& graph, int start, int mode, const string& expectedStart,
+                    const vector<int>& expected, const string& name) {
+    setGraphTraceMode(mode);
+    performGraphOperation(2, start);
+    if (mode == TRACE_OFF) {
+        setGraphTraceMode(TRACE_FULL);
+        return;
+    }
+    vector<string> messages = traceMessages();
+    CHECK(isGraphStepsComplete() && (int)messages.size() == getGraphStepCount(), name + ": trace length");
+    string first = messages.empty() ? "" : messages.front();
+    CHECK(first.compare(0, expectedStart.size(), expectedStart) == 0,
+          name + ": trace starts with \"" + first + "\", expected \"" + expectedStart + "\"");
+    for (const string& message : messages) {
+        int node, distance;
+        if (sscanf(message.c_str(), "Processing node %d with distance %d", &node, &distance) == 2) {
+            bool valid = node >= 0 && node < graph.nodes && expected[node] == distance;
+            CHECK(valid, name + ": traced run processes node " + to_string(node) + " at distance " +
+                             to_string(distance));
+        }
+    }
+    // Stepping back to the first step replays a lazy trace from its input
+    vector<test::Step> again = test::readSteps(getGraphStepBuffer(0, 1));
+    CHECK(!again.empty() && again[0].message == first, name + ": first step changed when read again");
+    setGraphTraceMode(TRACE_FULL);
+}
+
+} // namespace
+
+int main() {
+    mt19937 gen(11);
+    int repairs = 0;
+    for (int lazyWindow : {0, 25}) {
+        setGraphLazySteps(lazyWindow);
+        for (int round = 0; round < 200; round++) {
+            bool grid = round % 4 == 3;
+            MirrorGraph graph = buildGraph(grid ? 100 + gen() % 300 : 2 + gen() % 40, grid, gen);
+            int start = gen() % graph.nodes;
+            bool repairEnabled = round % 10 != 9;
+            setGraphPathRepair(repairEnabled);
+            vector<int> distances(graph.nodes);
+            computeShortestPaths(start, 0, distances.data());
+            string graphName = string(grid ? "grid " : "graph ") + to_string(round) + ", lazy window " +
+                               to_string(lazyWindow);
+
+            for (int step = 0; step < 8; step++) {
+                bool changed = false;
+                int mutations = 1 + gen() % 4;
+                for (int i = 0; i < mutations; i++) {
+                    changed = mutate(graph, start, gen) || changed;
+                }
+                vector<int> expected = referenceDijkstra(graph, start);
+                string name = graphName + ", step " + to_string(step);
+                bool repair = repairEnabled && changed;
+                repairs += repair;
+                if (gen() % 2 == 0) {
+                    distances.assign(graph.nodes, -1);
+                    computeShortestPaths(start, gen() % 3, distances.data());
+                    CHECK(distances == expected, name + ": repaired distances differ from a full run");
+                } else {
+                    // A run leaves nothing to repair, so running again on
+                    // the same graph, replayed or not, starts from scratch
+                    int mode = (int)(gen() % 3);
+                    string fullStart = "Starting Dijkstra's algorithm from node " + to_string(start);
+                    string expectedStart = repair ? "Repairing shortest paths from node " + to_string(start)
+                                                  : fullStart;
+                    checkTracedRun(graph, start, mode, expectedStart, expected, name);
+                    if (gen() % 3 == 0) {
+                        checkTracedRun(graph, start, mode, fullStart, expected, name + " (again)");
+                    }
+                }
+            }
+
+            // The tree the last run left, repaired over all the rounds, is
+            // still right when repaired once more
+            addGraphNode();
+            graph.nodes++;
+            distances.assign(graph.nodes, -1);
+            computeShortestPaths(start, 0, distances.data());
+            CHECK(distances == referenceDijkstra(graph, start), graphName + ": final repair");
+        }
+    }
+    setGraphLazySteps(0);
+    setGraphPathRepair(1);
+    CHECK(repairs > 1000, "too few repairs exercised: " + to_string(repairs));
+    return test::finish("repair_test");
+}
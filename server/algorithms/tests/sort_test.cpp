@@ -0,0 +1,123 @@
+// Sorting engines against std::sort: every algorithm untraced (SIMD,
+// radix and parallel kernels through sortIntArray) and traced in full,
+// coarse and lazy mode, sequential and parallel. A trace must end in the
+// sorted form of the array it starts from.
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "algorithms.h"
+#include "test_support.h"
+#include "trace_policy.h"
+
+using namespace std;
+
+namespace {
+
+const char* const SORT_NAMES[] = {"QuickSort", "MergeSort", "HeapSort", "RadixSort"};
+
+string describe(int algorithm, bool parallel, const string& detail) {
+    return string(SORT_NAMES[algorithm]) + (parallel ? " (parallel) " : " ") + detail;
+}
+
+// Arrays with duplicates, negatives, extremes and presorted runs
+vector<vector<int>> testArrays() {
+    mt19937 gen(42);
+    vector<vector<int>> arrays;
+    for (int size : {0, 1, 2, 3, 7, 15, 16, 17, 31, 64, 100, 1000, 5000, 100000}) {
+        vector<int> random(size), narrow(size), sorted(size), reversed(size);
+        for (int i = 0; i < size; i++) {
+            random[i] = (int)gen();
+            narrow[i] = (int)(gen() % 5) - 2;
+            sorted[i] = i - size / 2;
+            reversed[i] = size - i;
+        }
+        arrays.push_back(random);
+        arrays.push_back(narrow);
+        arrays.push_back(sorted);
+        arrays.push_back(reversed);
+    }
+    arrays.push_back({numeric_limits<int>::min(), numeric_limits<int>::max(), 0, -1, numeric_limits<int>::min()});
+    return arrays;
+}
+
+void testUntraced(int algorithm, bool parallel) {
+    setSortingParallel(parallel);
+    for (const vector<int>& input : testArrays()) {
+        vector<int> expected = input;
+        sort(expected.begin(), expected.end());
+        vector<int> actual = input;
+        CHECK(sortIntArray(actual.data(), actual.size(), algorithm) == 0, describe(algorithm, parallel, "rejected"));
+        CHECK(actual == expected, describe(algorithm, parallel, "untraced, size " + to_string(input.size())));
+    }
+}
+
+// The last step of a trace holds the first step's values in order
+void testTraced(int algorithm, bool parallel, int mode, int lazyWindow) {
+    setSortingParallel(parallel);
+    setSortingTraceMode(mode);
+    setSortingLazySteps(lazyWindow);
+    string detail = "trace mode " + to_string(mode) + ", lazy window " + to_string(lazyWindow);
+    for (int size : {1, 2, 10, 100, 3000}) {
+        int count = performSortingOperation(algorithm, size);
+        if (mode == TRACE_OFF) {
+            CHECK(count == 0, describe(algorithm, parallel, "untraced operation recorded steps"));
+            continue;
+        }
+        CHECK(count >= 2, describe(algorithm, parallel, detail + ": too few steps"));
+        vector<test::Step> first = test::readSteps(getSortingStepBuffer(0, 1));
+        // Lazy traces grow as steps are read; the last step is final once complete
+        while (!isSortingStepsComplete()) {
+            getSortingStepBuffer(getSortingStepCount(), 1024);
+        }
+        count = getSortingStepCount();
+        vector<test::Step> last = test::readSteps(getSortingStepBuffer(count - 1, 1));
+        if (first.size() != 1 || last.size() != 1) {
+            CHECK(false, describe(algorithm, parallel, detail + ": missing steps"));
+            continue;
+        }
+        vector<int> expected = first[0].values;
+        CHECK((int)expected.size() == size, describe(algorithm, parallel, detail + ": wrong array size"));
+        sort(expected.begin(), expected.end());
+        CHECK(last[0].values == expected, describe(algorithm, parallel, detail + ", size " + to_string(size)));
+    }
+    setSortingLazySteps(0);
+    setSortingTraceMode(TRACE_FULL);
+}
+
+// Sorting a caller's array leaves the trace shown by the UI untouched
+void testTraceSurvivesUntracedSort() {
+    setSortingTraceMode(TRACE_FULL);
+    int count = performSortingOperation(0, 50);
+    vector<test::Step> before = test::readSteps(getSortingStepBuffer(0, -1));
+    for (int algorithm = 0; algorithm < 4; algorithm++) {
+        vector<int> data = {5, 3, 9, 1};
+        sortIntArray(data.data(), data.size(), algorithm);
+    }
+    vector<test::Step> after = test::readSteps(getSortingStepBuffer(0, -1));
+    CHECK(getSortingStepCount() == count, "sortIntArray changed the step count");
+    bool same = before.size() == after.size();
+    for (size_t i = 0; same && i < before.size(); i++) {
+        same = before[i].message == after[i].message && before[i].values == after[i].values;
+    }
+    CHECK(same, "sortIntArray changed the trace");
+}
+
+} // namespace
+
+int main() {
+    for (int algorithm = 0; algorithm < 4; algorithm++) {
+        for (bool parallel : {false, true}) {
+            testUntraced(algorithm, parallel);
+            for (int mode : {TRACE_FULL, TRACE_COARSE, TRACE_OFF}) {
+                testTraced(algorithm, parallel, mode, 0);
+            }
+            testTraced(algorithm, parallel, TRACE_FULL, 64);
+        }
+    }
+    testTraceSurvivesUntracedSort();
+    CHECK(sortIntArray(nullptr, 0, 4) == -1, "unknown algorithm accepted");
+    return test::finish("sort_test");
+}
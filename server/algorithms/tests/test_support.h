@@ -0,0 +1,74 @@
+// Shared helpers of the engine tests: failure counting and a reader for
+// the binary step buffer (see step_buffer.h)
+//
+// Each test program drives the engines through the C interface of
+// algorithms.h, compares their results with a plain reference
+// implementation, and exits non-zero when any check failed.
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "step_buffer.h"
+
+namespace test {
+
+inline int failures = 0;
+
+// Record a failed check; prints the first few so a broken engine does not
+// flood the log
+inline void fail(const char* file, int line, const std::string& what) {
+    failures++;
+    if (failures <= 20) {
+        std::fprintf(stderr, "%s:%d: %s\n", file, line, what.c_str());
+    }
+}
+
+// Exit status of the test program
+inline int finish(const char* name) {
+    if (failures > 0) {
+        std::fprintf(stderr, "%s: %d checks failed\n", name, failures);
+        return 1;
+    }
+    std::printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+// One step of a step buffer, decoded
+struct Step {
+    std::string message;
+    std::vector<int> values; // Element values in element order
+};
+
+// Decode the steps of a buffer returned by a get*StepBuffer function
+inline std::vector<Step> readSteps(const unsigned char* buffer) {
+    StepBufferHeader header;
+    std::memcpy(&header, buffer, sizeof(header));
+    std::vector<Step> steps(header.stepCount);
+    std::vector<uint32_t> stringIndex(header.stringCount + 1);
+    std::memcpy(stringIndex.data(), buffer + header.stringsOffset, stringIndex.size() * sizeof(uint32_t));
+    const char* pool = (const char*)buffer + header.stringsOffset + stringIndex.size() * sizeof(uint32_t);
+    for (uint32_t i = 0; i < header.stepCount; i++) {
+        StepBufferStep step;
+        std::memcpy(&step, buffer + header.stepsOffset + i * sizeof(StepBufferStep), sizeof(step));
+        steps[i].message.assign(pool + stringIndex[step.message], stringIndex[step.message + 1] - stringIndex[step.message]);
+        for (uint32_t e = step.firstElement; e < step.firstElement + step.elementCount; e++) {
+            StepBufferElement element;
+            std::memcpy(&element, buffer + header.elementsOffset + e * sizeof(StepBufferElement), sizeof(element));
+            steps[i].values.push_back(element.value);
+        }
+    }
+    return steps;
+}
+
+} // namespace test
+
+#define CHECK(condition, what) \
+    do { \
+        if (!(condition)) test::fail(__FILE__, __LINE__, what); \
+    } while (0)
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,102 @@
+// Least-recently-used cache of finished traces under a memory budget
+//
+// Re-running a traced operation on unchanged input replays the same
+// steps, so a module can keep finished traces keyed by everything that
+// decides them (the input's version, the operation and its settings) and
+// hand a cached one back instead of recomputing it. Entries are shared
+// pointers, so a trace being shown stays valid after it is evicted.
+//
+// Each entry is charged the byte size its owner reports; inserting past
+// the budget evicts the least recently used entries first, and a trace
+// larger than the whole budget is not kept at all.
+
+#ifndef TRACE_CACHE_H
+#define TRACE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+template <class Key, class Value, class Hash = std::hash<Key>>
+class TraceCache {
+public:
+    explicit TraceCache(size_t bytes) : budget(bytes), used(0) {}
+
+    // The entry for key, now the most recently used, or null
+    std::shared_ptr<const Value> find(const Key& key) {
+        auto found = index.find(key);
+        if (found == index.end()) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->value;
+    }
+
+    // Store value under key, replacing any entry there, and evict the
+    // least recently used entries until the cache fits its budget
+    void insert(const Key& key, std::shared_ptr<const Value> value, size_t bytes) {
+        erase(key);
+        if (bytes > budget) {
+            return;
+        }
+        entries.push_front({key, std::move(value), bytes});
+        index.emplace(key, entries.begin());
+        used += bytes;
+        shrink();
+    }
+
+    void erase(const Key& key) {
+        auto found = index.find(key);
+        if (found == index.end()) {
+            return;
+        }
+        used -= found->second->bytes;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+        used = 0;
+    }
+
+    // Change the budget, evicting entries beyond it (0 disables the cache)
+    void setBudget(size_t bytes) {
+        budget = bytes;
+        shrink();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Bytes charged for the cached entries
+    size_t bytes() const {
+        return used;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        std::shared_ptr<const Value> value;
+        size_t bytes;
+    };
+
+    size_t budget;
+    size_t used;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+
+    void shrink() {
+        while (used > budget) {
+            used -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+};
+
+#endif // TRACE_CACHE_H
@@ -0,0 +1,48 @@
+// Compile-time trace policies shared by the algorithm engines
+//
+// Engines take a policy as a template argument and guard every piece of
+// visualization work with `if constexpr`, so with TraceOff no state or
+// message is ever built and only the algorithm's result comes back.
+
+#ifndef TRACE_POLICY_H
+#define TRACE_POLICY_H
+
+// Record every step (compares, swaps, relaxations, cell updates)
+struct TraceFull {
+    static constexpr bool recordsSteps = true;
+    static constexpr bool recordsPhases = true;
+};
+
+// Record phase-level steps only (segments, heap built, table rows, settled nodes)
+struct TraceCoarse {
+    static constexpr bool recordsSteps = false;
+    static constexpr bool recordsPhases = true;
+};
+
+// Record nothing; the engine runs the bare algorithm
+struct TraceOff {
+    static constexpr bool recordsSteps = false;
+    static constexpr bool recordsPhases = false;
+};
+
+// Runtime trace mode as passed through the C interface
+enum TraceMode {
+    TRACE_FULL = 0,
+    TRACE_COARSE = 1,
+    TRACE_OFF = 2
+};
+
+// Call f with the policy object matching a runtime trace mode
+template <class F>
+auto withTracePolicy(int mode, F&& f) {
+    switch (mode) {
+        case TRACE_COARSE:
+            return f(TraceCoarse());
+        case TRACE_OFF:
+            return f(TraceOff());
+        default:
+            return f(TraceFull());
+    }
+}
+
+#endif // TRACE_POLICY_H
@@ -3,11 +3,24 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <emscripten/bind.h>
-#include <emscripten/emscripten.h>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "wasm_compat.h"
+#include "trace_policy.h"
+#include "step_buffer.h"
+#include "step_message.h"
+#include "visual_state.h"
 
 using namespace std;
+#ifdef __EMSCRIPTEN__
 using namespace emscripten;
+#endif
+
+// Module internals get internal linkage so the four modules can be linked
+// into one native binary without clashing type names
+namespace {
 
 // Node structure for the tree
 struct Node {
@@ -18,40 +31,43 @@ struct Node {
     Node(int value) : data(value), left(nullptr), right(nullptr) {}
 };
 
-// Representation of a node's position for visualization
-struct NodePosition {
-    int id;
-    int value;
-    double x;
-    double y;
-    bool highlighted;
-};
-
-// Representation of an edge between nodes for visualization
-struct EdgePosition {
-    int source;
-    int target;
-    bool highlighted;
+// Step message templates (see step_message.h)
+enum TreeMessage : uint16_t {
+    TREE_INSERT_START,
+    TREE_INSERT_COMPARE,
+    TREE_INSERTED,
+    TREE_SEARCH_START,
+    TREE_SEARCH_HIT,
+    TREE_SEARCH_LEFT,
+    TREE_SEARCH_RIGHT,
+    TREE_FOUND,
+    TREE_NOT_FOUND,
+    TREE_MESSAGE_COUNT
 };
 
-// Structure to hold the current state of the algorithm
-struct AlgorithmState {
-    vector<NodePosition> nodes;
-    vector<EdgePosition> edges;
-    string message;
-    int step;
-    int totalSteps;
+const char* const TREE_MESSAGES[] = {
+    "Starting BST insertion for value {0}",
+    "Comparing with node {0}",
+    "Inserted {0} into the tree",
+    "Starting BST search for value {0}",
+    "Found value {0} at this node",
+    "Checking node {0}, moving to left",
+    "Checking node {0}, moving to right",
+    "Value {0} found in the tree",
+    "Value {0} not found in the tree"
 };
+static_assert(sizeof(TREE_MESSAGES) / sizeof(TREE_MESSAGES[0]) == TREE_MESSAGE_COUNT, "one template per message");
 
 // Binary Search Tree class
 class BinarySearchTree {
 private:
     Node* root;
-    vector<AlgorithmState> states;
+    vector<VisualState> states;
     int currentStep;
     int totalSteps;
     
     // Recursive helper for insertion
+    template <class Trace>
     Node* insertRecursive(Node* current, int value, vector<int>& path) {
         // If tree is empty, create a new node
         if (current == nullptr) {
@@ -59,143 +75,135 @@ private:
         }
         
         // Keep track of the path taken
-        path.push_back(current->data);
+        if constexpr (Trace::recordsSteps) {
+            path.push_back(current->data);
+        }
         
         // Navigate to the right position
         if (value < current->data) {
-            current->left = insertRecursive(current->left, value, path);
+            current->left = insertRecursive<Trace>(current->left, value, path);
         } 
         else if (value > current->data) {
-            current->right = insertRecursive(current->right, value, path);
+            current->right = insertRecursive<Trace>(current->right, value, path);
         }
         
         return current;
     }
     
+    // Recursive helper to free a subtree
+    void destroyRecursive(Node* current) {
+        if (current == nullptr) {
+            return;
+        }
+        destroyRecursive(current->left);
+        destroyRecursive(current->right);
+        delete current;
+    }
+    
     // Helper method to find a node by value
+    template <class Trace>
     Node* findNode(Node* current, int value, vector<int>& path) {
         if (current == nullptr) {
             return nullptr;
         }
         
-        path.push_back(current->data);
+        if constexpr (Trace::recordsSteps) {
+            path.push_back(current->data);
+        }
         
         if (current->data == value) {
             return current;
         }
         
         if (value < current->data) {
-            return findNode(current->left, value, path);
+            return findNode<Trace>(current->left, value, path);
         } else {
-            return findNode(current->right, value, path);
+            return findNode<Trace>(current->right, value, path);
         }
     }
     
+    // Position of a node in the layout, keyed by its value
+    struct NodePosition {
+        int id;
+        double x;
+        double y;
+    };
+    
     // Helper method to calculate node positions for visualization
-    void calculatePositions(Node* node, double x, double y, double horizontalSpacing, int level, map<int, NodePosition>& positions, int& nextId) {
+    void calculatePositions(Node* node, double x, double y, double horizontalSpacing, int level,
+                            map<int, NodePosition>& positions, VisualLayout& layout, int& nextId) {
         if (node == nullptr) {
             return;
         }
         
         // Assign ID and position to current node
         int id = nextId++;
-        positions[node->data] = {id, node->data, x, y, false};
+        positions[node->data] = {id, x, y};
         
         // Calculate positions for children
         double nextSpacing = horizontalSpacing / 2;
         
         if (node->left) {
-            calculatePositions(node->left, x - nextSpacing, y + 100, nextSpacing, level + 1, positions, nextId);
+            calculatePositions(node->left, x - nextSpacing, y + 100, nextSpacing, level + 1, positions, layout, nextId);
             // Add edge from current to left child
-            edges.push_back({id, positions[node->left->data].id, false});
+            layout.addEdge(id, positions[node->left->data].id);
         }
         
         if (node->right) {
-            calculatePositions(node->right, x + nextSpacing, y + 100, nextSpacing, level + 1, positions, nextId);
+            calculatePositions(node->right, x + nextSpacing, y + 100, nextSpacing, level + 1, positions, layout, nextId);
             // Add edge from current to right child
-            edges.push_back({id, positions[node->right->data].id, false});
+            layout.addEdge(id, positions[node->right->data].id);
         }
     }
     
-    // Create visualization states for insertion
-    void createInsertionStates(int value) {
-        states.clear();
-        
-        // Create initial state
-        AlgorithmState initialState;
-        initialState.message = "Starting BST insertion for value " + to_string(value);
-        initialState.step = 1;
-        
+    // Lay out the current tree and return a state showing it; steps until
+    // the tree changes share the layout
+    VisualState createLayoutState(StepMessage message) {
         // Calculate positions for visualization
         map<int, NodePosition> positions;
+        auto layout = make_shared<VisualLayout>();
         int nextId = 0;
-        calculatePositions(root, 400, 60, 200, 0, positions, nextId);
+        calculatePositions(root, 400, 60, 200, 0, positions, *layout, nextId);
         
-        // Convert positions map to vector
+        // Nodes are listed in value order
+        vector<int32_t> values;
         for (const auto& pair : positions) {
-            initialState.nodes.push_back(pair.second);
+            layout->addElement(pair.second.id, pair.second.x, pair.second.y);
+            values.push_back(pair.first);
         }
         
-        // Add edges
-        initialState.edges = edges;
-        
-        states.push_back(initialState);
-        
-        // Insert the value and track the path
-        vector<int> path;
-        root = insertRecursive(root, value, path);
-        
-        // Create states for each step of the path
-        for (int i = 0; i < path.size(); i++) {
-            AlgorithmState state = initialState;
-            state.step = i + 2;
-            state.message = "Comparing with node " + to_string(path[i]);
-            
-            // Highlight the current node in the path
-            for (auto& node : state.nodes) {
-                node.highlighted = (node.value == path[i]);
-            }
-            
-            // Highlight the edge if applicable
-            if (i > 0) {
-                for (auto& edge : state.edges) {
-                    // Find the edge between the previous and current node
-                    if ((edge.source == getNodeIdByValue(state, path[i-1])) && 
-                        (edge.target == getNodeIdByValue(state, path[i]))) {
-                        edge.highlighted = true;
-                    }
+        VisualState state(move(layout), move(message));
+        state.values = move(values);
+        state.step = states.size() + 1;
+        return state;
+    }
+    
+    // Create the state for one node on the insertion or search path
+    VisualState createPathState(const VisualState& initialState, const vector<int>& path, int i) {
+        VisualState state = initialState;
+        state.step = i + 2;
+        
+        // Highlight the current node in the path
+        state.mark(getNodeIndexByValue(state, path[i]));
+        
+        // Highlight the edge if applicable
+        if (i > 0) {
+            // Find the edge between the previous and current node
+            const VisualLayout& layout = *state.layout;
+            int source = getNodeIdByValue(state, path[i-1]);
+            int target = getNodeIdByValue(state, path[i]);
+            for (int e = 0; e < layout.edgeCount(); e++) {
+                if (layout.edgeSources[e] == source && layout.edgeTargets[e] == target) {
+                    state.markEdge(e);
                 }
             }
-            
-            states.push_back(state);
         }
         
-        // Final state - adding the new node
-        AlgorithmState finalState = states.back();
-        finalState.step = path.size() + 2;
-        finalState.message = "Inserted " + to_string(value) + " into the tree";
-        
-        // Calculate new positions after insertion
-        positions.clear();
-        nextId = 0;
-        edges.clear();
-        calculatePositions(root, 400, 60, 200, 0, positions, nextId);
-        
-        // Update nodes and edges for final state
-        finalState.nodes.clear();
-        for (const auto& pair : positions) {
-            NodePosition node = pair.second;
-            // Highlight the newly inserted node
-            if (node.value == value) {
-                node.highlighted = true;
-            }
-            finalState.nodes.push_back(node);
-        }
-        
-        finalState.edges = edges;
-        states.push_back(finalState);
-        
-        // Set total steps
+        return state;
+    }
+    
+    // Set total steps once a trace is complete
+    void finishTrace() {
         totalSteps = states.size();
         currentStep = 0;
         
@@ -205,119 +213,141 @@ private:
         }
     }
     
-    // Create visualization states for search
-    void createSearchStates(int value) {
+    // Create visualization states for insertion
+    template <class Trace>
+    void createInsertionStates(int value) {
         states.clear();
         
         // Create initial state
-        AlgorithmState initialState;
-        initialState.message = "Starting BST search for value " + to_string(value);
-        initialState.step = 1;
+        VisualState initialState;
+        if constexpr (Trace::recordsPhases) {
+            initialState = createLayoutState({TREE_INSERT_START, value});
+            states.push_back(initialState);
+        }
         
-        // Calculate positions for visualization
-        map<int, NodePosition> positions;
-        int nextId = 0;
-        calculatePositions(root, 400, 60, 200, 0, positions, nextId);
+        // Insert the value and track the path
+        vector<int> path;
+        root = insertRecursive<Trace>(root, value, path);
         
-        // Convert positions map to vector
-        for (const auto& pair : positions) {
-            initialState.nodes.push_back(pair.second);
+        // Create states for each step of the path
+        if constexpr (Trace::recordsSteps) {
+            for (int i = 0; i < (int)path.size(); i++) {
+                VisualState state = createPathState(initialState, path, i);
+                state.message = StepMessage(TREE_INSERT_COMPARE, path[i]);
+                states.push_back(state);
+            }
+        }
+        
+        // Final state - adding the new node
+        if constexpr (Trace::recordsPhases) {
+            // Calculate new positions after insertion
+            VisualState finalState = createLayoutState({TREE_INSERTED, value});
+            
+            // Highlight the newly inserted node
+            finalState.mark(getNodeIndexByValue(finalState, value));
+            
+            states.push_back(finalState);
         }
         
-        // Add edges
-        initialState.edges = edges;
+        finishTrace();
+    }
+    
+    // Create visualization states for search
+    template <class Trace>
+    bool createSearchStates(int value) {
+        states.clear();
         
-        states.push_back(initialState);
+        // Create initial state
+        VisualState initialState;
+        if constexpr (Trace::recordsPhases) {
+            initialState = createLayoutState({TREE_SEARCH_START, value});
+            states.push_back(initialState);
+        }
         
         // Search for the value and track the path
         vector<int> path;
-        Node* found = findNode(root, value, path);
+        Node* found = findNode<Trace>(root, value, path);
         
         // Create states for each step of the path
-        for (int i = 0; i < path.size(); i++) {
-            AlgorithmState state = initialState;
-            state.step = i + 2;
-            
-            if (path[i] == value) {
-                state.message = "Found value " + to_string(value) + " at this node";
-            } else {
-                state.message = "Checking node " + to_string(path[i]) + ", moving to " + 
-                               (value < path[i] ? "left" : "right");
-            }
-            
-            // Highlight the current node in the path
-            for (auto& node : state.nodes) {
-                node.highlighted = (node.value == path[i]);
-            }
-            
-            // Highlight the edge if applicable
-            if (i > 0) {
-                for (auto& edge : state.edges) {
-                    // Find the edge between the previous and current node
-                    if ((edge.source == getNodeIdByValue(state, path[i-1])) && 
-                        (edge.target == getNodeIdByValue(state, path[i]))) {
-                        edge.highlighted = true;
-                    }
+        if constexpr (Trace::recordsSteps) {
+            for (int i = 0; i < (int)path.size(); i++) {
+                VisualState state = createPathState(initialState, path, i);
+                
+                if (path[i] == value) {
+                    state.message = StepMessage(TREE_SEARCH_HIT, value);
+                } else {
+                    state.message = StepMessage(value < path[i] ? TREE_SEARCH_LEFT : TREE_SEARCH_RIGHT, path[i]);
                 }
+                
+                states.push_back(state);
             }
-            
-            states.push_back(state);
         }
         
         // Final state - result of search
-        AlgorithmState finalState = states.back();
-        finalState.step = path.size() + 2;
-        
-        if (found) {
-            finalState.message = "Value " + to_string(value) + " found in the tree";
-        } else {
-            finalState.message = "Value " + to_string(value) + " not found in the tree";
+        if constexpr (Trace::recordsPhases) {
+            VisualState finalState = states.back();
+            finalState.step = states.size() + 1;
+            
+            if (found) {
+                finalState.message = StepMessage(TREE_FOUND, value);
+            } else {
+                finalState.message = StepMessage(TREE_NOT_FOUND, value);
+            }
+            
+            states.push_back(finalState);
         }
         
-        states.push_back(finalState);
-        
-        // Set total steps
-        totalSteps = states.size();
-        currentStep = 0;
-        
-        // Update all states with total steps
-        for (auto& state : states) {
-            state.totalSteps = totalSteps;
-        }
+        finishTrace();
+        return found != nullptr;
+    }
+    
+    // Helper to get a node's position in the state's layout by its value
+    int getNodeIndexByValue(const VisualState& state, int value) {
+        auto found = find(state.values.begin(), state.values.end(), value);
+        return found == state.values.end() ? -1 : (int)(found - state.values.begin());
     }
     
     // Helper to get a node's ID by its value
-    int getNodeIdByValue(const AlgorithmState& state, int value) {
-        for (const auto& node : state.nodes) {
-            if (node.value == value) {
-                return node.id;
-            }
-        }
-        return -1;
+    int getNodeIdByValue(const VisualState& state, int value) {
+        int index = getNodeIndexByValue(state, value);
+        return index < 0 ? -1 : state.layout->ids[index];
     }
     
 public:
     BinarySearchTree() : root(nullptr), currentStep(0), totalSteps(0) {}
     
+    ~BinarySearchTree() {
+        destroyRecursive(root);
+    }
+    
+    BinarySearchTree(const BinarySearchTree&) = delete;
+    BinarySearchTree& operator=(const BinarySearchTree&) = delete;
+    
+    // Remove all values and recorded steps
+    void clear() {
+        destroyRecursive(root);
+        root = nullptr;
+        states.clear();
+        currentStep = 0;
+        totalSteps = 0;
+    }
+    
     // Insert a value into the tree
+    template <class Trace = TraceFull>
     void insert(int value) {
-        createInsertionStates(value);
+        createInsertionStates<Trace>(value);
     }
     
     // Search for a value in the tree
+    template <class Trace = TraceFull>
     bool search(int value) {
-        createSearchStates(value);
-        
-        // Perform the actual search
-        vector<int> path;
-        Node* found = findNode(root, value, path);
-        return found != nullptr;
+        return createSearchStates<Trace>(value);
     }
     
     // Get the current state
-    AlgorithmState getCurrentState() {
+    VisualState getCurrentState() {
         if (states.empty()) {
-            return AlgorithmState();
+            return VisualState();
         }
         return states[currentStep];
     }
@@ -327,10 +357,20 @@ public:
         return totalSteps;
     }
     
+    // Write a window of steps into a binary step buffer (see step_buffer.h)
+    void writeSteps(StepBufferWriter& writer, int firstStep, int count) const {
+        clampStepWindow(states.size(), firstStep, count);
+        writer.begin(totalSteps, firstStep);
+        for (int step = firstStep; step < firstStep + count; step++) {
+            writeVisualState(writer, step, states[step], TREE_MESSAGES);
+        }
+        writer.finish();
+    }
+    
     // Get a specific step
-    AlgorithmState getStep(int step) {
-        if (step < 0 || step >= states.size()) {
-            return AlgorithmState();
+    VisualState getStep(int step) {
+        if (step < 0 || step >= (int)states.size()) {
+            return VisualState();
         }
         return states[step];
     }
@@ -339,22 +379,38 @@ public:
 // Global instance of the BST
 BinarySearchTree bst;
 
+// Trace mode used by performOperation (see TraceMode)
+int treeTraceMode = TRACE_FULL;
+
+// Binary step buffer handed out by getStepBuffer
+StepBufferWriter treeStepBuffer;
+
+} // namespace
+
 // External interface functions
 
 // Perform an operation on the BST
 extern "C" EMSCRIPTEN_KEEPALIVE int performOperation(int operation, int value) {
-    switch (operation) {
-        case 0: // Insert
-            bst.insert(value);
-            break;
-        case 1: // Search
-            bst.search(value);
-            break;
-        // Case 2 would be delete
-        default:
-            return -1;
-    }
-    return bst.getStepCount();
+    bool known = withTracePolicy(treeTraceMode, [&](auto policy) {
+        using Trace = decltype(policy);
+        switch (operation) {
+            case 0: // Insert
+                bst.insert<Trace>(value);
+                return true;
+            case 1: // Search
+                bst.search<Trace>(value);
+                return true;
+            // Case 2 would be delete
+            default:
+                return false;
+        }
+    });
+    return known ? bst.getStepCount() : -1;
+}
+
+// Select full, coarse or no tracing for subsequent tree operations
+extern "C" EMSCRIPTEN_KEEPALIVE void setTreeTraceMode(int mode) {
+    treeTraceMode = mode;
 }
 
 // Get the number of steps in the current operation
@@ -364,13 +420,13 @@ extern "C" EMSCRIPTEN_KEEPALIVE int getStepCount() {
 
 // Get a specific step's data
 extern "C" EMSCRIPTEN_KEEPALIVE char* getStepData(int step) {
-    AlgorithmState state = bst.getStep(step);
+    VisualState state = bst.getStep(step);
     
     // Convert state to JSON or another format that can be passed to JavaScript
     // This is a simplified version - you'd need to serialize the state properly
     string result = "{\"step\":" + to_string(state.step) + 
                     ",\"totalSteps\":" + to_string(state.totalSteps) + 
-                    ",\"message\":\"" + state.message + "\"}";
+                    ",\"message\":\"" + escapeJson(formatStepMessage(TREE_MESSAGES, state.message)) + "\"}";
     
     // Allocate memory for the result that JavaScript can free later
     char* buffer = (char*)malloc(result.length() + 1);
@@ -383,12 +439,31 @@ extern "C" EMSCRIPTEN_KEEPALIVE void freeStepData(char* ptr) {
     free(ptr);
 }
 
+// Write steps [firstStep, firstStep + count) (count < 0 for all remaining
+// steps) into the binary step buffer and return its address; the buffer
+// stays valid until the next call (layout in step_buffer.h)
+extern "C" EMSCRIPTEN_KEEPALIVE const unsigned char* getStepBuffer(int firstStep, int count) {
+    bst.writeSteps(treeStepBuffer, firstStep, count);
+    return treeStepBuffer.data();
+}
+
+// Size in bytes of the last buffer returned by getStepBuffer
+extern "C" EMSCRIPTEN_KEEPALIVE int getStepBufferSize() {
+    return treeStepBuffer.size();
+}
+
+// Remove all values from the tree
+extern "C" EMSCRIPTEN_KEEPALIVE void resetTree() {
+    bst.clear();
+}
+
+#ifdef __EMSCRIPTEN__
 // Bind the C++ class and methods to JavaScript
 EMSCRIPTEN_BINDINGS(bst_module) {
     class_<BinarySearchTree>("BinarySearchTree")
         .constructor()
-        .function("insert", &BinarySearchTree::insert)
-        .function("search", &BinarySearchTree::search)
+        .function("insert", &BinarySearchTree::insert<TraceFull>)
+        .function("search", &BinarySearchTree::search<TraceFull>)
         .function("getStepCount", &BinarySearchTree::getStepCount);
 }
 
@@ -401,3 +476,4 @@ int main() {
     bst.insert(15);
     return 0;
 }
+#endif
@@ -0,0 +1,127 @@
+// Compact visual state shared by the algorithm modules
+//
+// Every step of a trace draws the same structure (array bars, graph or tree
+// nodes, DP cells) with different values and highlights. What stays fixed
+// across steps -- element ids, layout coordinates and edges -- is computed
+// once per structure into a VisualLayout that all of its steps share. A
+// VisualState holds only what a step changes, as parallel arrays of int32
+// values and uint8 flag masks (the StepBufferFlags bits), so a step costs
+// 5 bytes per element and 1 per edge and copying one is a few memcpys.
+// Messages stay unformatted until a step is written (see step_message.h).
+
+#ifndef VISUAL_STATE_H
+#define VISUAL_STATE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "step_buffer.h"
+#include "step_message.h"
+
+// Element ids, positions and edges of one laid-out structure
+struct VisualLayout {
+    std::vector<int32_t> ids;
+    std::vector<float> x;
+    std::vector<float> y;
+    float yPerValue = 0; // Bars rise with their value: y = y[i] + value * yPerValue
+
+    std::vector<int32_t> edgeSources;
+    std::vector<int32_t> edgeTargets;
+    std::vector<int32_t> edgeWeights;
+
+    int size() const {
+        return ids.size();
+    }
+
+    int edgeCount() const {
+        return edgeSources.size();
+    }
+
+    // Heap bytes held by the layout
+    size_t memoryBytes() const {
+        return ids.capacity() * sizeof(int32_t) + (x.capacity() + y.capacity()) * sizeof(float) +
+               (edgeSources.capacity() + edgeTargets.capacity() + edgeWeights.capacity()) * sizeof(int32_t);
+    }
+
+    void addElement(int id, double px, double py) {
+        ids.push_back(id);
+        x.push_back((float)px);
+        y.push_back((float)py);
+    }
+
+    void addEdge(int source, int target, int weight = 0) {
+        edgeSources.push_back(source);
+        edgeTargets.push_back(target);
+        edgeWeights.push_back(weight);
+    }
+
+    // Index of the element with the given id, or -1
+    int indexOf(int id) const {
+        auto found = std::find(ids.begin(), ids.end(), id);
+        return found == ids.end() ? -1 : (int)(found - ids.begin());
+    }
+};
+
+// What one step shows: a value and flags per layout element, flags per edge
+struct VisualState {
+    std::shared_ptr<const VisualLayout> layout;
+    std::vector<int32_t> values;
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> edgeFlags;
+    StepMessage message;
+    int step = 0;
+    int totalSteps = 0;
+
+    VisualState() = default;
+
+    // The layout with every value zero and nothing highlighted
+    VisualState(std::shared_ptr<const VisualLayout> stateLayout, StepMessage stateMessage)
+        : layout(std::move(stateLayout)),
+          values(layout->size(), 0),
+          flags(layout->size(), 0),
+          edgeFlags(layout->edgeCount(), 0),
+          message(std::move(stateMessage)) {}
+
+    // Set flags on an element; out-of-range indices (such as -1 for "none") are ignored
+    void mark(int element, uint8_t flag = STEP_HIGHLIGHTED) {
+        if (element >= 0 && element < (int)flags.size()) {
+            flags[element] |= flag;
+        }
+    }
+
+    void markEdge(int edge, uint8_t flag = STEP_HIGHLIGHTED) {
+        if (edge >= 0 && edge < (int)edgeFlags.size()) {
+            edgeFlags[edge] |= flag;
+        }
+    }
+};
+
+// Add a state to a step buffer as step number step + 1, formatting its
+// message with the module's table. With labelValues every element also
+// carries its value as a text label (DP cells).
+inline void writeVisualState(StepBufferWriter& writer, int step, const VisualState& state,
+                             MessageTable messages, bool labelValues = false) {
+    writer.addStep(step + 1, formatStepMessage(messages, state.message));
+    if (!state.layout) {
+        return;
+    }
+
+    const VisualLayout& layout = *state.layout;
+    std::string label;
+    for (int i = 0; i < layout.size(); i++) {
+        int value = state.values[i];
+        double y = layout.y[i] + (double)value * layout.yPerValue;
+        if (labelValues) {
+            label = std::to_string(value);
+        }
+        writer.addElement(layout.ids[i], value, layout.x[i], y, state.flags[i], labelValues ? &label : nullptr);
+    }
+    for (int e = 0; e < layout.edgeCount(); e++) {
+        writer.addEdge(layout.edgeSources[e], layout.edgeTargets[e], layout.edgeWeights[e], state.edgeFlags[e]);
+    }
+}
+
+#endif // VISUAL_STATE_H
@@ -0,0 +1,14 @@
+// Emscripten compatibility shim so the algorithm modules also build natively
+
+#ifndef WASM_COMPAT_H
+#define WASM_COMPAT_H
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/bind.h>
+#include <emscripten/emscripten.h>
+#else
+// Native builds have no JS glue; exported functions are plain extern "C" symbols
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
+#endif // WASM_COMPAT_H
@@ -3,6 +3,19 @@ import { registerRoutes } from "./routes";
 import { setupVite, serveStatic, log } from "./vite";
 
 const app = express();
+
+// Keep every response cross-origin isolated so the threaded algorithm
+// modules can use SharedArrayBuffer. COEP is credentialless rather than
+// require-corp so that cross-origin scripts without CORP headers, like the
+// Replit dev banner in client/index.html, still load (without cookies).
+app.use((_req, res, next) => {
+  res.set({
+    "Cross-Origin-Opener-Policy": "same-origin",
+    "Cross-Origin-Embedder-Policy": "credentialless",
+  });
+  next();
+});
+
 app.use(express.json());
 app.use(express.urlencoded({ extended: false }));
 